@@ -30,6 +30,7 @@
 #include "poppler-document.h"
 #include "poppler-embedded-file.h"
 #include "poppler-page.h"
+#include "poppler-text-index.h"
 #include "poppler-toc.h"
 
 #include "poppler-destination-private.h"
@@ -37,6 +38,7 @@
 #include "poppler-embedded-file-private.h"
 #include "poppler-page-private.h"
 #include "poppler-private.h"
+#include "poppler-text-index-private.h"
 #include "poppler-toc-private.h"
 
 #include "Catalog.h"
@@ -45,6 +47,7 @@
 #include "GlobalParams.h"
 #include "Link.h"
 #include "Outline.h"
+#include "TextIndex.h"
 
 #include <algorithm>
 #include <iterator>
@@ -1059,6 +1062,24 @@ toc *document::create_toc() const
     return toc_private::load_from_outline(d->doc->getOutline());
 }
 
+/**
+ Extracts the text of all the pages of the %document and indexes its words.
+
+ This takes about as long as reading the text of every page; the index can be
+ saved with text_index::save() so that it only has to be made once.
+
+ \returns a new text_index object, NULL if the %document is locked
+
+ \since 25.07
+ */
+text_index *document::create_text_index() const
+{
+    if (d->is_locked) {
+        return nullptr;
+    }
+    return text_index_private::create(TextIndex::build(d->doc));
+}
+
 /**
  Reads whether the current document has %document-level embedded files
  (attachments).
@@ -34,6 +34,7 @@ class destination;
 class document_private;
 class embedded_file;
 class page;
+class text_index;
 class toc;
 
 class POPPLER_CPP_EXPORT document : public poppler::noncopyable
@@ -125,6 +126,7 @@ public:
     font_iterator *create_font_iterator(int start_page = 0) const;
 
     toc *create_toc() const;
+    text_index *create_text_index() const;
 
     bool has_embedded_files() const;
     std::vector<embedded_file *> embedded_files() const;
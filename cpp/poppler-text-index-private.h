@@ -0,0 +1,42 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street - Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef POPPLER_TEXT_INDEX_PRIVATE_H
+#define POPPLER_TEXT_INDEX_PRIVATE_H
+
+#include "poppler-text-index.h"
+
+#include <memory>
+
+class PDFDoc;
+class TextIndex;
+
+namespace poppler {
+
+class text_index_private
+{
+public:
+    text_index_private();
+    ~text_index_private();
+
+    static text_index *create(std::unique_ptr<TextIndex> &&index);
+
+    std::unique_ptr<TextIndex> index;
+};
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street - Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/**
+ \file poppler-text-index.h
+ */
+#include "poppler-text-index.h"
+
+#include "poppler-text-index-private.h"
+#include "poppler-private.h"
+
+#include "TextIndex.h"
+
+using namespace poppler;
+
+text_index_private::text_index_private() = default;
+
+text_index_private::~text_index_private() = default;
+
+text_index *text_index_private::create(std::unique_ptr<TextIndex> &&index)
+{
+    if (!index) {
+        return nullptr;
+    }
+
+    text_index *new_index = new text_index();
+    new_index->d->index = std::move(index);
+    return new_index;
+}
+
+/**
+ \class poppler::text_index poppler-text-index.h "poppler/cpp/poppler-text-index.h"
+
+ A full-text index of the words of a PDF %document.
+
+ The index is made once, with document::create_text_index(), and can be saved
+ to a file and loaded again without the %document. Searching the index does
+ not need to extract the text of the pages again, so it is much faster than
+ page::search() over all the pages of a large %document.
+
+ Words are compared ignoring case, diacritics and punctuation, so "resume"
+ finds "Résumé,".
+
+ \since 25.07
+ */
+
+/**
+ \struct poppler::text_index::match poppler-text-index.h "poppler/cpp/poppler-text-index.h"
+
+ A match of a search: the page (starting from 0) and the areas of the words,
+ in the unrotated page, one per word of the searched text.
+ */
+
+text_index::text_index() : d(new text_index_private()) { }
+
+/**
+ Destroys the index.
+ */
+text_index::~text_index()
+{
+    delete d;
+}
+
+/**
+ Loads an index saved with save(). The file is mapped in memory, not read, so
+ loading a large index is cheap.
+
+ \returns a new text_index, or NULL if the file cannot be opened or is not an
+ index saved on a machine of the same byte order
+ */
+text_index *text_index::load_from_file(const std::string &file_name)
+{
+    return text_index_private::create(TextIndex::load(file_name));
+}
+
+/**
+ Saves the index to \p file_name.
+
+ \returns true on success, false on failure
+ */
+bool text_index::save(const std::string &file_name) const
+{
+    return d->index->save(file_name);
+}
+
+/**
+ \returns the number of pages of the indexed %document
+ */
+int text_index::pages() const
+{
+    return d->index->getNumPages();
+}
+
+/**
+ Finds the places where the words of \p text follow each other on a page.
+
+ \param text the text to search for
+ \param prefix whether the last word of \p text may be the start of a longer
+               word, for searching as the text is typed
+
+ \returns the matches, in page order
+ */
+std::vector<text_index::match> text_index::search(const ustring &text, bool prefix) const
+{
+    const size_t len = text.length();
+    std::vector<Unicode> u(len);
+    for (size_t i = 0; i < len; ++i) {
+        u[i] = text[i];
+    }
+
+    std::vector<match> matches;
+    for (const TextIndex::Match &m : d->index->find(u.data(), len, prefix)) {
+        match new_match;
+        new_match.page = m.page - 1;
+        for (const PDFRectangle &rect : m.rects) {
+            new_match.rects.push_back(detail::pdfrectangle_to_rectf(rect));
+        }
+        matches.push_back(std::move(new_match));
+    }
+    return matches;
+}
@@ -0,0 +1,57 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street - Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef POPPLER_TEXT_INDEX_H
+#define POPPLER_TEXT_INDEX_H
+
+#include "poppler-global.h"
+#include "poppler-rectangle.h"
+
+#include <string>
+#include <vector>
+
+namespace poppler {
+
+class text_index_private;
+
+class POPPLER_CPP_EXPORT text_index : public poppler::noncopyable
+{
+public:
+    struct match
+    {
+        int page;
+        std::vector<rectf> rects;
+    };
+
+    ~text_index();
+
+    static text_index *load_from_file(const std::string &file_name);
+    bool save(const std::string &file_name) const;
+
+    int pages() const;
+    std::vector<match> search(const ustring &text, bool prefix = false) const;
+
+private:
+    text_index();
+
+    text_index_private *d;
+
+    friend class text_index_private;
+};
+
+}
+
+#endif
@@ -55,6 +55,7 @@
 #    include <SplashOutputDev.h>
 #    include <Stream.h>
 #    include <FontInfo.h>
+#    include <TextIndex.h>
 #    include <PDFDocEncoding.h>
 #    include <OptionalContent.h>
 #    include <ViewerPreferences.h>
@@ -3195,6 +3196,259 @@ void poppler_font_info_free(PopplerFontInfo *font_info)
     g_object_unref(font_info);
 }
 
+/* Text index */
+
+typedef struct _PopplerTextIndexClass PopplerTextIndexClass;
+struct _PopplerTextIndexClass
+{
+    GObjectClass parent_class;
+};
+
+/**
+ * PopplerTextIndex:
+ *
+ * A full-text index of the words of a #PopplerDocument.
+ *
+ * The index is made once, with poppler_text_index_new(), and can be saved
+ * to a file and loaded again without the document. Searching the index
+ * doesn't extract the text of the pages again, so it is much faster than
+ * poppler_page_find_text() on every page of a large document.
+ *
+ * Words are compared ignoring case, diacritics and punctuation, so
+ * "resume" finds "Résumé,".
+ *
+ * Since: 25.07
+ */
+G_DEFINE_TYPE(PopplerTextIndex, poppler_text_index, G_TYPE_OBJECT)
+
+static void poppler_text_index_finalize(GObject *object);
+
+static void poppler_text_index_class_init(PopplerTextIndexClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->finalize = poppler_text_index_finalize;
+}
+
+static void poppler_text_index_init(PopplerTextIndex *text_index)
+{
+    text_index->index = nullptr;
+}
+
+static void poppler_text_index_finalize(GObject *object)
+{
+    PopplerTextIndex *text_index = POPPLER_TEXT_INDEX(object);
+
+    delete text_index->index;
+
+    G_OBJECT_CLASS(poppler_text_index_parent_class)->finalize(object);
+}
+
+static PopplerTextIndex *_poppler_text_index_new(std::unique_ptr<TextIndex> &&index)
+{
+    PopplerTextIndex *text_index;
+
+    text_index = (PopplerTextIndex *)g_object_new(POPPLER_TYPE_TEXT_INDEX, nullptr);
+    text_index->index = index.release();
+
+    return text_index;
+}
+
+/**
+ * poppler_text_index_new:
+ * @document: a #PopplerDocument
+ *
+ * Extracts the text of all the pages of @document and indexes its words.
+ *
+ * This takes about as long as getting the text of every page; the index
+ * can be saved with poppler_text_index_save() so that it only has to be
+ * made once.
+ *
+ * Returns: (transfer full) (nullable): a new #PopplerTextIndex, or %NULL
+ *   if the document is too large to index
+ *
+ * Since: 25.07
+ */
+PopplerTextIndex *poppler_text_index_new(PopplerDocument *document)
+{
+    g_return_val_if_fail(POPPLER_IS_DOCUMENT(document), NULL);
+
+    std::unique_ptr<TextIndex> index = TextIndex::build(document->doc);
+    if (!index) {
+        return nullptr;
+    }
+
+    return _poppler_text_index_new(std::move(index));
+}
+
+/**
+ * poppler_text_index_new_from_file:
+ * @filename: (type filename): the file of an index saved with
+ *   poppler_text_index_save()
+ * @error: (allow-none): Return location for an error, or %NULL
+ *
+ * Loads an index saved with poppler_text_index_save(). The file is mapped
+ * into memory, not read, so loading a large index is cheap. It must have
+ * been saved on a machine of the same byte order, and is checked in full,
+ * so a damaged index fails to load with %POPPLER_ERROR_DAMAGED.
+ *
+ * Returns: (transfer full) (nullable): a new #PopplerTextIndex, or %NULL
+ *
+ * Since: 25.07
+ */
+PopplerTextIndex *poppler_text_index_new_from_file(const char *filename, GError **error)
+{
+    g_return_val_if_fail(filename != nullptr, NULL);
+    g_return_val_if_fail(error == nullptr || *error == nullptr, NULL);
+
+    std::unique_ptr<TextIndex> index = TextIndex::load(filename);
+    if (!index) {
+        g_set_error(error, POPPLER_ERROR, POPPLER_ERROR_DAMAGED, "Failed to load text index %s", filename);
+        return nullptr;
+    }
+
+    return _poppler_text_index_new(std::move(index));
+}
+
+/**
+ * poppler_text_index_save:
+ * @text_index: a #PopplerTextIndex
+ * @filename: (type filename): the file to write
+ * @error: (allow-none): Return location for an error, or %NULL
+ *
+ * Saves @text_index to @filename, to be loaded with
+ * poppler_text_index_new_from_file().
+ *
+ * Returns: %TRUE, if the index was saved successfully
+ *
+ * Since: 25.07
+ */
+gboolean poppler_text_index_save(PopplerTextIndex *text_index, const char *filename, GError **error)
+{
+    g_return_val_if_fail(POPPLER_IS_TEXT_INDEX(text_index), FALSE);
+    g_return_val_if_fail(filename != nullptr, FALSE);
+    g_return_val_if_fail(error == nullptr || *error == nullptr, FALSE);
+
+    if (!text_index->index->save(filename)) {
+        g_set_error(error, POPPLER_ERROR, POPPLER_ERROR_OPEN_FILE, "Failed to save text index to %s", filename);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * poppler_text_index_get_n_pages:
+ * @text_index: a #PopplerTextIndex
+ *
+ * Returns: the number of pages of the indexed document
+ *
+ * Since: 25.07
+ */
+int poppler_text_index_get_n_pages(PopplerTextIndex *text_index)
+{
+    g_return_val_if_fail(POPPLER_IS_TEXT_INDEX(text_index), 0);
+
+    return text_index->index->getNumPages();
+}
+
+/**
+ * poppler_text_index_find:
+ * @text_index: a #PopplerTextIndex
+ * @text: the text to search for (UTF-8 encoded)
+ * @prefix: whether the last word of @text may be the start of a longer
+ *   word, for searching as the text is typed
+ *
+ * Finds the places where the words of @text follow each other on a page.
+ *
+ * Return value: (element-type PopplerTextIndexMatch) (transfer full): a
+ *   newly allocated list of newly allocated #PopplerTextIndexMatch, in page
+ *   order. Free with g_list_free_full() using poppler_text_index_match_free().
+ *
+ * Since: 25.07
+ */
+GList *poppler_text_index_find(PopplerTextIndex *text_index, const char *text, gboolean prefix)
+{
+    GList *matches = nullptr;
+    gunichar *ucs4;
+    glong ucs4_len;
+
+    g_return_val_if_fail(POPPLER_IS_TEXT_INDEX(text_index), NULL);
+    g_return_val_if_fail(text != nullptr, NULL);
+
+    ucs4 = g_utf8_to_ucs4_fast(text, -1, &ucs4_len);
+
+    for (const TextIndex::Match &m : text_index->index->find(ucs4, static_cast<int>(ucs4_len), prefix)) {
+        PopplerTextIndexMatch *match = poppler_text_index_match_new();
+
+        match->page_index = m.page - 1;
+        for (const PDFRectangle &rect : m.rects) {
+            match->areas = g_list_prepend(match->areas, poppler_rectangle_new_from_pdf_rectangle(&rect));
+        }
+        match->areas = g_list_reverse(match->areas);
+        matches = g_list_prepend(matches, match);
+    }
+
+    g_free(ucs4);
+
+    return g_list_reverse(matches);
+}
+
+/* PopplerTextIndexMatch type */
+G_DEFINE_BOXED_TYPE(PopplerTextIndexMatch, poppler_text_index_match, poppler_text_index_match_copy, poppler_text_index_match_free)
+
+/**
+ * poppler_text_index_match_new:
+ *
+ * Creates a new #PopplerTextIndexMatch
+ *
+ * Returns: a new #PopplerTextIndexMatch, use poppler_text_index_match_free() to free it
+ *
+ * Since: 25.07
+ */
+PopplerTextIndexMatch *poppler_text_index_match_new(void)
+{
+    return g_slice_new0(PopplerTextIndexMatch);
+}
+
+/**
+ * poppler_text_index_match_copy:
+ * @match: a #PopplerTextIndexMatch to copy
+ *
+ * Creates a copy of @match
+ *
+ * Returns: a new allocated copy of @match
+ *
+ * Since: 25.07
+ */
+PopplerTextIndexMatch *poppler_text_index_match_copy(PopplerTextIndexMatch *match)
+{
+    PopplerTextIndexMatch *new_match;
+
+    new_match = g_slice_dup(PopplerTextIndexMatch, match);
+    new_match->areas = g_list_copy_deep(match->areas, (GCopyFunc)poppler_rectangle_copy, nullptr);
+
+    return new_match;
+}
+
+/**
+ * poppler_text_index_match_free:
+ * @match: a #PopplerTextIndexMatch
+ *
+ * Frees the given #PopplerTextIndexMatch and its areas
+ *
+ * Since: 25.07
+ */
+void poppler_text_index_match_free(PopplerTextIndexMatch *match)
+{
+    if (G_UNLIKELY(!match)) {
+        return;
+    }
+
+    g_list_free_full(match->areas, (GDestroyNotify)poppler_rectangle_free);
+    g_slice_free(PopplerTextIndexMatch, match);
+}
+
 /* Optional content (layers) */
 static Layer *layer_new(OptionalContentGroup *oc)
 {
@@ -463,6 +463,50 @@ gboolean poppler_font_info_scan(PopplerFontInfo *font_info, int n_pages, Poppler
 POPPLER_PUBLIC
 void poppler_font_info_free(PopplerFontInfo *font_info);
 
+#define POPPLER_TYPE_TEXT_INDEX (poppler_text_index_get_type())
+#define POPPLER_TEXT_INDEX(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), POPPLER_TYPE_TEXT_INDEX, PopplerTextIndex))
+#define POPPLER_IS_TEXT_INDEX(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), POPPLER_TYPE_TEXT_INDEX))
+POPPLER_PUBLIC
+GType poppler_text_index_get_type(void) G_GNUC_CONST;
+POPPLER_PUBLIC
+PopplerTextIndex *poppler_text_index_new(PopplerDocument *document);
+POPPLER_PUBLIC
+PopplerTextIndex *poppler_text_index_new_from_file(const char *filename, GError **error);
+POPPLER_PUBLIC
+gboolean poppler_text_index_save(PopplerTextIndex *text_index, const char *filename, GError **error);
+POPPLER_PUBLIC
+int poppler_text_index_get_n_pages(PopplerTextIndex *text_index);
+POPPLER_PUBLIC
+GList *poppler_text_index_find(PopplerTextIndex *text_index, const char *text, gboolean prefix);
+
+/**
+ * PopplerTextIndexMatch:
+ * @page_index: the index of the page, starting from 0
+ * @areas: (element-type PopplerRectangle): the areas of the matching words,
+ *   one for each word of the searched text
+ *
+ * A match found by poppler_text_index_find(). The areas are in points, with
+ * the origin at the top left of the unrotated page, as those of
+ * poppler_page_get_text_layout().
+ *
+ * Since: 25.07
+ */
+struct _PopplerTextIndexMatch
+{
+    gint page_index;
+    GList *areas;
+};
+
+#define POPPLER_TYPE_TEXT_INDEX_MATCH (poppler_text_index_match_get_type())
+POPPLER_PUBLIC
+GType poppler_text_index_match_get_type(void) G_GNUC_CONST;
+POPPLER_PUBLIC
+PopplerTextIndexMatch *poppler_text_index_match_new(void);
+POPPLER_PUBLIC
+PopplerTextIndexMatch *poppler_text_index_match_copy(PopplerTextIndexMatch *match);
+POPPLER_PUBLIC
+void poppler_text_index_match_free(PopplerTextIndexMatch *match);
+
 #define POPPLER_TYPE_FONTS_ITER (poppler_fonts_iter_get_type())
 POPPLER_PUBLIC
 GType poppler_fonts_iter_get_type(void) G_GNUC_CONST;
@@ -551,6 +595,8 @@ G_END_DECLS
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PopplerDocument, g_object_unref)
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PopplerIndexIter, poppler_index_iter_free)
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PopplerFontInfo, poppler_font_info_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PopplerTextIndex, g_object_unref)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PopplerTextIndexMatch, poppler_text_index_match_free)
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PopplerFontsIter, poppler_fonts_iter_free)
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PopplerLayersIter, poppler_layers_iter_free)
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PopplerPSFile, poppler_ps_file_free)
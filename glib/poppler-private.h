@@ -13,6 +13,7 @@
 #    include <Gfx.h>
 #    include <FontInfo.h>
 #    include <TextOutputDev.h>
+#    include <TextIndex.h>
 #    include <Catalog.h>
 #    include <OptionalContent.h>
 #    include <CairoOutputDev.h>
@@ -59,6 +60,13 @@ struct _PopplerFontInfo
     FontInfoScanner *scanner;
 };
 
+struct _PopplerTextIndex
+{
+    /*< private >*/
+    GObject parent_instance;
+    TextIndex *index;
+};
+
 struct _PopplerPage
 {
     /*< private >*/
@@ -290,6 +290,8 @@ typedef struct _PopplerFormFieldMapping PopplerFormFieldMapping;
 typedef struct _PopplerAnnotMapping PopplerAnnotMapping;
 typedef struct _PopplerPage PopplerPage;
 typedef struct _PopplerFontInfo PopplerFontInfo;
+typedef struct _PopplerTextIndex PopplerTextIndex;
+typedef struct _PopplerTextIndexMatch PopplerTextIndexMatch;
 typedef struct _PopplerLayer PopplerLayer;
 typedef struct _PopplerPSFile PopplerPSFile;
 typedef union _PopplerAction PopplerAction;
@@ -0,0 +1,95 @@
+/*
+ * testing program for PopplerTextIndex
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <poppler.h>
+
+static void check_brown_fox(PopplerTextIndex *text_index)
+{
+    GList *matches;
+    PopplerTextIndexMatch *match;
+
+    g_assert_cmpint(poppler_text_index_get_n_pages(text_index), ==, 1);
+
+    matches = poppler_text_index_find(text_index, "Brown fox", FALSE);
+    g_assert_cmpuint(g_list_length(matches), ==, 1);
+    match = (PopplerTextIndexMatch *)matches->data;
+    g_assert_cmpint(match->page_index, ==, 0);
+    g_assert_cmpuint(g_list_length(match->areas), ==, 2);
+    g_list_free_full(matches, (GDestroyNotify)poppler_text_index_match_free);
+
+    matches = poppler_text_index_find(text_index, "jumps ov", TRUE);
+    g_assert_cmpuint(g_list_length(matches), ==, 1);
+    g_list_free_full(matches, (GDestroyNotify)poppler_text_index_match_free);
+
+    matches = poppler_text_index_find(text_index, "jumps ov", FALSE);
+    g_assert_null(matches);
+}
+
+/*
+ * main
+ */
+int main(int argc, char *argv[])
+{
+    GFile *infile;
+    PopplerDocument *doc;
+    PopplerTextIndex *text_index, *loaded;
+    char *filename;
+    GError *err = NULL;
+    int fd;
+
+    /* open file */
+
+    infile = g_file_new_for_path(TESTDATADIR "/unittestcases/WithActualText.pdf");
+    if (!infile) {
+        exit(EXIT_FAILURE);
+    }
+
+    doc = poppler_document_new_from_gfile(infile, NULL, NULL, &err);
+    if (doc == NULL) {
+        g_printerr("error opening pdf file: %s\n", err->message);
+        g_error_free(err);
+        exit(EXIT_FAILURE);
+    }
+
+    /* index the document, and search it */
+
+    text_index = poppler_text_index_new(doc);
+    g_assert_nonnull(text_index);
+    check_brown_fox(text_index);
+
+    /* save the index, and search it again once loaded */
+
+    fd = g_file_open_tmp("poppler-text-index-XXXXXX", &filename, &err);
+    g_assert_no_error(err);
+    g_close(fd, NULL);
+
+    g_assert_true(poppler_text_index_save(text_index, filename, &err));
+    g_assert_no_error(err);
+    loaded = poppler_text_index_new_from_file(filename, &err);
+    g_assert_no_error(err);
+    g_assert_nonnull(loaded);
+    check_brown_fox(loaded);
+    g_clear_object(&loaded);
+
+    /* a file that isn't an index fails to load */
+
+    g_assert_true(g_file_set_contents(filename, "%PDF-1.7\n", -1, &err));
+    loaded = poppler_text_index_new_from_file(filename, &err);
+    g_assert_null(loaded);
+    g_assert_error(err, POPPLER_ERROR, POPPLER_ERROR_DAMAGED);
+    g_clear_error(&err);
+
+    g_unlink(filename);
+    g_free(filename);
+    g_clear_object(&text_index);
+    g_clear_object(&doc);
+    g_clear_object(&infile);
+
+    return EXIT_SUCCESS;
+}
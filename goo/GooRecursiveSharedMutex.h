@@ -0,0 +1,73 @@
+//========================================================================
+//
+// GooRecursiveSharedMutex.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef GOO_RECURSIVE_SHARED_MUTEX_H
+#define GOO_RECURSIVE_SHARED_MUTEX_H
+
+#include <atomic>
+#include <shared_mutex>
+#include <thread>
+
+// A reader/writer mutex for objects that are read by many threads and
+// only rarely modified.  It can be used with std::scoped_lock (exclusive)
+// and std::shared_lock (shared).
+//
+// The exclusive lock is recursive, and the thread holding it may also
+// take shared locks, so code that modifies an object can call back into
+// its readers.  Shared locks can't be upgraded: a thread holding only a
+// shared lock must not take the exclusive lock.
+class GooRecursiveSharedMutex
+{
+public:
+    GooRecursiveSharedMutex() = default;
+
+    GooRecursiveSharedMutex(const GooRecursiveSharedMutex &) = delete;
+    GooRecursiveSharedMutex &operator=(const GooRecursiveSharedMutex &) = delete;
+
+    void lock()
+    {
+        if (owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+            ++depth;
+            return;
+        }
+        mutex.lock();
+        owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        depth = 1;
+    }
+
+    void unlock()
+    {
+        if (--depth == 0) {
+            owner.store(std::thread::id(), std::memory_order_relaxed);
+            mutex.unlock();
+        }
+    }
+
+    void lock_shared()
+    {
+        if (owner.load(std::memory_order_relaxed) != std::this_thread::get_id()) {
+            mutex.lock_shared();
+        }
+    }
+
+    void unlock_shared()
+    {
+        if (owner.load(std::memory_order_relaxed) != std::this_thread::get_id()) {
+            mutex.unlock_shared();
+        }
+    }
+
+private:
+    std::shared_mutex mutex;
+    // only ever equal to the id of the current thread if that thread
+    // holds the exclusive lock, so relaxed accesses are enough
+    std::atomic<std::thread::id> owner;
+    int depth = 0;
+};
+
+#endif
@@ -43,7 +43,11 @@
 #    include <climits>
 #    include <cstring>
 #    include <pwd.h>
+#    ifdef HAVE_SYS_MMAN_H
+#        include <sys/mman.h>
+#    endif
 #endif // _WIN32
+#include <cstdint>
 #include <cstdio>
 #include <limits>
 #include "GooString.h"
@@ -340,6 +344,38 @@ GooFile::GooFile(HANDLE handleA) : handle(handleA)
     GetFileTime(handleA, nullptr, nullptr, &modifiedTimeOnOpen);
 }
 
+GooFile::~GooFile()
+{
+    if (mapping) {
+        UnmapViewOfFile(mapping);
+    }
+    CloseHandle(handle);
+}
+
+const char *GooFile::map()
+{
+    if (mapping) {
+        return mapping;
+    }
+    const Goffset fileSize = size();
+    if (GetFileType(handle) != FILE_TYPE_DISK || fileSize <= 0 || (unsigned long long)fileSize > SIZE_MAX) {
+        return nullptr;
+    }
+    HANDLE mappingHandle = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle) {
+        return nullptr;
+    }
+    // the view keeps the mapping object alive
+    const void *view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mappingHandle);
+    if (!view) {
+        return nullptr;
+    }
+    mapping = static_cast<const char *>(view);
+    mappingSize = fileSize;
+    return mapping;
+}
+
 int GooFile::read(char *buf, int n, Goffset offset) const
 {
     DWORD m;
@@ -424,6 +460,38 @@ GooFile::GooFile(int fdA) : fd(fdA)
     modifiedTimeOnOpen = mtim(statbuf);
 }
 
+GooFile::~GooFile()
+{
+#    ifdef HAVE_SYS_MMAN_H
+    if (mapping) {
+        munmap(const_cast<char *>(mapping), (size_t)mappingSize);
+    }
+#    endif
+    close(fd);
+}
+
+const char *GooFile::map()
+{
+#    ifdef HAVE_SYS_MMAN_H
+    if (mapping) {
+        return mapping;
+    }
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode) || statbuf.st_size <= 0 || (unsigned long long)statbuf.st_size > SIZE_MAX) {
+        return nullptr;
+    }
+    void *p = mmap(nullptr, (size_t)statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        return nullptr;
+    }
+    mapping = static_cast<const char *>(p);
+    mappingSize = statbuf.st_size;
+    return mapping;
+#    else
+    return nullptr;
+#    endif
+}
+
 bool GooFile::modificationTimeChangedSinceOpen() const
 {
     struct stat statbuf;
@@ -129,10 +129,18 @@ public:
     static std::unique_ptr<GooFile> open(int fdA);
 #endif
 
+    // Map the whole file read-only into memory.  Returns nullptr if the
+    // file is not a regular file, is empty or can't be mapped.  The
+    // mapping is created on the first call and stays valid until the
+    // GooFile is destroyed.
+    const char *map();
+    // Size of the mapping returned by map().
+    Goffset mappedSize() const { return mappingSize; }
+
 #ifdef _WIN32
     static std::unique_ptr<GooFile> open(const wchar_t *fileName);
 
-    ~GooFile() { CloseHandle(handle); }
+    ~GooFile();
 
     // Asuming than on windows you can't change files that are already open
     bool modificationTimeChangedSinceOpen() const;
@@ -142,7 +150,7 @@ private:
     HANDLE handle;
     struct _FILETIME modifiedTimeOnOpen;
 #else
-    ~GooFile() { close(fd); }
+    ~GooFile();
 
     bool modificationTimeChangedSinceOpen() const;
 
@@ -151,6 +159,8 @@ private:
     int fd;
     struct timespec modifiedTimeOnOpen;
 #endif // _WIN32
+    const char *mapping = nullptr;
+    Goffset mappingSize = 0;
 };
 
 #endif
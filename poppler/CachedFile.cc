@@ -15,6 +15,8 @@
 #include <config.h>
 #include "CachedFile.h"
 
+#include <algorithm>
+
 //------------------------------------------------------------------------
 // CachedFile
 //------------------------------------------------------------------------
@@ -23,6 +25,7 @@ CachedFile::CachedFile(std::unique_ptr<CachedFileLoader> &&cacheLoader) : loader
 {
     streamPos = 0;
     length = 0;
+    readAhead = 0;
 
     length = loader->init(this);
 
@@ -102,6 +105,34 @@ int CachedFile::cache(const std::vector<ByteRange> &origRanges)
         }
     }
 
+    // also load short runs of chunks between needed ones, that is cheaper
+    // than one more request; runs with loaded chunks are left alone, they
+    // would still take two requests and load those chunks again
+    const int maxGap = readAhead / CachedFileChunkSize;
+    if (maxGap > 0) {
+        int last = -1;
+        for (int i = 0; i < numChunks; ++i) {
+            if (!chunkNeeded[i]) {
+                continue;
+            }
+            if (last >= 0 && i - last - 1 <= maxGap) {
+                bool allNew = true;
+                for (int j = last + 1; j < i; ++j) {
+                    if (chunks[j].state != chunkStateNew) {
+                        allNew = false;
+                        break;
+                    }
+                }
+                if (allNew) {
+                    for (int j = last + 1; j < i; ++j) {
+                        chunkNeeded[j] = true;
+                    }
+                }
+            }
+            last = i;
+        }
+    }
+
     int chunk = 0;
     while (chunk < numChunks) {
         while (chunk < numChunks && !chunkNeeded[chunk]) {
@@ -145,8 +176,13 @@ size_t CachedFile::read(void *ptr, size_t unitsize, size_t count)
         return 0;
     }
 
-    // Load data
-    if (cache(streamPos, bytes) != 0) {
+    // Load data, from the first chunk that is missing on, and at least
+    // readAhead bytes of it
+    size_t loadPos = streamPos;
+    while (loadPos < streamPos + bytes && chunks[loadPos / CachedFileChunkSize].state == chunkStateLoaded) {
+        loadPos = (loadPos / CachedFileChunkSize + 1) * CachedFileChunkSize;
+    }
+    if (loadPos < streamPos + bytes && cache(loadPos, std::max(streamPos + bytes - loadPos, readAhead)) != 0) {
         return 0;
     }
 
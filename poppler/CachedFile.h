@@ -58,6 +58,11 @@ public:
     size_t write(const char *ptr, size_t size, size_t fromByte);
     int cache(const std::vector<ByteRange> &ranges);
 
+    // Sets how many bytes read() loads at least, so that sequential
+    // reads don't each cost a request to the loader.  Needed ranges less
+    // than that far apart are also loaded in one go.  Defaults to 0.
+    void setReadAhead(size_t bytes) { readAhead = bytes; }
+
     ~CachedFile();
 
 private:
@@ -79,6 +84,7 @@ private:
 
     size_t length;
     size_t streamPos;
+    size_t readAhead;
 
     std::vector<Chunk> chunks;
 };
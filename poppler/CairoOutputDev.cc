@@ -3507,7 +3507,21 @@ void CairoOutputDev::drawImage(GfxState *state, Object *ref, Stream *str, int wi
 
     cairo_get_matrix(cairo, &matrix);
     getScaledSize(&matrix, widthA, heightA, &scaledWidth, &scaledHeight);
-    image = rescale.getSourceImage(str, widthA, heightA, scaledWidth, scaledHeight, printing, colorMap, maskColors);
+    // decode images that are drawn much smaller than their size at a
+    // lower resolution; when printing, the full image may be embedded
+    if (!printing && !inlineImg) {
+        const int reduction = str->setReducedDecoding(widthA, heightA, scaledWidth, scaledHeight);
+        if (reduction > 0) {
+            widthA = (widthA + (1 << reduction) - 1) >> reduction;
+            heightA = (heightA + (1 << reduction) - 1) >> reduction;
+        }
+    }
+    // images drawn on many pages are only decoded once
+    std::unique_ptr<Stream> decodedStr;
+    if (doc && !inlineImg) {
+        decodedStr = doc->getDecodedImageCache()->getDecodedStream(doc->getXRef(), ref, str, widthA, heightA, colorMap->getNumPixelComps(), colorMap->getBits());
+    }
+    image = rescale.getSourceImage(decodedStr ? decodedStr.get() : str, widthA, heightA, scaledWidth, scaledHeight, printing, colorMap, maskColors);
     if (!image) {
         return;
     }
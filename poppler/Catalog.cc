@@ -187,6 +187,13 @@ Page *Catalog::getPage(int i)
         return nullptr;
     }
 
+    {
+        const std::shared_lock readLocker(mutex);
+        if (std::size_t(i) <= pages.size()) {
+            return pages[i - 1].first.get();
+        }
+    }
+
     catalogLocker();
     if (std::size_t(i) > pages.size()) {
         bool cached = cachePageTree(i);
@@ -203,6 +210,13 @@ Ref *Catalog::getPageRef(int i)
         return nullptr;
     }
 
+    {
+        const std::shared_lock readLocker(mutex);
+        if (std::size_t(i) <= pages.size()) {
+            return &pages[i - 1].second;
+        }
+    }
+
     catalogLocker();
     if (std::size_t(i) > pages.size()) {
         bool cached = cachePageTree(i);
@@ -837,6 +851,13 @@ bool Catalog::indexToLabel(int index, GooString *label)
 
 int Catalog::getNumPages()
 {
+    {
+        const std::shared_lock readLocker(mutex);
+        if (numPages != -1) {
+            return numPages;
+        }
+    }
+
     catalogLocker();
     if (numPages == -1) {
         if (!initPageList()) {
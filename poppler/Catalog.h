@@ -43,6 +43,7 @@
 #ifndef CATALOG_H
 #define CATALOG_H
 
+#include "goo/GooRecursiveSharedMutex.h"
 #include "poppler-config.h"
 #include "poppler_private_export.h"
 #include "Object.h"
@@ -318,7 +319,8 @@ private:
     int catalogPdfMajorVersion = -1;
     int catalogPdfMinorVersion = -1;
 
-    mutable std::recursive_mutex mutex;
+    // the page lookups that only read the page cache take a shared lock
+    mutable GooRecursiveSharedMutex mutex;
 };
 
 #endif
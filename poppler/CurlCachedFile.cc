@@ -17,16 +17,41 @@
 
 #include "goo/GooString.h"
 
+#include <algorithm>
+
 //------------------------------------------------------------------------
 
+// A request for one of the ranges of a load().
+struct CurlCachedFileLoader::Transfer
+{
+    CurlCachedFileLoader *loader;
+    CURL *handle;
+    size_t offset; // first byte of the range
+    size_t length; // length of the range, clipped to the end of the file
+    size_t skip; // bytes of the response to drop before the range
+    size_t received; // bytes of the range received so far
+    bool started; // has the response started?
+    bool done;
+    std::vector<char> pending; // data received before it could be written
+};
+
 CurlCachedFileLoader::CurlCachedFileLoader(const std::string &urlA) : url(urlA)
 {
     cachedFile = nullptr;
     curl = nullptr;
+    multi = nullptr;
+    writer = nullptr;
+    nextToWrite = 0;
 }
 
 CurlCachedFileLoader::~CurlCachedFileLoader()
 {
+    for (CURL *handle : handles) {
+        curl_easy_cleanup(handle);
+    }
+    if (multi) {
+        curl_multi_cleanup(multi);
+    }
     curl_easy_cleanup(curl);
 }
 
@@ -59,36 +84,180 @@ size_t CurlCachedFileLoader::init(CachedFile *cachedFileA)
     }
     curl_easy_reset(curl);
 
+    multi = curl_multi_init();
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)curlCachedFileMaxTransfers);
+
     return size;
 }
 
-static size_t load_cb(const char *ptr, size_t size, size_t nmemb, void *data)
+size_t CurlCachedFileLoader::writeCallback(const char *ptr, size_t size, size_t nmemb, void *data)
+{
+    Transfer *transfer = (Transfer *)data;
+    CurlCachedFileLoader *loader = transfer->loader;
+    size_t n = size * nmemb;
+
+    if (!transfer->started) {
+        long code = 0;
+        curl_easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE, &code);
+        if (code == 200) {
+            // the server ignored the range and sends the whole file
+            transfer->skip = transfer->offset;
+        } else if (code != 206) {
+            error(errIO, -1, "Failed to load range {0:ulld}-{1:ulld} of '{2:s}': HTTP status {3:d}.", (unsigned long long)transfer->offset, (unsigned long long)(transfer->offset + transfer->length - 1), loader->url.c_str(), (int)code);
+            return 0;
+        }
+        transfer->started = true;
+    }
+
+    const size_t skip = std::min(n, transfer->skip);
+    transfer->skip -= skip;
+    ptr += skip;
+    n -= skip;
+    const size_t len = std::min(n, transfer->length - transfer->received);
+    if (len > 0) {
+        if (transfer == &loader->transfers[loader->nextToWrite]) {
+            if (loader->writer->write(ptr, len) != len) {
+                return 0;
+            }
+        } else {
+            transfer->pending.insert(transfer->pending.end(), ptr, ptr + len);
+        }
+        transfer->received += len;
+    }
+    // stop a response that goes on past the range
+    if (len < n) {
+        return 0;
+    }
+    return size * nmemb;
+}
+
+// Writes the data <transfer> received before its turn came.
+bool CurlCachedFileLoader::flush(Transfer *transfer)
 {
-    CachedFileWriter *writer = (CachedFileWriter *)data;
-    return (writer->write)(ptr, size * nmemb);
+    if (transfer->pending.empty()) {
+        return true;
+    }
+    const size_t len = transfer->pending.size();
+    const bool ok = writer->write(transfer->pending.data(), len) == len;
+    std::vector<char>().swap(transfer->pending);
+    return ok;
 }
 
-int CurlCachedFileLoader::load(const std::vector<ByteRange> &ranges, CachedFileWriter *writer)
+int CurlCachedFileLoader::load(const std::vector<ByteRange> &ranges, CachedFileWriter *writerA)
 {
+    const size_t fileLength = cachedFile->getLength();
     CURLcode r = CURLE_OK;
-    unsigned long long fromByte, toByte;
+
+    if (!multi) {
+        return CURLE_FAILED_INIT;
+    }
+
+    // The ranges are fetched concurrently, but the writer takes them in
+    // order: the one whose turn it is writes straight through, the others
+    // keep their data until their turn comes.
+    writer = writerA;
+    transfers.clear();
+    transfers.reserve(ranges.size());
     for (const ByteRange &bRange : ranges) {
+        if (bRange.offset >= fileLength || bRange.length == 0) {
+            continue;
+        }
+        Transfer transfer;
+        transfer.loader = this;
+        transfer.handle = nullptr;
+        transfer.offset = bRange.offset;
+        transfer.length = std::min((size_t)bRange.length, fileLength - bRange.offset);
+        transfer.skip = 0;
+        transfer.received = 0;
+        transfer.started = false;
+        transfer.done = false;
+        transfers.push_back(std::move(transfer));
+    }
+    nextToWrite = 0;
 
-        fromByte = bRange.offset;
-        toByte = fromByte + bRange.length - 1;
-        const std::string range = GooString::format("{0:ulld}-{1:ulld}", fromByte, toByte);
+    std::vector<CURL *> idle = handles;
+    size_t next = 0;
+    int running = 0;
+    while (true) {
+        while (r == CURLE_OK && next < transfers.size() && running < curlCachedFileMaxTransfers) {
+            Transfer *transfer = &transfers[next++];
+            if (idle.empty()) {
+                handles.push_back(curl_easy_init());
+                idle.push_back(handles.back());
+            }
+            transfer->handle = idle.back();
+            idle.pop_back();
 
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, load_cb);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, writer);
-        curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
-        r = curl_easy_perform(curl);
-        curl_easy_reset(curl);
+            const unsigned long long fromByte = transfer->offset;
+            const unsigned long long toByte = fromByte + transfer->length - 1;
+            const std::string range = GooString::format("{0:ulld}-{1:ulld}", fromByte, toByte);
+
+            curl_easy_reset(transfer->handle);
+            curl_easy_setopt(transfer->handle, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(transfer->handle, CURLOPT_WRITEFUNCTION, &writeCallback);
+            curl_easy_setopt(transfer->handle, CURLOPT_WRITEDATA, transfer);
+            curl_easy_setopt(transfer->handle, CURLOPT_PRIVATE, transfer);
+            curl_easy_setopt(transfer->handle, CURLOPT_RANGE, range.c_str());
+            curl_multi_add_handle(multi, transfer->handle);
+            ++running;
+        }
+        if (running == 0) {
+            break;
+        }
+
+        int stillRunning = 0;
+        const CURLMcode mr = curl_multi_perform(multi, &stillRunning);
+        if (mr != CURLM_OK && r == CURLE_OK) {
+            r = CURLE_RECV_ERROR;
+        }
+
+        CURLMsg *msg;
+        int msgsLeft;
+        while ((msg = curl_multi_info_read(multi, &msgsLeft))) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            Transfer *transfer = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&transfer);
+            CURLcode tr = msg->data.result;
+            // a response that went on past the range was stopped on purpose
+            if (tr == CURLE_WRITE_ERROR && transfer->started && transfer->received == transfer->length) {
+                tr = CURLE_OK;
+            }
+            if (tr == CURLE_OK && transfer->received != transfer->length) {
+                tr = CURLE_PARTIAL_FILE;
+            }
+            if (tr != CURLE_OK && r == CURLE_OK) {
+                r = tr;
+            }
+            transfer->done = true;
+            curl_multi_remove_handle(multi, msg->easy_handle);
+            idle.push_back(msg->easy_handle);
+            --running;
+        }
+
+        while (r == CURLE_OK && nextToWrite < transfers.size() && transfers[nextToWrite].done) {
+            ++nextToWrite;
+            if (nextToWrite < transfers.size() && !flush(&transfers[nextToWrite])) {
+                r = CURLE_WRITE_ERROR;
+            }
+        }
 
         if (r != CURLE_OK) {
+            for (size_t i = 0; i < next; ++i) {
+                if (!transfers[i].done) {
+                    curl_multi_remove_handle(multi, transfers[i].handle);
+                }
+            }
             break;
         }
+        if (running > 0 && stillRunning > 0) {
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
     }
+
+    transfers.clear();
+    writer = nullptr;
     return r;
 }
 
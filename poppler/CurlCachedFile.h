@@ -17,8 +17,14 @@
 
 #include <curl/curl.h>
 
+#include <vector>
+
 //------------------------------------------------------------------------
 
+// Loads the ranges of one load() call with up to this many concurrent
+// requests.
+#define curlCachedFileMaxTransfers 4
+
 class CurlCachedFileLoader : public CachedFileLoader
 {
 
@@ -29,9 +35,23 @@ public:
     int load(const std::vector<ByteRange> &ranges, CachedFileWriter *writer) override;
 
 private:
+    struct Transfer;
+
+    static size_t writeCallback(const char *ptr, size_t size, size_t nmemb, void *data);
+    bool flush(Transfer *transfer);
+
     const std::string url;
     CachedFile *cachedFile;
     CURL *curl;
+    // the handles are kept across loads so that they reuse their
+    // connections
+    CURLM *multi;
+    std::vector<CURL *> handles;
+
+    // state of the current load()
+    CachedFileWriter *writer;
+    std::vector<Transfer> transfers;
+    size_t nextToWrite;
 };
 
 #endif
@@ -19,6 +19,10 @@
 #include "CurlCachedFile.h"
 #include "ErrorCodes.h"
 
+// bytes loaded at least when a read from a remote file misses the cache,
+// see CachedFile::setReadAhead()
+#define curlReadAhead (64 * 1024)
+
 //------------------------------------------------------------------------
 // CurlPDFDocBuilder
 //------------------------------------------------------------------------
@@ -30,6 +34,7 @@ std::unique_ptr<PDFDoc> CurlPDFDocBuilder::buildPDFDoc(const GooString &uri, con
     if (cachedFile->getLength() == ((unsigned int)-1)) {
         return PDFDoc::ErrorPDFDoc(errOpenFile, uri.copy());
     }
+    cachedFile->setReadAhead(curlReadAhead);
 
     BaseStream *str = new CachedFileStream(cachedFile, 0, false, cachedFile->getLength(), Object::null());
 
@@ -63,6 +63,7 @@ static void str_term_source(j_decompress_ptr cinfo) { }
 DCTStream::DCTStream(Stream *strA, int colorXformA, Dict *dict, int recursion) : FilterStream(strA)
 {
     colorXform = colorXformA;
+    reduction = 0;
     if (dict != nullptr) {
         Object obj = dict->lookup("Width", recursion);
         err.width = (obj.isInt() && obj.getInt() <= JPEG_MAX_DIMENSION) ? obj.getInt() : 0;
@@ -184,6 +185,13 @@ bool DCTStream::reset()
                 break;
             }
 
+            // libjpeg can scale down by 1/2, 1/4 or 1/8 while decoding,
+            // which is much cheaper than decoding the full image
+            if (reduction > 0) {
+                cinfo.scale_num = 1;
+                cinfo.scale_denom = 1 << reduction;
+            }
+
             jpeg_start_decompress(&cinfo);
 
             row_stride = cinfo.output_width * cinfo.output_components;
@@ -269,3 +277,9 @@ bool DCTStream::isBinary(bool last) const
 {
     return str->isBinary(true);
 }
+
+int DCTStream::setReducedDecoding(int width, int height, int targetWidth, int targetHeight)
+{
+    reduction = getImageReduction(width, height, targetWidth, targetHeight, 3);
+    return reduction;
+}
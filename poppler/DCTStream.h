@@ -68,6 +68,7 @@ public:
     int lookChar() override;
     std::optional<std::string> getPSFilter(int psLevel, const char *indent) override;
     bool isBinary(bool last = true) const override;
+    int setReducedDecoding(int width, int height, int targetWidth, int targetHeight) override;
 
 private:
     void init();
@@ -77,6 +78,7 @@ private:
     int getChars(int nChars, unsigned char *buffer) override;
 
     int colorXform;
+    int reduction; // decode at 1 / 2^reduction of the full size
     JSAMPLE *current;
     JSAMPLE *limit;
     struct jpeg_decompress_struct cinfo;
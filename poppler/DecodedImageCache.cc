@@ -0,0 +1,194 @@
+//========================================================================
+//
+// DecodedImageCache.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <climits>
+
+#include "Stream.h"
+#include "XRef.h"
+#include "DecodedImageCache.h"
+
+// default size limit, in bytes
+#define decodedImageCacheDefaultSize (32 * 1024 * 1024)
+
+// approximate bookkeeping cost of an image on top of its data
+#define decodedImageCacheEntryOverhead 128
+
+namespace {
+
+// A memory stream over cached image data, which it keeps alive even if
+// the image is evicted meanwhile.
+class DecodedImageStream final : public BaseMemStream<const char>
+{
+public:
+    DecodedImageStream(std::shared_ptr<const std::vector<char>> dataA, Goffset startA, Goffset lengthA) : BaseMemStream(dataA->data(), startA, lengthA, Object::null()), data(std::move(dataA)) { }
+
+    BaseStream *copy() override { return new DecodedImageStream(data, getStart(), getLength()); }
+
+    std::unique_ptr<Stream> makeSubStream(Goffset startA, bool limited, Goffset lengthA, Object && /*dictA*/) override
+    {
+        const Goffset end = (Goffset)data->size();
+        if (startA > end) {
+            startA = end;
+        }
+        if (!limited || lengthA > end - startA) {
+            lengthA = end - startA;
+        }
+        return std::make_unique<DecodedImageStream>(data, startA, lengthA);
+    }
+
+private:
+    std::shared_ptr<const std::vector<char>> data;
+};
+
+}
+
+//------------------------------------------------------------------------
+// DecodedImageCache
+//------------------------------------------------------------------------
+
+size_t DecodedImageCache::KeyHash::operator()(const Key &key) const
+{
+    size_t h = std::hash<Ref>()(key.ref);
+    for (int x : { key.width, key.height, key.nComps, key.nBits }) {
+        h = h * 31 + (size_t)x;
+    }
+    return h;
+}
+
+DecodedImageCache::DecodedImageCache() : size(0), maxSize(decodedImageCacheDefaultSize), xrefModificationCount(0), hits(0), misses(0), evictions(0) { }
+
+DecodedImageCache::~DecodedImageCache() = default;
+
+// Must be called with the mutex locked.
+void DecodedImageCache::evict(size_t limit)
+{
+    while (size > limit && !lru.empty()) {
+        const Entry &entry = lru.back();
+        size -= entry.data->size() + decodedImageCacheEntryOverhead;
+        index.erase(entry.key);
+        lru.pop_back();
+        ++evictions;
+    }
+}
+
+void DecodedImageCache::setMaxSize(size_t maxSizeA)
+{
+    const std::scoped_lock locker(mutex);
+    maxSize = maxSizeA;
+    evict(maxSize);
+}
+
+size_t DecodedImageCache::getMaxSize() const
+{
+    const std::scoped_lock locker(mutex);
+    return maxSize;
+}
+
+std::unique_ptr<Stream> DecodedImageCache::getDecodedStream(XRef *xref, const Object *ref, Stream *str, int width, int height, int nComps, int nBits)
+{
+    if (!ref || !ref->isRef() || width <= 0 || height <= 0 || nComps <= 0 || nBits <= 0) {
+        return nullptr;
+    }
+    // an unfiltered stream is read straight from the file, there is
+    // nothing to save
+    if (str->getBaseStream() == str) {
+        return nullptr;
+    }
+    if ((size_t)width > (SIZE_MAX / 8 - 7) / (size_t)nComps / (size_t)nBits) {
+        return nullptr;
+    }
+    const size_t rowSize = ((size_t)width * nComps * nBits + 7) >> 3;
+    if (rowSize > INT_MAX / (size_t)height) {
+        return nullptr;
+    }
+    const size_t dataSize = rowSize * height;
+
+    const Key key = { ref->getRef(), width, height, nComps, nBits };
+    const unsigned int modificationCount = xref->getModificationCount();
+    {
+        const std::scoped_lock locker(mutex);
+        if (modificationCount != xrefModificationCount) {
+            clearEntries();
+            xrefModificationCount = modificationCount;
+        }
+        if (dataSize + decodedImageCacheEntryOverhead > maxSize) {
+            return nullptr;
+        }
+        auto it = index.find(key);
+        if (it != index.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            ++hits;
+            std::shared_ptr<const std::vector<char>> data = it->second->data;
+            return std::make_unique<DecodedImageStream>(data, 0, (Goffset)data->size());
+        }
+        ++misses;
+    }
+
+    // decode without holding the lock; if another thread is decoding the
+    // same image, the first one to finish gets to cache it
+    if (!str->reset()) {
+        return nullptr;
+    }
+    auto data = std::make_shared<std::vector<char>>(dataSize);
+    int n = str->doGetChars((int)dataSize, (unsigned char *)data->data());
+    str->close();
+    if (n < 0) {
+        n = 0;
+    }
+    // a truncated image reads as truncated from the cache too
+    data->resize(n);
+    data->shrink_to_fit();
+
+    {
+        const std::scoped_lock locker(mutex);
+        // don't cache the image if the XRef changed while it was decoded
+        if (modificationCount == xrefModificationCount && index.find(key) == index.end()) {
+            lru.push_front({ key, data });
+            index.emplace(key, lru.begin());
+            size += data->size() + decodedImageCacheEntryOverhead;
+            evict(maxSize);
+        }
+    }
+    return std::make_unique<DecodedImageStream>(std::move(data), 0, (Goffset)n);
+}
+
+void DecodedImageCache::clear()
+{
+    const std::scoped_lock locker(mutex);
+    clearEntries();
+}
+
+void DecodedImageCache::clearEntries()
+{
+    index.clear();
+    lru.clear();
+    size = 0;
+}
+
+DecodedImageCache::Stats DecodedImageCache::getStats() const
+{
+    const std::scoped_lock locker(mutex);
+    Stats stats;
+
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.size = size;
+    stats.images = lru.size();
+    return stats;
+}
+
+void DecodedImageCache::resetStats()
+{
+    const std::scoped_lock locker(mutex);
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
@@ -0,0 +1,113 @@
+//========================================================================
+//
+// DecodedImageCache.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef DECODEDIMAGECACHE_H
+#define DECODEDIMAGECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Object.h"
+#include "poppler_private_export.h"
+
+class Stream;
+class XRef;
+
+//------------------------------------------------------------------------
+// DecodedImageCache
+//------------------------------------------------------------------------
+
+// A per-document cache of decoded image XObject data, so that an image
+// drawn on many pages (a logo, a page background) only goes through its
+// Flate/DCT/JPX/... filters once.
+//
+// The cached data is the output of the stream filters, i.e. the packed
+// samples that ImageStream reads, before any colour conversion.  Images
+// are keyed by their object reference and dimensions.  The cache is
+// emptied whenever the document's XRef is modified, since a reference
+// may then point to a different image.  The least recently used images
+// are evicted once the cache is over its size limit.  All methods can be
+// called from several threads at once.
+class POPPLER_PRIVATE_EXPORT DecodedImageCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t size; // bytes currently used
+        size_t images; // number of cached images
+    };
+
+    DecodedImageCache();
+    ~DecodedImageCache();
+
+    DecodedImageCache(const DecodedImageCache &) = delete;
+    DecodedImageCache &operator=(const DecodedImageCache &) = delete;
+
+    // Set the size limit in bytes; 0 disables the cache.  Shrinking the
+    // limit evicts images as needed.
+    void setMaxSize(size_t maxSizeA);
+    size_t getMaxSize() const;
+
+    // Return a stream over the decoded data of the image XObject <ref>
+    // of <xref>, a <width> x <height> image with <nComps> components of
+    // <nBits> bits, whose stream is <str>.  On a miss, all of <str> is read and
+    // added to the cache.  Returns nullptr if the image can't be cached
+    // (inline images, unfiltered streams, images over the size limit),
+    // in which case the caller reads <str> as usual.  The returned stream
+    // is already reset.
+    std::unique_ptr<Stream> getDecodedStream(XRef *xref, const Object *ref, Stream *str, int width, int height, int nComps, int nBits);
+
+    // Remove all images.  The counters are kept.
+    void clear();
+
+    Stats getStats() const;
+    void resetStats();
+
+private:
+    struct Key
+    {
+        Ref ref;
+        int width, height, nComps, nBits;
+
+        bool operator==(const Key &other) const { return ref == other.ref && width == other.width && height == other.height && nComps == other.nComps && nBits == other.nBits; }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const;
+    };
+
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<const std::vector<char>> data;
+    };
+
+    void evict(size_t limit);
+    void clearEntries();
+
+    mutable std::mutex mutex;
+    std::list<Entry> lru; // most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    size_t size;
+    size_t maxSize;
+    unsigned int xrefModificationCount; // of the XRef the images came from
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+#endif
@@ -32,6 +32,8 @@
 
 #include <config.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include "goo/gmem.h"
@@ -39,6 +41,22 @@
 #include "Decrypt.h"
 #include "Error.h"
 
+// AES-NI and the SHA extensions are selected at runtime, which needs the
+// target attribute
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define DECRYPT_X86_CRYPTO 1
+#    include <cpuid.h>
+#    include <immintrin.h>
+#endif
+
+// the ARMv8 crypto extension is used when the compiler may assume it
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO))
+#    define DECRYPT_ARM_CRYPTO 1
+#    include <arm_neon.h>
+#endif
+
+#define decryptMaxAESRounds 14
+
 static void rc4InitKey(const unsigned char *key, int keyLen, unsigned char *state);
 static unsigned char rc4DecryptByte(unsigned char *state, unsigned char *x, unsigned char *y, unsigned char c);
 
@@ -46,11 +64,28 @@ static bool aesReadBlock(Stream *str, unsigned char *in, bool addPadding);
 
 static void aesKeyExpansion(DecryptAESState *s, const unsigned char *objKey, int objKeyLen, bool decrypt);
 static void aesEncryptBlock(DecryptAESState *s, const unsigned char *in);
-static void aesDecryptBlock(DecryptAESState *s, const unsigned char *in, bool last);
 
 static void aes256KeyExpansion(DecryptAES256State *s, const unsigned char *objKey, int objKeyLen, bool decrypt);
 static void aes256EncryptBlock(DecryptAES256State *s, const unsigned char *in);
-static void aes256DecryptBlock(DecryptAES256State *s, const unsigned char *in, bool last);
+
+// Encrypt or decrypt <nBlocks> 16-byte blocks of <buf> in place, in CBC
+// mode.  <w> is the key schedule for <nRounds> rounds, made by
+// aes[256]KeyExpansion for the matching direction.  <cbc> holds the IV
+// and is updated to chain into the next call.
+using AESCBCFunc = void (*)(const unsigned int *w, int nRounds, unsigned char *cbc, unsigned char *buf, int nBlocks);
+// Process <nBlocks> 64-byte blocks of <msg> into the SHA-256 state <H>.
+using SHA256BlocksFunc = void (*)(const unsigned char *msg, int nBlocks, unsigned int *H);
+
+struct CryptFuncs
+{
+    AESCBCFunc aesEncryptCBC;
+    AESCBCFunc aesDecryptCBC;
+    SHA256BlocksFunc sha256Blocks;
+};
+
+// Returns the fastest implementations the CPU supports, or the portable
+// ones, see setCryptHardwareEnabled().
+static const CryptFuncs &getCryptFuncs();
 
 static void sha256(unsigned char *msg, int msgLen, unsigned char *hash);
 static void sha384(unsigned char *msg, int msgLen, unsigned char *hash);
@@ -109,10 +144,8 @@ bool Decrypt::makeFileKey(int encVersion, int encRevision, int keyLength, const
                 for (i = 0; i < 16; ++i) {
                     state.cbc[i] = 0;
                 }
-                aes256DecryptBlock(&state, (unsigned char *)ownerEnc->c_str(), false);
-                memcpy(fileKey, state.buf, 16);
-                aes256DecryptBlock(&state, (unsigned char *)ownerEnc->c_str() + 16, false);
-                memcpy(fileKey + 16, state.buf, 16);
+                memcpy(fileKey, ownerEnc->c_str(), 32);
+                getCryptFuncs().aesDecryptCBC(state.w, 14, state.cbc, fileKey, 2);
 
                 *ownerPasswordOk = true;
                 return true;
@@ -149,10 +182,8 @@ bool Decrypt::makeFileKey(int encVersion, int encRevision, int keyLength, const
                 for (i = 0; i < 16; ++i) {
                     state.cbc[i] = 0;
                 }
-                aes256DecryptBlock(&state, (unsigned char *)userEnc->c_str(), false);
-                memcpy(fileKey, state.buf, 16);
-                aes256DecryptBlock(&state, (unsigned char *)userEnc->c_str() + 16, false);
-                memcpy(fileKey + 16, state.buf, 16);
+                memcpy(fileKey, userEnc->c_str(), 32);
+                getCryptFuncs().aesDecryptCBC(state.w, 14, state.cbc, fileKey, 2);
 
                 return true;
             }
@@ -481,7 +512,10 @@ int EncryptStream::lookChar()
 // DecryptStream
 //------------------------------------------------------------------------
 
-DecryptStream::DecryptStream(Stream *strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref refA) : BaseCryptStream(strA, fileKey, algoA, keyLength, refA) { }
+DecryptStream::DecryptStream(Stream *strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref refA) : BaseCryptStream(strA, fileKey, algoA, keyLength, refA)
+{
+    bufPos = bufLen = 0;
+}
 
 DecryptStream::~DecryptStream() = default;
 
@@ -500,66 +534,108 @@ bool DecryptStream::reset()
         for (i = 0; i < 16; ++i) {
             state.aes.cbc[i] = str->getChar();
         }
-        state.aes.bufIdx = 16;
         break;
     case cryptAES256:
         aes256KeyExpansion(&state.aes256, objKey, objKeyLength, true);
         for (i = 0; i < 16; ++i) {
             state.aes256.cbc[i] = str->getChar();
         }
-        state.aes256.bufIdx = 16;
         break;
     case cryptNone:
         break;
     }
+    bufPos = bufLen = 0;
 
     return baseResult;
 }
 
+int DecryptStream::getChar()
+{
+    if (bufPos >= bufLen && !fillBuf()) {
+        return EOF;
+    }
+    ++charactersRead;
+    return buf[bufPos++];
+}
+
 int DecryptStream::lookChar()
 {
-    unsigned char in[16];
-    int c;
+    if (bufPos >= bufLen && !fillBuf()) {
+        return EOF;
+    }
+    return buf[bufPos];
+}
 
-    if (nextCharBuff != EOF) {
-        return nextCharBuff;
+int DecryptStream::getChars(int nChars, unsigned char *buffer)
+{
+    int n, m;
+
+    n = 0;
+    while (n < nChars) {
+        if (bufPos >= bufLen && !fillBuf()) {
+            break;
+        }
+        m = std::min(nChars - n, bufLen - bufPos);
+        memcpy(buffer + n, buf + bufPos, m);
+        bufPos += m;
+        n += m;
     }
+    charactersRead += n;
+    return n;
+}
 
-    c = EOF; // make gcc happy
+bool DecryptStream::fillBuf()
+{
+    int n, nBlocks, padding, i;
+    unsigned char x, y;
+    bool last;
+
+    bufPos = bufLen = 0;
     switch (algo) {
     case cryptRC4:
-        if ((c = str->getChar()) != EOF) {
-            c = rc4DecryptByte(state.rc4.state, &state.rc4.x, &state.rc4.y, (unsigned char)c);
+        n = str->doGetChars(sizeof(buf), buf);
+        // keep the indices in locals, the stores to buf may alias them
+        x = state.rc4.x;
+        y = state.rc4.y;
+        for (i = 0; i < n; ++i) {
+            buf[i] = rc4DecryptByte(state.rc4.state, &x, &y, buf[i]);
         }
+        state.rc4.x = x;
+        state.rc4.y = y;
+        bufLen = n;
         break;
     case cryptAES:
-        if (state.aes.bufIdx == 16) {
-            if (aesReadBlock(str, in, false)) {
-                aesDecryptBlock(&state.aes, in, str->lookChar() == EOF);
-            }
+    case cryptAES256:
+        n = str->doGetChars(sizeof(buf), buf);
+        // a trailing partial block is dropped, and the padding is only
+        // removed if the stream ends with a whole block
+        nBlocks = n / 16;
+        if (nBlocks == 0) {
+            break;
         }
-        if (state.aes.bufIdx == 16) {
-            c = EOF;
+        if (n == (int)sizeof(buf)) {
+            last = str->lookChar() == EOF;
         } else {
-            c = state.aes.buf[state.aes.bufIdx++];
+            last = n % 16 == 0;
         }
-        break;
-    case cryptAES256:
-        if (state.aes256.bufIdx == 16) {
-            if (aesReadBlock(str, in, false)) {
-                aes256DecryptBlock(&state.aes256, in, str->lookChar() == EOF);
-            }
-        }
-        if (state.aes256.bufIdx == 16) {
-            c = EOF;
+        if (algo == cryptAES) {
+            getCryptFuncs().aesDecryptCBC(state.aes.w, 10, state.aes.cbc, buf, nBlocks);
         } else {
-            c = state.aes256.buf[state.aes256.bufIdx++];
+            getCryptFuncs().aesDecryptCBC(state.aes256.w, 14, state.aes256.cbc, buf, nBlocks);
+        }
+        bufLen = nBlocks * 16;
+        if (last) {
+            padding = buf[bufLen - 1];
+            if (padding < 1 || padding > 16) { // this should never happen
+                padding = 16;
+            }
+            bufLen -= padding;
         }
         break;
     case cryptNone:
         break;
     }
-    return (nextCharBuff = c);
+    return bufLen > 0;
 }
 
 //------------------------------------------------------------------------
@@ -933,97 +1009,14 @@ static void aesKeyExpansion(DecryptAESState *s, const unsigned char *objKey, int
 
 static void aesEncryptBlock(DecryptAESState *s, const unsigned char *in)
 {
-    int c, round;
-
-    // initial state (input is xor'd with previous output because of CBC)
-    for (c = 0; c < 4; ++c) {
-        s->state[c] = in[4 * c] ^ s->buf[4 * c];
-        s->state[4 + c] = in[4 * c + 1] ^ s->buf[4 * c + 1];
-        s->state[8 + c] = in[4 * c + 2] ^ s->buf[4 * c + 2];
-        s->state[12 + c] = in[4 * c + 3] ^ s->buf[4 * c + 3];
-    }
-
-    // round 0
-    addRoundKey(s->state, &s->w[0]);
-
-    // rounds 1-9
-    for (round = 1; round <= 9; ++round) {
-        subBytes(s->state);
-        shiftRows(s->state);
-        mixColumns(s->state);
-        addRoundKey(s->state, &s->w[round * 4]);
-    }
-
-    // round 10
-    subBytes(s->state);
-    shiftRows(s->state);
-    addRoundKey(s->state, &s->w[10 * 4]);
-
-    for (c = 0; c < 4; ++c) {
-        s->buf[4 * c] = s->state[c];
-        s->buf[4 * c + 1] = s->state[4 + c];
-        s->buf[4 * c + 2] = s->state[8 + c];
-        s->buf[4 * c + 3] = s->state[12 + c];
-    }
+    unsigned char block[16];
 
+    // the output block is left in buf, where it chains into the next block
+    memcpy(block, in, 16);
+    getCryptFuncs().aesEncryptCBC(s->w, 10, s->buf, block, 1);
     s->bufIdx = 0;
 }
 
-static void aesDecryptBlock(DecryptAESState *s, const unsigned char *in, bool last)
-{
-    int c, round, n, i;
-
-    // initial state
-    for (c = 0; c < 4; ++c) {
-        s->state[c] = in[4 * c];
-        s->state[4 + c] = in[4 * c + 1];
-        s->state[8 + c] = in[4 * c + 2];
-        s->state[12 + c] = in[4 * c + 3];
-    }
-
-    // round 0
-    addRoundKey(s->state, &s->w[10 * 4]);
-
-    // rounds 1-9
-    for (round = 9; round >= 1; --round) {
-        invSubBytes(s->state);
-        invShiftRows(s->state);
-        invMixColumns(s->state);
-        addRoundKey(s->state, &s->w[round * 4]);
-    }
-
-    // round 10
-    invSubBytes(s->state);
-    invShiftRows(s->state);
-    addRoundKey(s->state, &s->w[0]);
-
-    // CBC
-    for (c = 0; c < 4; ++c) {
-        s->buf[4 * c] = s->state[c] ^ s->cbc[4 * c];
-        s->buf[4 * c + 1] = s->state[4 + c] ^ s->cbc[4 * c + 1];
-        s->buf[4 * c + 2] = s->state[8 + c] ^ s->cbc[4 * c + 2];
-        s->buf[4 * c + 3] = s->state[12 + c] ^ s->cbc[4 * c + 3];
-    }
-
-    // save the input block for the next CBC
-    for (i = 0; i < 16; ++i) {
-        s->cbc[i] = in[i];
-    }
-
-    // remove padding
-    s->bufIdx = 0;
-    if (last) {
-        n = s->buf[15];
-        if (n < 1 || n > 16) { // this should never happen
-            n = 16;
-        }
-        for (i = 15; i >= n; --i) {
-            s->buf[i] = s->buf[i - n];
-        }
-        s->bufIdx = n;
-    }
-}
-
 //------------------------------------------------------------------------
 // AES-256 decryption
 //------------------------------------------------------------------------
@@ -1058,101 +1051,260 @@ static void aes256KeyExpansion(DecryptAES256State *s, const unsigned char *objKe
 
 static void aes256EncryptBlock(DecryptAES256State *s, const unsigned char *in)
 {
-    int c, round;
+    unsigned char block[16];
 
-    // initial state (input is xor'd with previous output because of CBC)
-    for (c = 0; c < 4; ++c) {
-        s->state[c] = in[4 * c] ^ s->buf[4 * c];
-        s->state[4 + c] = in[4 * c + 1] ^ s->buf[4 * c + 1];
-        s->state[8 + c] = in[4 * c + 2] ^ s->buf[4 * c + 2];
-        s->state[12 + c] = in[4 * c + 3] ^ s->buf[4 * c + 3];
-    }
+    // the output block is left in buf, where it chains into the next block
+    memcpy(block, in, 16);
+    getCryptFuncs().aesEncryptCBC(s->w, 14, s->buf, block, 1);
+    s->bufIdx = 0;
+}
 
-    // round 0
-    addRoundKey(s->state, &s->w[0]);
+//------------------------------------------------------------------------
+// AES-CBC on whole buffers
+//------------------------------------------------------------------------
 
-    // rounds 1-13
-    for (round = 1; round <= 13; ++round) {
-        subBytes(s->state);
-        shiftRows(s->state);
-        mixColumns(s->state);
-        addRoundKey(s->state, &s->w[round * 4]);
-    }
+static void aesEncryptCBCPortable(const unsigned int *w, int nRounds, unsigned char *cbc, unsigned char *buf, int nBlocks)
+{
+    unsigned char state[16];
+    int b, c, round;
 
-    // round 14
-    subBytes(s->state);
-    shiftRows(s->state);
-    addRoundKey(s->state, &s->w[14 * 4]);
+    for (b = 0; b < nBlocks; ++b, buf += 16) {
+        // initial state (input is xor'd with previous output because of CBC)
+        for (c = 0; c < 4; ++c) {
+            state[c] = buf[4 * c] ^ cbc[4 * c];
+            state[4 + c] = buf[4 * c + 1] ^ cbc[4 * c + 1];
+            state[8 + c] = buf[4 * c + 2] ^ cbc[4 * c + 2];
+            state[12 + c] = buf[4 * c + 3] ^ cbc[4 * c + 3];
+        }
 
-    for (c = 0; c < 4; ++c) {
-        s->buf[4 * c] = s->state[c];
-        s->buf[4 * c + 1] = s->state[4 + c];
-        s->buf[4 * c + 2] = s->state[8 + c];
-        s->buf[4 * c + 3] = s->state[12 + c];
+        // round 0
+        addRoundKey(state, &w[0]);
+
+        // rounds 1 to nRounds-1
+        for (round = 1; round < nRounds; ++round) {
+            subBytes(state);
+            shiftRows(state);
+            mixColumns(state);
+            addRoundKey(state, &w[round * 4]);
+        }
+
+        // last round
+        subBytes(state);
+        shiftRows(state);
+        addRoundKey(state, &w[nRounds * 4]);
+
+        for (c = 0; c < 4; ++c) {
+            buf[4 * c] = cbc[4 * c] = state[c];
+            buf[4 * c + 1] = cbc[4 * c + 1] = state[4 + c];
+            buf[4 * c + 2] = cbc[4 * c + 2] = state[8 + c];
+            buf[4 * c + 3] = cbc[4 * c + 3] = state[12 + c];
+        }
     }
+}
 
-    s->bufIdx = 0;
+static void aesDecryptCBCPortable(const unsigned int *w, int nRounds, unsigned char *cbc, unsigned char *buf, int nBlocks)
+{
+    unsigned char state[16];
+    unsigned char in[16];
+    int b, c, round;
+
+    for (b = 0; b < nBlocks; ++b, buf += 16) {
+        memcpy(in, buf, 16);
+
+        // initial state
+        for (c = 0; c < 4; ++c) {
+            state[c] = in[4 * c];
+            state[4 + c] = in[4 * c + 1];
+            state[8 + c] = in[4 * c + 2];
+            state[12 + c] = in[4 * c + 3];
+        }
+
+        // round 0
+        addRoundKey(state, &w[nRounds * 4]);
+
+        // rounds nRounds-1 to 1
+        for (round = nRounds - 1; round >= 1; --round) {
+            invSubBytes(state);
+            invShiftRows(state);
+            invMixColumns(state);
+            addRoundKey(state, &w[round * 4]);
+        }
+
+        // last round
+        invSubBytes(state);
+        invShiftRows(state);
+        addRoundKey(state, &w[0]);
+
+        // CBC
+        for (c = 0; c < 4; ++c) {
+            buf[4 * c] = state[c] ^ cbc[4 * c];
+            buf[4 * c + 1] = state[4 + c] ^ cbc[4 * c + 1];
+            buf[4 * c + 2] = state[8 + c] ^ cbc[4 * c + 2];
+            buf[4 * c + 3] = state[12 + c] ^ cbc[4 * c + 3];
+        }
+
+        // save the input block for the next CBC
+        memcpy(cbc, in, 16);
+    }
 }
 
-static void aes256DecryptBlock(DecryptAES256State *s, const unsigned char *in, bool last)
+// The round keys as bytes, the layout the crypto instructions expect.
+static inline void aesRoundKeyBytes(const unsigned int *w, unsigned char *key)
 {
-    int c, round, n, i;
+    int c;
 
-    // initial state
     for (c = 0; c < 4; ++c) {
-        s->state[c] = in[4 * c];
-        s->state[4 + c] = in[4 * c + 1];
-        s->state[8 + c] = in[4 * c + 2];
-        s->state[12 + c] = in[4 * c + 3];
+        key[4 * c] = w[c] >> 24;
+        key[4 * c + 1] = w[c] >> 16;
+        key[4 * c + 2] = w[c] >> 8;
+        key[4 * c + 3] = w[c];
     }
+}
 
-    // round 0
-    addRoundKey(s->state, &s->w[14 * 4]);
+#ifdef DECRYPT_X86_CRYPTO
 
-    // rounds 13-1
-    for (round = 13; round >= 1; --round) {
-        invSubBytes(s->state);
-        invShiftRows(s->state);
-        invMixColumns(s->state);
-        addRoundKey(s->state, &s->w[round * 4]);
-    }
+#    define DECRYPT_AESNI_TARGET __attribute__((target("aes,sse2")))
 
-    // round 14
-    invSubBytes(s->state);
-    invShiftRows(s->state);
-    addRoundKey(s->state, &s->w[0]);
+// The decryption key schedule made by aes[256]KeyExpansion is the one of
+// the equivalent inverse cipher, which is what AESDEC expects.
+DECRYPT_AESNI_TARGET static void aesEncryptCBCAESNI(const unsigned int *w, int nRounds, unsigned char *cbc, unsigned char *buf, int nBlocks)
+{
+    __m128i rk[decryptMaxAESRounds + 1];
+    unsigned char key[16];
+    __m128i x;
+    int b, round;
 
-    // CBC
-    for (c = 0; c < 4; ++c) {
-        s->buf[4 * c] = s->state[c] ^ s->cbc[4 * c];
-        s->buf[4 * c + 1] = s->state[4 + c] ^ s->cbc[4 * c + 1];
-        s->buf[4 * c + 2] = s->state[8 + c] ^ s->cbc[4 * c + 2];
-        s->buf[4 * c + 3] = s->state[12 + c] ^ s->cbc[4 * c + 3];
+    for (round = 0; round <= nRounds; ++round) {
+        aesRoundKeyBytes(&w[round * 4], key);
+        rk[round] = _mm_loadu_si128((const __m128i *)key);
     }
 
-    // save the input block for the next CBC
-    for (i = 0; i < 16; ++i) {
-        s->cbc[i] = in[i];
+    // CBC encryption is sequential
+    x = _mm_loadu_si128((const __m128i *)cbc);
+    for (b = 0; b < nBlocks; ++b, buf += 16) {
+        x = _mm_xor_si128(_mm_xor_si128(x, _mm_loadu_si128((const __m128i *)buf)), rk[0]);
+        for (round = 1; round < nRounds; ++round) {
+            x = _mm_aesenc_si128(x, rk[round]);
+        }
+        x = _mm_aesenclast_si128(x, rk[nRounds]);
+        _mm_storeu_si128((__m128i *)buf, x);
     }
+    _mm_storeu_si128((__m128i *)cbc, x);
+}
 
-    // remove padding
-    s->bufIdx = 0;
-    if (last) {
-        n = s->buf[15];
-        if (n < 1 || n > 16) { // this should never happen
-            n = 16;
+DECRYPT_AESNI_TARGET static void aesDecryptCBCAESNI(const unsigned int *w, int nRounds, unsigned char *cbc, unsigned char *buf, int nBlocks)
+{
+    __m128i rk[decryptMaxAESRounds + 1];
+    unsigned char key[16];
+    __m128i iv, in0, in1, in2, in3, x0, x1, x2, x3;
+    int b, round;
+
+    for (round = 0; round <= nRounds; ++round) {
+        aesRoundKeyBytes(&w[round * 4], key);
+        rk[round] = _mm_loadu_si128((const __m128i *)key);
+    }
+
+    iv = _mm_loadu_si128((const __m128i *)cbc);
+
+    // CBC decryption isn't sequential, so four blocks are interleaved to
+    // hide the latency of AESDEC
+    for (b = 0; b + 4 <= nBlocks; b += 4, buf += 64) {
+        in0 = _mm_loadu_si128((const __m128i *)buf);
+        in1 = _mm_loadu_si128((const __m128i *)(buf + 16));
+        in2 = _mm_loadu_si128((const __m128i *)(buf + 32));
+        in3 = _mm_loadu_si128((const __m128i *)(buf + 48));
+        x0 = _mm_xor_si128(in0, rk[nRounds]);
+        x1 = _mm_xor_si128(in1, rk[nRounds]);
+        x2 = _mm_xor_si128(in2, rk[nRounds]);
+        x3 = _mm_xor_si128(in3, rk[nRounds]);
+        for (round = nRounds - 1; round >= 1; --round) {
+            x0 = _mm_aesdec_si128(x0, rk[round]);
+            x1 = _mm_aesdec_si128(x1, rk[round]);
+            x2 = _mm_aesdec_si128(x2, rk[round]);
+            x3 = _mm_aesdec_si128(x3, rk[round]);
         }
-        for (i = 15; i >= n; --i) {
-            s->buf[i] = s->buf[i - n];
+        x0 = _mm_aesdeclast_si128(x0, rk[0]);
+        x1 = _mm_aesdeclast_si128(x1, rk[0]);
+        x2 = _mm_aesdeclast_si128(x2, rk[0]);
+        x3 = _mm_aesdeclast_si128(x3, rk[0]);
+        _mm_storeu_si128((__m128i *)buf, _mm_xor_si128(x0, iv));
+        _mm_storeu_si128((__m128i *)(buf + 16), _mm_xor_si128(x1, in0));
+        _mm_storeu_si128((__m128i *)(buf + 32), _mm_xor_si128(x2, in1));
+        _mm_storeu_si128((__m128i *)(buf + 48), _mm_xor_si128(x3, in2));
+        iv = in3;
+    }
+    for (; b < nBlocks; ++b, buf += 16) {
+        in0 = _mm_loadu_si128((const __m128i *)buf);
+        x0 = _mm_xor_si128(in0, rk[nRounds]);
+        for (round = nRounds - 1; round >= 1; --round) {
+            x0 = _mm_aesdec_si128(x0, rk[round]);
         }
-        s->bufIdx = n;
-        if (n > 16) {
-            error(errSyntaxError, -1, "Reducing bufIdx from {0:d} to 16 to not crash", n);
-            s->bufIdx = 16;
+        x0 = _mm_aesdeclast_si128(x0, rk[0]);
+        _mm_storeu_si128((__m128i *)buf, _mm_xor_si128(x0, iv));
+        iv = in0;
+    }
+    _mm_storeu_si128((__m128i *)cbc, iv);
+}
+
+#endif
+
+#ifdef DECRYPT_ARM_CRYPTO
+
+// AESE and AESD add the round key before the (inverse) byte substitution
+// rather than after the (inverse) mix columns step, so the keys are used
+// one round earlier than with AES-NI.
+static void aesEncryptCBCARM(const unsigned int *w, int nRounds, unsigned char *cbc, unsigned char *buf, int nBlocks)
+{
+    uint8x16_t rk[decryptMaxAESRounds + 1];
+    unsigned char key[16];
+    uint8x16_t x;
+    int b, round;
+
+    for (round = 0; round <= nRounds; ++round) {
+        aesRoundKeyBytes(&w[round * 4], key);
+        rk[round] = vld1q_u8(key);
+    }
+
+    x = vld1q_u8(cbc);
+    for (b = 0; b < nBlocks; ++b, buf += 16) {
+        x = veorq_u8(x, vld1q_u8(buf));
+        for (round = 0; round < nRounds - 1; ++round) {
+            x = vaesmcq_u8(vaeseq_u8(x, rk[round]));
         }
+        x = veorq_u8(vaeseq_u8(x, rk[nRounds - 1]), rk[nRounds]);
+        vst1q_u8(buf, x);
     }
+    vst1q_u8(cbc, x);
 }
 
+static void aesDecryptCBCARM(const unsigned int *w, int nRounds, unsigned char *cbc, unsigned char *buf, int nBlocks)
+{
+    uint8x16_t rk[decryptMaxAESRounds + 1];
+    unsigned char key[16];
+    uint8x16_t iv, in, x;
+    int b, round;
+
+    for (round = 0; round <= nRounds; ++round) {
+        aesRoundKeyBytes(&w[round * 4], key);
+        rk[round] = vld1q_u8(key);
+    }
+
+    iv = vld1q_u8(cbc);
+    for (b = 0; b < nBlocks; ++b, buf += 16) {
+        in = vld1q_u8(buf);
+        x = in;
+        for (round = nRounds; round > 1; --round) {
+            x = vaesimcq_u8(vaesdq_u8(x, rk[round]));
+        }
+        x = veorq_u8(vaesdq_u8(x, rk[1]), rk[0]);
+        vst1q_u8(buf, veorq_u8(x, iv));
+        iv = in;
+    }
+    vst1q_u8(cbc, iv);
+}
+
+#endif
+
 //------------------------------------------------------------------------
 // MD5 message digest
 //------------------------------------------------------------------------
@@ -1467,8 +1619,16 @@ static void sha256HashBlock(const unsigned char *blk, unsigned int *H)
     H[7] += h;
 }
 
+static void sha256BlocksPortable(const unsigned char *msg, int nBlocks, unsigned int *H)
+{
+    for (int i = 0; i < nBlocks; ++i) {
+        sha256HashBlock(msg + i * 64, H);
+    }
+}
+
 static void sha256(unsigned char *msg, int msgLen, unsigned char *hash)
 {
+    const SHA256BlocksFunc sha256Blocks = getCryptFuncs().sha256Blocks;
     unsigned char blk[64];
     unsigned int H[8];
     int blkLen, i;
@@ -1482,10 +1642,8 @@ static void sha256(unsigned char *msg, int msgLen, unsigned char *hash)
     H[6] = 0x1f83d9ab;
     H[7] = 0x5be0cd19;
 
-    blkLen = 0;
-    for (i = 0; i + 64 <= msgLen; i += 64) {
-        sha256HashBlock(msg + i, H);
-    }
+    i = msgLen & ~63;
+    sha256Blocks(msg, msgLen / 64, H);
     blkLen = msgLen - i;
     if (blkLen > 0) {
         memcpy(blk, msg + i, blkLen);
@@ -1497,7 +1655,7 @@ static void sha256(unsigned char *msg, int msgLen, unsigned char *hash)
         while (blkLen < 64) {
             blk[blkLen++] = 0;
         }
-        sha256HashBlock(blk, H);
+        sha256Blocks(blk, 1, H);
         blkLen = 0;
     }
     while (blkLen < 56) {
@@ -1511,7 +1669,7 @@ static void sha256(unsigned char *msg, int msgLen, unsigned char *hash)
     blk[61] = (unsigned char)(msgLen >> 13);
     blk[62] = (unsigned char)(msgLen >> 5);
     blk[63] = (unsigned char)(msgLen << 3);
-    sha256HashBlock(blk, H);
+    sha256Blocks(blk, 1, H);
 
     // copy the output into the buffer (convert words to bytes)
     for (i = 0; i < 8; ++i) {
@@ -1758,16 +1916,117 @@ static void sha384(unsigned char *msg, int msgLen, unsigned char *hash)
     }
 }
 
+//------------------------------------------------------------------------
+// SHA-256 with the SHA extensions
+//------------------------------------------------------------------------
+
+#ifdef DECRYPT_X86_CRYPTO
+
+#    define DECRYPT_SHA_TARGET __attribute__((target("sha,sse4.1")))
+
+DECRYPT_SHA_TARGET static void sha256BlocksSHA(const unsigned char *msg, int nBlocks, unsigned int *H)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i abef, cdgh, abefSave, cdghSave, tmp, msgK;
+    __m128i W[4];
+    int i;
+
+    // SHA256RNDS2 keeps the working variables as ABEF and CDGH
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&H[0]), 0xb1); // CDAB
+    cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&H[4]), 0x1b); // EFGH
+    abef = _mm_alignr_epi8(tmp, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+    for (; nBlocks > 0; --nBlocks, msg += 64) {
+        abefSave = abef;
+        cdghSave = cdgh;
+
+        // four rounds at a time; W[i & 3] holds words 4i to 4i+3 of the
+        // message schedule
+        for (i = 0; i < 16; ++i) {
+            if (i < 4) {
+                W[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(msg + i * 16)), byteSwap);
+            } else {
+                tmp = _mm_add_epi32(_mm_sha256msg1_epu32(W[i & 3], W[(i + 1) & 3]), _mm_alignr_epi8(W[(i + 3) & 3], W[(i + 2) & 3], 4));
+                W[i & 3] = _mm_sha256msg2_epu32(tmp, W[(i + 3) & 3]);
+            }
+            msgK = _mm_add_epi32(W[i & 3], _mm_loadu_si128((const __m128i *)&sha256K[i * 4]));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msgK);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msgK, 0x0e));
+        }
+
+        abef = _mm_add_epi32(abef, abefSave);
+        cdgh = _mm_add_epi32(cdgh, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(abef, 0x1b); // FEBA
+    cdgh = _mm_shuffle_epi32(cdgh, 0xb1); // DCHG
+    _mm_storeu_si128((__m128i *)&H[0], _mm_blend_epi16(tmp, cdgh, 0xf0)); // DCBA
+    _mm_storeu_si128((__m128i *)&H[4], _mm_alignr_epi8(cdgh, tmp, 8)); // HGFE
+}
+
+#endif
+
+//------------------------------------------------------------------------
+// implementation selection
+//------------------------------------------------------------------------
+
+static const CryptFuncs portableCryptFuncs = { &aesEncryptCBCPortable, &aesDecryptCBCPortable, &sha256BlocksPortable };
+
+static std::atomic<bool> cryptHardwareEnabled(true);
+
+static const CryptFuncs &getHardwareCryptFuncs()
+{
+    static const CryptFuncs funcs = [] {
+        CryptFuncs f = portableCryptFuncs;
+#ifdef DECRYPT_X86_CRYPTO
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            if (ecx & bit_AES) {
+                f.aesEncryptCBC = &aesEncryptCBCAESNI;
+                f.aesDecryptCBC = &aesDecryptCBCAESNI;
+            }
+            const bool sse41 = ecx & bit_SSE4_1;
+            if (sse41 && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA)) {
+                f.sha256Blocks = &sha256BlocksSHA;
+            }
+        }
+#endif
+#ifdef DECRYPT_ARM_CRYPTO
+        f.aesEncryptCBC = &aesEncryptCBCARM;
+        f.aesDecryptCBC = &aesDecryptCBCARM;
+#endif
+        return f;
+    }();
+    return funcs;
+}
+
+static const CryptFuncs &getCryptFuncs()
+{
+    return cryptHardwareEnabled ? getHardwareCryptFuncs() : portableCryptFuncs;
+}
+
+void setCryptHardwareEnabled(bool enabled)
+{
+    cryptHardwareEnabled = enabled;
+}
+
+void getCryptHardware(bool *aes, bool *sha256)
+{
+    const CryptFuncs &funcs = getCryptFuncs();
+    *aes = funcs.aesDecryptCBC != portableCryptFuncs.aesDecryptCBC;
+    *sha256 = funcs.sha256Blocks != portableCryptFuncs.sha256Blocks;
+}
+
 //------------------------------------------------------------------------
 // Section 7.6.3.3 (Encryption Key algorithm) of ISO/DIS 32000-2
 // Algorithm 2.B:Computing a hash (for revision 6).
 //------------------------------------------------------------------------
 static void revision6Hash(const GooString *inputPassword, unsigned char *K, const char *userKey)
 {
-    unsigned char K1[64 * (127 + 64 + 48)];
     unsigned char E[64 * (127 + 64 + 48)];
     DecryptAESState state;
-    unsigned char aesKey[16];
+    unsigned char iv[16];
     unsigned char BE16byteNumber[16];
 
     int inputPasswordLength = inputPassword->getLength();
@@ -1780,27 +2039,19 @@ static void revision6Hash(const GooString *inputPassword, unsigned char *K, cons
     while (rounds < 64 || rounds < E[totalLength - 1] + 32) {
         sequenceLength = inputPasswordLength + KLength + userKeyLength;
         totalLength = 64 * sequenceLength;
-        // a.make the string K1
-        memcpy(K1, inputPassword->c_str(), inputPasswordLength);
-        memcpy(K1 + inputPasswordLength, K, KLength);
+        // a.make the string K1 (in E, where it is encrypted in place)
+        memcpy(E, inputPassword->c_str(), inputPasswordLength);
+        memcpy(E + inputPasswordLength, K, KLength);
         if (userKey) {
-            memcpy(K1 + inputPasswordLength + KLength, userKey, userKeyLength);
+            memcpy(E + inputPasswordLength + KLength, userKey, userKeyLength);
         }
         for (int i = 1; i < 64; ++i) {
-            memcpy(K1 + (i * sequenceLength), K1, sequenceLength);
+            memcpy(E + (i * sequenceLength), E, sequenceLength);
         }
         // b.Encrypt K1
-        memcpy(aesKey, K, 16);
-        memcpy(state.cbc, K + 16, 16);
-        memcpy(state.buf, state.cbc, 16); // Copy CBC IV to buf
-        state.bufIdx = 0;
-        state.paddingReached = false;
-        aesKeyExpansion(&state, aesKey, 16, false);
-
-        for (int i = 0; i < (4 * sequenceLength); i++) {
-            aesEncryptBlock(&state, K1 + (16 * i));
-            memcpy(E + (16 * i), state.buf, 16);
-        }
+        memcpy(iv, K + 16, 16);
+        aesKeyExpansion(&state, K, 16, false);
+        getCryptFuncs().aesEncryptCBC(state.w, 10, iv, E, 4 * sequenceLength);
         memcpy(BE16byteNumber, E, 16);
         // c.Taking the first 16 Bytes of E as unsigned big-endian integer,
         // compute the remainder,modulo 3.
@@ -33,6 +33,7 @@
 #include "goo/GooString.h"
 #include "Object.h"
 #include "Stream.h"
+#include "poppler_private_export.h"
 
 //------------------------------------------------------------------------
 // Decrypt
@@ -63,8 +64,9 @@ private:
  * In case of decryption, the cbc field in AES and AES-256 contains the previous
  * input block or the CBC initialization vector (IV) if the stream has just been
  * reset). In case of encryption, it always contains the IV, whereas the
- * previous output is kept in buf. The paddingReached field is only used in
- * case of encryption. */
+ * previous output is kept in buf. The buf, bufIdx and paddingReached fields
+ * are only used in case of encryption, DecryptStream decrypts into its own
+ * buffer. */
 struct DecryptRC4State
 {
     unsigned char state[256];
@@ -74,21 +76,19 @@ struct DecryptRC4State
 struct DecryptAESState
 {
     unsigned int w[44];
-    unsigned char state[16];
     unsigned char cbc[16];
     unsigned char buf[16];
     bool paddingReached; // encryption only
-    int bufIdx;
+    int bufIdx; // encryption only
 };
 
 struct DecryptAES256State
 {
     unsigned int w[60];
-    unsigned char state[16];
     unsigned char cbc[16];
     unsigned char buf[16];
     bool paddingReached; // encryption only
-    int bufIdx;
+    int bufIdx; // encryption only
 };
 
 class BaseCryptStream : public FilterStream
@@ -139,11 +139,29 @@ public:
     DecryptStream(Stream *strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref ref);
     ~DecryptStream() override;
     [[nodiscard]] bool reset() override;
+    int getChar() override;
     int lookChar() override;
+    bool hasGetChars() override { return true; }
+    int getChars(int nChars, unsigned char *buffer) override;
+
+private:
+    bool fillBuf();
+
+    // decrypted data, filled a few thousand bytes at a time so that AES
+    // can work on many blocks at once
+    unsigned char buf[4096];
+    int bufPos, bufLen;
 };
 
 //------------------------------------------------------------------------
 
 extern void md5(const unsigned char *msg, int msgLen, unsigned char *digest);
 
+// Select whether AES and SHA-256 use the instructions of the CPU where it
+// has them (the default), or the portable code.  Both give the same
+// results; this is for comparing them in tests.
+POPPLER_PRIVATE_EXPORT void setCryptHardwareEnabled(bool enabled);
+// Return which of AES and SHA-256 use CPU instructions now.
+POPPLER_PRIVATE_EXPORT void getCryptHardware(bool *aes, bool *sha256);
+
 #endif
@@ -0,0 +1,1113 @@
+//========================================================================
+//
+// DisplayListOutputDev.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <cstring>
+#include <string>
+
+#include "goo/GooString.h"
+#include "Dict.h"
+#include "Error.h"
+#include "Function.h"
+#include "GfxState.h"
+#include "Object.h"
+#include "Stream.h"
+#include "DisplayListOutputDev.h"
+
+//------------------------------------------------------------------------
+// DisplayListOp
+//------------------------------------------------------------------------
+
+enum DisplayListOpKind
+{
+    displayListOpOther,
+    displayListOpNonText, // painting that devices without needNonText() skip
+    displayListOpShadedFill, // an axial or radial shaded fill
+    displayListOpShadingFallback, // the fills Gfx draws if the device can't do the shaded fill before
+    displayListOpDisableVectorAntialias, // Gfx turns vector antialiasing off for shadings
+    displayListOpRestoreVectorAntialias,
+    displayListOpType3Text, // a Type 3 character, for devices that don't run glyph procedures
+    displayListOpType3Char, // start of a Type 3 glyph procedure
+    displayListOpEndType3Char // end of a Type 3 glyph procedure
+};
+
+class DisplayListOp
+{
+public:
+    DisplayListOp(std::shared_ptr<GfxState> stateA, DisplayListOpKind kindA = displayListOpOther) : state(std::move(stateA)), kind(kindA) { }
+    virtual ~DisplayListOp();
+
+    DisplayListOp(const DisplayListOp &) = delete;
+    DisplayListOp &operator=(const DisplayListOp &) = delete;
+
+    // <stateA> is the recorded state, scaled to the replay resolution
+    virtual void replay(OutputDev *out, GfxState *stateA) const = 0;
+
+    // Replays an op that is followed by ops the device may not need: the
+    // start of a Type 3 glyph procedure or a shaded fill.  Returns true if
+    // the device did the drawing itself and the following ops have to be
+    // skipped.
+    virtual bool replayAlternative(OutputDev *out, GfxState *stateA) const
+    {
+        replay(out, stateA);
+        return false;
+    }
+
+    const GfxState *getState() const { return state.get(); }
+    DisplayListOpKind getKind() const { return kind; }
+
+private:
+    std::shared_ptr<GfxState> state;
+    DisplayListOpKind kind;
+};
+
+DisplayListOp::~DisplayListOp() = default;
+
+namespace {
+
+// All the OutputDev calls that only take the state
+class StateOp : public DisplayListOp
+{
+public:
+    StateOp(std::shared_ptr<GfxState> stateA, void (OutputDev::*funcA)(GfxState *), DisplayListOpKind kindA) : DisplayListOp(std::move(stateA), kindA), func(funcA) { }
+
+    void replay(OutputDev *out, GfxState *stateA) const override { (out->*func)(stateA); }
+
+private:
+    void (OutputDev::*func)(GfxState *);
+};
+
+class UpdateCTMOp : public DisplayListOp
+{
+public:
+    UpdateCTMOp(std::shared_ptr<GfxState> stateA, double m11, double m12, double m21, double m22, double m31, double m32) : DisplayListOp(std::move(stateA)), m { m11, m12, m21, m22, m31, m32 } { }
+
+    void replay(OutputDev *out, GfxState *stateA) const override { out->updateCTM(stateA, m[0], m[1], m[2], m[3], m[4], m[5]); }
+
+private:
+    double m[6];
+};
+
+class UpdateTextShiftOp : public DisplayListOp
+{
+public:
+    UpdateTextShiftOp(std::shared_ptr<GfxState> stateA, double shiftA) : DisplayListOp(std::move(stateA)), shift(shiftA) { }
+
+    void replay(OutputDev *out, GfxState *stateA) const override { out->updateTextShift(stateA, shift); }
+
+private:
+    double shift;
+};
+
+class ShadedFillOp : public DisplayListOp
+{
+public:
+    ShadedFillOp(std::shared_ptr<GfxState> stateA, const GfxShading *shadingA, double tMinA, double tMaxA) : DisplayListOp(std::move(stateA), displayListOpShadedFill), shading(shadingA->copy()), tMin(tMinA), tMax(tMaxA) { }
+
+    void replay(OutputDev *out, GfxState *stateA) const override { replayAlternative(out, stateA); }
+
+    bool replayAlternative(OutputDev *out, GfxState *stateA) const override
+    {
+        if (!shading || !out->useShadedFills(shading->getType())) {
+            return false;
+        }
+        if (shading->getType() == 2) {
+            return out->axialShadedFill(stateA, static_cast<GfxAxialShading *>(shading.get()), tMin, tMax);
+        } else if (shading->getType() == 3) {
+            return out->radialShadedFill(stateA, static_cast<GfxRadialShading *>(shading.get()), tMin, tMax);
+        }
+        return false;
+    }
+
+private:
+    std::unique_ptr<GfxShading> shading;
+    double tMin, tMax;
+};
+
+class BeginStringOp : public DisplayListOp
+{
+public:
+    BeginStringOp(std::shared_ptr<GfxState> stateA, const GooString *sA) : DisplayListOp(std::move(stateA)), s(sA) { }
+
+    void replay(OutputDev *out, GfxState *stateA) const override { out->beginString(stateA, &s); }
+
+private:
+    GooString s;
+};
+
+class BeginActualTextOp : public DisplayListOp
+{
+public:
+    BeginActualTextOp(std::shared_ptr<GfxState> stateA, const GooString *textA) : DisplayListOp(std::move(stateA)), text(textA) { }
+
+    void replay(OutputDev *out, GfxState *stateA) const override { out->beginActualText(stateA, &text); }
+
+private:
+    GooString text;
+};
+
+class DrawCharOp : public DisplayListOp
+{
+public:
+    DrawCharOp(std::shared_ptr<GfxState> stateA, double xA, double yA, double dxA, double dyA, double originXA, double originYA, CharCode codeA, int nBytesA, const Unicode *uA, int uLen, DisplayListOpKind kindA = displayListOpOther)
+        : DisplayListOp(std::move(stateA), kindA), x(xA), y(yA), dx(dxA), dy(dyA), originX(originXA), originY(originYA), code(codeA), nBytes(nBytesA)
+    {
+        if (uA && uLen > 0) {
+            u.assign(uA, uA + uLen);
+        }
+    }
+
+    void replay(OutputDev *out, GfxState *stateA) const override { out->drawChar(stateA, x, y, dx, dy, originX, originY, code, nBytes, u.empty() ? nullptr : u.data(), (int)u.size()); }
+
+private:
+    double x, y, dx, dy, originX, originY;
+    CharCode code;
+    int nBytes;
+    std::vector<Unicode> u;
+};
+
+class MarkedContentOp : public DisplayListOp
+{
+public:
+    enum Type
+    {
+        beginMarkedContent,
+        markPoint
+    };
+
+    // <propertiesA> is copied, the copy shares the objects it refers to
+    MarkedContentOp(Type typeA, const char *nameA, Dict *propertiesA, XRef *xref) : DisplayListOp(nullptr), type(typeA), name(nameA)
+    {
+        if (propertiesA) {
+            properties = Object(propertiesA->copy(xref));
+        }
+    }
+
+    void replay(OutputDev *out, GfxState * /*stateA*/) const override
+    {
+        Dict *dict = properties.isDict() ? properties.getDict() : nullptr;
+        switch (type) {
+        case beginMarkedContent:
+            out->beginMarkedContent(name.c_str(), dict);
+            break;
+        case markPoint:
+            if (dict) {
+                out->markPoint(name.c_str(), dict);
+            } else {
+                out->markPoint(name.c_str());
+            }
+            break;
+        }
+    }
+
+private:
+    Type type;
+    std::string name;
+    Object properties;
+};
+
+class BeginType3CharOp : public DisplayListOp
+{
+public:
+    BeginType3CharOp(std::shared_ptr<GfxState> stateA, double xA, double yA, double dxA, double dyA, CharCode codeA, const Unicode *uA, int uLen) : DisplayListOp(std::move(stateA), displayListOpType3Char), x(xA), y(yA), dx(dxA), dy(dyA), code(codeA)
+    {
+        if (uA && uLen > 0) {
+            u.assign(uA, uA + uLen);
+        }
+    }
+
+    void replay(OutputDev *out, GfxState *stateA) const override { replayAlternative(out, stateA); }
+    bool replayAlternative(OutputDev *out, GfxState *stateA) const override { return out->beginType3Char(stateA, x, y, dx, dy, code, u.empty() ? nullptr : u.data(), (int)u.size()); }
+
+private:
+    double x, y, dx, dy;
+    CharCode code;
+    std::vector<Unicode> u;
+};
+
+// Handled by DisplayList::replay()
+class VectorAntialiasOp : public DisplayListOp
+{
+public:
+    explicit VectorAntialiasOp(bool on) : DisplayListOp(nullptr, on ? displayListOpRestoreVectorAntialias : displayListOpDisableVectorAntialias) { }
+
+    void replay(OutputDev * /*out*/, GfxState * /*stateA*/) const override { }
+};
+
+class Type3MetricsOp : public DisplayListOp
+{
+public:
+    // d0 if <hasBBoxA> is false, d1 otherwise
+    Type3MetricsOp(std::shared_ptr<GfxState> stateA, double wxA, double wyA, bool hasBBoxA, double llxA, double llyA, double urxA, double uryA)
+        : DisplayListOp(std::move(stateA)), wx(wxA), wy(wyA), hasBBox(hasBBoxA), bbox { llxA, llyA, urxA, uryA }
+    {
+    }
+
+    void replay(OutputDev *out, GfxState *stateA) const override
+    {
+        if (hasBBox) {
+            out->type3D1(stateA, wx, wy, bbox[0], bbox[1], bbox[2], bbox[3]);
+        } else {
+            out->type3D0(stateA, wx, wy);
+        }
+    }
+
+private:
+    double wx, wy;
+    bool hasBBox;
+    double bbox[4];
+};
+
+class IncCharCountOp : public DisplayListOp
+{
+public:
+    explicit IncCharCountOp(int nCharsA) : DisplayListOp(nullptr), nChars(nCharsA) { }
+
+    void replay(OutputDev *out, GfxState * /*stateA*/) const override
+    {
+        if (out->needCharCount()) {
+            out->incCharCount(nChars);
+        }
+    }
+
+private:
+    int nChars;
+};
+
+// Decoded image samples, replayed through a MemStream
+class ImageData
+{
+public:
+    ImageData(Stream *str, size_t size) : data(size, 0)
+    {
+        if (size > 0 && str->reset()) {
+            str->doGetChars((int)size, reinterpret_cast<unsigned char *>(data.data()));
+            str->close();
+        }
+    }
+
+    std::unique_ptr<Stream> makeStream() const { return std::make_unique<MemStream>(data.data(), 0, data.size(), Object::null()); }
+    size_t size() const { return data.size(); }
+
+private:
+    std::vector<char> data;
+};
+
+static size_t imageDataSize(int width, int height, int nComps, int nBits)
+{
+    if (width <= 0 || height <= 0 || nComps <= 0 || nBits <= 0) {
+        return 0;
+    }
+    return (size_t)height * (((size_t)width * nComps * nBits + 7) / 8);
+}
+
+class ImageOp : public DisplayListOp
+{
+public:
+    enum Type
+    {
+        imageMask,
+        image,
+        maskedImage,
+        softMaskedImage
+    };
+
+    ImageOp(std::shared_ptr<GfxState> stateA, Type typeA, Object *refA, Stream *str, int widthA, int heightA, GfxImageColorMap *colorMapA, bool invertA, bool interpolateA, const int *maskColorsA)
+        : DisplayListOp(std::move(stateA), displayListOpNonText), type(typeA), ref(refA ? refA->copy() : Object()), width(widthA), height(heightA), invert(invertA), interpolate(interpolateA)
+    {
+        if (colorMapA) {
+            colorMap.reset(colorMapA->copy());
+            data = std::make_unique<ImageData>(str, imageDataSize(width, height, colorMap->getNumPixelComps(), colorMap->getBits()));
+            if (maskColorsA) {
+                maskColors.assign(maskColorsA, maskColorsA + 2 * colorMap->getNumPixelComps());
+            }
+        } else {
+            data = std::make_unique<ImageData>(str, imageDataSize(width, height, 1, 1));
+        }
+    }
+
+    void setMask(Stream *maskStr, int maskWidthA, int maskHeightA, bool maskInvertA, bool maskInterpolateA, GfxImageColorMap *maskColorMapA)
+    {
+        maskWidth = maskWidthA;
+        maskHeight = maskHeightA;
+        maskInvert = maskInvertA;
+        maskInterpolate = maskInterpolateA;
+        if (maskColorMapA) {
+            maskColorMap.reset(maskColorMapA->copy());
+            maskData = std::make_unique<ImageData>(maskStr, imageDataSize(maskWidth, maskHeight, maskColorMap->getNumPixelComps(), maskColorMap->getBits()));
+        } else {
+            maskData = std::make_unique<ImageData>(maskStr, imageDataSize(maskWidth, maskHeight, 1, 1));
+        }
+    }
+
+    size_t getDataSize() const { return data->size() + (maskData ? maskData->size() : 0); }
+
+    void replay(OutputDev *out, GfxState *stateA) const override
+    {
+        Object refCopy = ref.copy();
+        std::unique_ptr<Stream> str = data->makeStream();
+        std::unique_ptr<Stream> maskStr = maskData ? maskData->makeStream() : nullptr;
+        switch (type) {
+        case imageMask:
+            out->drawImageMask(stateA, &refCopy, str.get(), width, height, invert, interpolate, false);
+            break;
+        case image:
+            out->drawImage(stateA, &refCopy, str.get(), width, height, colorMap.get(), interpolate, maskColors.empty() ? nullptr : maskColors.data(), false);
+            break;
+        case maskedImage:
+            out->drawMaskedImage(stateA, &refCopy, str.get(), width, height, colorMap.get(), interpolate, maskStr.get(), maskWidth, maskHeight, maskInvert, maskInterpolate);
+            break;
+        case softMaskedImage:
+            out->drawSoftMaskedImage(stateA, &refCopy, str.get(), width, height, colorMap.get(), interpolate, maskStr.get(), maskWidth, maskHeight, maskColorMap.get(), maskInterpolate);
+            break;
+        }
+    }
+
+private:
+    Type type;
+    Object ref;
+    int width, height;
+    std::unique_ptr<GfxImageColorMap> colorMap;
+    bool invert, interpolate;
+    std::vector<int> maskColors;
+    std::unique_ptr<ImageData> data;
+
+    int maskWidth = 0, maskHeight = 0;
+    bool maskInvert = false, maskInterpolate = false;
+    std::unique_ptr<GfxImageColorMap> maskColorMap;
+    std::unique_ptr<ImageData> maskData;
+};
+
+class BeginTransparencyGroupOp : public DisplayListOp
+{
+public:
+    BeginTransparencyGroupOp(std::shared_ptr<GfxState> stateA, const double *bboxA, GfxColorSpace *blendingColorSpaceA, bool isolatedA, bool knockoutA, bool forSoftMaskA)
+        : DisplayListOp(std::move(stateA)), blendingColorSpace(blendingColorSpaceA ? blendingColorSpaceA->copy() : nullptr), isolated(isolatedA), knockout(knockoutA), forSoftMask(forSoftMaskA)
+    {
+        memcpy(bbox, bboxA, sizeof(bbox));
+    }
+
+    void replay(OutputDev *out, GfxState *stateA) const override { out->beginTransparencyGroup(stateA, bbox, blendingColorSpace.get(), isolated, knockout, forSoftMask); }
+
+private:
+    double bbox[4];
+    std::unique_ptr<GfxColorSpace> blendingColorSpace;
+    bool isolated, knockout, forSoftMask;
+};
+
+class PaintTransparencyGroupOp : public DisplayListOp
+{
+public:
+    PaintTransparencyGroupOp(std::shared_ptr<GfxState> stateA, const double *bboxA) : DisplayListOp(std::move(stateA)) { memcpy(bbox, bboxA, sizeof(bbox)); }
+
+    void replay(OutputDev *out, GfxState *stateA) const override { out->paintTransparencyGroup(stateA, bbox); }
+
+private:
+    double bbox[4];
+};
+
+class SetSoftMaskOp : public DisplayListOp
+{
+public:
+    SetSoftMaskOp(std::shared_ptr<GfxState> stateA, const double *bboxA, bool alphaA, Function *transferFuncA, const GfxColor *backdropColorA)
+        : DisplayListOp(std::move(stateA)), alpha(alphaA), transferFunc(transferFuncA ? transferFuncA->copy() : nullptr), hasBackdropColor(backdropColorA != nullptr)
+    {
+        memcpy(bbox, bboxA, sizeof(bbox));
+        if (backdropColorA) {
+            backdropColor = *backdropColorA;
+        }
+    }
+
+    void replay(OutputDev *out, GfxState *stateA) const override
+    {
+        GfxColor backdrop = backdropColor;
+        out->setSoftMask(stateA, bbox, alpha, transferFunc.get(), hasBackdropColor ? &backdrop : nullptr);
+    }
+
+private:
+    double bbox[4];
+    bool alpha;
+    std::unique_ptr<Function> transferFunc;
+    bool hasBackdropColor;
+    GfxColor backdropColor;
+};
+
+}
+
+//------------------------------------------------------------------------
+// DisplayList
+//------------------------------------------------------------------------
+
+DisplayList::DisplayList(int pageNumA, GfxState *state, XRef *xrefA, bool upsideDownA) : pageNum(pageNumA), pageState(state->copy(true)), xref(xrefA), upsideDown(upsideDownA), imageDataSize(0) { }
+
+DisplayList::~DisplayList() = default;
+
+double DisplayList::getHDPI() const
+{
+    return pageState->getHDPI();
+}
+
+double DisplayList::getVDPI() const
+{
+    return pageState->getVDPI();
+}
+
+bool DisplayList::replay(OutputDev *out, double hDPI, double vDPI) const
+{
+    if (out->upsideDown() != upsideDown) {
+        error(errInternal, -1, "DisplayList: output device coordinate orientation differs from the recorded one");
+        return false;
+    }
+
+    const double sx = hDPI / pageState->getHDPI();
+    const double sy = vDPI / pageState->getVDPI();
+
+    std::unique_ptr<GfxState> state(pageState->copy(true));
+    state->scaleDeviceSpace(sx, sy);
+    out->initGfxState(state.get());
+    out->startPage(pageNum, state.get(), xref);
+    out->setDefaultCTM(state->getCTM());
+
+    const bool needNonText = out->needNonText();
+    const bool drawType3Glyphs = out->interpretType3Chars();
+    // consecutive ops usually share their state, scale it only once;
+    // the scaled states are kept alive until the page is done since
+    // devices may hold on to them
+    std::vector<std::unique_ptr<GfxState>> scaledStates;
+    const GfxState *lastState = nullptr;
+    auto scaledState = [&](const DisplayListOp *op) -> GfxState * {
+        if (!op->getState()) {
+            return nullptr;
+        }
+        if (op->getState() != lastState) {
+            lastState = op->getState();
+            scaledStates.emplace_back(lastState->copy(true));
+            scaledStates.back()->scaleDeviceSpace(sx, sy);
+        }
+        return scaledStates.back().get();
+    };
+    // nesting depth of the glyph procedures being skipped
+    int skipDepth = 0;
+    bool skipShadingFallback = false;
+    std::vector<bool> savedVectorAntialias;
+    for (const std::unique_ptr<DisplayListOp> &op : ops) {
+        switch (op->getKind()) {
+        case displayListOpShadedFill:
+            if (!needNonText || skipDepth > 0) {
+                skipShadingFallback = true;
+                continue;
+            }
+            skipShadingFallback = op->replayAlternative(out, scaledState(op.get()));
+            continue;
+        case displayListOpShadingFallback:
+            if (!needNonText || skipDepth > 0 || skipShadingFallback) {
+                continue;
+            }
+            break;
+        case displayListOpDisableVectorAntialias:
+            if (skipDepth > 0) {
+                continue;
+            }
+            savedVectorAntialias.push_back(out->getVectorAntialias());
+            if (savedVectorAntialias.back()) {
+                out->setVectorAntialias(false);
+            }
+            continue;
+        case displayListOpRestoreVectorAntialias:
+            if (skipDepth > 0 || savedVectorAntialias.empty()) {
+                continue;
+            }
+            if (savedVectorAntialias.back()) {
+                out->setVectorAntialias(true);
+            }
+            savedVectorAntialias.pop_back();
+            continue;
+        case displayListOpType3Text:
+            if (drawType3Glyphs || skipDepth > 0) {
+                continue;
+            }
+            break;
+        case displayListOpType3Char:
+            // devices that don't interpret Type 3 glyphs got the character
+            // instead, devices with a glyph cache may draw it themselves
+            if (skipDepth > 0 || !drawType3Glyphs || op->replayAlternative(out, scaledState(op.get()))) {
+                ++skipDepth;
+            }
+            continue;
+        case displayListOpEndType3Char:
+            if (skipDepth > 0) {
+                --skipDepth;
+                continue;
+            }
+            break;
+        case displayListOpNonText:
+            if (!needNonText || skipDepth > 0) {
+                continue;
+            }
+            break;
+        case displayListOpOther:
+            if (skipDepth > 0) {
+                continue;
+            }
+            break;
+        }
+
+        op->replay(out, scaledState(op.get()));
+    }
+
+    out->endPage();
+    return true;
+}
+
+//------------------------------------------------------------------------
+// DisplayListOutputDev
+//------------------------------------------------------------------------
+
+DisplayListOutputDev::DisplayListOutputDev(bool upsideDownA) : upsideDownFlag(upsideDownA), stateChanged(true), shadingFallback(false), vectorAntialias(true) { }
+
+DisplayListOutputDev::~DisplayListOutputDev() = default;
+
+std::unique_ptr<DisplayList> DisplayListOutputDev::takeDisplayList()
+{
+    return std::move(list);
+}
+
+std::shared_ptr<GfxState> DisplayListOutputDev::snapshot(GfxState *state, bool withPath)
+{
+    // GfxState::copy(false) shares the path with the original, which is
+    // only safe for save/restore pairs, so snapshots always own a copy
+    if (withPath || stateChanged || !lastSnapshot) {
+        lastSnapshot.reset(state->copy(true));
+        stateChanged = false;
+    }
+    return lastSnapshot;
+}
+
+void DisplayListOutputDev::addOp(std::unique_ptr<DisplayListOp> op)
+{
+    if (op->getKind() != displayListOpShadingFallback) {
+        shadingFallback = false;
+    }
+    list->ops.push_back(std::move(op));
+}
+
+void DisplayListOutputDev::recordStateOp(GfxState *state, void (OutputDev::*func)(GfxState *), bool withPath, bool nonText)
+{
+    if (!list) {
+        return;
+    }
+    DisplayListOpKind kind = nonText ? displayListOpNonText : displayListOpOther;
+    // Gfx only sets the colors and fills the bands of a shading it
+    // couldn't hand to the device
+    if (shadingFallback && (func == &OutputDev::updateFillColor || func == &OutputDev::fill)) {
+        kind = displayListOpShadingFallback;
+    }
+    addOp(std::make_unique<StateOp>(snapshot(state, withPath), func, kind));
+}
+
+void DisplayListOutputDev::startPage(int pageNum, GfxState *state, XRef *xref)
+{
+    list.reset(new DisplayList(pageNum, state, xref, upsideDownFlag));
+    lastSnapshot.reset();
+    stateChanged = true;
+}
+
+void DisplayListOutputDev::endPage()
+{
+    lastSnapshot.reset();
+    stringSnapshot.reset();
+}
+
+void DisplayListOutputDev::saveState(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::saveState);
+}
+
+void DisplayListOutputDev::restoreState(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::restoreState);
+}
+
+void DisplayListOutputDev::updateAll(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateAll);
+}
+
+void DisplayListOutputDev::updateLineDash(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateLineDash);
+}
+
+void DisplayListOutputDev::updateFlatness(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateFlatness);
+}
+
+void DisplayListOutputDev::updateLineJoin(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateLineJoin);
+}
+
+void DisplayListOutputDev::updateLineCap(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateLineCap);
+}
+
+void DisplayListOutputDev::updateMiterLimit(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateMiterLimit);
+}
+
+void DisplayListOutputDev::updateLineWidth(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateLineWidth);
+}
+
+void DisplayListOutputDev::updateStrokeAdjust(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateStrokeAdjust);
+}
+
+void DisplayListOutputDev::updateAlphaIsShape(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateAlphaIsShape);
+}
+
+void DisplayListOutputDev::updateTextKnockout(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateTextKnockout);
+}
+
+void DisplayListOutputDev::updateFillColorSpace(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateFillColorSpace);
+}
+
+void DisplayListOutputDev::updateStrokeColorSpace(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateStrokeColorSpace);
+}
+
+void DisplayListOutputDev::updateFillColor(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateFillColor);
+}
+
+void DisplayListOutputDev::updateStrokeColor(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateStrokeColor);
+}
+
+void DisplayListOutputDev::updateBlendMode(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateBlendMode);
+}
+
+void DisplayListOutputDev::updateFillOpacity(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateFillOpacity);
+}
+
+void DisplayListOutputDev::updateStrokeOpacity(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateStrokeOpacity);
+}
+
+void DisplayListOutputDev::updatePatternOpacity(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updatePatternOpacity);
+}
+
+void DisplayListOutputDev::clearPatternOpacity(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::clearPatternOpacity);
+}
+
+void DisplayListOutputDev::updateFillOverprint(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateFillOverprint);
+}
+
+void DisplayListOutputDev::updateStrokeOverprint(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateStrokeOverprint);
+}
+
+void DisplayListOutputDev::updateOverprintMode(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateOverprintMode);
+}
+
+void DisplayListOutputDev::updateTransfer(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateTransfer);
+}
+
+void DisplayListOutputDev::updateFont(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateFont);
+}
+
+void DisplayListOutputDev::updateTextMat(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateTextMat);
+}
+
+void DisplayListOutputDev::updateCharSpace(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateCharSpace);
+}
+
+void DisplayListOutputDev::updateRender(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateRender);
+}
+
+void DisplayListOutputDev::updateRise(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateRise);
+}
+
+void DisplayListOutputDev::updateWordSpace(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateWordSpace);
+}
+
+void DisplayListOutputDev::updateHorizScaling(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateHorizScaling);
+}
+
+void DisplayListOutputDev::updateTextPos(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::updateTextPos);
+}
+
+void DisplayListOutputDev::updateCTM(GfxState *state, double m11, double m12, double m21, double m22, double m31, double m32)
+{
+    stateChanged = true;
+    if (list) {
+        addOp(std::make_unique<UpdateCTMOp>(snapshot(state), m11, m12, m21, m22, m31, m32));
+    }
+}
+
+void DisplayListOutputDev::updateTextShift(GfxState *state, double shift)
+{
+    stateChanged = true;
+    if (list) {
+        addOp(std::make_unique<UpdateTextShiftOp>(snapshot(state), shift));
+    }
+}
+
+void DisplayListOutputDev::stroke(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::stroke, true, true);
+}
+
+void DisplayListOutputDev::fill(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::fill, true, true);
+}
+
+void DisplayListOutputDev::eoFill(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::eoFill, true, true);
+}
+
+bool DisplayListOutputDev::axialShadedFill(GfxState *state, GfxAxialShading *shading, double tMin, double tMax)
+{
+    if (list) {
+        stateChanged = true;
+        addOp(std::make_unique<ShadedFillOp>(snapshot(state, true), shading, tMin, tMax));
+        shadingFallback = true;
+    }
+    // have Gfx record the fills it draws for devices that can't do the
+    // shaded fill
+    return false;
+}
+
+bool DisplayListOutputDev::radialShadedFill(GfxState *state, GfxRadialShading *shading, double sMin, double sMax)
+{
+    if (list) {
+        stateChanged = true;
+        addOp(std::make_unique<ShadedFillOp>(snapshot(state, true), shading, sMin, sMax));
+        shadingFallback = true;
+    }
+    return false;
+}
+
+void DisplayListOutputDev::setVectorAntialias(bool vaa)
+{
+    vectorAntialias = vaa;
+    if (list) {
+        addOp(std::make_unique<VectorAntialiasOp>(vaa));
+    }
+}
+
+void DisplayListOutputDev::clip(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::clip, true);
+}
+
+void DisplayListOutputDev::eoClip(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::eoClip, true);
+}
+
+void DisplayListOutputDev::clipToStrokePath(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::clipToStrokePath, true);
+}
+
+void DisplayListOutputDev::beginStringOp(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::beginStringOp);
+}
+
+void DisplayListOutputDev::endStringOp(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::endStringOp);
+}
+
+void DisplayListOutputDev::beginString(GfxState *state, const GooString *s)
+{
+    if (list) {
+        stringSnapshot = snapshot(state);
+        addOp(std::make_unique<BeginStringOp>(stringSnapshot, s));
+    }
+}
+
+void DisplayListOutputDev::endString(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::endString);
+    stringSnapshot.reset();
+}
+
+void DisplayListOutputDev::drawChar(GfxState *state, double x, double y, double dx, double dy, double originX, double originY, CharCode code, int nBytes, const Unicode *u, int uLen)
+{
+    if (list) {
+        addOp(std::make_unique<DrawCharOp>(snapshot(state), x, y, dx, dy, originX, originY, code, nBytes, u, uLen));
+    }
+}
+
+bool DisplayListOutputDev::beginType3Char(GfxState *state, double x, double y, double dx, double dy, CharCode code, const Unicode *u, int uLen)
+{
+    if (list) {
+        // Gfx has already switched the CTM to glyph space, devices that
+        // get the character instead of the glyph procedure need the text
+        // state of the string
+        std::shared_ptr<GfxState> textState = stringSnapshot ? stringSnapshot : snapshot(state);
+        // <dx>, <dy> went through the glyph space CTM, drawChar() wants
+        // the advance in user space like Gfx passes it for other fonts
+        const double *ctm = state->getCTM();
+        const double det = ctm[0] * ctm[3] - ctm[1] * ctm[2];
+        double tdx = 0, tdy = 0;
+        if (det != 0) {
+            const double textDx = (ctm[3] * dx - ctm[2] * dy) / det;
+            const double textDy = (ctm[0] * dy - ctm[1] * dx) / det;
+            textState->textTransformDelta(textDx, textDy, &tdx, &tdy);
+        }
+        addOp(std::make_unique<DrawCharOp>(textState, x, y, tdx, tdy, 0, 0, code, 1, u, uLen, displayListOpType3Text));
+        addOp(std::make_unique<BeginType3CharOp>(snapshot(state), x, y, dx, dy, code, u, uLen));
+    }
+    // always have Gfx run the glyph procedure
+    return false;
+}
+
+void DisplayListOutputDev::endType3Char(GfxState *state)
+{
+    if (list) {
+        addOp(std::make_unique<StateOp>(snapshot(state), &OutputDev::endType3Char, displayListOpEndType3Char));
+    }
+}
+
+void DisplayListOutputDev::type3D0(GfxState *state, double wx, double wy)
+{
+    if (list) {
+        addOp(std::make_unique<Type3MetricsOp>(snapshot(state), wx, wy, false, 0, 0, 0, 0));
+    }
+}
+
+void DisplayListOutputDev::type3D1(GfxState *state, double wx, double wy, double llx, double lly, double urx, double ury)
+{
+    if (list) {
+        addOp(std::make_unique<Type3MetricsOp>(snapshot(state), wx, wy, true, llx, lly, urx, ury));
+    }
+}
+
+void DisplayListOutputDev::beginTextObject(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::beginTextObject);
+}
+
+void DisplayListOutputDev::endTextObject(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::endTextObject);
+}
+
+void DisplayListOutputDev::incCharCount(int nChars)
+{
+    if (list) {
+        addOp(std::make_unique<IncCharCountOp>(nChars));
+    }
+}
+
+void DisplayListOutputDev::beginActualText(GfxState *state, const GooString *text)
+{
+    if (list) {
+        addOp(std::make_unique<BeginActualTextOp>(snapshot(state), text));
+    }
+}
+
+void DisplayListOutputDev::endActualText(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::endActualText);
+}
+
+void DisplayListOutputDev::beginMarkedContent(const char *name, Dict *properties)
+{
+    if (list) {
+        addOp(std::make_unique<MarkedContentOp>(MarkedContentOp::beginMarkedContent, name, properties, list->xref));
+    }
+}
+
+void DisplayListOutputDev::endMarkedContent(GfxState *state)
+{
+    recordStateOp(state, &OutputDev::endMarkedContent);
+}
+
+void DisplayListOutputDev::markPoint(const char *name)
+{
+    if (list) {
+        addOp(std::make_unique<MarkedContentOp>(MarkedContentOp::markPoint, name, nullptr, list->xref));
+    }
+}
+
+void DisplayListOutputDev::markPoint(const char *name, Dict *properties)
+{
+    if (list) {
+        addOp(std::make_unique<MarkedContentOp>(MarkedContentOp::markPoint, name, properties, list->xref));
+    }
+}
+
+void DisplayListOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str, int width, int height, bool invert, bool interpolate, bool /*inlineImg*/)
+{
+    if (!list) {
+        return;
+    }
+    stateChanged = true;
+    auto op = std::make_unique<ImageOp>(snapshot(state), ImageOp::imageMask, ref, str, width, height, nullptr, invert, interpolate, nullptr);
+    list->imageDataSize += op->getDataSize();
+    addOp(std::move(op));
+}
+
+void DisplayListOutputDev::drawImage(GfxState *state, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool interpolate, const int *maskColors, bool /*inlineImg*/)
+{
+    if (!list) {
+        return;
+    }
+    stateChanged = true;
+    auto op = std::make_unique<ImageOp>(snapshot(state), ImageOp::image, ref, str, width, height, colorMap, false, interpolate, maskColors);
+    list->imageDataSize += op->getDataSize();
+    addOp(std::move(op));
+}
+
+void DisplayListOutputDev::drawMaskedImage(GfxState *state, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool interpolate, Stream *maskStr, int maskWidth, int maskHeight, bool maskInvert, bool maskInterpolate)
+{
+    if (!list) {
+        return;
+    }
+    stateChanged = true;
+    auto op = std::make_unique<ImageOp>(snapshot(state), ImageOp::maskedImage, ref, str, width, height, colorMap, false, interpolate, nullptr);
+    op->setMask(maskStr, maskWidth, maskHeight, maskInvert, maskInterpolate, nullptr);
+    list->imageDataSize += op->getDataSize();
+    addOp(std::move(op));
+}
+
+void DisplayListOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool interpolate, Stream *maskStr, int maskWidth, int maskHeight, GfxImageColorMap *maskColorMap,
+                                               bool maskInterpolate)
+{
+    if (!list) {
+        return;
+    }
+    stateChanged = true;
+    auto op = std::make_unique<ImageOp>(snapshot(state), ImageOp::softMaskedImage, ref, str, width, height, colorMap, false, interpolate, nullptr);
+    op->setMask(maskStr, maskWidth, maskHeight, false, maskInterpolate, maskColorMap);
+    list->imageDataSize += op->getDataSize();
+    addOp(std::move(op));
+}
+
+void DisplayListOutputDev::beginTransparencyGroup(GfxState *state, const double *bbox, GfxColorSpace *blendingColorSpace, bool isolated, bool knockout, bool forSoftMask)
+{
+    if (list) {
+        stateChanged = true;
+        addOp(std::make_unique<BeginTransparencyGroupOp>(snapshot(state), bbox, blendingColorSpace, isolated, knockout, forSoftMask));
+    }
+}
+
+void DisplayListOutputDev::endTransparencyGroup(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::endTransparencyGroup);
+}
+
+void DisplayListOutputDev::paintTransparencyGroup(GfxState *state, const double *bbox)
+{
+    if (list) {
+        stateChanged = true;
+        addOp(std::make_unique<PaintTransparencyGroupOp>(snapshot(state), bbox));
+    }
+}
+
+void DisplayListOutputDev::setSoftMask(GfxState *state, const double *bbox, bool alpha, Function *transferFunc, GfxColor *backdropColor)
+{
+    if (list) {
+        stateChanged = true;
+        addOp(std::make_unique<SetSoftMaskOp>(snapshot(state), bbox, alpha, transferFunc, backdropColor));
+    }
+}
+
+void DisplayListOutputDev::clearSoftMask(GfxState *state)
+{
+    stateChanged = true;
+    recordStateOp(state, &OutputDev::clearSoftMask);
+}
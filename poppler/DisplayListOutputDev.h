@@ -0,0 +1,215 @@
+//========================================================================
+//
+// DisplayListOutputDev.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef DISPLAYLISTOUTPUTDEV_H
+#define DISPLAYLISTOUTPUTDEV_H
+
+#include <memory>
+#include <vector>
+
+#include "poppler_private_export.h"
+#include "OutputDev.h"
+
+class Dict;
+class GfxState;
+class XRef;
+class DisplayListOp;
+
+//------------------------------------------------------------------------
+// DisplayList
+//------------------------------------------------------------------------
+
+// The drawing calls made by Gfx for one page, as recorded by
+// DisplayListOutputDev.  Replaying them drives another OutputDev without
+// going through the content stream lexer, parser and resource lookups
+// again.
+//
+// Fonts, colour spaces and functions are shared with the PDFDoc the list
+// was recorded from, so that document must outlive the list.  Image data
+// is stored decoded.  A list must not be replayed by several threads at
+// the same time.
+//
+// The marked content operators are recorded, but content that optional
+// content hid while recording isn't, so a list has to be recorded again
+// after the optional content configuration changed.
+class POPPLER_PRIVATE_EXPORT DisplayList
+{
+public:
+    ~DisplayList();
+
+    DisplayList(const DisplayList &) = delete;
+    DisplayList &operator=(const DisplayList &) = delete;
+
+    // Replay the page on <out> at a resolution of <hDPI> x <vDPI>.
+    // Returns false if <out> uses a different coordinate orientation
+    // than the list was recorded with.
+    bool replay(OutputDev *out, double hDPI, double vDPI) const;
+
+    int getPageNum() const { return pageNum; }
+    double getHDPI() const;
+    double getVDPI() const;
+    size_t getOpCount() const { return ops.size(); }
+
+    // Approximate number of bytes used by the recorded image data.
+    size_t getImageDataSize() const { return imageDataSize; }
+
+private:
+    DisplayList(int pageNumA, GfxState *state, XRef *xrefA, bool upsideDownA);
+
+    int pageNum;
+    std::unique_ptr<GfxState> pageState;
+    XRef *xref;
+    bool upsideDown;
+    std::vector<std::unique_ptr<DisplayListOp>> ops;
+    size_t imageDataSize;
+
+    friend class DisplayListOutputDev;
+};
+
+//------------------------------------------------------------------------
+// DisplayListOutputDev
+//------------------------------------------------------------------------
+
+// Records the drawing calls of a page into a DisplayList.
+//
+// Type 3 glyphs are recorded both as characters and as their glyph
+// procedures, tiling patterns are unrolled and only axial and radial
+// shadings are kept as shaded fills, together with the fills Gfx reduces
+// them to for devices that can't draw them.  Other shading types are
+// only recorded as fills.
+class POPPLER_PRIVATE_EXPORT DisplayListOutputDev : public OutputDev
+{
+public:
+    // <upsideDownA> has to match upsideDown() of the devices the list
+    // is going to be replayed on.
+    explicit DisplayListOutputDev(bool upsideDownA = true);
+    ~DisplayListOutputDev() override;
+
+    // Returns the list recorded for the last page, transferring
+    // ownership to the caller.
+    std::unique_ptr<DisplayList> takeDisplayList();
+
+    //----- get info about output device
+    bool upsideDown() override { return upsideDownFlag; }
+    bool useDrawChar() override { return true; }
+    bool useShadedFills(int type) override { return type == 2 || type == 3; }
+    bool interpretType3Chars() override { return true; }
+    bool needCharCount() override { return true; }
+
+    //----- vector antialias, which Gfx turns off around shadings
+    bool getVectorAntialias() override { return vectorAntialias; }
+    void setVectorAntialias(bool vaa) override;
+
+    //----- initialization and control
+    void startPage(int pageNum, GfxState *state, XRef *xref) override;
+    void endPage() override;
+
+    //----- save/restore graphics state
+    void saveState(GfxState *state) override;
+    void restoreState(GfxState *state) override;
+
+    //----- update graphics state
+    void updateAll(GfxState *state) override;
+    void updateCTM(GfxState *state, double m11, double m12, double m21, double m22, double m31, double m32) override;
+    void updateLineDash(GfxState *state) override;
+    void updateFlatness(GfxState *state) override;
+    void updateLineJoin(GfxState *state) override;
+    void updateLineCap(GfxState *state) override;
+    void updateMiterLimit(GfxState *state) override;
+    void updateLineWidth(GfxState *state) override;
+    void updateStrokeAdjust(GfxState *state) override;
+    void updateAlphaIsShape(GfxState *state) override;
+    void updateTextKnockout(GfxState *state) override;
+    void updateFillColorSpace(GfxState *state) override;
+    void updateStrokeColorSpace(GfxState *state) override;
+    void updateFillColor(GfxState *state) override;
+    void updateStrokeColor(GfxState *state) override;
+    void updateBlendMode(GfxState *state) override;
+    void updateFillOpacity(GfxState *state) override;
+    void updateStrokeOpacity(GfxState *state) override;
+    void updatePatternOpacity(GfxState *state) override;
+    void clearPatternOpacity(GfxState *state) override;
+    void updateFillOverprint(GfxState *state) override;
+    void updateStrokeOverprint(GfxState *state) override;
+    void updateOverprintMode(GfxState *state) override;
+    void updateTransfer(GfxState *state) override;
+
+    //----- update text state
+    void updateFont(GfxState *state) override;
+    void updateTextMat(GfxState *state) override;
+    void updateCharSpace(GfxState *state) override;
+    void updateRender(GfxState *state) override;
+    void updateRise(GfxState *state) override;
+    void updateWordSpace(GfxState *state) override;
+    void updateHorizScaling(GfxState *state) override;
+    void updateTextPos(GfxState *state) override;
+    void updateTextShift(GfxState *state, double shift) override;
+
+    //----- path painting
+    void stroke(GfxState *state) override;
+    void fill(GfxState *state) override;
+    void eoFill(GfxState *state) override;
+    bool axialShadedFill(GfxState *state, GfxAxialShading *shading, double tMin, double tMax) override;
+    bool radialShadedFill(GfxState *state, GfxRadialShading *shading, double sMin, double sMax) override;
+
+    //----- path clipping
+    void clip(GfxState *state) override;
+    void eoClip(GfxState *state) override;
+    void clipToStrokePath(GfxState *state) override;
+
+    //----- text drawing
+    void beginStringOp(GfxState *state) override;
+    void endStringOp(GfxState *state) override;
+    void beginString(GfxState *state, const GooString *s) override;
+    void endString(GfxState *state) override;
+    void drawChar(GfxState *state, double x, double y, double dx, double dy, double originX, double originY, CharCode code, int nBytes, const Unicode *u, int uLen) override;
+    bool beginType3Char(GfxState *state, double x, double y, double dx, double dy, CharCode code, const Unicode *u, int uLen) override;
+    void endType3Char(GfxState *state) override;
+    void type3D0(GfxState *state, double wx, double wy) override;
+    void type3D1(GfxState *state, double wx, double wy, double llx, double lly, double urx, double ury) override;
+    void beginTextObject(GfxState *state) override;
+    void endTextObject(GfxState *state) override;
+    void incCharCount(int nChars) override;
+    void beginActualText(GfxState *state, const GooString *text) override;
+    void endActualText(GfxState *state) override;
+
+    //----- image drawing
+    void drawImageMask(GfxState *state, Object *ref, Stream *str, int width, int height, bool invert, bool interpolate, bool inlineImg) override;
+    void drawImage(GfxState *state, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool interpolate, const int *maskColors, bool inlineImg) override;
+    void drawMaskedImage(GfxState *state, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool interpolate, Stream *maskStr, int maskWidth, int maskHeight, bool maskInvert, bool maskInterpolate) override;
+    void drawSoftMaskedImage(GfxState *state, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool interpolate, Stream *maskStr, int maskWidth, int maskHeight, GfxImageColorMap *maskColorMap,
+                             bool maskInterpolate) override;
+
+    //----- grouping operators
+    void beginMarkedContent(const char *name, Dict *properties) override;
+    void endMarkedContent(GfxState *state) override;
+    void markPoint(const char *name) override;
+    void markPoint(const char *name, Dict *properties) override;
+
+    //----- transparency groups and soft masks
+    void beginTransparencyGroup(GfxState *state, const double *bbox, GfxColorSpace *blendingColorSpace, bool isolated, bool knockout, bool forSoftMask) override;
+    void endTransparencyGroup(GfxState *state) override;
+    void paintTransparencyGroup(GfxState *state, const double *bbox) override;
+    void setSoftMask(GfxState *state, const double *bbox, bool alpha, Function *transferFunc, GfxColor *backdropColor) override;
+    void clearSoftMask(GfxState *state) override;
+
+private:
+    void addOp(std::unique_ptr<DisplayListOp> op);
+    std::shared_ptr<GfxState> snapshot(GfxState *state, bool withPath = false);
+    void recordStateOp(GfxState *state, void (OutputDev::*func)(GfxState *), bool withPath = false, bool nonText = false);
+
+    bool upsideDownFlag;
+    std::unique_ptr<DisplayList> list;
+    std::shared_ptr<GfxState> lastSnapshot;
+    std::shared_ptr<GfxState> stringSnapshot; // text state of the string being shown
+    bool stateChanged;
+    bool shadingFallback; // the fills of a shading the device may not need
+    bool vectorAntialias;
+};
+
+#endif
@@ -29,6 +29,8 @@
 
 #include <config.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <cctype>
@@ -173,6 +175,15 @@ bool Function::init(Dict *dict)
     return true;
 }
 
+void Function::transformBatch(const double *in, double *out, int count) const
+{
+    for (int t = 0; t < count; ++t) {
+        transform(in, out);
+        in += m;
+        out += n;
+    }
+}
+
 //------------------------------------------------------------------------
 // IdentityFunction
 //------------------------------------------------------------------------
@@ -524,6 +535,56 @@ void SampledFunction::transform(const double *in, double *out) const
     }
 }
 
+void SampledFunction::transformBatch(const double *in, double *out, int count) const
+{
+    if (m != 1) {
+        for (int t = 0; t < count; ++t) {
+            SampledFunction::transform(in, out);
+            in += m;
+            out += n;
+        }
+        return;
+    }
+
+    // the one-input case of transform(), which is what Separation color
+    // spaces and axial/radial shadings use; a run of equal inputs (a flat
+    // area in an image) reuses the first result instead of the cache
+    const int idx1 = idxOffset[1];
+    for (int t = 0; t < count; ++t, out += n) {
+        if (t > 0 && in[t] == in[t - 1]) {
+            for (int i = 0; i < n; ++i) {
+                out[i] = out[i - n];
+            }
+            continue;
+        }
+        double x = (in[t] - domain[0][0]) * inputMul[0] + encode[0][0];
+        if (x < 0 || std::isnan(x)) {
+            x = 0;
+        } else if (x > sampleSize[0] - 1) {
+            x = sampleSize[0] - 1;
+        }
+        int e = (int)x;
+        if (e == sampleSize[0] - 1 && sampleSize[0] > 1) {
+            e = sampleSize[0] - 2;
+        }
+        const double efrac1 = x - e;
+        const double efrac0 = 1 - efrac1;
+        const int idx0 = e * n;
+        for (int i = 0; i < n; ++i) {
+            const int idxA = idx0 + i;
+            const int idxB = idx0 + idx1 + i;
+            const double s0 = likely(idxA >= 0 && idxA < nSamples) ? samples[idxA] : 0;
+            const double s1 = likely(idxB >= 0 && idxB < nSamples) ? samples[idxB] : 0;
+            out[i] = (efrac0 * s0 + efrac1 * s1) * (decode[i][1] - decode[i][0]) + decode[i][0];
+            if (out[i] < range[i][0]) {
+                out[i] = range[i][0];
+            } else if (out[i] > range[i][1]) {
+                out[i] = range[i][1];
+            }
+        }
+    }
+}
+
 bool SampledFunction::hasDifferentResultSet(const Function *func) const
 {
     if (func->getType() == Type::Sampled) {
@@ -660,6 +721,14 @@ void ExponentialFunction::transform(const double *in, double *out) const
     }
 }
 
+void ExponentialFunction::transformBatch(const double *in, double *out, int count) const
+{
+    for (int t = 0; t < count; ++t) {
+        ExponentialFunction::transform(in + t, out);
+        out += n;
+    }
+}
+
 //------------------------------------------------------------------------
 // StitchingFunction
 //------------------------------------------------------------------------
@@ -810,6 +879,42 @@ void StitchingFunction::transform(const double *in, double *out) const
     funcs[i]->transform(&x, out);
 }
 
+void StitchingFunction::transformBatch(const double *in, double *out, int count) const
+{
+    std::vector<double> x(count);
+    int t, t0, i, i0;
+
+    // map the inputs to the subfunctions, and hand each run of inputs
+    // that falls to the same subfunction to it in one go
+    t0 = 0;
+    i0 = -1;
+    for (t = 0; t <= count; ++t) {
+        i = -1;
+        if (t < count) {
+            if (in[t] < domain[0][0]) {
+                x[t] = domain[0][0];
+            } else if (in[t] > domain[0][1]) {
+                x[t] = domain[0][1];
+            } else {
+                x[t] = in[t];
+            }
+            for (i = 0; i < k - 1; ++i) {
+                if (x[t] < bounds[i + 1]) {
+                    break;
+                }
+            }
+            x[t] = encode[2 * i] + (x[t] - bounds[i]) * scale[i];
+        }
+        if (i != i0) {
+            if (i0 >= 0) {
+                funcs[i0]->transformBatch(x.data() + t0, out + (size_t)t0 * n, t - t0);
+            }
+            t0 = t;
+            i0 = i;
+        }
+    }
+}
+
 //------------------------------------------------------------------------
 // PostScriptFunction
 //------------------------------------------------------------------------
@@ -914,6 +1019,26 @@ struct PSObject
 
 #define psStackSize 100
 
+// Functions with up to this many inputs and outputs are sampled on a grid
+// with this many intervals per input (for one and two inputs), if their
+// code is continuous and interpolating the samples is accurate to
+// psSampledTolerance times the output range.
+#define psSampledMaxInputs 2
+#define psSampledMaxOutputs 8
+#define psSampledIntervals1 256
+#define psSampledIntervals2 64
+#define psSampledTolerance (1.0 / 2048)
+
+static std::atomic<PSFunctionImpl> maxPSFunctionImpl(psFunctionImplSampled);
+
+void setPSFunctionImpl(PSFunctionImpl impl)
+{
+    maxPSFunctionImpl = impl;
+}
+
+// Straight-line compiled code is run on blocks of this many inputs.
+#define psBatchSize 64
+
 class PSStack
 {
 public:
@@ -1086,15 +1211,771 @@ void PSStack::roll(int n, int j)
     }
 }
 
+//------------------------------------------------------------------------
+// compiled PostScript function code
+//------------------------------------------------------------------------
+
+// The code of a PostScript function is compiled to operations on a flat
+// register file.  These functions have no loops, so the depth of the
+// stack and the type of every entry are known at each point of the code,
+// which makes the operations typed.  The compiler tracks which register
+// holds each stack entry, so stack manipulation with constant arguments
+// doesn't generate any code, and literals are kept as constants, which
+// the real arithmetic operators take as immediate operands.  At the end
+// of an if/ifelse clause, the stack entries are moved to registers 0, 1,
+// ... so that both ways through the code leave them in the same place.
+//
+// Code whose stack depth or types depend on the inputs, or that would
+// fail with a type error or a stack over/underflow, isn't compiled.
+
+enum PSCodeOp
+{
+    psCodeLoadInt,
+    psCodeLoadReal,
+    psCodeLoadBool,
+    psCodeMove,
+    psCodeIntToReal,
+    psCodeAbsInt,
+    psCodeAbsReal,
+    psCodeAddInt,
+    psCodeAddReal,
+    psCodeAddRealImm,
+    psCodeAndInt,
+    psCodeAndBool,
+    psCodeAtan,
+    psCodeBitshift,
+    psCodeCeiling,
+    psCodeCos,
+    psCodeCvi,
+    psCodeDiv,
+    psCodeDivImm,
+    psCodeEqInt,
+    psCodeEqReal,
+    psCodeEqRealImm,
+    psCodeEqBool,
+    psCodeExp,
+    psCodeExpImm,
+    psCodeFloor,
+    psCodeGeInt,
+    psCodeGeReal,
+    psCodeGeRealImm,
+    psCodeGtInt,
+    psCodeGtReal,
+    psCodeGtRealImm,
+    psCodeIdiv,
+    psCodeLeInt,
+    psCodeLeReal,
+    psCodeLeRealImm,
+    psCodeLn,
+    psCodeLog,
+    psCodeLtInt,
+    psCodeLtReal,
+    psCodeLtRealImm,
+    psCodeMod,
+    psCodeMulInt,
+    psCodeMulReal,
+    psCodeMulRealImm,
+    psCodeNeInt,
+    psCodeNeReal,
+    psCodeNeRealImm,
+    psCodeNeBool,
+    psCodeNegInt,
+    psCodeNegReal,
+    psCodeNotInt,
+    psCodeNotBool,
+    psCodeOrInt,
+    psCodeOrBool,
+    psCodeRound,
+    psCodeSin,
+    psCodeSqrt,
+    psCodeSubInt,
+    psCodeSubReal,
+    psCodeSubRealImm,
+    psCodeTruncate,
+    psCodeXorInt,
+    psCodeXorBool,
+    psCodeJumpIfFalse, // jump to <target> if <src1> is false
+    psCodeJump, // jump to <target>
+    psCodeOutput, // clip <src1> to the range of output <dst> and store it
+    psCodeEnd,
+    psCodeNone // not an instruction
+};
+
+union PSValue {
+    int intg;
+    double real;
+    bool booln;
+};
+
+struct PSInstr
+{
+    PSCodeOp op;
+    int dst, src1, src2;
+    union {
+        int intg; // psCodeLoadInt
+        double real; // psCodeLoadReal, psCode*Imm
+        bool booln; // psCodeLoadBool
+        int target; // psCodeJumpIfFalse, psCodeJump
+    };
+};
+
+#define psNumRegisters (3 * psStackSize)
+
+namespace {
+
+// What the compiler knows about a stack entry.
+struct PSSlot
+{
+    PSObjectType type;
+    int reg; // register holding the value, or -1 for a constant
+    PSValue val; // the constant
+
+    bool isConstInt() const { return reg < 0 && type == psInt; }
+    double getConstReal() const { return type == psInt ? (double)val.intg : val.real; }
+};
+
+class PSCompiler
+{
+public:
+    PSCompiler(const PSObject *codeA, std::vector<PSInstr> *outA) : code(codeA), out(outA) { }
+
+    bool compile(int nInputs, int nOutputs);
+
+private:
+    bool compileBlock(int codePtr, std::vector<PSSlot> *stack);
+    bool compileOp(PSOp op, std::vector<PSSlot> *stack);
+    bool unary(std::vector<PSSlot> *stack, PSCodeOp intOp, PSCodeOp realOp, PSObjectType realResult);
+    bool binary(std::vector<PSSlot> *stack, PSCodeOp intOp, PSCodeOp realOp, PSCodeOp boolOp, PSObjectType intResult, PSObjectType realResult);
+    bool pushConst(std::vector<PSSlot> *stack, PSObjectType type, PSValue val);
+    bool popConstInt(std::vector<PSSlot> *stack, int *val);
+    bool materialize(std::vector<PSSlot> *stack, int i);
+    bool toReal(std::vector<PSSlot> *stack, int i);
+    bool normalize(std::vector<PSSlot> *stack);
+    int newReg(const std::vector<PSSlot> &stack, int minReg = 0) const;
+    PSInstr &emit(PSCodeOp op, int dst, int src1 = 0, int src2 = 0);
+
+    const PSObject *code;
+    std::vector<PSInstr> *out;
+};
+
+}
+
+PSInstr &PSCompiler::emit(PSCodeOp op, int dst, int src1, int src2)
+{
+    PSInstr instr;
+
+    instr.op = op;
+    instr.dst = dst;
+    instr.src1 = src1;
+    instr.src2 = src2;
+    instr.real = 0;
+    out->push_back(instr);
+    return out->back();
+}
+
+// Returns the lowest register, from <minReg> up, that doesn't hold a stack
+// entry, or -1 if there is none.
+int PSCompiler::newReg(const std::vector<PSSlot> &stack, int minReg) const
+{
+    bool used[psNumRegisters] = {};
+
+    for (const PSSlot &slot : stack) {
+        if (slot.reg >= 0) {
+            used[slot.reg] = true;
+        }
+    }
+    for (int reg = minReg; reg < psNumRegisters; ++reg) {
+        if (!used[reg]) {
+            return reg;
+        }
+    }
+    return -1;
+}
+
+// Load stack entry <i> into a register if it is a constant.
+bool PSCompiler::materialize(std::vector<PSSlot> *stack, int i)
+{
+    PSSlot &slot = (*stack)[i];
+
+    if (slot.reg >= 0) {
+        return true;
+    }
+    const int reg = newReg(*stack);
+    if (reg < 0) {
+        return false;
+    }
+    switch (slot.type) {
+    case psInt:
+        emit(psCodeLoadInt, reg).intg = slot.val.intg;
+        break;
+    case psReal:
+        emit(psCodeLoadReal, reg).real = slot.val.real;
+        break;
+    default:
+        emit(psCodeLoadBool, reg).booln = slot.val.booln;
+        break;
+    }
+    slot.reg = reg;
+    return true;
+}
+
+// Convert stack entry <i> to a real.
+bool PSCompiler::toReal(std::vector<PSSlot> *stack, int i)
+{
+    PSSlot &slot = (*stack)[i];
+
+    if (slot.type != psInt) {
+        return true;
+    }
+    if (slot.reg < 0) {
+        slot.val.real = (double)slot.val.intg;
+    } else {
+        const int reg = newReg(*stack);
+        if (reg < 0) {
+            return false;
+        }
+        emit(psCodeIntToReal, reg, slot.reg);
+        slot.reg = reg;
+    }
+    slot.type = psReal;
+    return true;
+}
+
+// Move stack entry i to register i, for all i.
+bool PSCompiler::normalize(std::vector<PSSlot> *stack)
+{
+    const int depth = (int)stack->size();
+    int i;
+
+    // first copy the entries that aren't in place out of the way if
+    // their registers are needed for other entries
+    std::vector<PSSlot> tmp = *stack;
+    for (i = 0; i < depth; ++i) {
+        PSSlot &slot = tmp[i];
+        if (slot.reg >= 0 && slot.reg < depth && slot.reg != i) {
+            const int reg = newReg(tmp, depth);
+            if (reg < 0) {
+                return false;
+            }
+            emit(psCodeMove, reg, slot.reg);
+            slot.reg = reg;
+        }
+    }
+    for (i = 0; i < depth; ++i) {
+        PSSlot &slot = tmp[i];
+        if (slot.reg < 0) {
+            slot.reg = i;
+            switch (slot.type) {
+            case psInt:
+                emit(psCodeLoadInt, i).intg = slot.val.intg;
+                break;
+            case psReal:
+                emit(psCodeLoadReal, i).real = slot.val.real;
+                break;
+            default:
+                emit(psCodeLoadBool, i).booln = slot.val.booln;
+                break;
+            }
+        } else if (slot.reg != i) {
+            emit(psCodeMove, i, slot.reg);
+        }
+        (*stack)[i].reg = i;
+    }
+    return true;
+}
+
+bool PSCompiler::pushConst(std::vector<PSSlot> *stack, PSObjectType type, PSValue val)
+{
+    if (stack->size() >= psStackSize) {
+        return false;
+    }
+    PSSlot slot;
+    slot.type = type;
+    slot.reg = -1;
+    slot.val = val;
+    stack->push_back(slot);
+    return true;
+}
+
+// Pop an integer constant.
+bool PSCompiler::popConstInt(std::vector<PSSlot> *stack, int *val)
+{
+    if (stack->empty() || !stack->back().isConstInt()) {
+        return false;
+    }
+    *val = stack->back().val.intg;
+    stack->pop_back();
+    return true;
+}
+
+// An operator on one number: <intOp> on an int, <realOp> on a real.  If
+// <intOp> is psCodeNone, an int is left alone if <realResult> is an int
+// or the op rounds, and converted to a real otherwise.  'not' passes its
+// boolean op as <intOp>.
+bool PSCompiler::unary(std::vector<PSSlot> *stack, PSCodeOp intOp, PSCodeOp realOp, PSObjectType realResult)
+{
+    if (stack->empty() || (stack->back().type == psBool && intOp != psCodeNotBool)) {
+        return false;
+    }
+    const int top = (int)stack->size() - 1;
+    PSCodeOp op = realOp;
+    if (stack->back().type != psReal) {
+        if (intOp != psCodeNone) {
+            op = intOp;
+        } else if (realResult == psInt || realOp == psCodeCeiling || realOp == psCodeFloor || realOp == psCodeRound || realOp == psCodeTruncate) {
+            return true;
+        } else if (!toReal(stack, top)) {
+            return false;
+        }
+    }
+    if (!materialize(stack, top)) {
+        return false;
+    }
+    const int reg = newReg(*stack);
+    if (reg < 0) {
+        return false;
+    }
+    emit(op, reg, stack->back().reg);
+    stack->back().reg = reg;
+    if (op != intOp) {
+        stack->back().type = realResult;
+    }
+    return true;
+}
+
+// An operator on two operands: <intOp> if both are ints, else <realOp> if
+// both are numbers, else <boolOp> if both are booleans.  Any of the ops
+// may be psCodeNone if the operator doesn't accept those types.  Real ops
+// that have an immediate form (the next op code) take a constant second
+// operand as an immediate.
+bool PSCompiler::binary(std::vector<PSSlot> *stack, PSCodeOp intOp, PSCodeOp realOp, PSCodeOp boolOp, PSObjectType intResult, PSObjectType realResult)
+{
+    if (stack->size() < 2) {
+        return false;
+    }
+    const int b = (int)stack->size() - 1;
+    const int a = b - 1;
+    const PSObjectType ta = (*stack)[a].type;
+    const PSObjectType tb = (*stack)[b].type;
+    const bool hasImm = realOp == psCodeAddReal || realOp == psCodeDiv || realOp == psCodeEqReal || realOp == psCodeExp || realOp == psCodeGeReal || realOp == psCodeGtReal || realOp == psCodeLeReal || realOp == psCodeLtReal
+            || realOp == psCodeMulReal || realOp == psCodeNeReal || realOp == psCodeSubReal;
+    PSCodeOp op;
+    PSObjectType result;
+
+    if (ta == psInt && tb == psInt && intOp != psCodeNone) {
+        op = intOp;
+        result = intResult;
+    } else if ((ta == psInt || ta == psReal) && (tb == psInt || tb == psReal) && realOp != psCodeNone) {
+        op = realOp;
+        result = realResult;
+        if (!toReal(stack, a) || !toReal(stack, b)) {
+            return false;
+        }
+        // a constant first operand can be swapped into the second place
+        if ((realOp == psCodeAddReal || realOp == psCodeMulReal || realOp == psCodeEqReal || realOp == psCodeNeReal) && (*stack)[a].reg < 0 && (*stack)[b].reg >= 0) {
+            std::swap((*stack)[a], (*stack)[b]);
+        }
+        if (hasImm && (*stack)[b].reg < 0) {
+            if (!materialize(stack, a)) {
+                return false;
+            }
+            const int reg = newReg(*stack);
+            if (reg < 0) {
+                return false;
+            }
+            emit((PSCodeOp)(realOp + 1), reg, (*stack)[a].reg).real = (*stack)[b].val.real;
+            stack->pop_back();
+            (*stack)[a].type = result;
+            (*stack)[a].reg = reg;
+            return true;
+        }
+    } else if (ta == psBool && tb == psBool && boolOp != psCodeNone) {
+        op = boolOp;
+        result = psBool;
+    } else {
+        return false;
+    }
+    if (!materialize(stack, a) || !materialize(stack, b)) {
+        return false;
+    }
+    const int reg = newReg(*stack);
+    if (reg < 0) {
+        return false;
+    }
+    emit(op, reg, (*stack)[a].reg, (*stack)[b].reg);
+    stack->pop_back();
+    (*stack)[a].type = result;
+    (*stack)[a].reg = reg;
+    return true;
+}
+
+bool PSCompiler::compile(int nInputs, int nOutputs)
+{
+    std::vector<PSSlot> stack;
+    int i;
+
+    for (i = 0; i < nInputs; ++i) {
+        PSSlot slot;
+        slot.type = psReal;
+        slot.reg = i;
+        slot.val.real = 0;
+        stack.push_back(slot);
+    }
+    if (!compileBlock(0, &stack)) {
+        return false;
+    }
+    // the outputs are taken off the top of the stack
+    if ((int)stack.size() < nOutputs) {
+        return false;
+    }
+    const int first = (int)stack.size() - nOutputs;
+    for (i = first; i < (int)stack.size(); ++i) {
+        if (stack[i].type == psBool || !toReal(&stack, i) || !materialize(&stack, i)) {
+            return false;
+        }
+    }
+    for (i = first; i < (int)stack.size(); ++i) {
+        emit(psCodeOutput, i - first, stack[i].reg);
+    }
+    emit(psCodeEnd, 0);
+    return true;
+}
+
+bool PSCompiler::compileBlock(int codePtr, std::vector<PSSlot> *stack)
+{
+    PSValue val;
+
+    while (true) {
+        const PSObject &obj = code[codePtr++];
+        switch (obj.type) {
+        case psInt:
+            val.intg = obj.intg;
+            if (!pushConst(stack, psInt, val)) {
+                return false;
+            }
+            break;
+        case psReal:
+            val.real = obj.real;
+            if (!pushConst(stack, psReal, val)) {
+                return false;
+            }
+            break;
+        case psOperator:
+            if (obj.op == psOpReturn) {
+                return true;
+            } else if (obj.op == psOpIf || obj.op == psOpIfelse) {
+                if (stack->empty() || stack->back().type != psBool) {
+                    return false;
+                }
+                const int thenPtr = codePtr + 2;
+                const int elsePtr = obj.op == psOpIfelse ? code[codePtr].blk : -1;
+                codePtr = code[codePtr + 1].blk;
+
+                // a constant condition picks one of the clauses
+                if (stack->back().reg < 0) {
+                    const bool cond = stack->back().val.booln;
+                    stack->pop_back();
+                    if (cond) {
+                        if (!compileBlock(thenPtr, stack)) {
+                            return false;
+                        }
+                    } else if (elsePtr >= 0) {
+                        if (!compileBlock(elsePtr, stack)) {
+                            return false;
+                        }
+                    }
+                    break;
+                }
+
+                // skipping an 'if' clause leaves the stack as it is, so it
+                // has to be in place before the jump
+                if (elsePtr < 0 && !normalize(stack)) {
+                    return false;
+                }
+                const size_t jumpToElse = out->size();
+                emit(psCodeJumpIfFalse, 0, stack->back().reg);
+                stack->pop_back();
+                std::vector<PSSlot> elseStack = *stack;
+                if (!compileBlock(thenPtr, stack) || !normalize(stack)) {
+                    return false;
+                }
+                if (elsePtr < 0) {
+                    (*out)[jumpToElse].target = (int)out->size();
+                } else {
+                    const size_t jumpToEnd = out->size();
+                    emit(psCodeJump, 0);
+                    (*out)[jumpToElse].target = (int)out->size();
+                    if (!compileBlock(elsePtr, &elseStack) || !normalize(&elseStack)) {
+                        return false;
+                    }
+                    (*out)[jumpToEnd].target = (int)out->size();
+                }
+                // both ways must leave the same stack
+                if (stack->size() != elseStack.size()) {
+                    return false;
+                }
+                for (size_t i = 0; i < stack->size(); ++i) {
+                    if ((*stack)[i].type != elseStack[i].type) {
+                        return false;
+                    }
+                }
+            } else if (!compileOp(obj.op, stack)) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+}
+
+bool PSCompiler::compileOp(PSOp op, std::vector<PSSlot> *stack)
+{
+    const PSCodeOp none = psCodeNone;
+    PSValue val;
+    int n, j, depth;
+
+    switch (op) {
+    case psOpAbs:
+        return unary(stack, psCodeAbsInt, psCodeAbsReal, psReal);
+    case psOpAdd:
+        return binary(stack, psCodeAddInt, psCodeAddReal, none, psInt, psReal);
+    case psOpAnd:
+        return binary(stack, psCodeAndInt, none, psCodeAndBool, psInt, psBool);
+    case psOpAtan:
+        return binary(stack, none, psCodeAtan, none, psInt, psReal);
+    case psOpBitshift:
+        return binary(stack, psCodeBitshift, none, none, psInt, psReal);
+    case psOpCeiling:
+        return unary(stack, none, psCodeCeiling, psReal);
+    case psOpCos:
+        return unary(stack, none, psCodeCos, psReal);
+    case psOpCvi:
+        return unary(stack, none, psCodeCvi, psInt);
+    case psOpCvr:
+        if (stack->empty() || stack->back().type == psBool) {
+            return false;
+        }
+        return toReal(stack, (int)stack->size() - 1);
+    case psOpDiv:
+        return binary(stack, none, psCodeDiv, none, psInt, psReal);
+    case psOpEq:
+        return binary(stack, psCodeEqInt, psCodeEqReal, psCodeEqBool, psBool, psBool);
+    case psOpExp:
+        return binary(stack, none, psCodeExp, none, psInt, psReal);
+    case psOpFalse:
+    case psOpTrue:
+        val.booln = op == psOpTrue;
+        return pushConst(stack, psBool, val);
+    case psOpFloor:
+        return unary(stack, none, psCodeFloor, psReal);
+    case psOpGe:
+        return binary(stack, psCodeGeInt, psCodeGeReal, none, psBool, psBool);
+    case psOpGt:
+        return binary(stack, psCodeGtInt, psCodeGtReal, none, psBool, psBool);
+    case psOpIdiv:
+        return binary(stack, psCodeIdiv, none, none, psInt, psReal);
+    case psOpLe:
+        return binary(stack, psCodeLeInt, psCodeLeReal, none, psBool, psBool);
+    case psOpLn:
+        return unary(stack, none, psCodeLn, psReal);
+    case psOpLog:
+        return unary(stack, none, psCodeLog, psReal);
+    case psOpLt:
+        return binary(stack, psCodeLtInt, psCodeLtReal, none, psBool, psBool);
+    case psOpMod:
+        return binary(stack, psCodeMod, none, none, psInt, psReal);
+    case psOpMul:
+        return binary(stack, psCodeMulInt, psCodeMulReal, none, psInt, psReal);
+    case psOpNe:
+        return binary(stack, psCodeNeInt, psCodeNeReal, psCodeNeBool, psBool, psBool);
+    case psOpNeg:
+        return unary(stack, psCodeNegInt, psCodeNegReal, psReal);
+    case psOpNot:
+        if (stack->empty() || stack->back().type == psReal) {
+            return false;
+        }
+        return unary(stack, stack->back().type == psInt ? psCodeNotInt : psCodeNotBool, psCodeNone, psReal);
+    case psOpOr:
+        return binary(stack, psCodeOrInt, none, psCodeOrBool, psInt, psBool);
+    case psOpRound:
+        return unary(stack, none, psCodeRound, psReal);
+    case psOpSin:
+        return unary(stack, none, psCodeSin, psReal);
+    case psOpSqrt:
+        return unary(stack, none, psCodeSqrt, psReal);
+    case psOpSub:
+        return binary(stack, psCodeSubInt, psCodeSubReal, none, psInt, psReal);
+    case psOpTruncate:
+        return unary(stack, none, psCodeTruncate, psReal);
+    case psOpXor:
+        return binary(stack, psCodeXorInt, none, psCodeXorBool, psInt, psBool);
+
+    // stack manipulation: this needs constant arguments, and then only
+    // moves entries around in the compiler
+    case psOpCopy:
+    case psOpDup:
+        if (op == psOpDup) {
+            n = 1;
+        } else if (!popConstInt(stack, &n)) {
+            return false;
+        }
+        depth = (int)stack->size();
+        if (n < 0 || n > depth || depth + n > psStackSize) {
+            return false;
+        }
+        for (int i = 0; i < n; ++i) {
+            stack->push_back((*stack)[depth - n + i]);
+        }
+        return true;
+    case psOpIndex:
+        if (!popConstInt(stack, &n)) {
+            return false;
+        }
+        depth = (int)stack->size();
+        if (n < 0 || n >= depth || depth >= psStackSize) {
+            return false;
+        }
+        stack->push_back((*stack)[depth - 1 - n]);
+        return true;
+    case psOpPop:
+        if (stack->empty()) {
+            return false;
+        }
+        stack->pop_back();
+        return true;
+    case psOpExch:
+    case psOpRoll:
+        if (op == psOpExch) {
+            n = 2;
+            j = 1;
+        } else if (!popConstInt(stack, &j) || !popConstInt(stack, &n)) {
+            return false;
+        }
+        depth = (int)stack->size();
+        // the same cases as PSStack::roll()
+        if (n == 0 || j == INT_MIN) {
+            return true;
+        }
+        if (j >= 0) {
+            j %= n;
+        } else {
+            j = -j % n;
+            if (j != 0) {
+                j = n - j;
+            }
+        }
+        if (n <= 0 || j == 0 || n > depth) {
+            return true;
+        }
+        std::rotate(stack->begin() + (depth - n), stack->begin() + (depth - j), stack->end());
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// Returns the number of registers used by <code> if it can be run on
+// blocks of inputs by PostScriptFunction::execCompiledBatch(), i.e. if it
+// has no jumps and only real operations, or 0 if it can't.  The output
+// numbers of psCodeOutput are counted as registers, so that they can be
+// treated like the other operands.
+static int getBatchRegisters(const std::vector<PSInstr> &code, int nInputs)
+{
+    int nRegs = nInputs;
+
+    if (code.empty()) {
+        return 0;
+    }
+    for (const PSInstr &instr : code) {
+        switch (instr.op) {
+        case psCodeLoadReal:
+        case psCodeMove:
+        case psCodeAbsReal:
+        case psCodeAddReal:
+        case psCodeAddRealImm:
+        case psCodeAtan:
+        case psCodeCeiling:
+        case psCodeCos:
+        case psCodeDiv:
+        case psCodeDivImm:
+        case psCodeExp:
+        case psCodeExpImm:
+        case psCodeFloor:
+        case psCodeLn:
+        case psCodeLog:
+        case psCodeMulReal:
+        case psCodeMulRealImm:
+        case psCodeNegReal:
+        case psCodeRound:
+        case psCodeSin:
+        case psCodeSqrt:
+        case psCodeSubReal:
+        case psCodeSubRealImm:
+        case psCodeTruncate:
+        case psCodeOutput:
+        case psCodeEnd:
+            break;
+        default:
+            return 0;
+        }
+        nRegs = std::max({ nRegs, instr.dst + 1, instr.src1 + 1, instr.src2 + 1 });
+    }
+    return nRegs;
+}
+
+// Returns true if <code> computes its outputs with continuous operations
+// only: no conditionals, no comparisons, no rounding, no integer
+// arithmetic, and no divisions or powers with a variable divisor or
+// exponent (those have poles), or atan (its result wraps around from 360
+// to 0).  Only such functions can be sampled: checking the interpolated
+// samples at a few points per grid cell can't find a step or a spike
+// between them.
+static bool isContinuousCode(const std::vector<PSInstr> &code)
+{
+    for (const PSInstr &instr : code) {
+        switch (instr.op) {
+        case psCodeLoadReal:
+        case psCodeMove:
+        case psCodeAbsReal:
+        case psCodeAddReal:
+        case psCodeAddRealImm:
+        case psCodeCos:
+        case psCodeDivImm:
+        case psCodeExpImm:
+        case psCodeLn:
+        case psCodeLog:
+        case psCodeMulReal:
+        case psCodeMulRealImm:
+        case psCodeNegReal:
+        case psCodeSin:
+        case psCodeSqrt:
+        case psCodeSubReal:
+        case psCodeSubRealImm:
+        case psCodeOutput:
+        case psCodeEnd:
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
 PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict)
 {
     Stream *str;
     int codePtr;
     double in[funcMaxInputs];
+    PSFunctionImpl maxImpl;
     int i;
 
     code = nullptr;
     codeSize = 0;
+    batchRegisters = 0;
+    impl = psFunctionImplInterpreter;
+    maxImpl = maxPSFunctionImpl;
     ok = false;
 
     //----- initialize the generic stuff
@@ -1129,6 +2010,27 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict)
     }
     str->close();
 
+    //----- compile the code
+    if (maxImpl == psFunctionImplInterpreter || !PSCompiler(code, &compiledCode).compile(m, n)) {
+        compiledCode.clear();
+    }
+    batchRegisters = getBatchRegisters(compiledCode, m);
+    if (!compiledCode.empty()) {
+        impl = psFunctionImplCompiled;
+    }
+
+    //----- sample functions of one or two inputs
+    if (impl == psFunctionImplCompiled && maxImpl == psFunctionImplSampled && m >= 1 && m <= psSampledMaxInputs && n <= psSampledMaxOutputs && isContinuousCode(compiledCode)) {
+        for (i = 0; i < m; ++i) {
+            if (!std::isfinite(domain[i][0]) || !std::isfinite(domain[i][1]) || !(domain[i][0] < domain[i][1])) {
+                break;
+            }
+        }
+        if (i == m && buildSamples()) {
+            impl = psFunctionImplSampled;
+        }
+    }
+
     //----- set up the cache
     for (i = 0; i < m; ++i) {
         in[i] = domain[i][0];
@@ -1153,6 +2055,11 @@ PostScriptFunction::PostScriptFunction(const PostScriptFunction *func, PrivateTa
 
     codeString = func->codeString->copy();
 
+    compiledCode = func->compiledCode;
+    batchRegisters = func->batchRegisters;
+    samples = func->samples;
+    impl = func->impl;
+
     memcpy(cacheIn, func->cacheIn, funcMaxInputs * sizeof(double));
     memcpy(cacheOut, func->cacheOut, funcMaxOutputs * sizeof(double));
 
@@ -1182,25 +2089,31 @@ void PostScriptFunction::transform(const double *in, double *out) const
         return;
     }
 
-    for (i = 0; i < m; ++i) {
-        //~ may need to check for integers here
-        stack.pushReal(in[i]);
-    }
-    exec(&stack, 0);
-    for (i = n - 1; i >= 0; --i) {
-        out[i] = stack.popNum();
-        if (out[i] < range[i][0]) {
-            out[i] = range[i][0];
-        } else if (out[i] > range[i][1]) {
-            out[i] = range[i][1];
+    if (samples && transformSampled(in, out)) {
+        // done
+    } else if (!compiledCode.empty() && execCompiled(in, out)) {
+        // done
+    } else {
+        for (i = 0; i < m; ++i) {
+            //~ may need to check for integers here
+            stack.pushReal(in[i]);
         }
-    }
-    stack.clear();
+        exec(&stack, 0);
+        for (i = n - 1; i >= 0; --i) {
+            out[i] = stack.popNum();
+            if (out[i] < range[i][0]) {
+                out[i] = range[i][0];
+            } else if (out[i] > range[i][1]) {
+                out[i] = range[i][1];
+            }
+        }
+        stack.clear();
 
-    // if (!stack->empty()) {
-    //   error(errSyntaxWarning, -1,
-    //         "Extra values on stack at end of PostScript function");
-    // }
+        // if (!stack->empty()) {
+        //   error(errSyntaxWarning, -1,
+        //         "Extra values on stack at end of PostScript function");
+        // }
+    }
 
     // save current result in the cache
     for (i = 0; i < m; ++i) {
@@ -1211,6 +2124,539 @@ void PostScriptFunction::transform(const double *in, double *out) const
     }
 }
 
+void PostScriptFunction::transformBatch(const double *in, double *out, int count) const
+{
+    while (count > 0) {
+        if (batchRegisters > 0 && !samples) {
+            const int blockSize = std::min(count, psBatchSize);
+            execCompiledBatch(in, out, blockSize);
+            in += blockSize * m;
+            out += blockSize * n;
+            count -= blockSize;
+        } else {
+            PostScriptFunction::transform(in, out);
+            in += m;
+            out += n;
+            --count;
+        }
+    }
+}
+
+// Run the compiled code.  Returns false if it hits an error (division by
+// zero, integer overflow), in which case the code must be interpreted to
+// get the same results and error messages.
+bool PostScriptFunction::execCompiled(const double *in, double *out) const
+{
+    PSValue regs[psNumRegisters];
+    const PSInstr *instrs = compiledCode.data();
+    int pc, i;
+
+    for (i = 0; i < m; ++i) {
+        regs[i].real = in[i];
+    }
+    pc = 0;
+    while (true) {
+        const PSInstr &instr = instrs[pc++];
+        PSValue &dst = regs[instr.dst];
+        const PSValue &a = regs[instr.src1];
+        const PSValue &b = regs[instr.src2];
+        switch (instr.op) {
+        case psCodeLoadInt:
+            dst.intg = instr.intg;
+            break;
+        case psCodeLoadReal:
+            dst.real = instr.real;
+            break;
+        case psCodeLoadBool:
+            dst.booln = instr.booln;
+            break;
+        case psCodeMove:
+            dst = a;
+            break;
+        case psCodeIntToReal:
+            dst.real = (double)a.intg;
+            break;
+        case psCodeAbsInt:
+            dst.intg = abs(a.intg);
+            break;
+        case psCodeAbsReal:
+            dst.real = fabs(a.real);
+            break;
+        case psCodeAddInt:
+            dst.intg = a.intg + b.intg;
+            break;
+        case psCodeAddReal:
+            dst.real = a.real + b.real;
+            break;
+        case psCodeAddRealImm:
+            dst.real = a.real + instr.real;
+            break;
+        case psCodeAndInt:
+            dst.intg = a.intg & b.intg;
+            break;
+        case psCodeAndBool:
+            dst.booln = a.booln && b.booln;
+            break;
+        case psCodeAtan: {
+            double result = atan2(a.real, b.real) * 180.0 / M_PI;
+            if (result < 0) {
+                result += 360.0;
+            }
+            dst.real = result;
+            break;
+        }
+        case psCodeBitshift:
+            if (b.intg > 0) {
+                dst.intg = a.intg << b.intg;
+            } else if (b.intg < 0) {
+                dst.intg = (int)((unsigned int)a.intg >> -b.intg);
+            } else {
+                dst.intg = a.intg;
+            }
+            break;
+        case psCodeCeiling:
+            dst.real = ceil(a.real);
+            break;
+        case psCodeCos:
+            dst.real = cos(a.real * M_PI / 180.0);
+            break;
+        case psCodeCvi:
+            dst.intg = (int)a.real;
+            break;
+        case psCodeDiv:
+            dst.real = a.real / b.real;
+            break;
+        case psCodeDivImm:
+            dst.real = a.real / instr.real;
+            break;
+        case psCodeEqInt:
+            dst.booln = a.intg == b.intg;
+            break;
+        case psCodeEqReal:
+            dst.booln = a.real == b.real;
+            break;
+        case psCodeEqRealImm:
+            dst.booln = a.real == instr.real;
+            break;
+        case psCodeEqBool:
+            dst.booln = a.booln == b.booln;
+            break;
+        case psCodeExp:
+            dst.real = pow(a.real, b.real);
+            break;
+        case psCodeExpImm:
+            dst.real = pow(a.real, instr.real);
+            break;
+        case psCodeFloor:
+            dst.real = floor(a.real);
+            break;
+        case psCodeGeInt:
+            dst.booln = a.intg >= b.intg;
+            break;
+        case psCodeGeReal:
+            dst.booln = a.real >= b.real;
+            break;
+        case psCodeGeRealImm:
+            dst.booln = a.real >= instr.real;
+            break;
+        case psCodeGtInt:
+            dst.booln = a.intg > b.intg;
+            break;
+        case psCodeGtReal:
+            dst.booln = a.real > b.real;
+            break;
+        case psCodeGtRealImm:
+            dst.booln = a.real > instr.real;
+            break;
+        case psCodeIdiv:
+            if (unlikely(b.intg == 0 || (b.intg == -1 && a.intg == INT_MIN))) {
+                return false;
+            }
+            dst.intg = a.intg / b.intg;
+            break;
+        case psCodeLeInt:
+            dst.booln = a.intg <= b.intg;
+            break;
+        case psCodeLeReal:
+            dst.booln = a.real <= b.real;
+            break;
+        case psCodeLeRealImm:
+            dst.booln = a.real <= instr.real;
+            break;
+        case psCodeLn:
+            dst.real = log(a.real);
+            break;
+        case psCodeLog:
+            dst.real = log10(a.real);
+            break;
+        case psCodeLtInt:
+            dst.booln = a.intg < b.intg;
+            break;
+        case psCodeLtReal:
+            dst.booln = a.real < b.real;
+            break;
+        case psCodeLtRealImm:
+            dst.booln = a.real < instr.real;
+            break;
+        case psCodeMod:
+            if (unlikely(b.intg == 0)) {
+                return false;
+            }
+            dst.intg = a.intg % b.intg;
+            break;
+        case psCodeMulInt: {
+            int result;
+            if (unlikely(checkedMultiply(a.intg, b.intg, &result))) {
+                return false;
+            }
+            dst.intg = result;
+            break;
+        }
+        case psCodeMulReal:
+            dst.real = a.real * b.real;
+            break;
+        case psCodeMulRealImm:
+            dst.real = a.real * instr.real;
+            break;
+        case psCodeNeInt:
+            dst.booln = a.intg != b.intg;
+            break;
+        case psCodeNeReal:
+            dst.booln = a.real != b.real;
+            break;
+        case psCodeNeRealImm:
+            dst.booln = a.real != instr.real;
+            break;
+        case psCodeNeBool:
+            dst.booln = a.booln != b.booln;
+            break;
+        case psCodeNegInt:
+            dst.intg = -a.intg;
+            break;
+        case psCodeNegReal:
+            dst.real = -a.real;
+            break;
+        case psCodeNotInt:
+            dst.intg = ~a.intg;
+            break;
+        case psCodeNotBool:
+            dst.booln = !a.booln;
+            break;
+        case psCodeOrInt:
+            dst.intg = a.intg | b.intg;
+            break;
+        case psCodeOrBool:
+            dst.booln = a.booln || b.booln;
+            break;
+        case psCodeRound:
+            dst.real = (a.real >= 0) ? floor(a.real + 0.5) : ceil(a.real - 0.5);
+            break;
+        case psCodeSin:
+            dst.real = sin(a.real * M_PI / 180.0);
+            break;
+        case psCodeSqrt:
+            dst.real = sqrt(a.real);
+            break;
+        case psCodeSubInt:
+            dst.intg = a.intg - b.intg;
+            break;
+        case psCodeSubReal:
+            dst.real = a.real - b.real;
+            break;
+        case psCodeSubRealImm:
+            dst.real = a.real - instr.real;
+            break;
+        case psCodeTruncate:
+            dst.real = (a.real >= 0) ? floor(a.real) : ceil(a.real);
+            break;
+        case psCodeXorInt:
+            dst.intg = a.intg ^ b.intg;
+            break;
+        case psCodeXorBool:
+            dst.booln = a.booln ^ b.booln;
+            break;
+        case psCodeJumpIfFalse:
+            if (!a.booln) {
+                pc = instr.target;
+            }
+            break;
+        case psCodeJump:
+            pc = instr.target;
+            break;
+        case psCodeOutput:
+            if (a.real < range[instr.dst][0]) {
+                out[instr.dst] = range[instr.dst][0];
+            } else if (a.real > range[instr.dst][1]) {
+                out[instr.dst] = range[instr.dst][1];
+            } else {
+                out[instr.dst] = a.real;
+            }
+            break;
+        case psCodeEnd:
+            return true;
+        case psCodeNone:
+            return false;
+        }
+    }
+}
+
+// Run straight-line compiled code (see getBatchRegisters()) on <count>
+// inputs, at most psBatchSize, one instruction at a time for all of them.
+// None of these instructions can fail.
+void PostScriptFunction::execCompiledBatch(const double *in, double *out, int count) const
+{
+    std::vector<double> regs((size_t)batchRegisters * psBatchSize);
+    int i, j;
+
+    for (i = 0; i < m; ++i) {
+        for (j = 0; j < count; ++j) {
+            regs[i * psBatchSize + j] = in[j * m + i];
+        }
+    }
+    for (const PSInstr &instr : compiledCode) {
+        double *dst = &regs[instr.dst * psBatchSize];
+        const double *a = &regs[instr.src1 * psBatchSize];
+        const double *b = &regs[instr.src2 * psBatchSize];
+        const double imm = instr.real;
+        switch (instr.op) {
+        case psCodeLoadReal:
+            for (j = 0; j < count; ++j) {
+                dst[j] = imm;
+            }
+            break;
+        case psCodeMove:
+            for (j = 0; j < count; ++j) {
+                dst[j] = a[j];
+            }
+            break;
+        case psCodeAbsReal:
+            for (j = 0; j < count; ++j) {
+                dst[j] = fabs(a[j]);
+            }
+            break;
+        case psCodeAddReal:
+            for (j = 0; j < count; ++j) {
+                dst[j] = a[j] + b[j];
+            }
+            break;
+        case psCodeAddRealImm:
+            for (j = 0; j < count; ++j) {
+                dst[j] = a[j] + imm;
+            }
+            break;
+        case psCodeAtan:
+            for (j = 0; j < count; ++j) {
+                double result = atan2(a[j], b[j]) * 180.0 / M_PI;
+                if (result < 0) {
+                    result += 360.0;
+                }
+                dst[j] = result;
+            }
+            break;
+        case psCodeCeiling:
+            for (j = 0; j < count; ++j) {
+                dst[j] = ceil(a[j]);
+            }
+            break;
+        case psCodeCos:
+            for (j = 0; j < count; ++j) {
+                dst[j] = cos(a[j] * M_PI / 180.0);
+            }
+            break;
+        case psCodeDiv:
+            for (j = 0; j < count; ++j) {
+                dst[j] = a[j] / b[j];
+            }
+            break;
+        case psCodeDivImm:
+            for (j = 0; j < count; ++j) {
+                dst[j] = a[j] / imm;
+            }
+            break;
+        case psCodeExp:
+            for (j = 0; j < count; ++j) {
+                dst[j] = pow(a[j], b[j]);
+            }
+            break;
+        case psCodeExpImm:
+            for (j = 0; j < count; ++j) {
+                dst[j] = pow(a[j], imm);
+            }
+            break;
+        case psCodeFloor:
+            for (j = 0; j < count; ++j) {
+                dst[j] = floor(a[j]);
+            }
+            break;
+        case psCodeLn:
+            for (j = 0; j < count; ++j) {
+                dst[j] = log(a[j]);
+            }
+            break;
+        case psCodeLog:
+            for (j = 0; j < count; ++j) {
+                dst[j] = log10(a[j]);
+            }
+            break;
+        case psCodeMulReal:
+            for (j = 0; j < count; ++j) {
+                dst[j] = a[j] * b[j];
+            }
+            break;
+        case psCodeMulRealImm:
+            for (j = 0; j < count; ++j) {
+                dst[j] = a[j] * imm;
+            }
+            break;
+        case psCodeNegReal:
+            for (j = 0; j < count; ++j) {
+                dst[j] = -a[j];
+            }
+            break;
+        case psCodeRound:
+            for (j = 0; j < count; ++j) {
+                dst[j] = (a[j] >= 0) ? floor(a[j] + 0.5) : ceil(a[j] - 0.5);
+            }
+            break;
+        case psCodeSin:
+            for (j = 0; j < count; ++j) {
+                dst[j] = sin(a[j] * M_PI / 180.0);
+            }
+            break;
+        case psCodeSqrt:
+            for (j = 0; j < count; ++j) {
+                dst[j] = sqrt(a[j]);
+            }
+            break;
+        case psCodeSubReal:
+            for (j = 0; j < count; ++j) {
+                dst[j] = a[j] - b[j];
+            }
+            break;
+        case psCodeSubRealImm:
+            for (j = 0; j < count; ++j) {
+                dst[j] = a[j] - imm;
+            }
+            break;
+        case psCodeTruncate:
+            for (j = 0; j < count; ++j) {
+                dst[j] = (a[j] >= 0) ? floor(a[j]) : ceil(a[j]);
+            }
+            break;
+        case psCodeOutput:
+            // <dst> is the output number
+            for (j = 0; j < count; ++j) {
+                double *p = &out[j * n + instr.dst];
+                if (a[j] < range[instr.dst][0]) {
+                    *p = range[instr.dst][0];
+                } else if (a[j] > range[instr.dst][1]) {
+                    *p = range[instr.dst][1];
+                } else {
+                    *p = a[j];
+                }
+            }
+            break;
+        case psCodeEnd:
+        default:
+            return;
+        }
+    }
+}
+
+// Sample the function on a grid over its domain.  The samples are kept if
+// interpolating them gives the function to within psSampledTolerance of
+// the output range at the thirds of every grid cell side and at the
+// thirds of its interior, in 2D.  Returns true if they are kept.
+bool PostScriptFunction::buildSamples()
+{
+    const int intervals = m == 1 ? psSampledIntervals1 : psSampledIntervals2;
+    const int gridSize = intervals + 1;
+    const double fractions[3] = { 0, 1.0 / 3, 2.0 / 3 };
+    double x[2], exact[funcMaxOutputs], approx[funcMaxOutputs];
+    int i, j, fi, fj, k;
+
+    auto data = std::make_shared<std::vector<double>>((size_t)(m == 1 ? gridSize : gridSize * gridSize) * n);
+    double *p = data->data();
+    for (j = 0; j < (m == 1 ? 1 : gridSize); ++j) {
+        x[1] = domain[m - 1][0] + (domain[m - 1][1] - domain[m - 1][0]) * j / intervals;
+        for (i = 0; i < gridSize; ++i, p += n) {
+            x[0] = domain[0][0] + (domain[0][1] - domain[0][0]) * i / intervals;
+            if (!execCompiled(x, p)) {
+                return false;
+            }
+        }
+    }
+    samples = std::move(data);
+
+    // the grid points themselves are skipped, and so are the points past
+    // the last grid line
+    for (j = 0; j < (m == 1 ? 1 : gridSize); ++j) {
+        for (fj = 0; fj < (m == 1 ? 1 : 3); ++fj) {
+            if (j == intervals && fj > 0) {
+                break;
+            }
+            x[1] = domain[m - 1][0] + (domain[m - 1][1] - domain[m - 1][0]) * (j + fractions[fj]) / intervals;
+            for (i = 0; i < gridSize; ++i) {
+                for (fi = 0; fi < 3; ++fi) {
+                    if ((fi == 0 && fj == 0) || (i == intervals && fi > 0)) {
+                        continue;
+                    }
+                    x[0] = domain[0][0] + (domain[0][1] - domain[0][0]) * (i + fractions[fi]) / intervals;
+                    if (!execCompiled(x, exact) || !transformSampled(x, approx)) {
+                        samples.reset();
+                        return false;
+                    }
+                    for (k = 0; k < n; ++k) {
+                        if (!(fabs(exact[k] - approx[k]) <= (range[k][1] - range[k][0]) * psSampledTolerance)) {
+                            samples.reset();
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Interpolate the samples.  Returns false for inputs outside the domain.
+bool PostScriptFunction::transformSampled(const double *in, double *out) const
+{
+    const int intervals = m == 1 ? psSampledIntervals1 : psSampledIntervals2;
+    int idx[2];
+    double t[2];
+    int i, k;
+
+    for (i = 0; i < m; ++i) {
+        if (!(in[i] >= domain[i][0] && in[i] <= domain[i][1])) {
+            return false;
+        }
+        const double x = (in[i] - domain[i][0]) / (domain[i][1] - domain[i][0]) * intervals;
+        idx[i] = (int)x;
+        if (idx[i] >= intervals) {
+            idx[i] = intervals - 1;
+        }
+        t[i] = x - idx[i];
+    }
+    const double *s = samples->data();
+    if (m == 1) {
+        const double *s0 = s + idx[0] * n;
+        for (k = 0; k < n; ++k) {
+            out[k] = s0[k] + (s0[n + k] - s0[k]) * t[0];
+        }
+    } else {
+        const int rowSize = (intervals + 1) * n;
+        const double *s0 = s + idx[1] * rowSize + idx[0] * n;
+        const double *s1 = s0 + rowSize;
+        for (k = 0; k < n; ++k) {
+            const double v0 = s0[k] + (s0[n + k] - s0[k]) * t[0];
+            const double v1 = s1[k] + (s1[n + k] - s1[k]) * t[0];
+            out[k] = v0 + (v1 - v0) * t[1];
+        }
+    }
+    return true;
+}
+
 bool PostScriptFunction::parseCode(Stream *str, int *codePtr)
 {
     bool isReal;
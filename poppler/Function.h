@@ -29,11 +29,14 @@
 #define FUNCTION_H
 
 #include "Object.h"
+#include <memory>
 #include <set>
+#include <vector>
 
 class Dict;
 class Stream;
 struct PSObject;
+struct PSInstr;
 class PSStack;
 
 //------------------------------------------------------------------------
@@ -87,6 +90,12 @@ public:
     // Transform an input tuple into an output tuple.
     virtual void transform(const double *in, double *out) const = 0;
 
+    // Transform <count> input tuples, stored one after the other in
+    // <in>, into <count> output tuples stored one after the other in
+    // <out>.  This gives the same results as calling transform() on each
+    // tuple, but is faster on long runs of them, e.g. image lines.
+    virtual void transformBatch(const double *in, double *out, int count) const;
+
     virtual bool isOk() const = 0;
 
 protected:
@@ -135,6 +144,7 @@ public:
     std::unique_ptr<Function> copy() const override { return std::make_unique<SampledFunction>(this); }
     Type getType() const override { return Type::Sampled; }
     void transform(const double *in, double *out) const override;
+    void transformBatch(const double *in, double *out, int count) const override;
     bool isOk() const override { return ok; }
     bool hasDifferentResultSet(const Function *func) const override;
 
@@ -182,6 +192,7 @@ public:
     std::unique_ptr<Function> copy() const override { return std::make_unique<ExponentialFunction>(this); }
     Type getType() const override { return Type::Exponential; }
     void transform(const double *in, double *out) const override;
+    void transformBatch(const double *in, double *out, int count) const override;
     bool isOk() const override { return ok; }
 
     const double *getC0() const { return c0; }
@@ -214,6 +225,7 @@ public:
     std::unique_ptr<Function> copy() const override { return std::make_unique<StitchingFunction>(this); }
     Type getType() const override { return Type::Stitching; }
     void transform(const double *in, double *out) const override;
+    void transformBatch(const double *in, double *out, int count) const override;
     bool isOk() const override { return ok; }
 
     int getNumFuncs() const { return k; }
@@ -237,6 +249,21 @@ private:
 // PostScriptFunction
 //------------------------------------------------------------------------
 
+// How a PostScript function is evaluated.
+enum PSFunctionImpl
+{
+    psFunctionImplInterpreter, // the code is interpreted
+    psFunctionImplCompiled, // the code is compiled to register operations
+    psFunctionImplSampled // the compiled code is sampled on a grid
+};
+
+// Set the best implementation that PostScript functions created from now
+// on may use.  The default is psFunctionImplSampled, the others are for
+// comparing the implementations in tests.  A function that can't be
+// compiled is interpreted, and one that can't be sampled accurately is
+// compiled.
+POPPLER_PRIVATE_EXPORT void setPSFunctionImpl(PSFunctionImpl impl);
+
 class PostScriptFunction : public Function
 {
     class PrivateTag
@@ -249,9 +276,11 @@ public:
     std::unique_ptr<Function> copy() const override { return std::make_unique<PostScriptFunction>(this); }
     Type getType() const override { return Type::PostScript; }
     void transform(const double *in, double *out) const override;
+    void transformBatch(const double *in, double *out, int count) const override;
     bool isOk() const override { return ok; }
 
     const GooString *getCodeString() const { return codeString.get(); }
+    PSFunctionImpl getImpl() const { return impl; }
 
     explicit PostScriptFunction(const PostScriptFunction *func, PrivateTag = {});
 
@@ -260,10 +289,24 @@ private:
     std::unique_ptr<GooString> getToken(Stream *str);
     void resizeCode(int newSize);
     void exec(PSStack *stack, int codePtr) const;
+    bool execCompiled(const double *in, double *out) const;
+    void execCompiledBatch(const double *in, double *out, int count) const;
+    bool buildSamples();
+    bool transformSampled(const double *in, double *out) const;
 
     std::unique_ptr<GooString> codeString;
     PSObject *code;
     int codeSize;
+    // the code compiled to register operations; empty if the code can't
+    // be compiled, in which case it is interpreted
+    std::vector<PSInstr> compiledCode;
+    // number of registers used by compiledCode if it can run on blocks of
+    // inputs at once (see execCompiledBatch()), else 0
+    int batchRegisters;
+    // the function sampled on a grid over its domain, used instead of
+    // the code when it is accurate enough; nullptr if it isn't sampled
+    std::shared_ptr<const std::vector<double>> samples;
+    PSFunctionImpl impl;
     mutable double cacheIn[funcMaxInputs];
     mutable double cacheOut[funcMaxOutputs];
     bool ok;
@@ -138,6 +138,10 @@
 // fill.
 #define patchColorDelta (dblToCol((3. / 256.0)))
 
+// Max nesting depth of the forms that are scanned for text showing
+// operators.
+#define formScanMaxDepth 8
+
 //------------------------------------------------------------------------
 // Operator table
 //------------------------------------------------------------------------
@@ -238,6 +242,12 @@ static inline bool isSameGfxColor(const GfxColor &colorA, const GfxColor &colorB
     return true;
 }
 
+// Can <c> follow the 'EI' tag that ends inline image data?
+static inline bool isImageEnd(int c)
+{
+    return c == EOF || Lexer::isSpace(c) || strchr("()<>[]{}/%", c);
+}
+
 //------------------------------------------------------------------------
 // GfxResources
 //------------------------------------------------------------------------
@@ -468,6 +478,7 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, int pageNum, Dict *resDict, double hDPI,
 
     // initialize
     out = outA;
+    buildPaths = out->needPaths();
     state = new GfxState(hDPI, vDPI, box, rotate, out->upsideDown());
     out->initGfxState(state);
     stackHeight = 1;
@@ -526,6 +537,7 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, Dict *resDict, const PDFRectangle *box,
 
     // initialize
     out = outA;
+    buildPaths = out->needPaths();
     double hDPI = 72;
     double vDPI = 72;
     if (gfxA) {
@@ -1516,7 +1528,8 @@ void Gfx::opSetFillColorN(Object args[], int numArgs)
             state->setFillColor(&color);
             out->updateFillColor(state);
         }
-        if (numArgs > 0) {
+        // patterns are only used for non-text content, see doPatternFill()
+        if (numArgs > 0 && out->needNonText()) {
             std::unique_ptr<GfxPattern> pattern;
             if (args[numArgs - 1].isName() && (pattern = res->lookupPattern(args[numArgs - 1].getName(), out, state))) {
                 state->setFillPattern(std::move(pattern));
@@ -1567,7 +1580,7 @@ void Gfx::opSetStrokeColorN(Object args[], int numArgs)
             return;
         }
         std::unique_ptr<GfxPattern> pattern;
-        if (args[numArgs - 1].isName() && (pattern = res->lookupPattern(args[numArgs - 1].getName(), out, state))) {
+        if (out->needNonText() && args[numArgs - 1].isName() && (pattern = res->lookupPattern(args[numArgs - 1].getName(), out, state))) {
             state->setStrokePattern(std::move(pattern));
         }
 
@@ -1595,11 +1608,19 @@ void Gfx::opSetStrokeColorN(Object args[], int numArgs)
 
 void Gfx::opMoveTo(Object args[], int numArgs)
 {
+    // without a current point, the painting and clipping operators do
+    // nothing but end the path
+    if (!buildPaths) {
+        return;
+    }
     state->moveTo(args[0].getNum(), args[1].getNum());
 }
 
 void Gfx::opLineTo(Object args[], int numArgs)
 {
+    if (!buildPaths) {
+        return;
+    }
     if (!state->isCurPt()) {
         error(errSyntaxError, getPos(), "No current point in lineto");
         return;
@@ -1611,6 +1632,9 @@ void Gfx::opCurveTo(Object args[], int numArgs)
 {
     double x1, y1, x2, y2, x3, y3;
 
+    if (!buildPaths) {
+        return;
+    }
     if (!state->isCurPt()) {
         error(errSyntaxError, getPos(), "No current point in curveto");
         return;
@@ -1628,6 +1652,9 @@ void Gfx::opCurveTo1(Object args[], int numArgs)
 {
     double x1, y1, x2, y2, x3, y3;
 
+    if (!buildPaths) {
+        return;
+    }
     if (!state->isCurPt()) {
         error(errSyntaxError, getPos(), "No current point in curveto1");
         return;
@@ -1645,6 +1672,9 @@ void Gfx::opCurveTo2(Object args[], int numArgs)
 {
     double x1, y1, x2, y2, x3, y3;
 
+    if (!buildPaths) {
+        return;
+    }
     if (!state->isCurPt()) {
         error(errSyntaxError, getPos(), "No current point in curveto2");
         return;
@@ -1662,6 +1692,9 @@ void Gfx::opRectangle(Object args[], int numArgs)
 {
     double x, y, w, h;
 
+    if (!buildPaths) {
+        return;
+    }
     x = args[0].getNum();
     y = args[1].getNum();
     w = args[2].getNum();
@@ -1675,6 +1708,9 @@ void Gfx::opRectangle(Object args[], int numArgs)
 
 void Gfx::opClosePath(Object args[], int numArgs)
 {
+    if (!buildPaths) {
+        return;
+    }
     if (!state->isCurPt()) {
         error(errSyntaxError, getPos(), "No current point in closepath");
         return;
@@ -2320,7 +2356,8 @@ void Gfx::opShFill(Object args[], int numArgs)
     GfxState *savedState;
     double xMin, yMin, xMax, yMax;
 
-    if (!ocState) {
+    // like patterns, shadings are skipped for text extraction
+    if (!ocState || !out->needNonText()) {
         return;
     }
 
@@ -4112,7 +4149,7 @@ void Gfx::opXObject(Object args[], int numArgs)
         if (shouldDoForm) {
             if (out->useDrawForm() && refObj.isRef()) {
                 out->drawForm(refObj.getRef());
-            } else {
+            } else if (out->needNonText() || buildPaths || formMayShowText(&obj1, refObj, 0)) {
                 Ref ref = refObj.isRef() ? refObj.getRef() : Ref::INVALID();
                 out->beginForm(&obj1, ref);
                 doForm(&obj1);
@@ -4279,8 +4316,8 @@ void Gfx::doImage(Object *ref, Stream *str, bool inlineImg)
                 goto err1;
             }
             n = height * ((width + 7) / 8);
-            for (i = 0; i < n; ++i) {
-                str->getChar();
+            if (n > 0) {
+                str->discardChars(n);
             }
             str->close();
 
@@ -4591,8 +4628,8 @@ void Gfx::doImage(Object *ref, Stream *str, bool inlineImg)
                 goto err1;
             }
             n = height * ((width * colorMap.getNumPixelComps() * colorMap.getBits() + 7) / 8);
-            for (i = 0; i < n; ++i) {
-                str->getChar();
+            if (n > 0) {
+                str->discardChars(n);
             }
             str->close();
 
@@ -4783,6 +4820,95 @@ void Gfx::doForm(Object *str)
     ocState = ocSaved;
 }
 
+// Returns false if the form <str> can't show any text, so that a device
+// that only needs text can skip it.  The content stream is only scanned
+// for the bytes of the text showing operators and of the XObjects it
+// draws: text in a string or in inline image data may make it look like
+// the form shows text when it doesn't, but never the other way round.
+bool Gfx::formMayShowText(Object *str, const Object &ref, int depth)
+{
+    if (ref.isRef()) {
+        const auto it = formsShowingText.find(ref.getRef().num);
+        if (it != formsShowingText.end()) {
+            return it->second;
+        }
+    }
+
+    Stream *contents = str->getStream();
+    if (!contents->reset()) {
+        return true;
+    }
+    bool showsText = false;
+    std::set<std::string> xObjects; // "" if a Do doesn't follow a name
+    std::string name;
+    bool inName = false;
+    bool afterName = false; // only spaces since the end of <name>
+    int prev = 0;
+    unsigned char buf[4096];
+    int n;
+    while (!showsText && (n = contents->doGetChars(sizeof(buf), buf)) > 0) {
+        for (int i = 0; i < n; ++i) {
+            const int c = buf[i];
+            const int last = prev;
+            prev = c;
+            if (c == '\'' || c == '"' || (last == 'T' && (c == 'j' || c == 'J'))) {
+                showsText = true;
+                break;
+            }
+            if (inName) {
+                if (!Lexer::isSpace(c) && !strchr("()<>[]{}/%", c)) {
+                    name.push_back(c);
+                    continue;
+                }
+                inName = false;
+                afterName = true;
+            }
+            if (c == '/') {
+                name.clear();
+                inName = true;
+            } else if (c == 'o' && last == 'D') {
+                xObjects.insert(afterName ? name : std::string());
+            } else if (c != 'D' && !Lexer::isSpace(c)) {
+                afterName = false;
+            }
+        }
+    }
+    contents->close();
+
+    // look at the XObjects it draws, which must all be in its own
+    // resources: otherwise whether it shows text depends on where it
+    // is drawn
+    if (!showsText && !xObjects.empty()) {
+        Object resObj = str->streamGetDict()->lookup("Resources");
+        Object xObjDict = resObj.isDict() ? resObj.dictLookup("XObject") : Object::null();
+        for (const std::string &xObjName : xObjects) {
+            if (depth >= formScanMaxDepth || xObjName.empty() || xObjName.find('#') != std::string::npos || !xObjDict.isDict()) {
+                showsText = true;
+                break;
+            }
+            Object xObj = xObjDict.dictLookup(xObjName.c_str());
+            const Object &xObjRef = xObjDict.dictLookupNF(xObjName.c_str());
+            if (!xObj.isStream() || (xObjRef.isRef() && formsDrawing.count(xObjRef.getRef().num))) {
+                showsText = true;
+                break;
+            }
+            Object subtype = xObj.streamGetDict()->lookup("Subtype");
+            if (subtype.isName("Image")) {
+                continue;
+            }
+            if (!subtype.isName("Form") || formMayShowText(&xObj, xObjRef, depth + 1)) {
+                showsText = true;
+                break;
+            }
+        }
+    }
+
+    if (ref.isRef()) {
+        formsShowingText[ref.getRef().num] = showsText;
+    }
+    return showsText;
+}
+
 void Gfx::drawForm(Object *str, Dict *resDict, const double *matrix, const double *bbox, bool transpGroup, bool softMask, GfxColorSpace *blendingColorSpace, bool isolated, bool knockout, bool alpha, Function *transferFunc,
                    GfxColor *backdropColor)
 {
@@ -4900,14 +5026,16 @@ void Gfx::opBeginImage(Object args[], int numArgs)
 
     // display the image
     if (str) {
-        doImage(nullptr, str, true);
+        if (out->needNonText() || !skipImageData(str)) {
+            doImage(nullptr, str, true);
 
-        // skip 'EI' tag
-        c1 = str->getUndecodedStream()->getChar();
-        c2 = str->getUndecodedStream()->getChar();
-        while (!(c1 == 'E' && c2 == 'I') && c2 != EOF) {
-            c1 = c2;
+            // skip 'EI' tag
+            c1 = str->getUndecodedStream()->getChar();
             c2 = str->getUndecodedStream()->getChar();
+            while (!(c1 == 'E' && c2 == 'I') && c2 != EOF) {
+                c1 = c2;
+                c2 = str->getUndecodedStream()->getChar();
+            }
         }
         delete str;
     }
@@ -4948,6 +5076,49 @@ Stream *Gfx::buildImageStream()
     return str;
 }
 
+// Skip the data of the inline image <str> and the 'EI' tag without
+// decoding the data, if its dictionary gives its length.  The length
+// isn't trusted: the data is read up to the first 'EI' that may end it,
+// so that a length that is too long doesn't lose the operators after
+// the image.  If that 'EI' isn't right after the length, the data that
+// was read is put back and false is returned, as when there is no
+// length, so that the image is decoded to find its end.
+bool Gfx::skipImageData(Stream *str)
+{
+    Object obj = str->getDict()->lookup("L");
+    if (obj.isNull()) {
+        obj = str->getDict()->lookup("Length");
+    }
+    if (!obj.isInt() || obj.getInt() < 0) {
+        return false;
+    }
+    const int length = obj.getInt();
+
+    // the stream records what is read until it is reset
+    EmbedStream *data = static_cast<EmbedStream *>(str->getBaseStream());
+    int i, c, prev = EOF;
+    for (i = 0; i < length; ++i) {
+        if ((c = data->getChar()) == EOF || (prev == 'E' && c == 'I' && isImageEnd(data->lookChar()))) {
+            break;
+        }
+        prev = c;
+    }
+    if (i == length) {
+        while (Lexer::isSpace(data->lookChar())) {
+            data->getChar();
+        }
+        if (data->lookChar() == 'E') {
+            data->getChar();
+            if (data->getChar() == 'I' && isImageEnd(data->lookChar())) {
+                return true;
+            }
+        }
+    }
+    error(errSyntaxError, getPos(), "Inline image data is not followed by 'EI'");
+    data->unread();
+    return false;
+}
+
 void Gfx::opImageData(Object args[], int numArgs)
 {
     error(errInternal, getPos(), "Got 'ID' operator");
@@ -41,6 +41,7 @@
 #include "Object.h"
 #include "PopplerCache.h"
 
+#include <map>
 #include <vector>
 
 class GooString;
@@ -207,6 +208,7 @@ private:
     const bool printCommands; // print the drawing commands (for debugging)
     const bool profileCommands; // profile the drawing commands (for debugging)
     bool commandAborted; // did the previous command abort the drawing?
+    bool buildPaths; // does the output device need paths?
     GfxResources *res; // resource stack
     int updateLevel;
 
@@ -228,6 +230,8 @@ private:
 
     std::set<int> formsDrawing; // the forms/patterns that are being drawn
     std::set<int> charProcDrawing; // the charProc that are being drawn
+    std::map<int, bool> formsShowingText; // formMayShowText() of the forms
+                                          //   seen so far
 
     bool // callback to check for an abort
             (*abortCheckCbk)(void *data);
@@ -344,10 +348,12 @@ private:
     void opXObject(Object args[], int numArgs);
     void doImage(Object *ref, Stream *str, bool inlineImg);
     void doForm(Object *str);
+    bool formMayShowText(Object *str, const Object &ref, int depth);
 
     // in-line image operators
     void opBeginImage(Object args[], int numArgs);
     Stream *buildImageStream();
+    bool skipImageData(Stream *str);
     void opImageData(Object args[], int numArgs);
     void opEndImage(Object args[], int numArgs);
 
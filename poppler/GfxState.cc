@@ -1254,6 +1254,80 @@ void GfxCalRGBColorSpace::getDeviceN(const GfxColor *color, GfxColor *deviceN) c
     deviceN->c[3] = cmyk.k;
 }
 
+// The line variants convert one pixel at a time, as getRGB() does, but
+// only once for each run of equal pixels, as the conversion goes through
+// XYZ and three pow() calls.
+void GfxCalRGBColorSpace::bytesToColor(const unsigned char *in, GfxColor *color) const
+{
+    color->c[0] = byteToCol(in[0]);
+    color->c[1] = byteToCol(in[1]);
+    color->c[2] = byteToCol(in[2]);
+}
+
+void GfxCalRGBColorSpace::getRGBLine(unsigned char *in, unsigned int *out, int length)
+{
+    GfxColor color;
+    GfxRGB rgb;
+
+    for (int i = 0; i < length; i++, in += 3) {
+        if (i == 0 || in[0] != in[-3] || in[1] != in[-2] || in[2] != in[-1]) {
+            bytesToColor(in, &color);
+            getRGB(&color, &rgb);
+        }
+        out[i] = ((int)colToByte(rgb.r) << 16) | ((int)colToByte(rgb.g) << 8) | ((int)colToByte(rgb.b) << 0);
+    }
+}
+
+void GfxCalRGBColorSpace::getRGBLine(unsigned char *in, unsigned char *out, int length)
+{
+    GfxColor color;
+    GfxRGB rgb;
+
+    for (int i = 0; i < length; i++, in += 3) {
+        if (i == 0 || in[0] != in[-3] || in[1] != in[-2] || in[2] != in[-1]) {
+            bytesToColor(in, &color);
+            getRGB(&color, &rgb);
+        }
+        *out++ = colToByte(rgb.r);
+        *out++ = colToByte(rgb.g);
+        *out++ = colToByte(rgb.b);
+    }
+}
+
+void GfxCalRGBColorSpace::getRGBXLine(unsigned char *in, unsigned char *out, int length)
+{
+    GfxColor color;
+    GfxRGB rgb;
+
+    for (int i = 0; i < length; i++, in += 3) {
+        if (i == 0 || in[0] != in[-3] || in[1] != in[-2] || in[2] != in[-1]) {
+            bytesToColor(in, &color);
+            getRGB(&color, &rgb);
+        }
+        *out++ = colToByte(rgb.r);
+        *out++ = colToByte(rgb.g);
+        *out++ = colToByte(rgb.b);
+        *out++ = 255;
+    }
+}
+
+void GfxCalRGBColorSpace::getCMYKLine(unsigned char *in, unsigned char *out, int length)
+{
+    GfxColor color;
+    GfxCMYK cmyk;
+
+    for (int i = 0; i < length; i++, in += 3) {
+        if (i == 0 || in[0] != in[-3] || in[1] != in[-2] || in[2] != in[-1]) {
+            bytesToColor(in, &color);
+            getCMYK(&color, &cmyk);
+        }
+        *out++ = colToByte(cmyk.c);
+        *out++ = colToByte(cmyk.m);
+        *out++ = colToByte(cmyk.y);
+        *out++ = colToByte(cmyk.k);
+    }
+}
+
 void GfxCalRGBColorSpace::getDefaultColor(GfxColor *color) const
 {
     color->c[0] = 0;
@@ -1628,6 +1702,81 @@ void GfxLabColorSpace::getDeviceN(const GfxColor *color, GfxColor *deviceN) cons
     deviceN->c[3] = cmyk.k;
 }
 
+// Lab images are converted pixel by pixel too, through XYZ (or the
+// color management transform), once for each run of equal pixels.
+void GfxLabColorSpace::bytesToColor(const unsigned char *in, GfxColor *color) const
+{
+    // the components are scaled to 0..255 over their default ranges, see
+    // GfxImageColorMap
+    color->c[0] = dblToCol(in[0] * (100.0 / 255.0));
+    color->c[1] = dblToCol(aMin + in[1] * ((aMax - aMin) * (1.0 / 255.0)));
+    color->c[2] = dblToCol(bMin + in[2] * ((bMax - bMin) * (1.0 / 255.0)));
+}
+
+void GfxLabColorSpace::getRGBLine(unsigned char *in, unsigned int *out, int length)
+{
+    GfxColor color;
+    GfxRGB rgb;
+
+    for (int i = 0; i < length; i++, in += 3) {
+        if (i == 0 || in[0] != in[-3] || in[1] != in[-2] || in[2] != in[-1]) {
+            bytesToColor(in, &color);
+            getRGB(&color, &rgb);
+        }
+        out[i] = ((int)colToByte(rgb.r) << 16) | ((int)colToByte(rgb.g) << 8) | ((int)colToByte(rgb.b) << 0);
+    }
+}
+
+void GfxLabColorSpace::getRGBLine(unsigned char *in, unsigned char *out, int length)
+{
+    GfxColor color;
+    GfxRGB rgb;
+
+    for (int i = 0; i < length; i++, in += 3) {
+        if (i == 0 || in[0] != in[-3] || in[1] != in[-2] || in[2] != in[-1]) {
+            bytesToColor(in, &color);
+            getRGB(&color, &rgb);
+        }
+        *out++ = colToByte(rgb.r);
+        *out++ = colToByte(rgb.g);
+        *out++ = colToByte(rgb.b);
+    }
+}
+
+void GfxLabColorSpace::getRGBXLine(unsigned char *in, unsigned char *out, int length)
+{
+    GfxColor color;
+    GfxRGB rgb;
+
+    for (int i = 0; i < length; i++, in += 3) {
+        if (i == 0 || in[0] != in[-3] || in[1] != in[-2] || in[2] != in[-1]) {
+            bytesToColor(in, &color);
+            getRGB(&color, &rgb);
+        }
+        *out++ = colToByte(rgb.r);
+        *out++ = colToByte(rgb.g);
+        *out++ = colToByte(rgb.b);
+        *out++ = 255;
+    }
+}
+
+void GfxLabColorSpace::getCMYKLine(unsigned char *in, unsigned char *out, int length)
+{
+    GfxColor color;
+    GfxCMYK cmyk;
+
+    for (int i = 0; i < length; i++, in += 3) {
+        if (i == 0 || in[0] != in[-3] || in[1] != in[-2] || in[2] != in[-1]) {
+            bytesToColor(in, &color);
+            getCMYK(&color, &cmyk);
+        }
+        *out++ = colToByte(cmyk.c);
+        *out++ = colToByte(cmyk.m);
+        *out++ = colToByte(cmyk.y);
+        *out++ = colToByte(cmyk.k);
+    }
+}
+
 void GfxLabColorSpace::getDefaultColor(GfxColor *color) const
 {
     color->c[0] = 0;
@@ -2568,6 +2717,34 @@ void GfxIndexedColorSpace::getDefaultRanges(double *decodeLow, double *decodeRan
 // GfxSeparationColorSpace
 //------------------------------------------------------------------------
 
+// Run the tint transform <func> on a line of <length> pixels of <nComps>
+// 8-bit components.  Returns the pixels in the alternate color space
+// <alt>, as 8-bit components too; the caller must gfree() them.
+static unsigned char *tintTransformLine(const Function *func, int nComps, const GfxColorSpace *alt, const unsigned char *in, int length)
+{
+    const int m = func->getInputSize();
+    const int n = func->getOutputSize();
+    const int altNComps = alt->getNComps();
+    std::vector<double> x((size_t)length * m);
+    std::vector<double> y((size_t)length * n);
+    unsigned char *out;
+    int i, j;
+
+    for (i = 0; i < length; ++i) {
+        for (j = 0; j < m; ++j) {
+            x[(size_t)i * m + j] = byteToDbl(in[(size_t)i * nComps + j]);
+        }
+    }
+    func->transformBatch(x.data(), y.data(), length);
+    out = (unsigned char *)gmallocn(length, altNComps);
+    for (i = 0; i < length; ++i) {
+        for (j = 0; j < altNComps; ++j) {
+            out[(size_t)i * altNComps + j] = colToByte(clip01(dblToCol(y[(size_t)i * n + j])));
+        }
+    }
+    return out;
+}
+
 GfxSeparationColorSpace::GfxSeparationColorSpace(std::unique_ptr<GooString> &&nameA, std::unique_ptr<GfxColorSpace> &&altA, std::unique_ptr<Function> funcA) : name(std::move(nameA)), alt(std::move(altA))
 {
     func = std::move(funcA);
@@ -2739,6 +2916,75 @@ void GfxSeparationColorSpace::getDeviceN(const GfxColor *color, GfxColor *device
     }
 }
 
+void GfxSeparationColorSpace::getRGBLine(unsigned char *in, unsigned int *out, int length)
+{
+    if (alt->getMode() == csDeviceGray && name->cmp("Black") == 0) {
+        for (int i = 0; i < length; i++) {
+            const unsigned int gray = 255 - in[i];
+            out[i] = (gray << 16) | (gray << 8) | gray;
+        }
+        return;
+    }
+    unsigned char *altLine = tintTransformLine(func.get(), 1, alt.get(), in, length);
+    alt->getRGBLine(altLine, out, length);
+    gfree(altLine);
+}
+
+void GfxSeparationColorSpace::getRGBLine(unsigned char *in, unsigned char *out, int length)
+{
+    if (alt->getMode() == csDeviceGray && name->cmp("Black") == 0) {
+        for (int i = 0; i < length; i++) {
+            *out++ = 255 - in[i];
+            *out++ = 255 - in[i];
+            *out++ = 255 - in[i];
+        }
+        return;
+    }
+    unsigned char *altLine = tintTransformLine(func.get(), 1, alt.get(), in, length);
+    alt->getRGBLine(altLine, out, length);
+    gfree(altLine);
+}
+
+void GfxSeparationColorSpace::getRGBXLine(unsigned char *in, unsigned char *out, int length)
+{
+    if (alt->getMode() == csDeviceGray && name->cmp("Black") == 0) {
+        for (int i = 0; i < length; i++) {
+            *out++ = 255 - in[i];
+            *out++ = 255 - in[i];
+            *out++ = 255 - in[i];
+            *out++ = 255;
+        }
+        return;
+    }
+    unsigned char *altLine = tintTransformLine(func.get(), 1, alt.get(), in, length);
+    alt->getRGBXLine(altLine, out, length);
+    gfree(altLine);
+}
+
+void GfxSeparationColorSpace::getCMYKLine(unsigned char *in, unsigned char *out, int length)
+{
+    int comp;
+
+    if (name->cmp("Cyan") == 0) {
+        comp = 0;
+    } else if (name->cmp("Magenta") == 0) {
+        comp = 1;
+    } else if (name->cmp("Yellow") == 0) {
+        comp = 2;
+    } else if (name->cmp("Black") == 0) {
+        comp = 3;
+    } else {
+        unsigned char *altLine = tintTransformLine(func.get(), 1, alt.get(), in, length);
+        alt->getCMYKLine(altLine, out, length);
+        gfree(altLine);
+        return;
+    }
+    memset(out, 0, (size_t)length * 4);
+    for (int i = 0; i < length; i++) {
+        out[4 * i + comp] = in[i];
+    }
+}
+
 void GfxSeparationColorSpace::getDefaultColor(GfxColor *color) const
 {
     color->c[0] = gfxColorComp1;
@@ -2988,6 +3234,34 @@ void GfxDeviceNColorSpace::getDeviceN(const GfxColor *color, GfxColor *deviceN)
     }
 }
 
+void GfxDeviceNColorSpace::getRGBLine(unsigned char *in, unsigned int *out, int length)
+{
+    unsigned char *altLine = tintTransformLine(func.get(), nComps, alt.get(), in, length);
+    alt->getRGBLine(altLine, out, length);
+    gfree(altLine);
+}
+
+void GfxDeviceNColorSpace::getRGBLine(unsigned char *in, unsigned char *out, int length)
+{
+    unsigned char *altLine = tintTransformLine(func.get(), nComps, alt.get(), in, length);
+    alt->getRGBLine(altLine, out, length);
+    gfree(altLine);
+}
+
+void GfxDeviceNColorSpace::getRGBXLine(unsigned char *in, unsigned char *out, int length)
+{
+    unsigned char *altLine = tintTransformLine(func.get(), nComps, alt.get(), in, length);
+    alt->getRGBXLine(altLine, out, length);
+    gfree(altLine);
+}
+
+void GfxDeviceNColorSpace::getCMYKLine(unsigned char *in, unsigned char *out, int length)
+{
+    unsigned char *altLine = tintTransformLine(func.get(), nComps, alt.get(), in, length);
+    alt->getCMYKLine(altLine, out, length);
+    gfree(altLine);
+}
+
 void GfxDeviceNColorSpace::getDefaultColor(GfxColor *color) const
 {
     int i;
@@ -5464,6 +5738,7 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode, std::unique_ptr<Gf
     const Function *sepFunc;
     double x[gfxColorMaxComps];
     double y[gfxColorMaxComps] = {};
+    double byteLow[gfxColorMaxComps], byteRange[gfxColorMaxComps];
     int i, j, k;
     double mapped;
     bool useByteLookup;
@@ -5600,6 +5875,21 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode, std::unique_ptr<Gf
             byte_lookup = (unsigned char *)gmallocn((maxPixel + 1), nComps);
             useByteLookup = true;
         }
+        // the line functions take components scaled to 0..255; that is
+        // over 0..1 for all color spaces but Lab, which uses its default
+        // ranges
+        for (k = 0; k < nComps; ++k) {
+            byteLow[k] = 0;
+            byteRange[k] = 1;
+        }
+        if (colorSpace->getMode() == csLab) {
+            colorSpace->getDefaultRanges(byteLow, byteRange, 255);
+            for (k = 0; k < nComps; ++k) {
+                if (byteRange[k] == 0) {
+                    byteRange[k] = 1;
+                }
+            }
+        }
         for (k = 0; k < nComps; ++k) {
             lookup2[k] = (GfxColorComp *)gmallocn(maxPixel + 1, sizeof(GfxColorComp));
             for (i = 0; i <= maxPixel; ++i) {
@@ -5608,7 +5898,7 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode, std::unique_ptr<Gf
                 if (useByteLookup) {
                     int byte;
 
-                    byte = (int)(mapped * 255.0 + 0.5);
+                    byte = (int)((mapped - byteLow[k]) / byteRange[k] * 255.0 + 0.5);
                     if (byte < 0) {
                         byte = 0;
                     } else if (byte > 255) {
@@ -6972,6 +7262,24 @@ void GfxState::clipToRect(double xMin, double yMin, double xMax, double yMax)
     }
 }
 
+void GfxState::scaleDeviceSpace(double sx, double sy)
+{
+    hDPI *= sx;
+    vDPI *= sy;
+    pageWidth *= sx;
+    pageHeight *= sy;
+    ctm[0] *= sx;
+    ctm[1] *= sy;
+    ctm[2] *= sx;
+    ctm[3] *= sy;
+    ctm[4] *= sx;
+    ctm[5] *= sy;
+    clipXMin *= sx;
+    clipYMin *= sy;
+    clipXMax *= sx;
+    clipYMax *= sy;
+}
+
 void GfxState::textShift(double tx, double ty)
 {
     double dx, dy;
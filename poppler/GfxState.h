@@ -466,6 +466,12 @@ public:
     void getRGB(const GfxColor *color, GfxRGB *rgb) const override;
     void getCMYK(const GfxColor *color, GfxCMYK *cmyk) const override;
     void getDeviceN(const GfxColor *color, GfxColor *deviceN) const override;
+    void getRGBLine(unsigned char *in, unsigned int *out, int length) override;
+    void getRGBLine(unsigned char *in, unsigned char *out, int length) override;
+    void getRGBXLine(unsigned char *in, unsigned char *out, int length) override;
+    void getCMYKLine(unsigned char *in, unsigned char *out, int length) override;
+    bool useGetRGBLine() const override { return true; }
+    bool useGetCMYKLine() const override { return true; }
 
     int getNComps() const override { return 3; }
     void getDefaultColor(GfxColor *color) const override;
@@ -488,6 +494,7 @@ private:
     double gammaR, gammaG, gammaB; // gamma values
     double mat[9]; // ABC -> XYZ transform matrix
     void getXYZ(const GfxColor *color, double *pX, double *pY, double *pZ) const;
+    void bytesToColor(const unsigned char *in, GfxColor *color) const;
 #ifdef USE_CMS
     std::shared_ptr<GfxColorTransform> transform;
 #endif
@@ -543,6 +550,12 @@ public:
     void getRGB(const GfxColor *color, GfxRGB *rgb) const override;
     void getCMYK(const GfxColor *color, GfxCMYK *cmyk) const override;
     void getDeviceN(const GfxColor *color, GfxColor *deviceN) const override;
+    void getRGBLine(unsigned char *in, unsigned int *out, int length) override;
+    void getRGBLine(unsigned char *in, unsigned char *out, int length) override;
+    void getRGBXLine(unsigned char *in, unsigned char *out, int length) override;
+    void getCMYKLine(unsigned char *in, unsigned char *out, int length) override;
+    bool useGetRGBLine() const override { return true; }
+    bool useGetCMYKLine() const override { return true; }
 
     int getNComps() const override { return 3; }
     void getDefaultColor(GfxColor *color) const override;
@@ -566,6 +579,7 @@ private:
     double blackX, blackY, blackZ; // black point
     double aMin, aMax, bMin, bMax; // range for the a and b components
     void getXYZ(const GfxColor *color, double *pX, double *pY, double *pZ) const;
+    void bytesToColor(const unsigned char *in, GfxColor *color) const;
 #ifdef USE_CMS
     std::shared_ptr<GfxColorTransform> transform;
 #endif
@@ -705,6 +719,12 @@ public:
     void getRGB(const GfxColor *color, GfxRGB *rgb) const override;
     void getCMYK(const GfxColor *color, GfxCMYK *cmyk) const override;
     void getDeviceN(const GfxColor *color, GfxColor *deviceN) const override;
+    void getRGBLine(unsigned char *in, unsigned int *out, int length) override;
+    void getRGBLine(unsigned char *in, unsigned char *out, int length) override;
+    void getRGBXLine(unsigned char *in, unsigned char *out, int length) override;
+    void getCMYKLine(unsigned char *in, unsigned char *out, int length) override;
+    bool useGetRGBLine() const override { return alt->useGetRGBLine(); }
+    bool useGetCMYKLine() const override { return alt->useGetCMYKLine(); }
 
     void createMapping(std::vector<std::unique_ptr<GfxSeparationColorSpace>> *separationList, int maxSepComps) override;
 
@@ -750,6 +770,12 @@ public:
     void getRGB(const GfxColor *color, GfxRGB *rgb) const override;
     void getCMYK(const GfxColor *color, GfxCMYK *cmyk) const override;
     void getDeviceN(const GfxColor *color, GfxColor *deviceN) const override;
+    void getRGBLine(unsigned char *in, unsigned int *out, int length) override;
+    void getRGBLine(unsigned char *in, unsigned char *out, int length) override;
+    void getRGBXLine(unsigned char *in, unsigned char *out, int length) override;
+    void getCMYKLine(unsigned char *in, unsigned char *out, int length) override;
+    bool useGetRGBLine() const override { return alt->useGetRGBLine(); }
+    bool useGetCMYKLine() const override { return alt->useGetCMYKLine(); }
 
     void createMapping(std::vector<std::unique_ptr<GfxSeparationColorSpace>> *separationList, int maxSepComps) override;
 
@@ -1715,6 +1741,10 @@ public:
     void clipToStrokePath();
     void clipToRect(double xMin, double yMin, double xMax, double yMax);
 
+    // Scale the device space by <sx> x <sy>, as if the state had been
+    // created for a resolution of <sx>*hDPI x <sy>*vDPI.
+    void scaleDeviceSpace(double sx, double sy);
+
     // Text position.
     void textMoveTo(double tx, double ty)
     {
@@ -427,6 +427,8 @@ GlobalParams::GlobalParams(const std::string &customPopplerDataDir) : popplerDat
     printCommands = false;
     profileCommands = false;
     errQuiet = false;
+    mapFiles = false;
+    jpxDecodeThreads = 1;
 
     cidToUnicodeCache = std::make_unique<CharCodeToUnicodeCache>(cidToUnicodeCacheSize);
     unicodeToUnicodeCache = std::make_unique<CharCodeToUnicodeCache>(unicodeToUnicodeCacheSize);
@@ -1440,6 +1442,24 @@ bool GlobalParams::getErrQuiet()
     return errQuiet;
 }
 
+std::string GlobalParams::getXRefIndexDir()
+{
+    globalParamsLocker();
+    return xrefIndexDir;
+}
+
+bool GlobalParams::getMapFiles()
+{
+    globalParamsLocker();
+    return mapFiles;
+}
+
+int GlobalParams::getJPXDecodeThreads()
+{
+    globalParamsLocker();
+    return jpxDecodeThreads;
+}
+
 std::shared_ptr<CharCodeToUnicode> GlobalParams::getCIDToUnicode(const GooString *collection)
 {
     std::shared_ptr<CharCodeToUnicode> ctu;
@@ -1527,6 +1547,24 @@ void GlobalParams::setErrQuiet(bool errQuietA)
     errQuiet = errQuietA;
 }
 
+void GlobalParams::setXRefIndexDir(const std::string &dir)
+{
+    globalParamsLocker();
+    xrefIndexDir = dir;
+}
+
+void GlobalParams::setMapFiles(bool mapFilesA)
+{
+    globalParamsLocker();
+    mapFiles = mapFilesA;
+}
+
+void GlobalParams::setJPXDecodeThreads(int threads)
+{
+    globalParamsLocker();
+    jpxDecodeThreads = threads;
+}
+
 #ifdef ANDROID
 void GlobalParams::setFontDir(const std::string &fontDir)
 {
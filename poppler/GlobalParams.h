@@ -147,6 +147,9 @@ public:
     bool getPrintCommands();
     bool getProfileCommands();
     bool getErrQuiet();
+    std::string getXRefIndexDir();
+    bool getMapFiles();
+    int getJPXDecodeThreads();
 
     std::shared_ptr<CharCodeToUnicode> getCIDToUnicode(const GooString *collection);
     const UnicodeMap *getUnicodeMap(const std::string &encodingName);
@@ -163,6 +166,18 @@ public:
     void setPrintCommands(bool printCommandsA);
     void setProfileCommands(bool profileCommandsA);
     void setErrQuiet(bool errQuietA);
+    // Directory where PDFDoc keeps xref indexes of the files it opens,
+    // so that reopening them doesn't have to parse the xref again.  An
+    // empty string (the default) disables the indexes.
+    void setXRefIndexDir(const std::string &dir);
+    // Read the files PDFDoc opens by name through a memory mapping
+    // instead of read().  Off by default: if such a file is truncated
+    // while it is open, accessing the lost pages raises SIGBUS.
+    void setMapFiles(bool mapFilesA);
+    // Number of threads the JPX decoder uses for each image, 0 for one
+    // per CPU core.  The default is 1, which suits callers that already
+    // render several pages or bands at once.
+    void setJPXDecodeThreads(int threads);
 #ifdef ANDROID
     static void setFontDir(const std::string &fontDir);
 #endif
@@ -212,6 +227,9 @@ private:
     bool printCommands; // print the drawing commands
     bool profileCommands; // profile the drawing commands
     bool errQuiet; // suppress error messages?
+    std::string xrefIndexDir; // directory for xref indexes, empty if disabled
+    bool mapFiles; // read files through a memory mapping?
+    int jpxDecodeThreads; // threads per JPX image, 0 for one per core
 
     std::unique_ptr<CharCodeToUnicodeCache> cidToUnicodeCache;
     std::unique_ptr<CharCodeToUnicodeCache> unicodeToUnicodeCache;
@@ -140,6 +140,7 @@ Hints::Hints(BaseStream *str, Linearization *linearization, XRef *xref, Security
         memset(pageObjectNum, 0, nPages * sizeof(int));
     }
 
+    nSharedGroups = 0;
     groupLength = nullptr;
     groupOffset = nullptr;
     groupHasSignature = nullptr;
@@ -392,7 +393,7 @@ bool Hints::readSharedObjectsTable(Stream *str)
 
     const unsigned int nSharedGroupsFirst = sbr.readBits(32);
 
-    const unsigned int nSharedGroups = sbr.readBits(32);
+    nSharedGroups = sbr.readBits(32);
 
     const unsigned int nBitsNumObjects = sbr.readBits(16);
 
@@ -402,14 +403,17 @@ bool Hints::readSharedObjectsTable(Stream *str)
 
     if ((!nSharedGroups) || (nSharedGroups >= INT_MAX / (int)sizeof(unsigned int))) {
         error(errSyntaxWarning, -1, "Invalid number of shared object groups");
+        nSharedGroups = 0;
         return false;
     }
     if ((!nSharedGroupsFirst) || (nSharedGroupsFirst > nSharedGroups)) {
         error(errSyntaxWarning, -1, "Invalid number of first page shared object groups");
+        nSharedGroups = 0;
         return false;
     }
     if (nBitsNumObjects > 32 || nBitsDiffGroupLength > 32) {
         error(errSyntaxWarning, -1, "Invalid shared object groups bit length");
+        nSharedGroups = 0;
         return false;
     }
 
@@ -420,6 +424,7 @@ bool Hints::readSharedObjectsTable(Stream *str)
     groupXRefOffset = (unsigned int *)gmallocn_checkoverflow(nSharedGroups, sizeof(unsigned int));
     if (!groupLength || !groupOffset || !groupHasSignature || !groupNumObjects || !groupXRefOffset) {
         error(errSyntaxWarning, -1, "Failed to allocate memory for shared object groups");
+        nSharedGroups = 0;
         return false;
     }
 
@@ -488,32 +493,48 @@ bool Hints::isOk() const
     return ok;
 }
 
-Goffset Hints::getPageOffset(int page)
+// The tables list the first page first, then the others in order.
+int Hints::getPageIndex(int page) const
 {
     if ((page < 1) || (page > nPages)) {
-        return 0;
+        return -1;
     }
 
     if (page - 1 > pageFirst) {
-        return pageOffset[page - 1];
+        return page - 1;
     } else if (page - 1 < pageFirst) {
-        return pageOffset[page];
+        return page;
     } else {
-        return pageOffset[0];
+        return 0;
     }
 }
 
+Goffset Hints::getPageOffset(int page)
+{
+    const int i = getPageIndex(page);
+    return i < 0 ? 0 : pageOffset[i];
+}
+
 int Hints::getPageObjectNum(int page)
 {
-    if ((page < 1) || (page > nPages)) {
-        return 0;
-    }
+    const int i = getPageIndex(page);
+    return i < 0 ? 0 : pageObjectNum[i];
+}
 
-    if (page - 1 > pageFirst) {
-        return pageObjectNum[page - 1];
-    } else if (page - 1 < pageFirst) {
-        return pageObjectNum[page];
-    } else {
-        return pageObjectNum[0];
+std::vector<ByteRange> Hints::getPageRanges(int page)
+{
+    std::vector<ByteRange> ranges;
+    const int i = getPageIndex(page);
+
+    if (!ok || i < 0) {
+        return ranges;
+    }
+    ranges.push_back({ (size_t)pageOffset[i], pageLength[i] });
+    for (unsigned int j = 0; j < numSharedObject[i]; j++) {
+        const unsigned int group = sharedObjectId[i][j];
+        if (group < nSharedGroups) {
+            ranges.push_back({ groupOffset[group], groupLength[group] });
+        }
     }
+    return ranges;
 }
@@ -40,7 +40,12 @@ public:
     int getPageObjectNum(int page);
     Goffset getPageOffset(int page);
 
+    // Byte ranges of the file holding the objects of <page>: its own
+    // section, and the shared object groups it uses.
+    std::vector<ByteRange> getPageRanges(int page);
+
 private:
+    int getPageIndex(int page) const;
     void readTables(BaseStream *str, Linearization *linearization, XRef *xref, SecurityHandler *secHdlr);
     bool readPageOffsetTable(Stream *str);
     bool readSharedObjectsTable(Stream *str);
@@ -79,6 +84,7 @@ private:
     unsigned int *numSharedObject;
     unsigned int **sharedObjectId;
 
+    unsigned int nSharedGroups;
     unsigned int *groupLength;
     unsigned int *groupOffset;
     unsigned int *groupHasSignature;
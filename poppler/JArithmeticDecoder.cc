@@ -172,7 +172,9 @@ void JArithmeticDecoder::cleanup()
     }
 }
 
-int JArithmeticDecoder::decodeBit(unsigned int context, JArithmeticDecoderStats *stats)
+// The general case of decodeBit(): the inline fast path handles an MPS
+// that doesn't need renormalization.
+int JArithmeticDecoder::decodeBitSlow(unsigned int context, JArithmeticDecoderStats *stats)
 {
     int bit;
     unsigned int qe;
@@ -236,6 +238,28 @@ int JArithmeticDecoder::decodeBit(unsigned int context, JArithmeticDecoderStats
     return bit;
 }
 
+int JArithmeticDecoder::decodeMPSRun(unsigned int context, JArithmeticDecoderStats *stats, int n)
+{
+    const unsigned int qe = qeTab[stats->cxTab[context] >> 1];
+
+    // the MPS path in decodeBit() doesn't touch the context state, and
+    // skips renormalization as long as a-qe stays above both c and
+    // 0x80000000
+    if (c == 0xffffffff) {
+        return 0;
+    }
+    const unsigned int limit = c >= 0x80000000 ? c + 1 : 0x80000000;
+    if (a < limit || n <= 0) {
+        return 0;
+    }
+    unsigned int m = (a - limit) / qe;
+    if (m > (unsigned int)n) {
+        m = n;
+    }
+    a -= m * qe;
+    return (int)m;
+}
+
 int JArithmeticDecoder::decodeByte(unsigned int context, JArithmeticDecoderStats *stats)
 {
     int byte;
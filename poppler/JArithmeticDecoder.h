@@ -45,6 +45,7 @@ public:
     int getContextSize() { return contextSize; }
     void copyFrom(JArithmeticDecoderStats *stats);
     void setEntry(unsigned int cx, int i, int mps);
+    int getMPS(unsigned int cx) const { return cxTab[cx] & 1; }
     bool isValid() const { return cxTab != nullptr; }
 
 private:
@@ -93,7 +94,22 @@ public:
     void cleanup();
 
     // Decode one bit.
-    int decodeBit(unsigned int context, JArithmeticDecoderStats *stats);
+    int decodeBit(unsigned int context, JArithmeticDecoderStats *stats)
+    {
+        // fast path: an MPS that doesn't need renormalization
+        const unsigned int aMPS = a - qeTab[stats->cxTab[context] >> 1];
+        if (c < aMPS && (aMPS & 0x80000000)) {
+            a = aMPS;
+            return stats->cxTab[context] & 1;
+        }
+        return decodeBitSlow(context, stats);
+    }
+
+    // Decode up to <n> bits in <context>, stopping at the first one that
+    // is not the MPS or needs renormalization.  Returns the number of
+    // bits decoded, all of which are the MPS.  This gives the same
+    // result as calling decodeBit() that many times.
+    int decodeMPSRun(unsigned int context, JArithmeticDecoderStats *stats, int n);
 
     // Decode eight bits.
     int decodeByte(unsigned int context, JArithmeticDecoderStats *stats);
@@ -108,6 +124,7 @@ public:
 
 private:
     unsigned int readByte();
+    int decodeBitSlow(unsigned int context, JArithmeticDecoderStats *stats);
     int decodeIntBit(JArithmeticDecoderStats *stats);
     void byteIn();
 
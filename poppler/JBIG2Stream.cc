@@ -38,6 +38,8 @@
 
 #include <config.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 
 #include <cstdlib>
@@ -54,6 +56,18 @@
 static const int contextSize[4] = { 16, 13, 10, 10 };
 static const int refContextSize[2] = { 13, 10 };
 
+static std::atomic<bool> fastDecoding(true);
+
+void jbig2SetFastDecoding(bool enabled)
+{
+    fastDecoding = enabled;
+}
+
+bool jbig2GetFastDecoding()
+{
+    return fastDecoding;
+}
+
 //------------------------------------------------------------------------
 // JBIG2HuffmanTable
 //------------------------------------------------------------------------
@@ -591,6 +605,7 @@ public:
     int getPixel(int x, int y) const { return (x < 0 || x >= w || y < 0 || y >= h) ? 0 : (data[y * line + (x >> 3)] >> (7 - (x & 7))) & 1; }
     void setPixel(int x, int y) { data[y * line + (x >> 3)] |= 1 << (7 - (x & 7)); }
     void clearPixel(int x, int y) { data[y * line + (x >> 3)] &= 0x7f7f >> (x & 7); }
+    void setPixels(int x0, int x1, int y);
     void getPixelPtr(int x, int y, JBIG2BitmapPtr *ptr);
     int nextPixel(JBIG2BitmapPtr *ptr);
     void duplicateRow(int yDest, int ySrc);
@@ -756,6 +771,25 @@ inline int JBIG2Bitmap::nextPixel(JBIG2BitmapPtr *ptr)
     return pix;
 }
 
+// Set pixels <x0> .. <x1>-1 of row <y>.
+void JBIG2Bitmap::setPixels(int x0, int x1, int y)
+{
+    if (x0 >= x1) {
+        return;
+    }
+    unsigned char *p = data + y * line + (x0 >> 3);
+    unsigned char *pLast = data + y * line + ((x1 - 1) >> 3);
+    const unsigned char mask0 = 0xff >> (x0 & 7);
+    const unsigned char mask1 = 0xff << (7 - ((x1 - 1) & 7));
+    if (p == pLast) {
+        *p |= mask0 & mask1;
+        return;
+    }
+    *p++ |= mask0;
+    memset(p, 0xff, pLast - p);
+    *pLast |= mask1;
+}
+
 void JBIG2Bitmap::duplicateRow(int yDest, int ySrc)
 {
     memcpy(data + yDest * line, data + ySrc * line, line);
@@ -1093,13 +1127,156 @@ JBIG2CodeTable::~JBIG2CodeTable()
     gfree(table);
 }
 
+//------------------------------------------------------------------------
+// JBIG2GlobalsCache
+//------------------------------------------------------------------------
+
+// default size limit, in bytes
+#define jbig2GlobalsCacheDefaultSize (64 * 1024 * 1024)
+
+// approximate bookkeeping cost of a segment on top of its data
+#define jbig2SegmentOverhead 64
+
+static size_t getStatsMemorySize(JArithmeticDecoderStats *stats)
+{
+    return stats ? (size_t)stats->getContextSize() : 0;
+}
+
+static size_t getBitmapMemorySize(JBIG2Bitmap *bitmap)
+{
+    return bitmap ? (size_t)bitmap->getDataSize() + jbig2SegmentOverhead : 0;
+}
+
+// Approximate memory used by a decoded segment.
+static size_t getSegmentMemorySize(JBIG2Segment *seg)
+{
+    size_t segSize = jbig2SegmentOverhead;
+    switch (seg->getType()) {
+    case jbig2SegBitmap:
+        segSize += ((JBIG2Bitmap *)seg)->getDataSize();
+        break;
+    case jbig2SegSymbolDict: {
+        JBIG2SymbolDict *symbolDict = (JBIG2SymbolDict *)seg;
+        for (unsigned int i = 0; i < symbolDict->getSize(); ++i) {
+            segSize += sizeof(JBIG2Bitmap *) + getBitmapMemorySize(symbolDict->getBitmap(i));
+        }
+        segSize += getStatsMemorySize(symbolDict->getGenericRegionStats());
+        segSize += getStatsMemorySize(symbolDict->getRefinementRegionStats());
+        break;
+    }
+    case jbig2SegPatternDict: {
+        JBIG2PatternDict *patternDict = (JBIG2PatternDict *)seg;
+        for (unsigned int i = 0; i < patternDict->getSize(); ++i) {
+            segSize += sizeof(JBIG2Bitmap *) + getBitmapMemorySize(patternDict->getBitmap(i));
+        }
+        break;
+    }
+    case jbig2SegCodeTable: {
+        const JBIG2HuffmanTable *table = ((JBIG2CodeTable *)seg)->getHuffTable();
+        int n = 0;
+        while (table && table[n].rangeLen != jbig2HuffmanEOT) {
+            ++n;
+        }
+        segSize += (size_t)(n + 1) * sizeof(JBIG2HuffmanTable);
+        break;
+    }
+    }
+    return segSize;
+}
+
+JBIG2GlobalsCache::JBIG2GlobalsCache() : size(0), maxSize(jbig2GlobalsCacheDefaultSize), hits(0), misses(0), evictions(0) { }
+
+JBIG2GlobalsCache::~JBIG2GlobalsCache() = default;
+
+// Must be called with the mutex locked.
+void JBIG2GlobalsCache::evict(size_t limit)
+{
+    while (size > limit && !lru.empty()) {
+        const Entry &entry = lru.back();
+        size -= entry.size;
+        index.erase(entry.ref);
+        lru.pop_back();
+        ++evictions;
+    }
+}
+
+void JBIG2GlobalsCache::setMaxSize(size_t maxSizeA)
+{
+    const std::scoped_lock locker(mutex);
+    maxSize = maxSizeA;
+    evict(maxSize);
+}
+
+size_t JBIG2GlobalsCache::getMaxSize() const
+{
+    const std::scoped_lock locker(mutex);
+    return maxSize;
+}
+
+std::shared_ptr<const JBIG2GlobalsCache::Segments> JBIG2GlobalsCache::lookup(Ref ref)
+{
+    const std::scoped_lock locker(mutex);
+    auto it = index.find(ref);
+    if (it == index.end()) {
+        ++misses;
+        return nullptr;
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    ++hits;
+    return it->second->segments;
+}
+
+std::shared_ptr<const JBIG2GlobalsCache::Segments> JBIG2GlobalsCache::insert(Ref ref, std::shared_ptr<const Segments> segments)
+{
+    size_t segmentsSize = 0;
+    for (const std::unique_ptr<JBIG2Segment> &seg : *segments) {
+        segmentsSize += getSegmentMemorySize(seg.get());
+    }
+
+    const std::scoped_lock locker(mutex);
+    auto it = index.find(ref);
+    if (it != index.end()) {
+        return it->second->segments;
+    }
+    if (segmentsSize <= maxSize) {
+        lru.push_front({ ref, segments, segmentsSize });
+        index.emplace(ref, lru.begin());
+        size += segmentsSize;
+        evict(maxSize);
+    }
+    return segments;
+}
+
+void JBIG2GlobalsCache::clear()
+{
+    const std::scoped_lock locker(mutex);
+    index.clear();
+    lru.clear();
+    size = 0;
+}
+
+JBIG2GlobalsCache::Stats JBIG2GlobalsCache::getStats() const
+{
+    const std::scoped_lock locker(mutex);
+    Stats stats;
+
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.size = size;
+    stats.globals = lru.size();
+    return stats;
+}
+
 //------------------------------------------------------------------------
 // JBIG2Stream
 //------------------------------------------------------------------------
 
-JBIG2Stream::JBIG2Stream(Stream *strA, Object &&globalsStreamA, Object *globalsStreamRefA) : FilterStream(strA)
+JBIG2Stream::JBIG2Stream(Stream *strA, Object &&globalsStreamA, Object *globalsStreamRefA, JBIG2GlobalsCache *globalsCacheA) : FilterStream(strA)
 {
     pageBitmap = nullptr;
+    globalsStreamRef = Ref::INVALID();
+    globalsCache = globalsCacheA;
 
     arithDecoder = new JArithmeticDecoder();
     genericRegionStats = new JArithmeticDecoderStats(1 << 1);
@@ -1160,20 +1337,33 @@ JBIG2Stream::~JBIG2Stream()
 bool JBIG2Stream::reset()
 {
     segments.resize(0);
-    globalSegments.resize(0);
+    globalSegments.reset();
+    discardedGlobalSegments.clear();
     bool innerReset = true;
 
-    // read the globals stream
+    // read the globals stream, unless another page decoded it already
     if (globalsStream.isStream()) {
-        curStr = globalsStream.getStream();
-        innerReset = innerReset && curStr->reset();
-        arithDecoder->setStream(curStr);
-        huffDecoder->setStream(curStr);
-        mmrDecoder->setStream(curStr);
-        readSegments();
-        curStr->close();
-        // swap the newly read segments list into globalSegments
-        std::swap(segments, globalSegments);
+        const bool cacheable = globalsCache && globalsStreamRef != Ref::INVALID();
+        if (cacheable) {
+            globalSegments = globalsCache->lookup(globalsStreamRef);
+        }
+        if (!globalSegments) {
+            curStr = globalsStream.getStream();
+            innerReset = innerReset && curStr->reset();
+            arithDecoder->setStream(curStr);
+            huffDecoder->setStream(curStr);
+            mmrDecoder->setStream(curStr);
+            readSegments();
+            curStr->close();
+            // move the newly read segments list into globalSegments
+            globalSegments = std::make_shared<const JBIG2GlobalsCache::Segments>(std::move(segments));
+            segments.clear();
+            // a globals stream that painted a page has side effects the
+            // cache can't replay
+            if (cacheable && innerReset && !pageBitmap) {
+                globalSegments = globalsCache->insert(globalsStreamRef, globalSegments);
+            }
+        }
     }
 
     // read the main stream
@@ -1201,7 +1391,8 @@ void JBIG2Stream::close()
         pageBitmap = nullptr;
     }
     segments.resize(0);
-    globalSegments.resize(0);
+    globalSegments.reset();
+    discardedGlobalSegments.clear();
     dataPtr = dataEnd = nullptr;
     FilterStream::close();
 }
@@ -2825,6 +3016,150 @@ inline void JBIG2Stream::mmrAddPixelsNeg(int a1, int blackPixels, int *codingLin
     }
 }
 
+// Returns true if the adaptive template pixels of a generic region are
+// at their nominal positions.
+static bool isNominalGenericAT(int templ, const int *atx, const int *aty)
+{
+    switch (templ) {
+    case 0:
+        return atx[0] == 3 && aty[0] == -1 && atx[1] == -3 && aty[1] == -1 && atx[2] == 2 && aty[2] == -2 && atx[3] == -2 && aty[3] == -2;
+    case 1:
+        return atx[0] == 3 && aty[0] == -1;
+    case 2:
+    case 3:
+        return atx[0] == 2 && aty[0] == -1;
+    }
+    return false;
+}
+
+// Returns the number of leading zero bytes in <p>[0 .. <n>-1].
+static int countZeroBytes(const unsigned char *p, int n)
+{
+    uint64_t word;
+    int i = 0;
+
+    while (i + 8 <= n) {
+        memcpy(&word, p + i, 8);
+        if (word) {
+            break;
+        }
+        i += 8;
+    }
+    while (i < n && !p[i]) {
+        ++i;
+    }
+    return i;
+}
+
+// Returns bytes <xb>-1 .. <xb>+1 of row <p> (which is <lineSize> bytes
+// long, or all zero if <p> is null), so that pixel x of byte <xb> is at
+// bit 15-(x&7).
+static inline unsigned int getGenericWindow(const unsigned char *p, int xb, int lineSize)
+{
+    if (!p) {
+        return 0;
+    }
+    return ((xb > 0 ? p[xb - 1] : 0) << 16) | (p[xb] << 8) | (xb + 1 < lineSize ? p[xb + 1] : 0);
+}
+
+// Decode row <y> of a generic region whose adaptive template pixels are
+// at their nominal positions, without a skip bitmap.  This builds the
+// same contexts as the general code in readGenericBitmap, but takes all
+// of the reference pixels from byte windows over the previous rows, at
+// fixed offsets.  Where the reference pixels are all white, every pixel
+// has context 0, so a run of white pixels is decoded in one step.
+template<int templ>
+static void readGenericNominalRow(JBIG2Bitmap *bitmap, int y, JArithmeticDecoder *arithDecoder, JArithmeticDecoderStats *stats)
+{
+    // the pixels to the left in row y used by the context
+    const unsigned int line2Mask = templ == 1 ? 0x07 : templ == 2 ? 0x03 : 0x0f;
+    const int w = bitmap->getWidth();
+    const int lineSize = bitmap->getLineSize();
+    unsigned char *p2 = bitmap->getDataPtr() + y * lineSize;
+    const unsigned char *p1 = y >= 1 ? p2 - lineSize : nullptr;
+    const unsigned char *p0 = templ != 3 && y >= 2 ? p1 - lineSize : nullptr;
+
+    // windows over rows y-2 and y-1
+    unsigned int line0 = getGenericWindow(p0, 0, lineSize);
+    unsigned int line1 = getGenericWindow(p1, 0, lineSize);
+    // the pixels decoded so far in row y, the last one in bit 0
+    unsigned int line2 = 0;
+
+    int xb = 0;
+    while (xb < lineSize) {
+        int k = 0;
+
+        // skip a white run: the row was cleared, so there is nothing to write
+        if (!(line0 | line1) && !(line2 & line2Mask) && !stats->getMPS(0)) {
+            // the windows of bytes xb .. xb+nBytes-1 are all zero
+            const int avail = lineSize - xb - 2;
+            int nZero = avail;
+            if (avail > 0) {
+                if (p0) {
+                    nZero = countZeroBytes(p0 + xb + 2, avail);
+                }
+                if (p1 && nZero > 0) {
+                    nZero = countZeroBytes(p1 + xb + 2, nZero);
+                }
+            }
+            const int nBytes = nZero == avail ? lineSize - xb : nZero + 1;
+            const int nPixels = nBytes * 8 < w - xb * 8 ? nBytes * 8 : w - xb * 8;
+            const int run = arithDecoder->decodeMPSRun(0, stats, nPixels);
+            if (run >= 8) {
+                xb += run >> 3;
+                if (xb >= lineSize) {
+                    break;
+                }
+                line0 = getGenericWindow(p0, xb, lineSize);
+                line1 = getGenericWindow(p1, xb, lineSize);
+            }
+            k = run & 7;
+        }
+
+        const int n = w - (xb << 3) < 8 ? w - (xb << 3) : 8;
+        unsigned int byte = 0;
+        for (; k < n; ++k) {
+            const int s = 15 - k;
+            unsigned int cx, r0, r1;
+            switch (templ) {
+            case 0:
+                r0 = line0 >> (s - 2); // x+2 (bit 0) .. x-2 (bit 4)
+                r1 = line1 >> (s - 3); // x+3 (bit 0) .. x-3 (bit 6)
+                cx = (((r0 >> 1) & 0x07) << 13) | (((r1 >> 1) & 0x1f) << 8) | ((line2 & 0x0f) << 4) | ((r1 & 1) << 3) | (((r1 >> 6) & 1) << 2) | ((r0 & 1) << 1) | ((r0 >> 4) & 1);
+                break;
+            case 1:
+                r0 = line0 >> (s - 2); // x+2 (bit 0) .. x-1 (bit 3)
+                r1 = line1 >> (s - 3); // x+3 (bit 0) .. x-2 (bit 5)
+                cx = ((r0 & 0x0f) << 9) | (((r1 >> 1) & 0x1f) << 4) | ((line2 & 0x07) << 1) | (r1 & 1);
+                break;
+            case 2:
+                r0 = line0 >> (s - 1); // x+1 (bit 0) .. x-1 (bit 2)
+                r1 = line1 >> (s - 2); // x+2 (bit 0) .. x-2 (bit 4)
+                cx = ((r0 & 0x07) << 7) | (((r1 >> 1) & 0x0f) << 3) | ((line2 & 0x03) << 1) | (r1 & 1);
+                break;
+            default:
+                r1 = line1 >> (s - 2); // x+2 (bit 0) .. x-3 (bit 5)
+                cx = (((r1 >> 1) & 0x1f) << 5) | ((line2 & 0x0f) << 1) | (r1 & 1);
+                break;
+            }
+            const unsigned int pix = arithDecoder->decodeBit(cx, stats);
+            line2 = (line2 << 1) | pix;
+            byte |= pix << (7 - k);
+        }
+        p2[xb] = (unsigned char)byte;
+
+        // slide the windows along by one byte
+        ++xb;
+        const bool more = xb + 1 < lineSize;
+        if (p0) {
+            line0 = ((line0 << 8) | (more ? p0[xb + 1] : 0)) & 0xffffff;
+        }
+        if (p1) {
+            line1 = ((line1 << 8) | (more ? p1[xb + 1] : 0)) & 0xffffff;
+        }
+    }
+}
+
 std::unique_ptr<JBIG2Bitmap> JBIG2Stream::readGenericBitmap(bool mmr, int w, int h, int templ, bool tpgdOn, bool useSkip, JBIG2Bitmap *skip, int *atx, int *aty, int mmrDataLength)
 {
     bool ltp;
@@ -2838,6 +3173,7 @@ std::unique_ptr<JBIG2Bitmap> JBIG2Stream::readGenericBitmap(bool mmr, int w, int
     int atShift0, atShift1, atShift2, atShift3;
     unsigned char mask;
     int x, y, x0, x1, a0i, b1i, blackPixels, pix, i;
+    const bool fast = fastDecoding;
 
     auto bitmap = std::make_unique<JBIG2Bitmap>(0, w, h);
     if (!bitmap->isOk()) {
@@ -3041,8 +3377,12 @@ std::unique_ptr<JBIG2Bitmap> JBIG2Stream::readGenericBitmap(bool mmr, int w, int
             // convert the run lengths to a bitmap line
             i = 0;
             while (true) {
-                for (x = codingLine[i]; x < codingLine[i + 1]; ++x) {
-                    bitmap->setPixel(x, y);
+                if (fast) {
+                    bitmap->setPixels(codingLine[i], codingLine[i + 1], y);
+                } else {
+                    for (x = codingLine[i]; x < codingLine[i + 1]; ++x) {
+                        bitmap->setPixel(x, y);
+                    }
                 }
                 if (codingLine[i + 1] >= w || codingLine[i + 2] >= w) {
                     break;
@@ -3084,6 +3424,9 @@ std::unique_ptr<JBIG2Bitmap> JBIG2Stream::readGenericBitmap(bool mmr, int w, int
             }
         }
 
+        // the common case gets a faster row decoder
+        const bool nominalAT = fast && !useSkip && isNominalGenericAT(templ, atx, aty);
+
         ltp = false;
         cx = cx0 = cx1 = cx2 = 0; // make gcc happy
         for (y = 0; y < h; ++y) {
@@ -3101,6 +3444,24 @@ std::unique_ptr<JBIG2Bitmap> JBIG2Stream::readGenericBitmap(bool mmr, int w, int
                 }
             }
 
+            if (nominalAT) {
+                switch (templ) {
+                case 0:
+                    readGenericNominalRow<0>(bitmap.get(), y, arithDecoder, genericRegionStats);
+                    break;
+                case 1:
+                    readGenericNominalRow<1>(bitmap.get(), y, arithDecoder, genericRegionStats);
+                    break;
+                case 2:
+                    readGenericNominalRow<2>(bitmap.get(), y, arithDecoder, genericRegionStats);
+                    break;
+                case 3:
+                    readGenericNominalRow<3>(bitmap.get(), y, arithDecoder, genericRegionStats);
+                    break;
+                }
+                continue;
+            }
+
             switch (templ) {
             case 0:
 
@@ -3999,9 +4360,11 @@ void JBIG2Stream::readExtensionSeg(unsigned int length)
 
 JBIG2Segment *JBIG2Stream::findSegment(unsigned int segNum)
 {
-    for (std::unique_ptr<JBIG2Segment> &seg : globalSegments) {
-        if (seg->getSegNum() == segNum) {
-            return seg.get();
+    if (globalSegments && std::find(discardedGlobalSegments.begin(), discardedGlobalSegments.end(), segNum) == discardedGlobalSegments.end()) {
+        for (const std::unique_ptr<JBIG2Segment> &seg : *globalSegments) {
+            if (seg->getSegNum() == segNum) {
+                return seg.get();
+            }
         }
     }
     for (std::unique_ptr<JBIG2Segment> &seg : segments) {
@@ -4014,10 +4377,14 @@ JBIG2Segment *JBIG2Stream::findSegment(unsigned int segNum)
 
 void JBIG2Stream::discardSegment(unsigned int segNum)
 {
-    for (auto it = globalSegments.begin(); it != globalSegments.end(); ++it) {
-        if ((*it)->getSegNum() == segNum) {
-            globalSegments.erase(it);
-            return;
+    // global segments may be shared with other streams, only hide them
+    // from this one
+    if (globalSegments && std::find(discardedGlobalSegments.begin(), discardedGlobalSegments.end(), segNum) == discardedGlobalSegments.end()) {
+        for (const std::unique_ptr<JBIG2Segment> &seg : *globalSegments) {
+            if (seg->getSegNum() == segNum) {
+                discardedGlobalSegments.push_back(segNum);
+                return;
+            }
         }
     }
     for (auto it = segments.begin(); it != segments.end(); ++it) {
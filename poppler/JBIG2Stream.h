@@ -31,8 +31,16 @@
 #ifndef JBIG2STREAM_H
 #define JBIG2STREAM_H
 
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 #include "Object.h"
 #include "Stream.h"
+#include "poppler_private_export.h"
 
 class JBIG2Segment;
 class JBIG2Bitmap;
@@ -43,11 +51,91 @@ struct JBIG2HuffmanTable;
 class JBIG2MMRDecoder;
 
 //------------------------------------------------------------------------
+// JBIG2GlobalsCache
+//------------------------------------------------------------------------
+
+// A per-document cache of decoded JBIG2Globals streams.  Scanned books
+// often share one large symbol dictionary between all their pages, which
+// is then only decoded once instead of once per page.
+//
+// The decoded segments are shared read-only between JBIG2Streams, also
+// from several threads.  The least recently used globals are dropped once
+// the cache is over its size limit; streams still using them keep them
+// alive.
+class POPPLER_PRIVATE_EXPORT JBIG2GlobalsCache
+{
+public:
+    using Segments = std::vector<std::unique_ptr<JBIG2Segment>>;
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t size; // approximate bytes currently used
+        size_t globals; // number of cached globals streams
+    };
+
+    JBIG2GlobalsCache();
+    ~JBIG2GlobalsCache();
+
+    JBIG2GlobalsCache(const JBIG2GlobalsCache &) = delete;
+    JBIG2GlobalsCache &operator=(const JBIG2GlobalsCache &) = delete;
+
+    // Set the size limit in bytes; 0 disables the cache.
+    void setMaxSize(size_t maxSizeA);
+    size_t getMaxSize() const;
+
+    // Return the decoded segments of the globals stream <ref>, or nullptr
+    // if they are not cached.
+    std::shared_ptr<const Segments> lookup(Ref ref);
+
+    // Add the decoded segments of the globals stream <ref>.  If another
+    // thread added them meanwhile, its segments are returned instead.
+    std::shared_ptr<const Segments> insert(Ref ref, std::shared_ptr<const Segments> segments);
+
+    // Remove all globals.  The counters are kept.
+    void clear();
+
+    Stats getStats() const;
+
+private:
+    struct Entry
+    {
+        Ref ref;
+        std::shared_ptr<const Segments> segments;
+        size_t size;
+    };
+
+    void evict(size_t limit);
+
+    mutable std::mutex mutex;
+    std::list<Entry> lru; // most recently used first
+    std::unordered_map<Ref, std::list<Entry>::iterator> index;
+    size_t size;
+    size_t maxSize;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+//------------------------------------------------------------------------
+// JBIG2Stream
+//------------------------------------------------------------------------
+
+// Select whether generic regions with nominal adaptive template pixels
+// and MMR rows are decoded by the specialized row decoders (the
+// default), or by the general code.  Both give the same bitmaps; this
+// is for comparing them in tests and benchmarks.
+POPPLER_PRIVATE_EXPORT void jbig2SetFastDecoding(bool enabled);
+POPPLER_PRIVATE_EXPORT bool jbig2GetFastDecoding();
 
 class JBIG2Stream : public FilterStream
 {
 public:
-    JBIG2Stream(Stream *strA, Object &&globalsStreamA, Object *globalsStreamRefA);
+    // <globalsCacheA>, if not nullptr, is where the decoded
+    // <globalsStreamA> is looked up and stored.
+    JBIG2Stream(Stream *strA, Object &&globalsStreamA, Object *globalsStreamRefA, JBIG2GlobalsCache *globalsCacheA = nullptr);
     ~JBIG2Stream() override;
     StreamKind getKind() const override { return strJBIG2; }
     [[nodiscard]] bool reset() override;
@@ -97,12 +185,14 @@ private:
 
     Object globalsStream;
     Ref globalsStreamRef;
+    JBIG2GlobalsCache *globalsCache;
     unsigned int pageW, pageH, curPageH;
     unsigned int pageDefPixel;
     JBIG2Bitmap *pageBitmap;
     unsigned int defCombOp;
     std::vector<std::unique_ptr<JBIG2Segment>> segments;
-    std::vector<std::unique_ptr<JBIG2Segment>> globalSegments;
+    std::shared_ptr<const JBIG2GlobalsCache::Segments> globalSegments;
+    std::vector<unsigned int> discardedGlobalSegments; // global segments this stream no longer sees
     Stream *curStr;
     unsigned char *dataPtr;
     unsigned char *dataEnd;
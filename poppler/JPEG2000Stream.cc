@@ -20,8 +20,15 @@
 
 #include "config.h"
 #include "JPEG2000Stream.h"
+#include "GlobalParams.h"
 #include <openjpeg.h>
 
+#include <algorithm>
+#include <climits>
+
+// never skip more resolution levels than this, even for tiny thumbnails
+#define jpxMaxReduction 5
+
 struct JPXStreamPrivate
 {
     opj_image_t *image = nullptr;
@@ -30,7 +37,26 @@ struct JPXStreamPrivate
     int npixels = 0;
     int ncomps = 0;
     bool inited = false;
+
+    // codestream, read ahead of init() when the header is needed early
+    std::vector<unsigned char> buf;
+
+    // main header information, see readHeader()
+    bool headerRead = false;
+    bool headerOk = false;
+    int headerWidth = 0;
+    int headerHeight = 0;
+    int headerNumComps = 0;
+    OPJ_COLOR_SPACE headerColorSpace = OPJ_CLRSPC_UNKNOWN;
+    int maxReduction = 0;
+
+    // what setReducedDecoding() and setDecodeArea() asked for
+    int reduction = 0;
+    bool hasDecodeArea = false;
+    int areaX0 = 0, areaY0 = 0, areaX1 = 0, areaY1 = 0;
+
     void init2(OPJ_CODEC_FORMAT format, const unsigned char *buf, int length, bool indexed);
+    void readHeader(const unsigned char *buf, int length);
 };
 
 static inline unsigned char adjustComp(int r, int adjust, int depth, int sgndcorr, bool indexed)
@@ -150,26 +176,36 @@ bool JPXStream::isBinary(bool last) const
 
 void JPXStream::getImageParams(int *bitsPerComponent, StreamColorSpaceMode *csMode, bool *hasAlpha)
 {
-    if (unlikely(priv->inited == false)) {
-        init();
+    int numComps = 1;
+    OPJ_COLOR_SPACE colorSpace = OPJ_CLRSPC_UNKNOWN;
+    if (unlikely(priv->inited == false) && canUseHeaderParams()) {
+        // the caller only needs to know whether there's an alpha channel,
+        // keep the decoding for when the resolution needed is known
+        numComps = priv->headerNumComps;
+        colorSpace = priv->headerColorSpace;
+    } else {
+        if (unlikely(priv->inited == false)) {
+            init();
+        }
+        if (priv->image) {
+            numComps = priv->image->numcomps;
+            colorSpace = priv->image->color_space;
+        }
     }
 
     *bitsPerComponent = 8;
     *hasAlpha = false;
-    int numComps = (priv->image) ? priv->image->numcomps : 1;
-    if (priv->image) {
-        if (priv->image->color_space == OPJ_CLRSPC_SRGB && numComps == 4) {
-            numComps = 3;
-            *hasAlpha = true;
-        } else if (priv->image->color_space == OPJ_CLRSPC_SYCC && numComps == 4) {
-            numComps = 3;
-            *hasAlpha = true;
-        } else if (numComps == 2) {
-            numComps = 1;
-        } else if (numComps > 4) {
-            *hasAlpha = true;
-            numComps = 4;
-        }
+    if (colorSpace == OPJ_CLRSPC_SRGB && numComps == 4) {
+        numComps = 3;
+        *hasAlpha = true;
+    } else if (colorSpace == OPJ_CLRSPC_SYCC && numComps == 4) {
+        numComps = 3;
+        *hasAlpha = true;
+    } else if (numComps == 2) {
+        numComps = 1;
+    } else if (numComps > 4) {
+        *hasAlpha = true;
+        numComps = 4;
     }
     if (numComps == 3) {
         *csMode = streamCSDeviceRGB;
@@ -190,6 +226,8 @@ static void libopenjpeg_warning_callback(const char *msg, void * /*client_data*/
     error(errSyntaxWarning, -1, "{0:s}", msg);
 }
 
+static void libopenjpeg_quiet_callback(const char * /*msg*/, void * /*client_data*/) { }
+
 typedef struct JPXData_s
 {
     const unsigned char *data;
@@ -235,19 +273,91 @@ static OPJ_BOOL jpxSeek_callback(OPJ_OFF_T seek_pos, void *p_user_data)
     return OPJ_TRUE;
 }
 
-void JPXStream::init()
+void JPXStream::readCodestream()
 {
-    Object oLen, cspace, smaskInDataObj;
+    Object oLen;
     if (getDict()) {
         oLen = getDict()->lookup("Length");
-        cspace = getDict()->lookup("ColorSpace");
-        smaskInDataObj = getDict()->lookup("SMaskInData");
     }
 
     int bufSize = BUFFER_INITIAL_SIZE;
     if (oLen.isInt() && oLen.getInt() > 0) {
         bufSize = oLen.getInt();
     }
+    priv->buf = str->toUnsignedChars(bufSize);
+}
+
+// With an explicit colour space and no SMaskInData, getImageParams()
+// only decides whether the image has an alpha channel, which the main
+// header already tells.  Without a colour space, a palette expanded by
+// the decoder changes the number of components, so decode first.
+bool JPXStream::canUseHeaderParams()
+{
+    if (!getDict()) {
+        return false;
+    }
+    Object cspace = getDict()->lookup("ColorSpace");
+    if (cspace.isNull()) {
+        cspace = getDict()->lookup("CS");
+    }
+    const Object smaskInData = getDict()->lookup("SMaskInData");
+    if (cspace.isNull() || (smaskInData.isInt() && smaskInData.getInt() != 0)) {
+        return false;
+    }
+    return readHeader();
+}
+
+bool JPXStream::readHeader()
+{
+    if (!priv->headerRead) {
+        if (priv->buf.empty()) {
+            readCodestream();
+        }
+        priv->readHeader(priv->buf.data(), priv->buf.size());
+        priv->headerRead = true;
+    }
+    return priv->headerOk;
+}
+
+int JPXStream::setReducedDecoding(int width, int height, int targetWidth, int targetHeight)
+{
+    int reduction = 0;
+    if (readHeader() && width == priv->headerWidth && height == priv->headerHeight) {
+        reduction = getImageReduction(width, height, targetWidth, targetHeight, priv->maxReduction);
+    }
+    if (reduction != priv->reduction) {
+        priv->reduction = reduction;
+        // decode again if the image was already decoded differently
+        close();
+        priv->inited = false;
+    }
+    return reduction;
+}
+
+bool JPXStream::setDecodeArea(int x0, int y0, int x1, int y1)
+{
+    if (!readHeader() || x0 < 0 || y0 < 0 || x1 > priv->headerWidth || y1 > priv->headerHeight || x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+    if (!priv->hasDecodeArea || x0 != priv->areaX0 || y0 != priv->areaY0 || x1 != priv->areaX1 || y1 != priv->areaY1) {
+        priv->hasDecodeArea = true;
+        priv->areaX0 = x0;
+        priv->areaY0 = y0;
+        priv->areaX1 = x1;
+        priv->areaY1 = y1;
+        close();
+        priv->inited = false;
+    }
+    return true;
+}
+
+void JPXStream::init()
+{
+    Object cspace, smaskInDataObj;
+    if (getDict()) {
+        cspace = getDict()->lookup("ColorSpace");
+        smaskInDataObj = getDict()->lookup("SMaskInData");
+    }
 
     bool indexed = false;
     if (cspace.isArray() && cspace.arrayGetLength() > 0) {
@@ -258,8 +368,31 @@ void JPXStream::init()
     }
 
     const int smaskInData = smaskInDataObj.isInt() ? smaskInDataObj.getInt() : 0;
-    const std::vector<unsigned char> buf = str->toUnsignedChars(bufSize);
-    priv->init2(OPJ_CODEC_JP2, buf.data(), buf.size(), indexed);
+    if (priv->buf.empty()) {
+        readCodestream();
+    }
+    priv->init2(OPJ_CODEC_JP2, priv->buf.data(), priv->buf.size(), indexed);
+    // the decoded samples are all that is needed from now on, unless
+    // the caller asks for another resolution or area
+    if (priv->image) {
+        priv->buf = {};
+    }
+
+    if (priv->image && (priv->reduction > 0 || priv->hasDecodeArea)) {
+        // the caller sized the image from what was asked for, don't
+        // hand it samples of a different size
+        const int scale = 1 << priv->reduction;
+        const int x0 = priv->hasDecodeArea ? priv->areaX0 : 0;
+        const int y0 = priv->hasDecodeArea ? priv->areaY0 : 0;
+        const int x1 = priv->hasDecodeArea ? priv->areaX1 : priv->headerWidth;
+        const int y1 = priv->hasDecodeArea ? priv->areaY1 : priv->headerHeight;
+        const int expectedWidth = (x1 + scale - 1) / scale - (x0 + scale - 1) / scale;
+        const int expectedHeight = (y1 + scale - 1) / scale - (y0 + scale - 1) / scale;
+        if ((int)priv->image->comps[0].w != expectedWidth || (int)priv->image->comps[0].h != expectedHeight) {
+            error(errSyntaxWarning, -1, "JPX image decoded at {0:d}x{1:d} instead of {2:d}x{3:d}", (int)priv->image->comps[0].w, (int)priv->image->comps[0].h, expectedWidth, expectedHeight);
+            close();
+        }
+    }
 
     if (priv->image) {
         int numComps = priv->image->numcomps;
@@ -319,6 +452,78 @@ void JPXStream::init()
     priv->inited = true;
 }
 
+static opj_stream_t *createJPXStream(JPXData *jpxData)
+{
+    opj_stream_t *stream = opj_stream_default_create(OPJ_TRUE);
+
+    opj_stream_set_user_data(stream, jpxData, nullptr);
+
+    opj_stream_set_read_function(stream, jpxRead_callback);
+    opj_stream_set_skip_function(stream, jpxSkip_callback);
+    opj_stream_set_seek_function(stream, jpxSeek_callback);
+    /* Set the length to avoid an assert */
+    opj_stream_set_user_data_length(stream, jpxData->size);
+    return stream;
+}
+
+// Read only the main header, to find out the image size and how many
+// resolution levels can be skipped.  Reduced and partial decoding are
+// only offered for images whose reference grid starts at 0 and whose
+// components are not subsampled, so that the decoded size follows from
+// the image size alone.
+void JPXStreamPrivate::readHeader(const unsigned char *buf, int length)
+{
+    headerOk = false;
+    for (OPJ_CODEC_FORMAT format : { OPJ_CODEC_JP2, OPJ_CODEC_J2K }) {
+        JPXData jpxData;
+        jpxData.data = buf;
+        jpxData.pos = 0;
+        jpxData.size = length;
+        opj_stream_t *stream = createJPXStream(&jpxData);
+        opj_image_t *headerImage = nullptr;
+
+        opj_codec_t *decoder = opj_create_decompress(format);
+        if (decoder != nullptr) {
+            /* Errors are reported by the real decoding */
+            opj_set_warning_handler(decoder, libopenjpeg_quiet_callback, nullptr);
+            opj_set_error_handler(decoder, libopenjpeg_quiet_callback, nullptr);
+            opj_dparameters_t parameters;
+            opj_set_default_decoder_parameters(&parameters);
+            if (opj_setup_decoder(decoder, &parameters) && opj_read_header(stream, decoder, &headerImage)) {
+                bool simpleGrid = headerImage->x0 == 0 && headerImage->y0 == 0 && headerImage->numcomps > 0;
+                for (OPJ_UINT32 i = 0; simpleGrid && i < headerImage->numcomps; ++i) {
+                    simpleGrid = headerImage->comps[i].dx == 1 && headerImage->comps[i].dy == 1;
+                }
+                opj_codestream_info_v2_t *info = opj_get_cstr_info(decoder);
+                if (simpleGrid && info != nullptr && info->m_default_tile_info.tccp_info != nullptr && headerImage->x1 <= INT_MAX && headerImage->y1 <= INT_MAX) {
+                    OPJ_UINT32 numResolutions = info->m_default_tile_info.tccp_info[0].numresolutions;
+                    for (OPJ_UINT32 i = 1; i < info->nbcomps; ++i) {
+                        numResolutions = std::min(numResolutions, info->m_default_tile_info.tccp_info[i].numresolutions);
+                    }
+                    headerOk = numResolutions > 0;
+                    headerWidth = headerImage->x1;
+                    headerHeight = headerImage->y1;
+                    headerNumComps = headerImage->numcomps;
+                    headerColorSpace = headerImage->color_space;
+                    maxReduction = std::min((int)numResolutions - 1, jpxMaxReduction);
+                }
+                if (info != nullptr) {
+                    opj_destroy_cstr_info(&info);
+                }
+            }
+            opj_destroy_codec(decoder);
+        }
+        if (headerImage != nullptr) {
+            opj_image_destroy(headerImage);
+        }
+        opj_stream_destroy(stream);
+
+        if (headerOk) {
+            break;
+        }
+    }
+}
+
 void JPXStreamPrivate::init2(OPJ_CODEC_FORMAT format, const unsigned char *buf, int length, bool indexed)
 {
     JPXData jpxData;
@@ -327,17 +532,7 @@ void JPXStreamPrivate::init2(OPJ_CODEC_FORMAT format, const unsigned char *buf,
     jpxData.pos = 0;
     jpxData.size = length;
 
-    opj_stream_t *stream;
-
-    stream = opj_stream_default_create(OPJ_TRUE);
-
-    opj_stream_set_user_data(stream, &jpxData, nullptr);
-
-    opj_stream_set_read_function(stream, jpxRead_callback);
-    opj_stream_set_skip_function(stream, jpxSkip_callback);
-    opj_stream_set_seek_function(stream, jpxSeek_callback);
-    /* Set the length to avoid an assert */
-    opj_stream_set_user_data_length(stream, length);
+    opj_stream_t *stream = createJPXStream(&jpxData);
 
     opj_codec_t *decoder;
 
@@ -347,6 +542,8 @@ void JPXStreamPrivate::init2(OPJ_CODEC_FORMAT format, const unsigned char *buf,
     if (indexed) {
         parameters.flags |= OPJ_DPARAMETERS_IGNORE_PCLR_CMAP_CDEF_FLAG;
     }
+    /* Skip the resolution levels that are too fine to be seen */
+    parameters.cp_reduce = reduction;
 
     /* Get the decoder handle of the format */
     decoder = opj_create_decompress(format);
@@ -365,6 +562,19 @@ void JPXStreamPrivate::init2(OPJ_CODEC_FORMAT format, const unsigned char *buf,
         goto error;
     }
 
+#if defined(OPJ_VERSION_MAJOR) && (OPJ_VERSION_MAJOR > 2 || (OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 3))
+    /* Decode code blocks on as many threads as asked for */
+    if (globalParams && opj_has_thread_support()) {
+        int threads = globalParams->getJPXDecodeThreads();
+        if (threads <= 0) {
+            threads = opj_get_num_cpus();
+        }
+        if (threads > 1) {
+            opj_codec_set_threads(decoder, threads);
+        }
+    }
+#endif
+
     /* Decode the stream and fill the image structure */
     image = nullptr;
     if (!opj_read_header(stream, decoder, &image)) {
@@ -372,7 +582,13 @@ void JPXStreamPrivate::init2(OPJ_CODEC_FORMAT format, const unsigned char *buf,
         goto error;
     }
 
-    /* Optional if you want decode the entire image */
+    /* Decode the visible area only if asked to, else the entire image */
+    if (hasDecodeArea) {
+        parameters.DA_x0 = areaX0;
+        parameters.DA_y0 = areaY0;
+        parameters.DA_x1 = areaX1;
+        parameters.DA_y1 = areaY1;
+    }
     if (!opj_set_decode_area(decoder, image, parameters.DA_x0, parameters.DA_y0, parameters.DA_x1, parameters.DA_y1)) {
         error(errSyntaxWarning, -1, "X2");
         goto error;
@@ -42,6 +42,8 @@ public:
     std::optional<std::string> getPSFilter(int psLevel, const char *indent) override;
     bool isBinary(bool last = true) const override;
     void getImageParams(int *bitsPerComponent, StreamColorSpaceMode *csMode, bool *hasAlpha) override;
+    int setReducedDecoding(int width, int height, int targetWidth, int targetHeight) override;
+    bool setDecodeArea(int x0, int y0, int x1, int y1) override;
 
     // Whether this JPX Stream should handle transparency (usually set when OutputDev also supports it)
     void setSupportJPXtransparency(bool val) { handleJPXtransparency = val; }
@@ -56,6 +58,9 @@ private:
     bool handleJPXtransparency;
 
     void init();
+    void readCodestream();
+    bool readHeader();
+    bool canUseHeaderParams();
     bool hasGetChars() override { return true; }
     int getChars(int nChars, unsigned char *buffer) override;
 };
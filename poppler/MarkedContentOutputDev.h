@@ -79,6 +79,7 @@ public:
     bool useDrawChar() override { return true; }
     bool interpretType3Chars() override { return false; }
     bool needNonText() override { return false; }
+    bool needPaths() override { return false; }
     bool needCharCount() override { return false; }
 
     void startPage(int pageNum, GfxState *state, XRef *xref) override;
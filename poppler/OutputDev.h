@@ -104,6 +104,10 @@ public:
     // Does this device need non-text content?
     virtual bool needNonText() { return true; }
 
+    // Does this device need the paths that are stroked, filled and
+    // clipped?  If not, Gfx doesn't even build them.
+    virtual bool needPaths() { return true; }
+
     // Does this device require incCharCount to be called for text on
     // non-shown layers?
     virtual bool needCharCount() { return false; }
@@ -69,6 +69,7 @@
 
 #include <array>
 #include <cctype>
+#include <cstdarg>
 #include <clocale>
 #include <cstdio>
 #include <cerrno>
@@ -77,7 +78,9 @@
 #include <cstddef>
 #include <cstring>
 #include <ctime>
+#include <filesystem>
 #include <iomanip>
+#include <random>
 #include <regex>
 #include <sstream>
 #include <sys/stat.h>
@@ -130,12 +133,151 @@ struct FILECloser
     1024 // read this many bytes at end of file
          //   to look for 'startxref'
 
+#define linearizedPageObjectSize 1024 // prefetch this many bytes for
+                                      //   each page object of a
+                                      //   linearized file
+
+#define objectStreamMaxObjects 100 // objects per written object stream
+
+#define deflateStreamMinSize 64 // don't compress smaller streams, their
+                                //   /Filter entry costs more than it saves
+
+#define xrefIndexMagic "PopplerXRefIndex"
+#define xrefIndexVersion 1
+#define xrefIndexTailSize 4096 // hash this many bytes at end of file
+                               //   into the xref index key
+
 //------------------------------------------------------------------------
 // PDFDoc
 //------------------------------------------------------------------------
 
 #define pdfdocLocker() const std::scoped_lock locker(mutex)
 
+// If enabled with GlobalParams::setMapFiles(), regular files are read
+// through a memory mapping, which saves a copy and a read() per buffer
+// refill.
+static BaseStream *createFileStream(GooFile *file)
+{
+    if (globalParams && globalParams->getMapFiles() && file->map()) {
+        return new MappedFileStream(file, 0, false, file->mappedSize(), Object::null());
+    }
+    return new FileStream(file, 0, false, file->size(), Object::null());
+}
+
+//------------------------------------------------------------------------
+// xref index
+//------------------------------------------------------------------------
+
+// Identifies the version of a file an xref index was written for.  The
+// tail of the file holds the trailer and startxref, which change with
+// every incremental update.
+struct XRefIndexKey
+{
+    Goffset fileSize;
+    long long modTime;
+    unsigned long long tailHash;
+
+    bool operator==(const XRefIndexKey &other) const { return fileSize == other.fileSize && modTime == other.modTime && tailHash == other.tailHash; }
+};
+
+// FNV-1a hash
+static unsigned long long hashXRefIndexBytes(const char *p, size_t len, unsigned long long h = 0xcbf29ce484222325ULL)
+{
+    for (size_t i = 0; i < len; ++i) {
+        h = (h ^ (unsigned char)p[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Returns the path of the xref index for <fileName> and fills in <key>,
+// or returns an empty string if xref indexes are disabled or the file
+// can't be indexed.
+static std::string getXRefIndexPath(const GooString *fileName, GooFile *file, XRefIndexKey *key)
+{
+    if (!globalParams || !fileName || !file) {
+        return {};
+    }
+    const std::string dir = globalParams->getXRefIndexDir();
+    if (dir.empty()) {
+        return {};
+    }
+
+    std::error_code ec;
+    const std::filesystem::path path = std::filesystem::absolute(fileName->toStr(), ec);
+    if (ec) {
+        return {};
+    }
+    const std::filesystem::file_time_type modTime = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return {};
+    }
+
+    key->fileSize = file->size();
+    key->modTime = modTime.time_since_epoch().count();
+    const int tailSize = (int)std::min<Goffset>(key->fileSize, xrefIndexTailSize);
+    std::vector<char> tail(tailSize);
+    if (tailSize <= 0 || file->read(tail.data(), tailSize, key->fileSize - tailSize) != tailSize) {
+        return {};
+    }
+    key->tailHash = hashXRefIndexBytes(tail.data(), tailSize);
+
+    const std::string pathStr = path.string();
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.xrefidx", hashXRefIndexBytes(pathStr.c_str(), pathStr.size()));
+    return (std::filesystem::path(dir) / name).string();
+}
+
+// Returns the XRef stored in the index at <path>, or nullptr if there is
+// no index for this version of the file.
+static XRef *readXRefIndex(const std::string &path, const XRefIndexKey &key, BaseStream *str)
+{
+    std::unique_ptr<FILE, FILECloser> f(openFile(path.c_str(), "rb"));
+    if (!f) {
+        return nullptr;
+    }
+
+    char magic[sizeof(xrefIndexMagic) - 1];
+    int version;
+    XRefIndexKey fileKey;
+    if (fread(magic, sizeof(magic), 1, f.get()) != 1 || memcmp(magic, xrefIndexMagic, sizeof(magic)) || fread(&version, sizeof(version), 1, f.get()) != 1 || version != xrefIndexVersion || fread(&fileKey.fileSize, sizeof(fileKey.fileSize), 1, f.get()) != 1
+        || fread(&fileKey.modTime, sizeof(fileKey.modTime), 1, f.get()) != 1 || fread(&fileKey.tailHash, sizeof(fileKey.tailHash), 1, f.get()) != 1 || !(fileKey == key)) {
+        return nullptr;
+    }
+
+    XRef *xref = XRef::readIndex(str, f.get());
+    if (!xref) {
+        error(errIO, -1, "Ignoring invalid xref index '{0:s}'", path.c_str());
+    }
+    return xref;
+}
+
+// Writes the index for <xref> to <path>.  The index is written to a
+// temporary file first, so concurrent readers never see a partial one.
+static void writeXRefIndex(const std::string &path, const XRefIndexKey &key, XRef *xref)
+{
+    const std::string tmpPath = path + "." + std::to_string(std::random_device {}()) + ".tmp";
+    std::unique_ptr<FILE, FILECloser> f(openFile(tmpPath.c_str(), "wb"));
+    if (!f) {
+        return;
+    }
+
+    const int version = xrefIndexVersion;
+    bool ok = fwrite(xrefIndexMagic, sizeof(xrefIndexMagic) - 1, 1, f.get()) == 1 && fwrite(&version, sizeof(version), 1, f.get()) == 1 && fwrite(&key.fileSize, sizeof(key.fileSize), 1, f.get()) == 1
+            && fwrite(&key.modTime, sizeof(key.modTime), 1, f.get()) == 1 && fwrite(&key.tailHash, sizeof(key.tailHash), 1, f.get()) == 1 && xref->writeIndex(f.get());
+    ok = fclose(f.release()) == 0 && ok;
+
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(tmpPath, path, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        std::filesystem::remove(tmpPath, ec);
+    }
+}
+
+//------------------------------------------------------------------------
+
 PDFDoc::PDFDoc() = default;
 
 PDFDoc::PDFDoc(std::unique_ptr<GooString> &&fileNameA, const std::optional<GooString> &ownerPassword, const std::optional<GooString> &userPassword, const std::function<void()> &xrefReconstructedCallback) : fileName(std::move(fileNameA))
@@ -164,7 +306,7 @@ PDFDoc::PDFDoc(std::unique_ptr<GooString> &&fileNameA, const std::optional<GooSt
     }
 
     // create stream
-    str = new FileStream(file.get(), 0, false, file->size(), Object::null());
+    str = createFileStream(file.get());
 
     ok = setup(ownerPassword, userPassword, xrefReconstructedCallback);
 }
@@ -198,7 +340,7 @@ PDFDoc::PDFDoc(wchar_t *fileNameA, int fileNameLen, const std::optional<GooStrin
     }
 
     // create stream
-    str = new FileStream(file.get(), 0, false, file->size(), Object::null());
+    str = createFileStream(file.get());
 
     ok = setup(ownerPassword, userPassword, xrefReconstructedCallback);
 }
@@ -251,18 +393,29 @@ bool PDFDoc::setup(const std::optional<GooString> &ownerPassword, const std::opt
 
     bool wasReconstructed = false;
 
+    // use the xref index if there is one for this version of the file
+    XRefIndexKey xrefIndexKey;
+    const std::string xrefIndexPath = getXRefIndexPath(fileName.get(), file.get(), &xrefIndexKey);
+    bool xrefFromIndex = false;
+    if (!xrefIndexPath.empty()) {
+        xref = readXRefIndex(xrefIndexPath, xrefIndexKey, str);
+        xrefFromIndex = xref != nullptr;
+    }
+
     // read xref table
-    xref = new XRef(str, getStartXRef(), getMainXRefEntriesOffset(), &wasReconstructed, false, xrefReconstructedCallback);
-    if (!xref->isOk()) {
-        if (wasReconstructed) {
-            delete xref;
-            startXRefPos = -1;
-            xref = new XRef(str, getStartXRef(true), getMainXRefEntriesOffset(true), &wasReconstructed, false, xrefReconstructedCallback);
-        }
+    if (!xrefFromIndex) {
+        xref = new XRef(str, getStartXRef(), getMainXRefEntriesOffset(), &wasReconstructed, false, xrefReconstructedCallback);
         if (!xref->isOk()) {
-            error(errSyntaxError, -1, "Couldn't read xref table");
-            errCode = xref->getErrorCode();
-            return false;
+            if (wasReconstructed) {
+                delete xref;
+                startXRefPos = -1;
+                xref = new XRef(str, getStartXRef(true), getMainXRefEntriesOffset(true), &wasReconstructed, false, xrefReconstructedCallback);
+            }
+            if (!xref->isOk()) {
+                error(errSyntaxError, -1, "Couldn't read xref table");
+                errCode = xref->getErrorCode();
+                return false;
+            }
         }
     }
 
@@ -280,6 +433,7 @@ bool PDFDoc::setup(const std::optional<GooString> &ownerPassword, const std::opt
             delete catalog;
             delete xref;
             xref = new XRef(str, 0, 0, nullptr, true, xrefReconstructedCallback);
+            xrefFromIndex = false;
             catalog = new Catalog(this);
         }
 
@@ -293,6 +447,10 @@ bool PDFDoc::setup(const std::optional<GooString> &ownerPassword, const std::opt
     // Extract PDF Subtype information
     extractPDFSubtype();
 
+    if (!xrefIndexPath.empty() && !xrefFromIndex) {
+        writeXRefIndex(xrefIndexPath, xrefIndexKey, xref);
+    }
+
     // done
     return true;
 }
@@ -679,6 +837,19 @@ bool PDFDoc::checkLinearization()
         linearizationState = 2;
         return false;
     }
+    // the page objects are spread over the file, so load them all in one
+    // go before fetching them
+    std::vector<ByteRange> ranges;
+    for (int page = 1; page <= linearization->getNumPages(); page++) {
+        const int num = hints->getPageObjectNum(page);
+        if (num > 0 && num < xref->getNumObjects()) {
+            const XRefEntry *entry = xref->getEntry(num);
+            if (entry->type == xrefEntryUncompressed && entry->offset >= 0) {
+                ranges.push_back({ (size_t)entry->offset, linearizedPageObjectSize });
+            }
+        }
+    }
+    str->prefetch(ranges);
     for (int page = 1; page <= linearization->getNumPages(); page++) {
         Ref pageRef;
 
@@ -824,6 +995,14 @@ Hints *PDFDoc::getHints()
 }
 
 int PDFDoc::savePageAs(const GooString &name, int pageNo)
+{
+    getXRef()->recordModifiedObjects();
+    const int res = doSavePageAs(name, pageNo);
+    getXRef()->restoreModifiedObjects();
+    return res;
+}
+
+int PDFDoc::doSavePageAs(const GooString &name, int pageNo)
 {
     FILE *f;
 
@@ -868,20 +1047,21 @@ int PDFDoc::savePageAs(const GooString &name, int pageNo)
         yRef->setEncryption(secHdlr->getPermissionFlags(), secHdlr->getOwnerPasswordOk(), fileKey, keyLength, secHdlr->getEncVersion(), secHdlr->getEncRevision(), encAlgorithm);
     }
     const std::unique_ptr<XRef> countRef = std::make_unique<XRef>();
-    Object *trailerObj = getXRef()->getTrailerDict();
-    if (trailerObj->isDict()) {
-        markPageObjects(trailerObj->getDict(), yRef.get(), countRef.get(), 0, refPage->num, rootNum + 2);
+    // markPageObjects() removes entries from the dictionaries it is given
+    Object trailerObj = getXRef()->getTrailerDict()->deepCopy();
+    if (trailerObj.isDict()) {
+        markPageObjects(trailerObj.getDict(), yRef.get(), countRef.get(), 0, refPage->num, rootNum + 2);
     }
     yRef->add(0, 65535, 0, false);
     writeHeader(outStr.get(), getPDFMajorVersion(), getPDFMinorVersion());
 
     // get and mark info dict
-    Object infoObj = getXRef()->getDocInfo();
+    Object infoObj = getXRef()->getDocInfo().deepCopy();
     if (infoObj.isDict()) {
         Dict *infoDict = infoObj.getDict();
         markPageObjects(infoDict, yRef.get(), countRef.get(), 0, refPage->num, rootNum + 2);
-        if (trailerObj->isDict()) {
-            Dict *trailerDict = trailerObj->getDict();
+        if (trailerObj.isDict()) {
+            Dict *trailerDict = trailerObj.getDict();
             const Object &ref = trailerDict->lookupNF("Info");
             if (ref.isRef()) {
                 yRef->add(ref.getRef(), 0, true);
@@ -926,7 +1106,7 @@ int PDFDoc::savePageAs(const GooString &name, int pageNo)
     if (resourcesObj.isNull() && !pageDict->hasKey("Resources")) {
         Object *resourceDictObject = getCatalog()->getPage(pageNo)->getResourceDictObject();
         if (resourceDictObject->isDict()) {
-            resourcesObj = resourceDictObject->copy();
+            resourcesObj = resourceDictObject->deepCopy();
             markPageObjects(resourcesObj.getDict(), yRef.get(), countRef.get(), 0, refPage->num, rootNum + 2);
         }
     }
@@ -1020,8 +1200,8 @@ int PDFDoc::saveAs(OutStream *outStr, PDFWriteMode mode)
     if (!xref->isModified() && mode == writeStandard) {
         // simply copy the original file
         saveWithoutChangesAs(outStr);
-    } else if (mode == writeForceRewrite) {
-        saveCompleteRewrite(outStr);
+    } else if (mode == writeForceRewrite || mode == writeForceRewriteCompressed) {
+        saveCompleteRewrite(outStr, mode == writeForceRewriteCompressed);
     } else {
         saveIncrementalUpdate(outStr);
     }
@@ -1152,7 +1332,7 @@ void PDFDoc::saveIncrementalUpdate(OutStream *outStr)
     delete uxref;
 }
 
-void PDFDoc::saveCompleteRewrite(OutStream *outStr)
+void PDFDoc::saveCompleteRewrite(OutStream *outStr, bool compress)
 {
     // Make sure that special flags are set, because we are going to read
     // all objects, including Unencrypted ones.
@@ -1163,9 +1343,19 @@ void PDFDoc::saveCompleteRewrite(OutStream *outStr)
     int keyLength;
     xref->getEncryptionParameters(&fileKey, &encAlgorithm, &keyLength);
 
-    writeHeader(outStr, getPDFMajorVersion(), getPDFMinorVersion());
+    int majorVersion = getPDFMajorVersion();
+    int minorVersion = getPDFMinorVersion();
+    if (compress && majorVersion == 1 && minorVersion < 5) {
+        // object and xref streams need PDF 1.5
+        minorVersion = 5;
+    }
+    writeHeader(outStr, majorVersion, minorVersion);
     XRef *uxref = new XRef();
     uxref->add(0, 65535, 0, false);
+    std::unique_ptr<ObjectStreamWriter> objStms;
+    if (compress) {
+        objStms = std::make_unique<ObjectStreamWriter>(outStr, uxref, xref->getNumObjects(), fileKey, encAlgorithm, keyLength);
+    }
     xref->lock();
     for (int i = 0; i < xref->getNumObjects(); i++) {
         Ref ref;
@@ -1183,6 +1373,30 @@ void PDFDoc::saveCompleteRewrite(OutStream *outStr)
             ref.num = i;
             ref.gen = xref->getEntry(i)->gen + 1;
             uxref->add(ref, 0, false);
+        } else if (compress) {
+            ref.num = i;
+            ref.gen = type == xrefEntryCompressed ? 0 : xref->getEntry(i)->gen;
+            Object obj1 = xref->fetch(ref, 1 /* recursion */);
+            const bool unencrypted = xref->getEntry(i)->getFlag(XRefEntry::Unencrypted);
+            if (obj1.isStream() && (obj1.streamGetDict()->is("ObjStm") || obj1.streamGetDict()->is("XRef"))) {
+                // the objects and the xref are in the streams written here now
+                ref.gen++;
+                uxref->add(ref, 0, false);
+            } else if (!unencrypted && ObjectStreamWriter::canPack(&obj1, ref)) {
+                OutStream *objOutStr = objStms->startObject(ref);
+                writeObject(&obj1, objOutStr, nullptr, cryptRC4, 0, ref);
+                objStms->endObject();
+            } else {
+                deflateStream(&obj1);
+                Goffset offset = writeObjectHeader(&ref, outStr);
+                if (unencrypted) {
+                    writeObject(&obj1, outStr, nullptr, cryptRC4, 0, 0, 0);
+                } else {
+                    writeObject(&obj1, outStr, fileKey, encAlgorithm, keyLength, ref);
+                }
+                writeObjectFooter(outStr);
+                uxref->add(ref, offset, true);
+            }
         } else if (type == xrefEntryUncompressed) {
             ref.num = i;
             ref.gen = xref->getEntry(i)->gen;
@@ -1207,8 +1421,21 @@ void PDFDoc::saveCompleteRewrite(OutStream *outStr)
         }
     }
     xref->unlock();
-    Goffset uxrefOffset = outStr->getPos();
-    writeXRefTableTrailer(uxrefOffset, uxref, true /* write all entries */, uxref->getNumObjects(), outStr, false /* complete rewrite */);
+    if (compress) {
+        objStms->flush();
+        Goffset uxrefOffset = outStr->getPos();
+        Ref uxrefStreamRef = { uxref->getNumObjects(), 0 };
+        uxref->add(uxrefStreamRef, uxrefOffset, true);
+        Object trailerDict = createTrailerDict(uxref->getNumObjects(), false);
+        if (trailerDict.dictGetLength() == 0) {
+            delete uxref;
+            return;
+        }
+        writeXRefStreamTrailer(std::move(trailerDict), uxref, &uxrefStreamRef, uxrefOffset, outStr, getXRef(), true);
+    } else {
+        Goffset uxrefOffset = outStr->getPos();
+        writeXRefTableTrailer(uxrefOffset, uxref, true /* write all entries */, uxref->getNumObjects(), outStr, false /* complete rewrite */);
+    }
     delete uxref;
 }
 
@@ -1639,14 +1866,18 @@ void PDFDoc::writeXRefTableTrailer(Object &&trailerDict, XRef *uxref, bool write
     outStr->printf("%%%%EOF\r\n");
 }
 
-void PDFDoc::writeXRefStreamTrailer(Object &&trailerDict, XRef *uxref, Ref *uxrefStreamRef, Goffset uxrefOffset, OutStream *outStr, XRef *xRef)
+void PDFDoc::writeXRefStreamTrailer(Object &&trailerDict, XRef *uxref, Ref *uxrefStreamRef, Goffset uxrefOffset, OutStream *outStr, XRef *xRef, bool compress)
 {
     GooString stmData;
 
     // Fill stmData and some trailerDict fields
     uxref->writeStreamToBuffer(&stmData, trailerDict.getDict(), xRef);
 
-    // Create XRef stream object and write it
+    // Create XRef stream object and write it, writeObject() compresses it
+    // if it has a filter
+    if (compress) {
+        trailerDict.dictSet("Filter", Object(objName, "FlateDecode"));
+    }
     auto mStream = std::make_unique<MemStream>(stmData.c_str(), 0, stmData.getLength(), std::move(trailerDict));
     writeObjectHeader(uxrefStreamRef, outStr);
     Object obj1(std::move(mStream));
@@ -1658,14 +1889,144 @@ void PDFDoc::writeXRefStreamTrailer(Object &&trailerDict, XRef *uxref, Ref *uxre
     outStr->printf("%%%%EOF\r\n");
 }
 
-void PDFDoc::writeXRefTableTrailer(Goffset uxrefOffset, XRef *uxref, bool writeAllEntries, int uxrefSize, OutStream *outStr, bool incrUpdate)
+void PDFDoc::deflateStream(Object *obj)
+{
+    if (!obj->isStream()) {
+        return;
+    }
+    Stream *str = obj->getStream();
+    Dict *dict = str->getDict();
+    if (dict->hasKey("Filter") || dict->is("Metadata")) {
+        return;
+    }
+    std::string data;
+    str->fillString(data);
+    str->close();
+    if (data.size() < deflateStreamMinSize) {
+        return;
+    }
+    Object newDict(dict->copy(dict->getXRef()));
+    newDict.dictSet("Filter", Object(objName, "FlateDecode"));
+    newDict.dictRemove("DecodeParms");
+    *obj = Object(std::make_unique<AutoFreeMemStream>(std::vector<char>(data.begin(), data.end()), std::move(newDict)));
+}
+
+//------------------------------------------------------------------------
+// PDFDoc::ObjectStreamWriter
+//------------------------------------------------------------------------
+
+// Collects the serialized objects in memory.
+class PDFDoc::ObjectStreamWriter::BufferOutStream final : public OutStream
+{
+public:
+    void close() override { }
+    Goffset getPos() override { return data.size(); }
+    void put(char c) override { data.push_back(c); }
+    size_t write(std::span<const unsigned char> bytes) override
+    {
+        data.append((const char *)bytes.data(), bytes.size());
+        return bytes.size();
+    }
+    void printf(const char *format, ...) override GCC_PRINTF_FORMAT(2, 3);
+
+    std::string data;
+};
+
+void PDFDoc::ObjectStreamWriter::BufferOutStream::printf(const char *format, ...)
+{
+    char buf[64];
+    va_list args;
+    va_start(args, format);
+    va_list args2;
+    va_copy(args2, args);
+    const int n = vsnprintf(buf, sizeof(buf), format, args);
+    if (n >= (int)sizeof(buf)) {
+        const size_t pos = data.size();
+        data.resize(pos + n + 1);
+        vsnprintf(data.data() + pos, n + 1, format, args2);
+        data.resize(pos + n);
+    } else if (n > 0) {
+        data.append(buf, n);
+    }
+    va_end(args2);
+    va_end(args);
+}
+
+PDFDoc::ObjectStreamWriter::ObjectStreamWriter(OutStream *outStrA, XRef *uxrefA, int firstNumA, unsigned char *fileKeyA, CryptAlgorithm encAlgorithmA, int keyLengthA)
+    : outStr(outStrA), uxref(uxrefA), nextNum(firstNumA), fileKey(fileKeyA), encAlgorithm(encAlgorithmA), keyLength(keyLengthA), buffer(std::make_unique<BufferOutStream>())
+{
+}
+
+PDFDoc::ObjectStreamWriter::~ObjectStreamWriter() = default;
+
+bool PDFDoc::ObjectStreamWriter::canPack(const Object *obj, Ref ref)
+{
+    // streams can't be nested, and object stream entries have no
+    // generation number
+    return !obj->isStream() && ref.gen == 0;
+}
+
+OutStream *PDFDoc::ObjectStreamWriter::startObject(Ref ref)
+{
+    // reserve the number, so that no object stream gets it
+    uxref->add(ref, 0, true);
+    objects.emplace_back(ref.num, buffer->data.size());
+    return buffer.get();
+}
+
+void PDFDoc::ObjectStreamWriter::endObject()
+{
+    buffer->put('\n');
+    if (objects.size() >= objectStreamMaxObjects) {
+        flush();
+    }
+}
+
+void PDFDoc::ObjectStreamWriter::flush()
+{
+    if (objects.empty()) {
+        return;
+    }
+
+    std::string data;
+    for (const auto &[num, offset] : objects) {
+        data += std::to_string(num) + ' ' + std::to_string(offset) + ' ';
+    }
+    const int first = data.size();
+    data += buffer->data;
+
+    Dict *dict = new Dict(uxref);
+    dict->add("Type", Object(objName, "ObjStm"));
+    dict->add("N", Object((int)objects.size()));
+    dict->add("First", Object(first));
+    dict->add("Filter", Object(objName, "FlateDecode"));
+    Object obj(std::make_unique<AutoFreeMemStream>(std::vector<char>(data.begin(), data.end()), Object(dict)));
+
+    nextNum = std::max(nextNum, uxref->getNumObjects());
+    Ref ref = { nextNum++, 0 };
+    const Goffset offset = writeObjectHeader(&ref, outStr);
+    writeObject(&obj, outStr, uxref, 0, fileKey, encAlgorithm, keyLength, ref);
+    writeObjectFooter(outStr);
+    uxref->add(ref, offset, true);
+
+    for (size_t i = 0; i < objects.size(); ++i) {
+        XRefEntry *e = uxref->getEntry(objects[i].first);
+        e->type = xrefEntryCompressed;
+        e->offset = ref.num;
+        e->gen = i;
+    }
+    objects.clear();
+    buffer->data.clear();
+}
+
+Object PDFDoc::createTrailerDict(int uxrefSize, bool incrUpdate)
 {
     const char *fileNameA = fileName ? fileName->c_str() : nullptr;
     // file size (doesn't include the trailer)
     unsigned int fileSize = 0;
     int c;
     if (!str->reset()) {
-        return;
+        return Object(new Dict(getXRef()));
     }
     while ((c = str->getChar()) != EOF) {
         fileSize++;
@@ -1674,7 +2035,15 @@ void PDFDoc::writeXRefTableTrailer(Goffset uxrefOffset, XRef *uxref, bool writeA
     Ref ref;
     ref.num = getXRef()->getRootNum();
     ref.gen = getXRef()->getRootGen();
-    Object trailerDict = createTrailerDict(uxrefSize, incrUpdate, getStartXRef(), &ref, getXRef(), fileNameA, fileSize);
+    return createTrailerDict(uxrefSize, incrUpdate, getStartXRef(), &ref, getXRef(), fileNameA, fileSize);
+}
+
+void PDFDoc::writeXRefTableTrailer(Goffset uxrefOffset, XRef *uxref, bool writeAllEntries, int uxrefSize, OutStream *outStr, bool incrUpdate)
+{
+    Object trailerDict = createTrailerDict(uxrefSize, incrUpdate);
+    if (trailerDict.dictGetLength() == 0) {
+        return;
+    }
     writeXRefTableTrailer(std::move(trailerDict), uxref, writeAllEntries, uxrefOffset, outStr, getXRef());
 }
 
@@ -1967,7 +2336,7 @@ void PDFDoc::markAcroForm(Object *afObj, XRef *xRef, XRef *countRef, unsigned in
     }
 }
 
-unsigned int PDFDoc::writePageObjects(OutStream *outStr, XRef *xRef, unsigned int numOffset, bool combine)
+unsigned int PDFDoc::writePageObjects(OutStream *outStr, XRef *xRef, unsigned int numOffset, bool combine, ObjectStreamWriter *objStms, bool deflate)
 {
     unsigned int objectsCount = 0; // count the number of objects in the XRef(s)
     unsigned char *fileKey;
@@ -1975,13 +2344,24 @@ unsigned int PDFDoc::writePageObjects(OutStream *outStr, XRef *xRef, unsigned in
     int keyLength;
     xRef->getEncryptionParameters(&fileKey, &encAlgorithm, &keyLength);
 
-    for (int n = numOffset; n < xRef->getNumObjects(); n++) {
+    // object streams are added to xRef while writing
+    const int numObjects = xRef->getNumObjects();
+    for (int n = numOffset; n < numObjects; n++) {
         if (xRef->getEntry(n)->type != xrefEntryFree) {
             Ref ref;
             ref.num = n;
             ref.gen = xRef->getEntry(n)->gen;
             objectsCount++;
             Object obj = getXRef()->fetch(ref.num - numOffset, ref.gen);
+            if (objStms && (combine || !fileKey) && ObjectStreamWriter::canPack(&obj, ref)) {
+                OutStream *objOutStr = objStms->startObject(ref);
+                writeObject(&obj, objOutStr, getXRef(), numOffset, nullptr, cryptRC4, 0, 0, 0);
+                objStms->endObject();
+                continue;
+            }
+            if (deflate) {
+                deflateStream(&obj);
+            }
             Goffset offset = writeObjectHeader(&ref, outStr);
             if (combine) {
                 writeObject(&obj, outStr, getXRef(), numOffset, nullptr, cryptRC4, 0, 0, 0);
@@ -2165,11 +2545,18 @@ Page *PDFDoc::getPage(int page)
     }
 
     if (isLinearized() && checkLinearization()) {
+        {
+            const std::shared_lock readLocker(mutex);
+            if (!pageCache.empty() && pageCache[page - 1]) {
+                return pageCache[page - 1].get();
+            }
+        }
         pdfdocLocker();
         if (pageCache.empty()) {
             pageCache.resize(getNumPages());
         }
         if (!pageCache[page - 1]) {
+            str->prefetch(getHints()->getPageRanges(page));
             pageCache[page - 1] = parsePage(page);
         }
         if (pageCache[page - 1]) {
@@ -55,6 +55,7 @@
 #include <mutex>
 
 #include "CryptoSignBackend.h"
+#include "goo/GooRecursiveSharedMutex.h"
 #include "poppler-config.h"
 
 #include "poppler_private_export.h"
@@ -67,6 +68,7 @@
 #include "Form.h"
 #include "OptionalContent.h"
 #include "Stream.h"
+#include "DecodedImageCache.h"
 
 class GooString;
 class GooFile;
@@ -85,7 +87,8 @@ enum PDFWriteMode
 {
     writeStandard,
     writeForceRewrite,
-    writeForceIncremental
+    writeForceIncremental,
+    writeForceRewriteCompressed // like writeForceRewrite, with object streams, a xref stream and Flate-compressed streams
 };
 
 enum PDFSubtype
@@ -179,6 +182,10 @@ public:
     // Get base stream.
     BaseStream *getBaseStream() const { return str; }
 
+    // Get the cache of decoded images shared by everything that renders
+    // this document.
+    DecodedImageCache *getDecodedImageCache() { return &decodedImageCache; }
+
     // Get page parameters.
     double getPageMediaWidth(int page) { return getPage(page) ? getPage(page)->getMediaWidth() : 0.0; }
     double getPageMediaHeight(int page) { return getPage(page) ? getPage(page)->getMediaHeight() : 0.0; }
@@ -304,7 +311,9 @@ public:
     // Return the PDF ID in the trailer dictionary (if any).
     bool getID(GooString *permanent_id, GooString *update_id) const;
 
-    // Save one page with another name.
+    // Save one page with another name.  This works on copies of the
+    // objects it changes and leaves the document as it was, so that
+    // several pages can be saved from one PDFDoc.
     int savePageAs(const GooString &name, int pageNo);
     // Save this file with another name.
     int saveAs(const GooString &name, PDFWriteMode mode = writeStandard);
@@ -320,15 +329,66 @@ public:
     bool markPageObjects(Dict *pageDict, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::set<Dict *> *alreadyMarkedDicts = nullptr);
     bool markAnnotations(Object *annots, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldPageNum, int newPageNum, std::set<Dict *> *alreadyMarkedDicts = nullptr);
     void markAcroForm(Object *afObj, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum);
-    // write all objects used by pageDict to outStr
-    unsigned int writePageObjects(OutStream *outStr, XRef *xRef, unsigned int numOffset, bool combine = false);
+    class ObjectStreamWriter;
+    // write all objects used by pageDict to outStr; if objStms is set, the
+    // objects that can go into object streams are written there, and with
+    // deflate the streams without filter are Flate-compressed
+    unsigned int writePageObjects(OutStream *outStr, XRef *xRef, unsigned int numOffset, bool combine = false, ObjectStreamWriter *objStms = nullptr, bool deflate = false);
     static void writeObject(Object *obj, OutStream *outStr, XRef *xref, unsigned int numOffset, unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, int objNum, int objGen, std::set<Dict *> *alreadyWrittenDicts = nullptr);
     static void writeObject(Object *obj, OutStream *outStr, XRef *xref, unsigned int numOffset, unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref, std::set<Dict *> *alreadyWrittenDicts = nullptr);
     static void writeHeader(OutStream *outStr, int major, int minor);
 
     static Object createTrailerDict(int uxrefSize, bool incrUpdate, Goffset startxRef, Ref *root, XRef *xRef, const char *fileName, Goffset fileSize);
     static void writeXRefTableTrailer(Object &&trailerDict, XRef *uxref, bool writeAllEntries, Goffset uxrefOffset, OutStream *outStr, XRef *xRef);
-    static void writeXRefStreamTrailer(Object &&trailerDict, XRef *uxref, Ref *uxrefStreamRef, Goffset uxrefOffset, OutStream *outStr, XRef *xRef);
+    // with compress, the xref stream is Flate-compressed
+    static void writeXRefStreamTrailer(Object &&trailerDict, XRef *uxref, Ref *uxrefStreamRef, Goffset uxrefOffset, OutStream *outStr, XRef *xRef, bool compress = false);
+    // Replace the stream <obj> by a copy that writeObject() Flate-compresses,
+    // if it has no filter and is not a metadata stream.
+    static void deflateStream(Object *obj);
+
+    // Packs the objects of a document being written into Flate-compressed
+    // object streams (PDF 1.5).  The objects are written to the stream
+    // returned by startObject() instead of the output, and every
+    // objectStreamMaxObjects of them are written out as one object stream.
+    // Their entries in the output xref then point into that object stream,
+    // so it must be written as a xref stream, see writeXRefStreamTrailer().
+    class ObjectStreamWriter
+    {
+    public:
+        // Object streams get the numbers from firstNum on that are not used
+        // in uxref yet.  If fileKey is set, the object streams are encrypted
+        // with it; the objects in them must be written unencrypted.
+        ObjectStreamWriter(OutStream *outStrA, XRef *uxrefA, int firstNumA, unsigned char *fileKeyA = nullptr, CryptAlgorithm encAlgorithmA = cryptRC4, int keyLengthA = 0);
+        ~ObjectStreamWriter();
+
+        ObjectStreamWriter(const ObjectStreamWriter &) = delete;
+        ObjectStreamWriter &operator=(const ObjectStreamWriter &) = delete;
+
+        // Return true if obj can be stored in an object stream as ref.
+        static bool canPack(const Object *obj, Ref ref);
+
+        // Return the stream to write the body of object ref to, which must
+        // be followed by endObject().
+        OutStream *startObject(Ref ref);
+        void endObject();
+
+        // Write out the objects collected so far.  Must be called before
+        // the xref is written.
+        void flush();
+
+    private:
+        class BufferOutStream;
+
+        OutStream *outStr;
+        XRef *uxref;
+        int nextNum;
+        unsigned char *fileKey;
+        CryptAlgorithm encAlgorithm;
+        int keyLength;
+        std::unique_ptr<BufferOutStream> buffer;
+        std::vector<std::pair<int, size_t>> objects; // number and offset in buffer
+    };
+
     // scans the PDF and returns whether it contains any javascript
     bool hasJavascript();
 
@@ -354,6 +414,8 @@ public:
                                                                                  std::unique_ptr<AnnotColor> &&backgroundColor, const std::string &imagePath);
 
 private:
+    int doSavePageAs(const GooString &name, int pageNo);
+
     // insert referenced objects in XRef
     bool markDictionary(Dict *dict, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::set<Dict *> *alreadyMarkedDicts);
     bool markObject(Object *obj, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::set<Dict *> *alreadyMarkedDicts = nullptr);
@@ -375,10 +437,11 @@ private:
     inline void writeObject(Object *obj, OutStream *outStr, unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref) { writeObject(obj, outStr, getXRef(), 0, fileKey, encAlgorithm, keyLength, ref); }
     static void writeStream(Stream *str, OutStream *outStr);
     static void writeRawStream(Stream *str, OutStream *outStr);
+    Object createTrailerDict(int uxrefSize, bool incrUpdate);
     void writeXRefTableTrailer(Goffset uxrefOffset, XRef *uxref, bool writeAllEntries, int uxrefSize, OutStream *outStr, bool incrUpdate);
     static void writeString(const GooString *s, OutStream *outStr, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref);
     void saveIncrementalUpdate(OutStream *outStr);
-    void saveCompleteRewrite(OutStream *outStr);
+    void saveCompleteRewrite(OutStream *outStr, bool compress);
 
     std::unique_ptr<Page> parsePage(int page);
 
@@ -421,6 +484,7 @@ private:
     Hints *hints = nullptr;
     Outline *outline = nullptr;
     std::vector<std::unique_ptr<Page>> pageCache;
+    DecodedImageCache decodedImageCache;
 
     bool ok = false;
     int errCode = errNone;
@@ -429,7 +493,7 @@ private:
     int fopenErrno;
 
     Goffset startXRefPos = -1; // offset of last xref table
-    mutable std::recursive_mutex mutex;
+    mutable GooRecursiveSharedMutex mutex;
 };
 
 #endif
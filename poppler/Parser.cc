@@ -33,6 +33,9 @@
 #include <config.h>
 
 #include <cstddef>
+#include <optional>
+#include <set>
+#include <utility>
 #include "Object.h"
 #include "Array.h"
 #include "Dict.h"
@@ -46,6 +49,39 @@
 // lots of nested arrays that made us consume all the stack
 #define recursionLimit 500
 
+// Stream objects being parsed by the current thread, to catch streams
+// whose Length refers back to the stream itself.  This is per thread
+// since several threads may parse the same object at the same time.
+static thread_local std::set<std::pair<const XRef *, int>> streamsBeingParsed;
+
+namespace {
+
+// Marks a stream object as being parsed by the current thread while it
+// exists.
+class ParsingStream
+{
+public:
+    ParsingStream(const XRef *xref, int num) : key(xref, num) { inserted = streamsBeingParsed.insert(key).second; }
+    ~ParsingStream()
+    {
+        if (inserted) {
+            streamsBeingParsed.erase(key);
+        }
+    }
+
+    ParsingStream(const ParsingStream &) = delete;
+    ParsingStream &operator=(const ParsingStream &) = delete;
+
+    // Is the object already being parsed further up the stack?
+    bool isLoop() const { return !inserted; }
+
+private:
+    std::pair<const XRef *, int> key;
+    bool inserted;
+};
+
+}
+
 Parser::Parser(XRef *xrefA, std::unique_ptr<Stream> &&streamA, bool allowStreamsA) : lexer { xrefA, std::move(streamA) }
 {
     allowStreams = allowStreamsA;
@@ -230,15 +266,13 @@ Stream *Parser::makeStream(Object &&dict, const unsigned char *fileKey, CryptAlg
     Goffset length;
     Goffset pos, endPos;
 
-    if (XRef *xref = lexer.getXRef()) {
-        XRefEntry *entry = xref->getEntry(objNum, false);
-        if (entry) {
-            if (!entry->getFlag(XRefEntry::Parsing) || (objNum == 0 && objGen == 0)) {
-                entry->setFlag(XRefEntry::Parsing, true);
-            } else {
-                error(errSyntaxError, getPos(), "Object '{0:d} {1:d} obj' is being already parsed", objNum, objGen);
-                return nullptr;
-            }
+    // objects without a number (0 0) can't refer back to themselves
+    std::optional<ParsingStream> parsing;
+    if (XRef *xref = lexer.getXRef(); xref && !(objNum == 0 && objGen == 0)) {
+        parsing.emplace(xref, objNum);
+        if (parsing->isLoop()) {
+            error(errSyntaxError, getPos(), "Object '{0:d} {1:d} obj' is being already parsed", objNum, objGen);
+            return nullptr;
         }
     }
 
@@ -326,16 +360,6 @@ Stream *Parser::makeStream(Object &&dict, const unsigned char *fileKey, CryptAlg
     // get filters
     str = str->addFilters(str->getDict(), recursion);
 
-    if (XRef *xref = lexer.getXRef()) {
-        // Don't try to reuse the entry from the block at the start
-        // of the function, xref can change in the middle because of
-        // reconstruction
-        XRefEntry *entry = xref->getEntry(objNum, false);
-        if (entry) {
-            entry->setFlag(XRefEntry::Parsing, false);
-        }
-    }
-
     return str;
 }
 
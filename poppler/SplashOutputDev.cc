@@ -54,6 +54,8 @@
 
 #include <cstring>
 #include <cmath>
+#include <climits>
+#include <thread>
 #include <vector>
 #include "Stream.h"
 #include "goo/gfile.h"
@@ -62,6 +64,7 @@
 #include "Object.h"
 #include "Gfx.h"
 #include "GfxFont.h"
+#include "Annot.h"
 #include "Page.h"
 #include "PDFDoc.h"
 #include "Link.h"
@@ -82,6 +85,7 @@
 #include "splash/Splash.h"
 #include "SplashOutputDev.h"
 #include <algorithm>
+#include <limits>
 
 static const double s_minLineWidth = 0.0;
 
@@ -1233,6 +1237,9 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA, int bitmapRowPadA,
     }
     skipHorizText = false;
     skipRotatedText = false;
+    tileThreads = 1;
+    bandYMin = bandYMax = 0;
+    bandScreen = nullptr;
     keepAlphaChannel = paperColorA == nullptr;
 
     doc = nullptr;
@@ -1321,6 +1328,10 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state, XRef *xrefA)
             w = 1;
         }
         h = (int)(state->getPageHeight() + 0.5);
+        // one row more than the band, see displayPageSliceTiled()
+        if (bandYMax > 0 && bandYMax < h) {
+            h = bandYMax + 1;
+        }
         if (h <= 0) {
             h = 1;
         }
@@ -1345,7 +1356,11 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state, XRef *xrefA)
             bitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode, colorMode != splashModeMono1, bitmapTopDown);
         }
     }
-    splash = new Splash(bitmap, vectorAntialias, &screenParams);
+    if (bandScreen) {
+        splash = new Splash(bitmap, vectorAntialias, bandScreen);
+    } else {
+        splash = new Splash(bitmap, vectorAntialias, &screenParams);
+    }
     splash->setThinLineMode(thinLineMode);
     splash->setMinLineWidth(s_minLineWidth);
     if (state) {
@@ -1358,6 +1373,9 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state, XRef *xrefA)
         mat[5] = (SplashCoord)ctm[5];
         splash->setMatrix(mat);
     }
+    if (bandYMax > 0) {
+        splash->clipToRect(0, std::max(bandYMin - 1, 0), w, h);
+    }
     switch (colorMode) {
     case splashModeMono1:
     case splashModeMono8:
@@ -3223,6 +3241,60 @@ bool SplashOutputDev::tilingBitmapSrc(void *data, SplashColorPtr colorLine, unsi
     return true;
 }
 
+enum class ImageVisibility
+{
+    All, // most of the image can be seen
+    Part, // only the area returned can be seen
+    None // the image is entirely clipped away
+};
+
+// Find the part of a <width> x <height> image drawn with <mat> that can
+// show through <clip>, with a margin for interpolation, and with its
+// edges rounded out to multiples of <align> samples.
+static ImageVisibility getVisibleImageArea(const SplashCoord *mat, SplashClip *clip, int width, int height, int align, int *x0, int *y0, int *x1, int *y1)
+{
+    const SplashCoord det = mat[0] * mat[3] - mat[1] * mat[2];
+    if (width <= 0 || height <= 0 || splashAbs(det) < 0.000001) {
+        return ImageVisibility::All;
+    }
+    const SplashCoord inv[6] = { mat[3] / det, -mat[1] / det, -mat[2] / det, mat[0] / det, (mat[2] * mat[5] - mat[3] * mat[4]) / det, (mat[1] * mat[4] - mat[0] * mat[5]) / det };
+    // one more pixel on each side, for images rounded out to whole pixels
+    const SplashCoord xs[2] = { (SplashCoord)(clip->getXMinI() - 1), (SplashCoord)(clip->getXMaxI() + 2) };
+    const SplashCoord ys[2] = { (SplashCoord)(clip->getYMinI() - 1), (SplashCoord)(clip->getYMaxI() + 2) };
+    SplashCoord uMin = std::numeric_limits<SplashCoord>::max();
+    SplashCoord uMax = std::numeric_limits<SplashCoord>::lowest();
+    SplashCoord vMin = uMin, vMax = uMax;
+    for (SplashCoord x : xs) {
+        for (SplashCoord y : ys) {
+            const SplashCoord u = inv[0] * x + inv[2] * y + inv[4];
+            const SplashCoord v = inv[1] * x + inv[3] * y + inv[5];
+            uMin = std::min(uMin, u);
+            uMax = std::max(uMax, u);
+            vMin = std::min(vMin, v);
+            vMax = std::max(vMax, v);
+        }
+    }
+    if (!(uMin < uMax && vMin < vMax)) {
+        // not finite
+        return ImageVisibility::All;
+    }
+    if (uMax <= 0 || uMin >= 1 || vMax <= 0 || vMin >= 1) {
+        return ImageVisibility::None;
+    }
+    const SplashCoord uLo = std::max(uMin, (SplashCoord)0) * width - 2;
+    const SplashCoord uHi = std::min(uMax, (SplashCoord)1) * width + 2;
+    const SplashCoord vLo = std::max(vMin, (SplashCoord)0) * height - 2;
+    const SplashCoord vHi = std::min(vMax, (SplashCoord)1) * height + 2;
+    *x0 = std::max(splashFloor(uLo), 0) / align * align;
+    *y0 = std::max(splashFloor(vLo), 0) / align * align;
+    *x1 = std::min(width, (std::min(splashCeil(uHi), width) + align - 1) / align * align);
+    *y1 = std::min(height, (std::min(splashCeil(vHi), height) + align - 1) / align * align);
+    if (*x0 >= *x1 || *y0 >= *y1 || (double)(*x1 - *x0) * (*y1 - *y0) >= 0.75 * width * height) {
+        return ImageVisibility::All;
+    }
+    return ImageVisibility::Part;
+}
+
 void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool interpolate, const int *maskColors, bool inlineImg)
 {
     SplashCoord mat[6];
@@ -3244,11 +3316,6 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str, int w
             return;
         }
     }
-    imgData.imgStr = std::make_unique<ImageStream>(str, width, colorMap->getNumPixelComps(), colorMap->getBits());
-    if (!imgData.imgStr->reset()) {
-        return;
-    }
-
     mat[0] = ctm[0];
     mat[1] = ctm[1];
     mat[2] = -ctm[2];
@@ -3256,6 +3323,52 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str, int w
     mat[4] = ctm[2] + ctm[4];
     mat[5] = ctm[3] + ctm[5];
 
+    // decode images that are drawn much smaller than their size at a
+    // lower resolution, and only the visible part of partly clipped
+    // images, if the decoder can do that
+    bool decodeArea = false;
+    if (!inlineImg) {
+        const int reduction = str->setReducedDecoding(width, height, (int)ceil(hypot(ctm[0], ctm[1])), (int)ceil(hypot(ctm[2], ctm[3])));
+        const int scale = 1 << reduction;
+        int x0, y0, x1, y1;
+        const ImageVisibility visibility = getVisibleImageArea(mat, splash->getClip(), width, height, scale, &x0, &y0, &x1, &y1);
+        if (visibility == ImageVisibility::None) {
+            // nothing can be seen, don't decode anything
+            return;
+        }
+        if (visibility == ImageVisibility::Part && str->setDecodeArea(x0, y0, x1, y1)) {
+            decodeArea = true;
+            // map the unit square to the decoded area only
+            const SplashCoord sx = (SplashCoord)(x1 - x0) / width;
+            const SplashCoord sy = (SplashCoord)(y1 - y0) / height;
+            const SplashCoord tx = (SplashCoord)x0 / width;
+            const SplashCoord ty = (SplashCoord)y0 / height;
+            mat[4] += mat[0] * tx + mat[2] * ty;
+            mat[5] += mat[1] * tx + mat[3] * ty;
+            mat[0] *= sx;
+            mat[1] *= sx;
+            mat[2] *= sy;
+            mat[3] *= sy;
+            width = (x1 + scale - 1) / scale - x0 / scale;
+            height = (y1 + scale - 1) / scale - y0 / scale;
+        } else if (reduction > 0) {
+            width = (width + scale - 1) >> reduction;
+            height = (height + scale - 1) >> reduction;
+        }
+    }
+
+    // images drawn on many pages are only decoded once; partly decoded
+    // images are left out, the next page may show another part
+    std::unique_ptr<Stream> decodedStr;
+    if (doc && !inlineImg && !decodeArea) {
+        decodedStr = doc->getDecodedImageCache()->getDecodedStream(doc->getXRef(), ref, str, width, height, colorMap->getNumPixelComps(), colorMap->getBits());
+    }
+    Stream *imageStr = decodedStr ? decodedStr.get() : str;
+    imgData.imgStr = std::make_unique<ImageStream>(imageStr, width, colorMap->getNumPixelComps(), colorMap->getBits());
+    if (!imgData.imgStr->reset()) {
+        return;
+    }
+
     imgData.colorMap = colorMap;
     imgData.maskColors = maskColors;
     imgData.colorMode = colorMode;
@@ -3368,7 +3481,7 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str, int w
     }
 
     gfree(imgData.lookup);
-    str->close();
+    imageStr->close();
 }
 
 struct SplashOutMaskedImageData
@@ -4214,6 +4327,137 @@ void SplashOutputDev::setFreeTypeHinting(bool enable, bool enableSlightHintingA)
     enableSlightHinting = enableSlightHintingA;
 }
 
+void SplashOutputDev::displayPageSliceTiled(PDFDoc *docA, int page, double hDPI, double vDPI, int rotate, bool useMediaBox, bool crop, bool printing, int sliceX, int sliceY, int sliceW, int sliceH, bool (*abortCheckCbk)(void *data),
+                                            void *abortCheckCbkData, bool (*annotDisplayDecideCbk)(Annot *annot, void *user_data), void *annotDisplayDecideCbkData)
+{
+    Page *p = docA->getPage(page);
+    if (tileThreads <= 1 || !bitmapTopDown || colorMode == splashModeDeviceN8 || !p) {
+        docA->displayPageSlice(this, page, hDPI, vDPI, rotate, useMediaBox, crop, printing, sliceX, sliceY, sliceW, sliceH, abortCheckCbk, abortCheckCbkData, annotDisplayDecideCbk, annotDisplayDecideCbkData);
+        return;
+    }
+
+    // size of the whole page in device pixels, as computed by GfxState
+    int sliceHA = sliceH;
+    int sliceWA = sliceW;
+    if (sliceW < 0 || sliceH < 0) {
+        const PDFRectangle *box = useMediaBox ? p->getMediaBox() : p->getCropBox();
+        int rot = (rotate + p->getRotate()) % 360;
+        if (rot < 0) {
+            rot += 360;
+        }
+        double pageW, pageH;
+        if (rot == 90 || rot == 270) {
+            pageW = (box->y2 - box->y1) * hDPI / 72.0;
+            pageH = (box->x2 - box->x1) * vDPI / 72.0;
+        } else {
+            pageW = (box->x2 - box->x1) * hDPI / 72.0;
+            pageH = (box->y2 - box->y1) * vDPI / 72.0;
+        }
+        sliceWA = (int)(pageW + 0.5);
+        sliceHA = (int)(pageH + 0.5);
+    }
+    if (sliceWA <= 0 || sliceHA <= 0) {
+        docA->displayPageSlice(this, page, hDPI, vDPI, rotate, useMediaBox, crop, printing, sliceX, sliceY, sliceW, sliceH, abortCheckCbk, abortCheckCbkData, annotDisplayDecideCbk, annotDisplayDecideCbkData);
+        return;
+    }
+
+    // The rounding of transformed coordinates depends on their magnitude,
+    // so shifting the page up by the band's offset can move edges by a
+    // pixel.  Every band is therefore drawn with the transform of the whole
+    // slice, into a bitmap that reaches from the top of the slice to the end
+    // of the band.  It is clipped to the band's rows plus one row above and
+    // below, because Splash treats the first and last row of the clip
+    // region specially in places (the shape correction of shadings).  The
+    // bands share one halftone screen, the stochastic ones are random.
+    setupScreenParams(hDPI, vDPI);
+    SplashScreen screen(&screenParams);
+    screen.isStatic(0); // build the matrix before the threads copy it
+    const int bandH = (sliceHA + tileThreads - 1) / tileThreads;
+    const int nBands = (sliceHA + bandH - 1) / bandH;
+
+    // make sure the annotations are loaded before the threads race for them
+    Annots *annotList = p->getAnnots();
+
+    const SplashThinLineMode thinLineMode = splash->getThinLineMode();
+    std::vector<std::unique_ptr<SplashOutputDev>> bandOuts;
+    for (int i = 0; i < nBands; ++i) {
+        auto bandOut = std::make_unique<SplashOutputDev>(colorMode, bitmapRowPad, reverseVideo, keepAlphaChannel ? nullptr : paperColor, bitmapTopDown, thinLineMode, overprintPreview);
+        bandOut->setFontAntialias(fontAntialias);
+        bandOut->setVectorAntialias(vectorAntialias);
+        bandOut->setEnableFreeType(enableFreeType);
+        bandOut->setFreeTypeHinting(enableFreeTypeHinting, enableSlightHinting);
+        bandOut->setSkipText(skipHorizText, skipRotatedText);
+#ifdef USE_CMS
+        bandOut->setDisplayProfile(getDisplayProfile());
+        bandOut->setDefaultGrayProfile(getDefaultGrayProfile());
+        bandOut->setDefaultRGBProfile(getDefaultRGBProfile());
+        bandOut->setDefaultCMYKProfile(getDefaultCMYKProfile());
+#endif
+        // the screen parameters only depend on the resolution, the band's
+        // startPage() sets them up the same way
+        bandOut->bandYMin = i * bandH;
+        // the last band runs to the bottom of the page, whatever GfxState
+        // rounds its height to
+        bandOut->bandYMax = i == nBands - 1 ? INT_MAX : (i + 1) * bandH;
+        bandOut->bandScreen = &screen;
+        bandOut->startDoc(docA);
+        bandOuts.push_back(std::move(bandOut));
+    }
+
+    // Page::displaySlice() holds the page lock while drawing, so the bands
+    // drive their own Gfx instead
+    auto renderBand = [&](int i) {
+        SplashOutputDev *bandOut = bandOuts[i].get();
+        std::unique_ptr<Gfx> gfx = p->createGfx(bandOut, hDPI, vDPI, rotate, useMediaBox, crop, sliceX, sliceY, sliceW, sliceH, abortCheckCbk, abortCheckCbkData, docA->getXRef());
+        Object obj = p->getContents();
+        if (!obj.isNull()) {
+            gfx->saveState();
+            gfx->display(&obj);
+            gfx->restoreState();
+        }
+        for (const std::shared_ptr<Annot> &annot : annotList->getAnnots()) {
+            if (!annotDisplayDecideCbk || (*annotDisplayDecideCbk)(annot.get(), annotDisplayDecideCbkData)) {
+                annot->draw(gfx.get(), printing);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(nBands - 1);
+    for (int i = 1; i < nBands; ++i) {
+        threads.emplace_back(renderBand, i);
+    }
+    renderBand(0);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    // stitch the bands together
+    SplashBitmap *lastBitmap = bandOuts[nBands - 1]->getBitmap();
+    const int width = lastBitmap->getWidth();
+    const int height = lastBitmap->getHeight();
+    delete splash;
+    delete bitmap;
+    bitmap = new SplashBitmap(width, height, bitmapRowPad, colorMode, colorMode != splashModeMono1, bitmapTopDown);
+    splash = new Splash(bitmap, vectorAntialias, &screen);
+    splash->setThinLineMode(thinLineMode);
+    splash->setMinLineWidth(s_minLineWidth);
+    if (!bitmap->getDataPtr()) {
+        return;
+    }
+    for (int i = 0; i < nBands; ++i) {
+        SplashBitmap *bandBitmap = bandOuts[i]->getBitmap();
+        const int y0 = bandOuts[i]->bandYMin;
+        const int y1 = std::min({ bandOuts[i]->bandYMax, bandBitmap->getHeight(), height });
+        if (bandBitmap->getWidth() != width || bandBitmap->getRowSize() != bitmap->getRowSize() || y1 <= y0) {
+            continue;
+        }
+        memcpy(bitmap->getDataPtr() + (size_t)y0 * bitmap->getRowSize(), bandBitmap->getDataPtr() + (size_t)y0 * bitmap->getRowSize(), (size_t)(y1 - y0) * bitmap->getRowSize());
+        if (bitmap->getAlphaPtr() && bandBitmap->getAlphaPtr()) {
+            memcpy(bitmap->getAlphaPtr() + (size_t)y0 * width, bandBitmap->getAlphaPtr() + (size_t)y0 * width, (size_t)(y1 - y0) * width);
+        }
+    }
+}
+
 bool SplashOutputDev::tilingPatternFill(GfxState *state, Gfx *gfxA, Catalog *catalog, GfxTilingPattern *tPat, const double *mat, int x0, int y0, int x1, int y1, double xStep, double yStep)
 {
     PDFRectangle box;
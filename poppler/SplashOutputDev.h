@@ -45,6 +45,7 @@ class Gfx8BitFont;
 class SplashBitmap;
 class Splash;
 class SplashPath;
+class SplashScreen;
 class SplashFontEngine;
 class SplashFont;
 class T3FontCache;
@@ -347,6 +348,22 @@ public:
     void setFreeTypeHinting(bool enable, bool enableSlightHinting);
     void setEnableFreeType(bool enable) { enableFreeType = enable; }
 
+    // Number of threads used by displayPageSliceTiled(), 1 (the default)
+    // disables tiled rendering.
+    int getTileThreads() const { return tileThreads; }
+    void setTileThreads(int tileThreadsA) { tileThreads = tileThreadsA; }
+
+    // Like PDFDoc::displayPageSlice(), but if more than one tile thread is
+    // set the slice is split into horizontal bands.  Each band is rendered
+    // from the page content stream by its own thread, with the same
+    // settings as this device, into its own bitmap, and the bands are then
+    // stitched into this device's bitmap.  The result is the same as that
+    // of PDFDoc::displayPageSlice(), byte for byte.  The bitmap of a band
+    // spans the slice from its top to the end of the band.  Falls back to
+    // PDFDoc::displayPageSlice() for bottom-up bitmaps and DeviceN output.
+    void displayPageSliceTiled(PDFDoc *docA, int page, double hDPI, double vDPI, int rotate, bool useMediaBox, bool crop, bool printing, int sliceX, int sliceY, int sliceW, int sliceH, bool (*abortCheckCbk)(void *data) = nullptr,
+                               void *abortCheckCbkData = nullptr, bool (*annotDisplayDecideCbk)(Annot *annot, void *user_data) = nullptr, void *annotDisplayDecideCbkData = nullptr);
+
 protected:
     void doUpdateFont(GfxState *state);
 
@@ -389,6 +406,14 @@ private:
     SplashScreenParams screenParams;
     bool skipHorizText;
     bool skipRotatedText;
+    int tileThreads;
+    // rows [bandYMin, bandYMax) of the page are the only ones needed when
+    // this device renders a band for displayPageSliceTiled(), bandYMax is
+    // 0 when it renders whole pages; bandScreen is the halftone screen
+    // shared by all bands
+    int bandYMin;
+    int bandYMax;
+    SplashScreen *bandScreen;
 
     PDFDoc *doc; // the current document
     XRef *xref; // the xref of the current document
@@ -168,6 +168,22 @@ unsigned int Stream::discardChars(unsigned int n)
     return count;
 }
 
+int Stream::getImageReduction(int width, int height, int targetWidth, int targetHeight, int maxReduction)
+{
+    if (width <= 0 || height <= 0 || targetWidth <= 0 || targetHeight <= 0) {
+        return 0;
+    }
+    int reduction = 0;
+    while (reduction < maxReduction) {
+        const int scale = 2 << reduction;
+        if ((width + scale - 1) / scale < targetWidth || (height + scale - 1) / scale < targetHeight) {
+            break;
+        }
+        ++reduction;
+    }
+    return reduction;
+}
+
 std::optional<std::string> Stream::getPSFilter(int psLevel, const char *indent)
 {
     return std::string {};
@@ -389,12 +405,16 @@ Stream *Stream::makeFilter(const char *name, Stream *str, Object *params, int re
         str = new FlateStream(str, pred, columns, colors, bits);
     } else if (!strcmp(name, "JBIG2Decode")) {
         Object globals;
+        JBIG2GlobalsCache *globalsCache = nullptr;
         if (params->isDict()) {
             XRef *xref = params->getDict()->getXRef();
             obj = params->dictLookupNF("JBIG2Globals").copy();
             globals = obj.fetch(xref, recursion);
+            if (xref) {
+                globalsCache = xref->getJBIG2GlobalsCache();
+            }
         }
-        str = new JBIG2Stream(str, std::move(globals), &obj);
+        str = new JBIG2Stream(str, std::move(globals), &obj, globalsCache);
     } else if (!strcmp(name, "JPXDecode")) {
 #ifdef HAVE_JPX_DECODER
         str = new JPXStream(str);
@@ -1137,6 +1157,14 @@ void CachedFileStream::moveStart(Goffset delta)
     bufPos = start;
 }
 
+void CachedFileStream::prefetch(const std::vector<ByteRange> &ranges)
+{
+    // CachedFile::cache() takes no ranges as the whole file
+    if (!ranges.empty()) {
+        cc->cache(ranges);
+    }
+}
+
 MemStream::~MemStream() = default;
 
 AutoFreeMemStream::~AutoFreeMemStream() = default;
@@ -1151,6 +1179,40 @@ void AutoFreeMemStream::setFilterRemovalForbidden(bool forbidden)
     filterRemovalForbidden = forbidden;
 }
 
+//------------------------------------------------------------------------
+// MappedFileStream
+//------------------------------------------------------------------------
+
+static Goffset mappedStreamLength(const GooFile *file, Goffset start, bool limited, Goffset length)
+{
+    const Goffset fileSize = file->mappedSize();
+
+    if (start >= fileSize) {
+        return 0;
+    }
+    if (!limited || length > fileSize - start) {
+        return fileSize - start;
+    }
+    return length;
+}
+
+MappedFileStream::MappedFileStream(GooFile *fileA, Goffset startA, bool limitedA, Goffset lengthA, Object &&dictA)
+    : BaseMemStream(fileA->map(), startA, mappedStreamLength(fileA, startA, limitedA, lengthA), std::move(dictA)), file(fileA)
+{
+}
+
+MappedFileStream::~MappedFileStream() = default;
+
+BaseStream *MappedFileStream::copy()
+{
+    return new MappedFileStream(file, getStart(), true, length, dict.copy());
+}
+
+std::unique_ptr<Stream> MappedFileStream::makeSubStream(Goffset startA, bool limitedA, Goffset lengthA, Object &&dictA)
+{
+    return std::make_unique<MappedFileStream>(file, startA, limitedA, lengthA, std::move(dictA));
+}
+
 //------------------------------------------------------------------------
 // EmbedStream
 //------------------------------------------------------------------------
@@ -1163,6 +1225,7 @@ EmbedStream::EmbedStream(Stream *strA, Object &&dictA, bool limitedA, Goffset le
     reusable = reusableA;
     record = false;
     replay = false;
+    resume = false;
     start = str->getPos();
     if (reusable) {
         bufData = (unsigned char *)gmalloc(16384);
@@ -1182,6 +1245,12 @@ EmbedStream::~EmbedStream()
 bool EmbedStream::reset()
 {
     bool success = true;
+    if (resume) {
+        // the data that was put back hasn't all been read again
+        replay = true;
+        bufPos = 0;
+        return true;
+    }
     if (str->getPos() != start) {
         success = str->reset();
         // Might be a FilterStream that does not support str->setPos(start)
@@ -1226,6 +1295,14 @@ void EmbedStream::restore()
     replay = false;
 }
 
+void EmbedStream::unread()
+{
+    record = false;
+    replay = true;
+    resume = true;
+    bufPos = 0;
+}
+
 Goffset EmbedStream::getPos()
 {
     if (replay) {
@@ -1240,25 +1317,25 @@ int EmbedStream::getChar()
     if (replay) {
         if (bufPos < bufLen) {
             return bufData[bufPos++];
-        } else {
+        } else if (!resume) {
             return EOF;
         }
-    } else {
-        if (limited && !length) {
-            return EOF;
-        }
-        int c = str->getChar();
-        --length;
-        if (record) {
-            bufData[bufLen] = c;
-            bufLen++;
-            if (bufLen >= bufMax) {
-                bufMax *= 2;
-                bufData = (unsigned char *)grealloc(bufData, bufMax);
-            }
+        replay = resume = false;
+    }
+    if (limited && !length) {
+        return EOF;
+    }
+    int c = str->getChar();
+    --length;
+    if (record) {
+        bufData[bufLen] = c;
+        bufLen++;
+        if (bufLen >= bufMax) {
+            bufMax *= 2;
+            bufData = (unsigned char *)grealloc(bufData, bufMax);
         }
-        return c;
     }
+    return c;
 }
 
 int EmbedStream::lookChar()
@@ -1266,51 +1343,53 @@ int EmbedStream::lookChar()
     if (replay) {
         if (bufPos < bufLen) {
             return bufData[bufPos];
-        } else {
+        } else if (!resume) {
             return EOF;
         }
-    } else {
-        if (limited && !length) {
-            return EOF;
-        }
-        return str->lookChar();
+        replay = resume = false;
+    }
+    if (limited && !length) {
+        return EOF;
     }
+    return str->lookChar();
 }
 
 int EmbedStream::getChars(int nChars, unsigned char *buffer)
 {
-    int len;
+    int len, replayLen;
 
     if (nChars <= 0) {
         return 0;
     }
+    replayLen = 0;
     if (replay) {
-        if (bufPos >= bufLen) {
-            return EOF;
+        if (bufPos < bufLen) {
+            replayLen = bufLen - bufPos < nChars ? (int)(bufLen - bufPos) : nChars;
+            memcpy(buffer, bufData + bufPos, replayLen);
+            bufPos += replayLen;
         }
-        len = bufLen - bufPos;
-        if (nChars > len) {
-            nChars = len;
+        if (replayLen == nChars || !resume) {
+            return replayLen;
         }
-        memcpy(buffer, bufData, nChars);
-        return len;
-    } else {
-        if (limited && length < nChars) {
-            nChars = length;
-        }
-        len = str->doGetChars(nChars, buffer);
-        if (record) {
-            if (bufLen + len >= bufMax) {
-                while (bufLen + len >= bufMax) {
-                    bufMax *= 2;
-                }
-                bufData = (unsigned char *)grealloc(bufData, bufMax);
+        replay = resume = false;
+        nChars -= replayLen;
+        buffer += replayLen;
+    }
+    if (limited && length < nChars) {
+        nChars = length;
+    }
+    len = str->doGetChars(nChars, buffer);
+    if (record) {
+        if (bufLen + len >= bufMax) {
+            while (bufLen + len >= bufMax) {
+                bufMax *= 2;
             }
-            memcpy(bufData + bufLen, buffer, len);
-            bufLen += len;
+            bufData = (unsigned char *)grealloc(bufData, bufMax);
         }
+        memcpy(bufData + bufLen, buffer, len);
+        bufLen += len;
     }
-    return len;
+    return replayLen + len;
 }
 
 void EmbedStream::setPos(Goffset pos, int dir)
@@ -66,6 +66,7 @@ enum StreamKind
 {
     strFile,
     strCachedFile,
+    strMappedFile,
     strASCIIHex,
     strASCII85,
     strLZW,
@@ -260,6 +261,22 @@ public:
     // Get image parameters which are defined by the stream contents.
     virtual void getImageParams(int * /*bitsPerComponent*/, StreamColorSpaceMode * /*csMode*/, bool * /*hasAlpha*/) { }
 
+    // Ask an image decoder to decode a <width> x <height> image at a
+    // lower resolution, because it is only drawn at <targetWidth> x
+    // <targetHeight> device pixels.  Returns the reduction <n> the stream
+    // will apply: it then produces ceil(width / 2^n) x ceil(height / 2^n)
+    // samples.  Must be called before reset().
+    virtual int setReducedDecoding(int /*width*/, int /*height*/, int /*targetWidth*/, int /*targetHeight*/) { return 0; }
+
+    // Ask an image decoder to only decode columns <x0> to <x1> and rows
+    // <y0> to <y1> (exclusive, in full resolution samples), because the
+    // rest of the image is clipped away.  With the reduction <n> from
+    // setReducedDecoding(), the stream then produces
+    // ceil(x1 / 2^n) - ceil(x0 / 2^n) x ceil(y1 / 2^n) - ceil(y0 / 2^n)
+    // samples.  Returns false if the whole image is decoded instead.
+    // Must be called before reset().
+    virtual bool setDecodeArea(int /*x0*/, int /*y0*/, int /*x1*/, int /*y1*/) { return false; }
+
     // Return the next stream in the "stack".
     virtual Stream *getNextStream() const { return nullptr; }
 
@@ -270,6 +287,11 @@ public:
     // Returns true if this stream includes a crypt filter.
     bool isEncrypted() const;
 
+protected:
+    // Largest reduction, up to <maxReduction>, for setReducedDecoding()
+    // that still keeps at least the target resolution.
+    static int getImageReduction(int width, int height, int targetWidth, int targetHeight, int maxReduction);
+
 private:
     friend class Object; // for incRef/decRef
 
@@ -367,6 +389,11 @@ public:
     virtual Goffset getStart() = 0;
     virtual void moveStart(Goffset delta) = 0;
 
+    // Hint that the byte <ranges> of the file, in the same positions as
+    // setPos(), are about to be read.  Streams over slow transports load
+    // them at once.
+    virtual void prefetch(const std::vector<ByteRange> & /*ranges*/) { }
+
 protected:
     Goffset length;
     Object dict;
@@ -628,6 +655,7 @@ public:
     void setPos(Goffset pos, int dir = 0) override;
     Goffset getStart() override { return start; }
     void moveStart(Goffset delta) override;
+    void prefetch(const std::vector<ByteRange> &ranges) override;
 
     int getUnfilteredChar() override { return getChar(); }
     [[nodiscard]] bool unfilteredReset() override { return reset(); }
@@ -777,6 +805,28 @@ public:
     void setFilterRemovalForbidden(bool forbidden);
 };
 
+//------------------------------------------------------------------------
+// MappedFileStream
+//
+// A FileStream replacement that reads straight out of a file mapped
+// with GooFile::map(), without copying through a buffer.  Like
+// FileStream it does not own the GooFile, which must outlive the stream
+// and all its copies and substreams.
+//------------------------------------------------------------------------
+
+class POPPLER_PRIVATE_EXPORT MappedFileStream final : public BaseMemStream<const char>
+{
+public:
+    MappedFileStream(GooFile *fileA, Goffset startA, bool limitedA, Goffset lengthA, Object &&dictA);
+    ~MappedFileStream() override;
+    BaseStream *copy() override;
+    std::unique_ptr<Stream> makeSubStream(Goffset startA, bool limitedA, Goffset lengthA, Object &&dictA) override;
+    StreamKind getKind() const override { return strMappedFile; }
+
+private:
+    GooFile *file;
+};
+
 //------------------------------------------------------------------------
 // EmbedStream
 //
@@ -809,6 +859,11 @@ public:
     void rewind();
     void restore();
 
+    // Put back the data read so far, which a reusable stream records
+    // until it is reset: it is read again, and then the data after it.
+    // A reset() before it has all been read again starts it over.
+    void unread();
+
 private:
     bool hasGetChars() override { return true; }
     int getChars(int nChars, unsigned char *buffer) override;
@@ -818,6 +873,7 @@ private:
     bool reusable;
     bool record;
     bool replay;
+    bool resume; // go on with <str> at the end of the replay
     unsigned char *bufData;
     long bufMax;
     long bufLen;
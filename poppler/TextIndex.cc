@@ -0,0 +1,608 @@
+//========================================================================
+//
+// TextIndex.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <string_view>
+#include "goo/gfile.h"
+#include "goo/gmem.h"
+#include "Error.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "TextOutputDev.h"
+#include "UnicodeMap.h"
+#include "UnicodeMapFuncs.h"
+#include "UnicodeTypeTable.h"
+#include "TextIndex.h"
+
+#define textIndexMagic 0x49585450 // "PTXI" in little endian
+#define textIndexVersion 1
+
+// the header, in 32 bit words
+enum TextIndexHeader
+{
+    textIndexHdrMagic,
+    textIndexHdrVersion,
+    textIndexHdrNumPages,
+    textIndexHdrNumTerms,
+    textIndexHdrTerms, // offset of the terms, in words
+    textIndexHdrNumOccurrences,
+    textIndexHdrOccurrences,
+    textIndexHdrNumEdges,
+    textIndexHdrEdges,
+    textIndexHdrStrings,
+    textIndexHdrStringsSize, // in bytes
+    textIndexHdrLength
+};
+
+// a term: offset of its string (in bytes, from the strings), length of
+// its string in bytes, its number of characters, its first occurrence,
+// its number of occurrences
+#define textIndexTermWords 5
+
+// an occurrence: page, position on the page, rotation, extent across
+// the writing direction (2 floats), first edge
+#define textIndexOccurrenceWords 6
+
+static inline uint32_t floatToWord(float f)
+{
+    uint32_t w;
+    memcpy(&w, &f, sizeof(w));
+    return w;
+}
+
+static inline float wordToFloat(uint32_t w)
+{
+    float f;
+    memcpy(&f, &w, sizeof(f));
+    return f;
+}
+
+//------------------------------------------------------------------------
+
+namespace {
+
+// A normalized word: its UTF-8 string, and for each of its characters
+// the index of the character it comes from.
+struct TextIndexToken
+{
+    std::string term;
+    std::vector<int> chars;
+};
+
+}
+
+// unicodeTypeAlphaNum() also counts the separators of numbers, like '.'
+// and '/', which would join the words of a URL or a date.
+static bool isWordChar(Unicode c)
+{
+    if (c < 0x80) {
+        return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+    }
+    return unicodeTypeL(c) || unicodeTypeR(c);
+}
+
+// Normalize <u> and split it into words at anything that isn't a letter
+// or a digit.
+static std::vector<TextIndexToken> tokenize(const Unicode *u, int len)
+{
+    std::vector<TextIndexToken> tokens;
+    if (len <= 0) {
+        return tokens;
+    }
+
+    int normLen;
+    int *normIdx = nullptr;
+    Unicode *norm = unicodeNormalizeNFKC(u, len, &normLen, &normIdx);
+    const UnicodeMap *ascii7 = globalParams->getUnicodeMap("ASCII7");
+
+    TextIndexToken token;
+    char buf[8];
+    for (int i = 0; i < normLen; ++i) {
+        const Unicode c = unicodeToUpper(norm[i]);
+        Unicode folded[sizeof(buf)];
+        int nFolded = 0;
+        int n;
+        if (c >= 0x80 && ascii7 && (n = ascii7->mapUnicode(c, buf, sizeof(buf))) > 0) {
+            // drop the diacritics
+            for (int j = 0; j < n; ++j) {
+                folded[nFolded++] = unicodeToUpper((unsigned char)buf[j]);
+            }
+        } else {
+            folded[nFolded++] = c;
+        }
+        for (int j = 0; j < nFolded; ++j) {
+            if (folded[j] >= 0x300 && folded[j] <= 0x36f) {
+                // a combining diacritic doesn't end the word
+                continue;
+            }
+            if (isWordChar(folded[j])) {
+                char utf8[8];
+                token.term.append(utf8, mapUTF8(folded[j], utf8, sizeof(utf8)));
+                token.chars.push_back(normIdx[i]);
+            } else {
+                if (!token.chars.empty()) {
+                    tokens.push_back(std::move(token));
+                    token = TextIndexToken();
+                }
+            }
+        }
+    }
+    if (!token.chars.empty()) {
+        tokens.push_back(std::move(token));
+    }
+
+    gfree(norm);
+    gfree(normIdx);
+    return tokens;
+}
+
+//------------------------------------------------------------------------
+// TextIndex
+//------------------------------------------------------------------------
+
+TextIndex::TextIndex() : data(nullptr), size(0) { }
+
+TextIndex::~TextIndex() = default;
+
+std::unique_ptr<TextIndex> TextIndex::build(PDFDoc *doc)
+{
+    TextIndexBuilder builder;
+
+    for (int page = 1; page <= doc->getNumPages(); ++page) {
+        TextOutputDev textOut(nullptr, false, 0, false, false);
+        doc->displayPage(&textOut, page, 72, 72, 0, false, true, false);
+        TextPage *text = textOut.takeText();
+        builder.addPage(page, text);
+        text->decRefCnt();
+    }
+    return builder.finish();
+}
+
+std::unique_ptr<TextIndex> TextIndex::load(const std::string &fileName)
+{
+    std::unique_ptr<TextIndex> index(new TextIndex());
+
+    index->file = GooFile::open(fileName);
+    if (!index->file) {
+        error(errIO, -1, "Couldn't open text index '{0:s}'", fileName.c_str());
+        return nullptr;
+    }
+    const Goffset fileSize = index->file->size();
+    if (fileSize < (Goffset)(textIndexHdrLength * sizeof(uint32_t)) || fileSize % sizeof(uint32_t) != 0 || (unsigned long long)fileSize > SIZE_MAX) {
+        error(errSyntaxError, -1, "'{0:s}' isn't a text index", fileName.c_str());
+        return nullptr;
+    }
+    index->size = fileSize / sizeof(uint32_t);
+
+    if (const char *mapping = index->file->map()) {
+        index->data = reinterpret_cast<const uint32_t *>(mapping);
+    } else {
+        index->buf.resize(index->size);
+        char *p = reinterpret_cast<char *>(index->buf.data());
+        for (Goffset pos = 0; pos < fileSize;) {
+            const int n = index->file->read(p + pos, (int)std::min<Goffset>(fileSize - pos, INT_MAX), pos);
+            if (n <= 0) {
+                error(errIO, -1, "Couldn't read text index '{0:s}'", fileName.c_str());
+                return nullptr;
+            }
+            pos += n;
+        }
+        index->data = index->buf.data();
+    }
+
+    if (!index->init()) {
+        error(errSyntaxError, -1, "'{0:s}' isn't a text index", fileName.c_str());
+        return nullptr;
+    }
+    return index;
+}
+
+static std::string_view getTermString(const uint32_t *data, uint32_t term)
+{
+    const uint32_t *rec = data + data[textIndexHdrTerms] + (size_t)term * textIndexTermWords;
+    return std::string_view(reinterpret_cast<const char *>(data + data[textIndexHdrStrings]) + rec[0], rec[1]);
+}
+
+// Check the whole index, so that the queries don't have to: the tables
+// must fill the index as finish() lays them out, the string and the
+// occurrences of every term must be within their tables, and the edges
+// of every occurrence within theirs.
+// The terms, and the occurrences of each term, must be sorted for the
+// binary searches.
+bool TextIndex::init()
+{
+    if (size < textIndexHdrLength || data[textIndexHdrMagic] != textIndexMagic || data[textIndexHdrVersion] != textIndexVersion) {
+        return false;
+    }
+    // the tables follow each other, in the order save() writes them
+    const uint64_t occurrencesOffset = textIndexHdrLength + (uint64_t)data[textIndexHdrNumTerms] * textIndexTermWords;
+    const uint64_t edgesOffset = occurrencesOffset + (uint64_t)data[textIndexHdrNumOccurrences] * textIndexOccurrenceWords;
+    const uint64_t stringsOffset = edgesOffset + data[textIndexHdrNumEdges];
+    if (data[textIndexHdrTerms] != textIndexHdrLength || data[textIndexHdrOccurrences] != occurrencesOffset || data[textIndexHdrEdges] != edgesOffset || data[textIndexHdrStrings] != stringsOffset
+        || size != stringsOffset + ((uint64_t)data[textIndexHdrStringsSize] + 3) / 4) {
+        return false;
+    }
+
+    const uint32_t numPages = data[textIndexHdrNumPages];
+    const uint32_t numTerms = data[textIndexHdrNumTerms];
+    const uint32_t numOccurrences = data[textIndexHdrNumOccurrences];
+    const uint32_t numEdges = data[textIndexHdrNumEdges];
+    const uint32_t stringsSize = data[textIndexHdrStringsSize];
+    const uint32_t *occurrences = data + data[textIndexHdrOccurrences];
+    uint32_t nextOccurrence = 0;
+    std::string_view prevTerm;
+    for (uint32_t t = 0; t < numTerms; ++t) {
+        // the occurrences of the terms follow each other
+        const uint32_t *rec = data + data[textIndexHdrTerms] + (size_t)t * textIndexTermWords;
+        if (rec[0] > stringsSize || rec[1] == 0 || rec[1] > stringsSize - rec[0] || rec[2] == 0 || rec[3] != nextOccurrence || rec[4] == 0 || rec[4] > numOccurrences - rec[3]) {
+            return false;
+        }
+        const std::string_view term = getTermString(data, t);
+        if (t > 0 && term <= prevTerm) {
+            return false;
+        }
+        prevTerm = term;
+
+        for (uint32_t o = rec[3]; o < rec[3] + rec[4]; ++o) {
+            const uint32_t *occ = occurrences + (size_t)o * textIndexOccurrenceWords;
+            if (occ[0] == 0 || occ[0] > numPages || occ[2] > 3 || occ[5] > numEdges || rec[2] >= numEdges - occ[5]) {
+                return false;
+            }
+            if (o > rec[3] && (occ[0] < occ[-textIndexOccurrenceWords] || (occ[0] == occ[-textIndexOccurrenceWords] && occ[1] <= occ[1 - textIndexOccurrenceWords]))) {
+                return false;
+            }
+        }
+        nextOccurrence = rec[3] + rec[4];
+    }
+    return nextOccurrence == numOccurrences;
+}
+
+bool TextIndex::save(const std::string &fileName) const
+{
+    FILE *f = openFile(fileName.c_str(), "wb");
+    if (!f) {
+        error(errIO, -1, "Couldn't open text index '{0:s}' for writing", fileName.c_str());
+        return false;
+    }
+    const bool ok = fwrite(data, sizeof(uint32_t), size, f) == size;
+    if (fclose(f) != 0 || !ok) {
+        error(errIO, -1, "Couldn't write text index '{0:s}'", fileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+int TextIndex::getNumPages() const
+{
+    return data[textIndexHdrNumPages];
+}
+
+int TextIndex::getNumTerms() const
+{
+    return data[textIndexHdrNumTerms];
+}
+
+std::string TextIndex::getTerm(uint32_t term) const
+{
+    return std::string(getTermString(data, term));
+}
+
+// Set [<first>, <last>) to the terms equal to <word>, or starting with it
+// if <prefix> is true.
+void TextIndex::findTerms(const std::string &word, bool prefix, uint32_t *first, uint32_t *last) const
+{
+    uint32_t lo = 0, hi = data[textIndexHdrNumTerms];
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (getTermString(data, mid) < word) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *first = lo;
+
+    hi = data[textIndexHdrNumTerms];
+    if (!prefix) {
+        *last = (lo < hi && getTermString(data, lo) == word) ? lo + 1 : lo;
+        return;
+    }
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (getTermString(data, mid).substr(0, word.size()) == word) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *last = lo;
+}
+
+// Find an occurrence of one of the terms [<firstTerm>, <lastTerm>) at
+// <position> on <page>.
+bool TextIndex::findOccurrence(uint32_t firstTerm, uint32_t lastTerm, uint32_t page, uint32_t position, uint32_t *term, uint32_t *occurrence) const
+{
+    const uint32_t *occurrences = data + data[textIndexHdrOccurrences];
+    for (uint32_t t = firstTerm; t < lastTerm; ++t) {
+        const uint32_t *rec = data + data[textIndexHdrTerms] + (size_t)t * textIndexTermWords;
+        uint32_t lo = rec[3], hi = rec[3] + rec[4];
+        while (lo < hi) {
+            const uint32_t mid = lo + (hi - lo) / 2;
+            const uint32_t *occ = occurrences + (size_t)mid * textIndexOccurrenceWords;
+            if (occ[0] < page || (occ[0] == page && occ[1] < position)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < rec[3] + rec[4]) {
+            const uint32_t *occ = occurrences + (size_t)lo * textIndexOccurrenceWords;
+            if (occ[0] == page && occ[1] == position) {
+                *term = t;
+                *occurrence = lo;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Get the box of the first <nChars> characters of <occurrence>.
+PDFRectangle TextIndex::getRect(uint32_t term, uint32_t occurrence, uint32_t nChars) const
+{
+    const uint32_t *rec = data + data[textIndexHdrTerms] + (size_t)term * textIndexTermWords;
+    const uint32_t *occ = data + data[textIndexHdrOccurrences] + (size_t)occurrence * textIndexOccurrenceWords;
+    nChars = std::min(nChars, rec[2]);
+    const uint32_t *edges = data + data[textIndexHdrEdges] + occ[5];
+    const double start = wordToFloat(edges[0]);
+    const double end = wordToFloat(edges[nChars]);
+    const double crossMin = wordToFloat(occ[3]);
+    const double crossMax = wordToFloat(occ[4]);
+    if (occ[2] == 0 || occ[2] == 2) {
+        return PDFRectangle(std::min(start, end), crossMin, std::max(start, end), crossMax);
+    }
+    return PDFRectangle(crossMin, std::min(start, end), crossMax, std::max(start, end));
+}
+
+std::vector<TextIndex::Match> TextIndex::find(const Unicode *s, int len, bool prefix) const
+{
+    std::vector<Match> matches;
+    const std::vector<TextIndexToken> words = tokenize(s, len);
+    if (words.empty()) {
+        return matches;
+    }
+
+    const size_t n = words.size();
+    std::vector<uint32_t> firstTerms(n), lastTerms(n);
+    for (size_t i = 0; i < n; ++i) {
+        findTerms(words[i].term, prefix && i == n - 1, &firstTerms[i], &lastTerms[i]);
+        if (firstTerms[i] == lastTerms[i]) {
+            return matches;
+        }
+    }
+
+    // every occurrence of the first word starts a candidate match
+    struct Start
+    {
+        uint32_t page, position, term, occurrence;
+    };
+    std::vector<Start> starts;
+    const uint32_t *occurrences = data + data[textIndexHdrOccurrences];
+    for (uint32_t t = firstTerms[0]; t < lastTerms[0]; ++t) {
+        const uint32_t *rec = data + data[textIndexHdrTerms] + (size_t)t * textIndexTermWords;
+        for (uint32_t o = rec[3]; o < rec[3] + rec[4]; ++o) {
+            const uint32_t *occ = occurrences + (size_t)o * textIndexOccurrenceWords;
+            starts.push_back({ occ[0], occ[1], t, o });
+        }
+    }
+    if (lastTerms[0] - firstTerms[0] > 1) {
+        std::sort(starts.begin(), starts.end(), [](const Start &a, const Start &b) { return a.page < b.page || (a.page == b.page && a.position < b.position); });
+    }
+
+    for (const Start &start : starts) {
+        Match match;
+        match.page = start.page;
+        bool found = true;
+        for (size_t i = 0; i < n && found; ++i) {
+            uint32_t term = start.term, occurrence = start.occurrence;
+            if (i > 0) {
+                found = findOccurrence(firstTerms[i], lastTerms[i], start.page, start.position + i, &term, &occurrence);
+            }
+            // the whole word, or as much of it as the search word covers
+            const uint32_t nChars = (prefix && i == n - 1) ? words[i].chars.size() : UINT32_MAX;
+            if (found) {
+                match.rects.push_back(getRect(term, occurrence, nChars));
+            }
+        }
+        if (found) {
+            matches.push_back(std::move(match));
+        }
+    }
+    return matches;
+}
+
+//------------------------------------------------------------------------
+// TextIndexBuilder
+//------------------------------------------------------------------------
+
+TextIndexBuilder::TextIndexBuilder() : numPages(0) { }
+
+TextIndexBuilder::~TextIndexBuilder() = default;
+
+void TextIndexBuilder::addPage(int page, TextPage *text)
+{
+    std::unique_ptr<TextWordList> words = text->makeWordList(false);
+    uint32_t position = 0;
+
+    numPages = std::max(numPages, page);
+    for (int w = 0; w < words->getLength(); ++w) {
+        const TextWord *word = words->get(w);
+        const int len = word->getLength();
+        if (len == 0) {
+            continue;
+        }
+        std::vector<Unicode> u(len);
+        for (int i = 0; i < len; ++i) {
+            u[i] = *word->getChar(i);
+        }
+        const std::vector<TextIndexToken> tokens = tokenize(u.data(), len);
+        if (tokens.empty()) {
+            continue;
+        }
+
+        // where each character starts and ends along the writing
+        // direction
+        const int rot = word->getRotation();
+        std::vector<double> starts(len), ends(len);
+        for (int i = 0; i < len; ++i) {
+            double xMin, yMin, xMax, yMax;
+            word->getCharBBox(i, &xMin, &yMin, &xMax, &yMax);
+            switch (rot) {
+            case 0:
+            default:
+                starts[i] = xMin;
+                ends[i] = xMax;
+                break;
+            case 1:
+                starts[i] = yMin;
+                ends[i] = yMax;
+                break;
+            case 2:
+                starts[i] = xMax;
+                ends[i] = xMin;
+                break;
+            case 3:
+                starts[i] = yMax;
+                ends[i] = yMin;
+                break;
+            }
+        }
+        double xMin, yMin, xMax, yMax;
+        word->getBBox(&xMin, &yMin, &xMax, &yMax);
+        const bool horizontal = rot == 0 || rot == 2;
+
+        // a character that normalizes to several ones (a ligature) is
+        // split evenly between them
+        std::vector<int> count(len, 0), seen(len, 0);
+        for (const TextIndexToken &token : tokens) {
+            for (const int c : token.chars) {
+                ++count[c];
+            }
+        }
+        const auto edge = [&](int c) { return (float)(starts[c] + (ends[c] - starts[c]) * seen[c] / count[c]); };
+
+        for (const TextIndexToken &token : tokens) {
+            auto inserted = termIds.try_emplace(token.term, (uint32_t)terms.size());
+            if (inserted.second) {
+                terms.push_back(&inserted.first->first);
+                termLengths.push_back(token.chars.size());
+            }
+            occurrences.push_back({ inserted.first->second, (uint32_t)page, position++, (uint32_t)rot, (float)(horizontal ? yMin : xMin), (float)(horizontal ? yMax : xMax), (uint32_t)edges.size() });
+            for (const int c : token.chars) {
+                edges.push_back(edge(c));
+                ++seen[c];
+            }
+            edges.push_back(edge(token.chars.back()));
+        }
+    }
+}
+
+std::unique_ptr<TextIndex> TextIndexBuilder::finish()
+{
+    const uint32_t numTerms = terms.size();
+
+    // sort the terms, and the occurrences by term, page and position
+    std::vector<uint32_t> order(numTerms), rank(numTerms);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return *terms[a] < *terms[b]; });
+    for (uint32_t r = 0; r < numTerms; ++r) {
+        rank[order[r]] = r;
+    }
+    std::sort(occurrences.begin(), occurrences.end(), [&rank](const Occurrence &a, const Occurrence &b) {
+        if (a.term != b.term) {
+            return rank[a.term] < rank[b.term];
+        }
+        return a.page < b.page || (a.page == b.page && a.position < b.position);
+    });
+
+    size_t stringsSize = 0;
+    for (const std::string *term : terms) {
+        stringsSize += term->size();
+    }
+    const size_t termsOffset = textIndexHdrLength;
+    const size_t occurrencesOffset = termsOffset + (size_t)numTerms * textIndexTermWords;
+    const size_t edgesOffset = occurrencesOffset + occurrences.size() * textIndexOccurrenceWords;
+    const size_t stringsOffset = edgesOffset + edges.size();
+    const size_t size = stringsOffset + (stringsSize + 3) / 4;
+    if (size > UINT32_MAX || stringsSize > UINT32_MAX) {
+        error(errInternal, -1, "Text index is too large");
+        return nullptr;
+    }
+
+    std::unique_ptr<TextIndex> index(new TextIndex());
+    std::vector<uint32_t> &buf = index->buf;
+    buf.resize(size, 0);
+    buf[textIndexHdrMagic] = textIndexMagic;
+    buf[textIndexHdrVersion] = textIndexVersion;
+    buf[textIndexHdrNumPages] = numPages;
+    buf[textIndexHdrNumTerms] = numTerms;
+    buf[textIndexHdrTerms] = termsOffset;
+    buf[textIndexHdrNumOccurrences] = occurrences.size();
+    buf[textIndexHdrOccurrences] = occurrencesOffset;
+    buf[textIndexHdrNumEdges] = edges.size();
+    buf[textIndexHdrEdges] = edgesOffset;
+    buf[textIndexHdrStrings] = stringsOffset;
+    buf[textIndexHdrStringsSize] = stringsSize;
+
+    char *strings = reinterpret_cast<char *>(buf.data() + stringsOffset);
+    uint32_t stringPos = 0;
+    size_t o = 0;
+    for (uint32_t r = 0; r < numTerms; ++r) {
+        const uint32_t id = order[r];
+        uint32_t *rec = buf.data() + termsOffset + (size_t)r * textIndexTermWords;
+        rec[0] = stringPos;
+        rec[1] = terms[id]->size();
+        rec[2] = termLengths[id];
+        rec[3] = o;
+        while (o < occurrences.size() && occurrences[o].term == id) {
+            ++o;
+        }
+        rec[4] = o - rec[3];
+        memcpy(strings + stringPos, terms[id]->data(), terms[id]->size());
+        stringPos += terms[id]->size();
+    }
+    for (size_t i = 0; i < occurrences.size(); ++i) {
+        const Occurrence &occ = occurrences[i];
+        uint32_t *rec = buf.data() + occurrencesOffset + i * textIndexOccurrenceWords;
+        rec[0] = occ.page;
+        rec[1] = occ.position;
+        rec[2] = occ.rot;
+        rec[3] = floatToWord(occ.crossMin);
+        rec[4] = floatToWord(occ.crossMax);
+        rec[5] = occ.firstEdge;
+    }
+    for (size_t i = 0; i < edges.size(); ++i) {
+        buf[edgesOffset + i] = floatToWord(edges[i]);
+    }
+    index->data = buf.data();
+    index->size = size;
+
+    termIds.clear();
+    terms.clear();
+    termLengths.clear();
+    occurrences.clear();
+    edges.clear();
+    numPages = 0;
+    return index;
+}
@@ -0,0 +1,135 @@
+//========================================================================
+//
+// TextIndex.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef TEXTINDEX_H
+#define TEXTINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CharTypes.h"
+#include "Page.h"
+#include "poppler_private_export.h"
+
+class GooFile;
+class PDFDoc;
+class TextPage;
+
+//------------------------------------------------------------------------
+// TextIndex
+//------------------------------------------------------------------------
+
+// A full-text index of a document, made once from the TextPages of its
+// pages, that finds words and phrases without running the content
+// streams again.
+//
+// Words are indexed in a normalized form: NFKC, case folded, without
+// diacritics (where the ASCII7 unicode map knows the letter), and split
+// at anything that isn't a letter or digit, so that "Résumé," matches
+// "resume".  For every occurrence the index keeps the page, the position
+// of the word on the page (in reading order) and the edges of its
+// characters, so that a match can be highlighted without the TextPage.
+//
+// The index is a flat array of 32 bit words, in the byte order of the
+// machine that made it, that load() maps into memory as it is: the
+// sorted terms, the occurrences of each term sorted by page and
+// position, the character edges, and the term strings in UTF-8.
+class POPPLER_PRIVATE_EXPORT TextIndex
+{
+public:
+    struct Match
+    {
+        int page; // 1-based
+        std::vector<PDFRectangle> rects; // one per word, in TextPage coordinates
+    };
+
+    ~TextIndex();
+
+    TextIndex(const TextIndex &) = delete;
+    TextIndex &operator=(const TextIndex &) = delete;
+
+    // Index all the pages of <doc>, unrotated.
+    static std::unique_ptr<TextIndex> build(PDFDoc *doc);
+
+    // Map the index saved in <fileName>, and check all of it.  Returns
+    // nullptr if the file isn't an index written by save() on a machine
+    // of the same byte order, or is damaged.
+    static std::unique_ptr<TextIndex> load(const std::string &fileName);
+    bool save(const std::string &fileName) const;
+
+    // Find the places where the words of <s> follow each other on a
+    // page, in page order.  If <prefix> is true the last word only has
+    // to start with the last word of <s>, for search as you type.
+    std::vector<Match> find(const Unicode *s, int len, bool prefix) const;
+
+    int getNumPages() const;
+    int getNumTerms() const;
+    // Size of the index, in bytes.
+    size_t getSize() const { return size * sizeof(uint32_t); }
+
+private:
+    TextIndex();
+
+    bool init();
+    std::string getTerm(uint32_t term) const;
+    void findTerms(const std::string &word, bool prefix, uint32_t *first, uint32_t *last) const;
+    bool findOccurrence(uint32_t firstTerm, uint32_t lastTerm, uint32_t page, uint32_t position, uint32_t *term, uint32_t *occurrence) const;
+    PDFRectangle getRect(uint32_t term, uint32_t occurrence, uint32_t nChars) const;
+
+    std::unique_ptr<GooFile> file;
+    std::vector<uint32_t> buf; // if the index isn't mapped
+    const uint32_t *data;
+    size_t size; // in words
+
+    friend class TextIndexBuilder;
+};
+
+//------------------------------------------------------------------------
+// TextIndexBuilder
+//------------------------------------------------------------------------
+
+class POPPLER_PRIVATE_EXPORT TextIndexBuilder
+{
+public:
+    TextIndexBuilder();
+    ~TextIndexBuilder();
+
+    TextIndexBuilder(const TextIndexBuilder &) = delete;
+    TextIndexBuilder &operator=(const TextIndexBuilder &) = delete;
+
+    // Add the words of <text>, the text of page <page> (1-based).  Each
+    // page must only be added once.
+    void addPage(int page, TextPage *text);
+
+    // Return the index of the pages added so far.
+    std::unique_ptr<TextIndex> finish();
+
+private:
+    struct Occurrence
+    {
+        uint32_t term;
+        uint32_t page;
+        uint32_t position;
+        uint32_t rot;
+        float crossMin, crossMax; // extent across the writing direction
+        uint32_t firstEdge; // in edges
+    };
+
+    std::unordered_map<std::string, uint32_t> termIds;
+    std::vector<const std::string *> terms; // by id
+    std::vector<uint32_t> termLengths; // in characters, by id
+    std::vector<Occurrence> occurrences;
+    std::vector<float> edges;
+    int numPages;
+};
+
+#endif
@@ -803,6 +803,10 @@ public:
     // Does this device need non-text content?
     bool needNonText() override { return false; }
 
+    // Does this device need the paths that are stroked, filled and
+    // clipped?  Only to find underlines for HTML.
+    bool needPaths() override { return doHTML; }
+
     // Does this device require incCharCount to be called for text on
     // non-shown layers?
     bool needCharCount() override { return true; }
@@ -54,6 +54,7 @@
 #include <climits>
 #include <cfloat>
 #include <limits>
+#include <algorithm>
 #include "goo/gfile.h"
 #include "goo/gmem.h"
 #include "Object.h"
@@ -64,6 +65,7 @@
 #include "Error.h"
 #include "ErrorCodes.h"
 #include "XRef.h"
+#include "JBIG2Stream.h"
 
 //------------------------------------------------------------------------
 // Permission bits
@@ -255,6 +257,7 @@ XRef::XRef() : objStrs { 5 }
     capacity = 0;
     size = 0;
     modified = false;
+    modificationCount = 0;
     streamEnds = nullptr;
     streamEndsLen = 0;
     mainXRefEntriesOffset = 0;
@@ -269,6 +272,9 @@ XRef::XRef() : objStrs { 5 }
     xrefReconstructed = false;
     encAlgorithm = cryptNone;
     keyLength = 0;
+    jbig2GlobalsCache = std::make_unique<JBIG2GlobalsCache>();
+    recordingModifiedObjects = false;
+    modifiedBeforeRecording = false;
 }
 
 XRef::XRef(const Object *trailerDictA) : XRef {}
@@ -426,6 +432,241 @@ XRef *XRef::copy() const
     return xref;
 }
 
+//------------------------------------------------------------------------
+// XRef index
+//------------------------------------------------------------------------
+
+// Maximum nesting of arrays and dicts in an indexed trailer dictionary.
+#define xrefIndexMaxDepth 32
+
+template<typename T>
+static bool writeIndexValue(FILE *f, T val)
+{
+    return fwrite(&val, sizeof(T), 1, f) == 1;
+}
+
+template<typename T>
+static bool readIndexValue(FILE *f, T *val)
+{
+    return fread(val, sizeof(T), 1, f) == 1;
+}
+
+static bool writeIndexString(FILE *f, const char *s, int len)
+{
+    return writeIndexValue(f, len) && (len == 0 || fwrite(s, 1, len, f) == (size_t)len);
+}
+
+static bool readIndexString(FILE *f, std::string *s)
+{
+    int len;
+
+    if (!readIndexValue(f, &len) || len < 0) {
+        return false;
+    }
+    s->resize(len);
+    return len == 0 || fread(s->data(), 1, len, f) == (size_t)len;
+}
+
+static bool writeIndexObject(FILE *f, const Object &obj, int depth)
+{
+    if (depth > xrefIndexMaxDepth || !writeIndexValue(f, (unsigned char)obj.getType())) {
+        return false;
+    }
+    switch (obj.getType()) {
+    case objBool:
+        return writeIndexValue(f, (unsigned char)obj.getBool());
+    case objInt:
+        return writeIndexValue(f, obj.getInt());
+    case objInt64:
+        return writeIndexValue(f, obj.getInt64());
+    case objReal:
+        return writeIndexValue(f, obj.getReal());
+    case objString:
+    case objHexString: {
+        const GooString *str = obj.isString() ? obj.getString() : obj.getHexString();
+        return writeIndexString(f, str->c_str(), str->getLength());
+    }
+    case objName:
+        return writeIndexString(f, obj.getName(), strlen(obj.getName()));
+    case objNull:
+        return true;
+    case objRef:
+        return writeIndexValue(f, obj.getRefNum()) && writeIndexValue(f, obj.getRefGen());
+    case objArray:
+        if (!writeIndexValue(f, obj.arrayGetLength())) {
+            return false;
+        }
+        for (int i = 0; i < obj.arrayGetLength(); ++i) {
+            if (!writeIndexObject(f, obj.arrayGetNF(i), depth + 1)) {
+                return false;
+            }
+        }
+        return true;
+    case objDict:
+        if (!writeIndexValue(f, obj.dictGetLength())) {
+            return false;
+        }
+        for (int i = 0; i < obj.dictGetLength(); ++i) {
+            const char *key = obj.dictGetKey(i);
+            if (!writeIndexString(f, key, strlen(key)) || !writeIndexObject(f, obj.dictGetValNF(i), depth + 1)) {
+                return false;
+            }
+        }
+        return true;
+    default:
+        // streams and parser-only objects can't appear in a trailer
+        return false;
+    }
+}
+
+static Object readIndexObject(FILE *f, XRef *xref, int depth)
+{
+    unsigned char type;
+    std::string str;
+
+    if (depth > xrefIndexMaxDepth || !readIndexValue(f, &type)) {
+        return Object::error();
+    }
+    switch (type) {
+    case objBool: {
+        unsigned char b;
+        return readIndexValue(f, &b) ? Object(b != 0) : Object::error();
+    }
+    case objInt: {
+        int i;
+        return readIndexValue(f, &i) ? Object(i) : Object::error();
+    }
+    case objInt64: {
+        long long i;
+        return readIndexValue(f, &i) ? Object(i) : Object::error();
+    }
+    case objReal: {
+        double r;
+        return readIndexValue(f, &r) ? Object(r) : Object::error();
+    }
+    case objString:
+        return readIndexString(f, &str) ? Object(std::move(str)) : Object::error();
+    case objHexString:
+        return readIndexString(f, &str) ? Object(objHexString, std::move(str)) : Object::error();
+    case objName:
+        return readIndexString(f, &str) ? Object(objName, str.c_str()) : Object::error();
+    case objNull:
+        return Object::null();
+    case objRef: {
+        Ref ref;
+        return readIndexValue(f, &ref.num) && readIndexValue(f, &ref.gen) ? Object(ref) : Object::error();
+    }
+    case objArray: {
+        int len;
+        if (!readIndexValue(f, &len) || len < 0) {
+            return Object::error();
+        }
+        Object obj(new Array(xref));
+        for (int i = 0; i < len; ++i) {
+            Object elem = readIndexObject(f, xref, depth + 1);
+            if (elem.isError()) {
+                return Object::error();
+            }
+            obj.arrayAdd(std::move(elem));
+        }
+        return obj;
+    }
+    case objDict: {
+        int len;
+        if (!readIndexValue(f, &len) || len < 0) {
+            return Object::error();
+        }
+        Object obj(new Dict(xref));
+        for (int i = 0; i < len; ++i) {
+            if (!readIndexString(f, &str)) {
+                return Object::error();
+            }
+            Object val = readIndexObject(f, xref, depth + 1);
+            if (val.isError()) {
+                return Object::error();
+            }
+            obj.dictAdd(str.c_str(), std::move(val));
+        }
+        return obj;
+    }
+    default:
+        return Object::error();
+    }
+}
+
+bool XRef::writeIndex(FILE *f)
+{
+    xrefLocker();
+
+    // the index has to hold every entry, so read the remaining xref
+    // sections now
+    readXRefUntil(-1);
+    if (!ok || modified) {
+        return false;
+    }
+
+    if (!writeIndexValue(f, size)) {
+        return false;
+    }
+    for (int i = 0; i < size; ++i) {
+        if (!writeIndexValue(f, entries[i].offset) || !writeIndexValue(f, entries[i].gen) || !writeIndexValue(f, (unsigned char)entries[i].type)) {
+            return false;
+        }
+    }
+    if (!writeIndexValue(f, rootNum) || !writeIndexValue(f, rootGen) || !writeIndexValue(f, (unsigned char)xRefStream) || !writeIndexValue(f, (unsigned char)xrefReconstructed) || !writeIndexValue(f, mainXRefOffset)
+        || !writeIndexValue(f, mainXRefEntriesOffset) || !writeIndexValue(f, streamEndsLen)) {
+        return false;
+    }
+    for (int i = 0; i < streamEndsLen; ++i) {
+        if (!writeIndexValue(f, streamEnds[i])) {
+            return false;
+        }
+    }
+    return writeIndexObject(f, trailerDict, 0);
+}
+
+XRef *XRef::readIndex(BaseStream *strA, FILE *f)
+{
+    auto xref = std::make_unique<XRef>();
+    int n;
+    unsigned char xRefStreamA, xrefReconstructedA;
+
+    xref->str = strA;
+    xref->start = strA->getStart();
+    if (!readIndexValue(f, &n) || n < 0 || xref->resize(n) != n) {
+        return nullptr;
+    }
+    for (int i = 0; i < n; ++i) {
+        XRefEntry *e = &xref->entries[i];
+        unsigned char type;
+        if (!readIndexValue(f, &e->offset) || !readIndexValue(f, &e->gen) || !readIndexValue(f, &type) || type > xrefEntryNone) {
+            return nullptr;
+        }
+        e->type = (XRefEntryType)type;
+    }
+    if (!readIndexValue(f, &xref->rootNum) || !readIndexValue(f, &xref->rootGen) || !readIndexValue(f, &xRefStreamA) || !readIndexValue(f, &xrefReconstructedA) || !readIndexValue(f, &xref->mainXRefOffset)
+        || !readIndexValue(f, &xref->mainXRefEntriesOffset) || !readIndexValue(f, &xref->streamEndsLen) || xref->streamEndsLen < 0 || xref->streamEndsLen > INT_MAX / (int)sizeof(Goffset)) {
+        return nullptr;
+    }
+    xref->xRefStream = xRefStreamA != 0;
+    xref->xrefReconstructed = xrefReconstructedA != 0;
+    // every xref section is already in the table
+    xref->prevXRefOffset = 0;
+    if (xref->streamEndsLen > 0) {
+        xref->streamEnds = (Goffset *)gmallocn(xref->streamEndsLen, sizeof(Goffset));
+        for (int i = 0; i < xref->streamEndsLen; ++i) {
+            if (!readIndexValue(f, &xref->streamEnds[i])) {
+                return nullptr;
+            }
+        }
+    }
+    xref->trailerDict = readIndexObject(f, xref.get(), 0);
+    if (!xref->trailerDict.isDict()) {
+        return nullptr;
+    }
+    return xref.release();
+}
+
 int XRef::reserve(int newSize)
 {
     if (newSize > capacity) {
@@ -1196,39 +1437,103 @@ Object XRef::fetch(const Ref ref, int recursion)
     return fetch(ref.num, ref.gen, recursion);
 }
 
-Object XRef::fetch(int num, int gen, int recursion, Goffset *endPos)
+// Refs being fetched by the current thread, to break reference loops.
+// This is per thread since several threads may fetch the same object at
+// the same time.
+static thread_local std::set<std::pair<const XRef *, int>> refsBeingFetched;
+
+namespace {
+
+// Marks a ref as being fetched by the current thread while it exists.
+class FetchingRef
 {
-    XRefEntry *e;
-    Object obj1, obj2, obj3;
+public:
+    FetchingRef(const XRef *xref, int num) : key(xref, num) { inserted = refsBeingFetched.insert(key).second; }
+    ~FetchingRef() { release(); }
 
-    xrefLocker();
+    FetchingRef(const FetchingRef &) = delete;
+    FetchingRef &operator=(const FetchingRef &) = delete;
 
-    const Ref ref = { num, gen };
+    // Is the ref already being fetched further up the stack?
+    bool isLoop() const { return !inserted; }
 
-    if (!refsBeingFetched.insert(ref)) {
-        return Object::null();
+    void release()
+    {
+        if (inserted) {
+            refsBeingFetched.erase(key);
+            inserted = false;
+        }
+    }
+
+private:
+    std::pair<const XRef *, int> key;
+    bool inserted;
+};
+
+}
+
+bool XRef::lookupEntry(int num, FetchEntry *entry)
+{
+    const auto copyEntry = [this, entry](const XRefEntry *e) {
+        entry->type = e->type;
+        entry->offset = e->offset;
+        entry->gen = e->gen;
+        entry->unencrypted = e->getFlag(XRefEntry::Unencrypted);
+        entry->deepCopy = recordingModifiedObjects;
+        entry->obj = recordingModifiedObjects ? e->obj.deepCopy() : e->obj.copy();
+        entry->validObjStr = e->type == xrefEntryCompressed && e->offset < (unsigned int)size && (entries[e->offset].type == xrefEntryUncompressed || entries[e->offset].type == xrefEntryNone);
+    };
+
+    // entries that are known already only have to be copied
+    {
+        const std::shared_lock readLocker(mutex);
+        if (num < 0 || num >= size) {
+            return false;
+        }
+        if (entries[num].type != xrefEntryNone) {
+            copyEntry(&entries[num]);
+            return true;
+        }
+    }
+
+    // getEntry() may have to read more of the xref
+    xrefLocker();
+    if (num < 0 || num >= size) {
+        return false;
     }
+    copyEntry(getEntry(num));
+    return true;
+}
+
+Object XRef::fetch(int num, int gen, int recursion, Goffset *endPos)
+{
+    FetchEntry e;
+    Object obj1, obj2, obj3;
 
     // Will remove ref from refsBeingFetched once it's destroyed, i.e. the function returns
-    auto remover = std::make_unique<RefRecursionCheckerRemover>(refsBeingFetched, ref);
+    FetchingRef fetching(this, num);
+    if (fetching.isLoop()) {
+        return Object::null();
+    }
 
     // check for bogus ref - this can happen in corrupted PDF files
-    if (num < 0 || num >= size) {
+    if (!lookupEntry(num, &e)) {
         goto err;
     }
 
-    e = getEntry(num);
-    if (!e->obj.isNull()) { // check for updated object
-        return e->obj.copy();
+    if (!e.obj.isNull()) { // check for updated object
+        return std::move(e.obj);
     }
 
-    switch (e->type) {
+    // the object is parsed without holding the lock, so other threads can
+    // fetch objects at the same time
+    switch (e.type) {
 
     case xrefEntryUncompressed: {
-        if (e->gen != gen || e->offset < 0) {
+        if (e.gen != gen || e.offset < 0) {
             goto err;
         }
-        Parser parser { this, str->makeSubStream(start + e->offset, false, 0, Object::null()), true };
+        Parser parser { this, str->makeSubStream(start + e.offset, false, 0, Object::null()), true };
         obj1 = parser.getObj(recursion);
         obj2 = parser.getObj(recursion);
         obj3 = parser.getObj(recursion);
@@ -1252,7 +1557,7 @@ Object XRef::fetch(int num, int gen, int recursion, Goffset *endPos)
             }
             goto err;
         }
-        Object obj = parser.getObj(false, (encrypted && !e->getFlag(XRefEntry::Unencrypted)) ? fileKey : nullptr, encAlgorithm, keyLength, num, gen, recursion);
+        Object obj = parser.getObj(false, (encrypted && !e.unencrypted) ? fileKey : nullptr, encAlgorithm, keyLength, num, gen, recursion);
         if (endPos) {
             *endPos = parser.getPos();
         }
@@ -1265,28 +1570,44 @@ Object XRef::fetch(int num, int gen, int recursion, Goffset *endPos)
       goto err;
     }
 #endif
-        if (e->offset >= (unsigned int)size || (entries[e->offset].type != xrefEntryUncompressed && entries[e->offset].type != xrefEntryNone)) {
+        if (!e.validObjStr) {
             error(errSyntaxError, -1, "Invalid object stream");
             goto err;
         }
 
-        ObjectStream *objStr = objStrs.lookup(e->offset);
-        if (!objStr) {
-            objStr = new ObjectStream(this, static_cast<int>(e->offset), recursion + 1);
-            if (!objStr->isOk()) {
-                delete objStr;
-                objStr = nullptr;
-                goto err;
-            } else {
-                // XRef could be reconstructed in constructor of ObjectStream:
-                e = getEntry(num);
-                objStrs.put(e->offset, objStr);
+        {
+            const std::scoped_lock objStrsLocker(objStrsMutex);
+            if (ObjectStream *objStr = objStrs.lookup(e.offset)) {
+                if (endPos) {
+                    *endPos = -1;
+                }
+                Object obj = objStr->getObject(e.gen, num);
+                return e.deepCopy ? obj.deepCopy() : std::move(obj);
             }
         }
+
+        // another thread may be parsing the same object stream, in which
+        // case the first one to finish gets to cache it
+        auto objStr = std::make_unique<ObjectStream>(this, static_cast<int>(e.offset), recursion + 1);
+        if (!objStr->isOk()) {
+            goto err;
+        }
+        // XRef could be reconstructed in constructor of ObjectStream:
+        if (!lookupEntry(num, &e)) {
+            goto err;
+        }
         if (endPos) {
             *endPos = -1;
         }
-        return objStr->getObject(e->gen, num);
+        Object obj = objStr->getObject(e.gen, num);
+        if (e.deepCopy) {
+            obj = obj.deepCopy();
+        }
+        const std::scoped_lock objStrsLocker(objStrsMutex);
+        if (!objStrs.lookup(e.offset)) {
+            objStrs.put(e.offset, std::move(objStr));
+        }
+        return obj;
     }
 
     default:
@@ -1294,6 +1615,7 @@ Object XRef::fetch(int num, int gen, int recursion, Goffset *endPos)
     }
 
 err:
+    xrefLocker();
     if (!xRefStream && !xrefReconstructed) {
         // Check if there has been any updated object, if there has been we can't reconstruct because that would mean losing the changes
         bool xrefHasChanges = false;
@@ -1313,7 +1635,7 @@ err:
         error(errInternal, -1, "xref num {0:d} not found but needed, try to reconstruct", num);
         rootNum = -1;
         constructXRef(&xrefReconstructed);
-        remover.reset(); // Manually delete the remover since we're calling ourselves so recursion for this one is valid
+        fetching.release(); // Manually release the ref since we're calling ourselves so recursion for this one is valid
         return fetch(num, gen, ++recursion, endPos);
     }
     if (endPos) {
@@ -1472,9 +1794,36 @@ void XRef::setModifiedObject(const Object *o, Ref r)
     if (unlikely(e->type == xrefEntryFree)) {
         error(errInternal, -1, "XRef::setModifiedObject on ref: {0:d}, {1:d} that is marked as free. This will cause a memory leak", r.num, r.gen);
     }
+    if (recordingModifiedObjects && std::none_of(replacedObjects.begin(), replacedObjects.end(), [&r](const ReplacedObject &replaced) { return replaced.num == r.num; })) {
+        replacedObjects.push_back({ r.num, e->obj.copy(), e->getFlag(XRefEntry::Updated) });
+    }
     e->obj = o->copy();
     e->setFlag(XRefEntry::Updated, true);
     setModified();
+    // the object may be a JBIG2Globals stream
+    jbig2GlobalsCache->clear();
+}
+
+void XRef::recordModifiedObjects()
+{
+    xrefLocker();
+    recordingModifiedObjects = true;
+    modifiedBeforeRecording = modified;
+    replacedObjects.clear();
+}
+
+void XRef::restoreModifiedObjects()
+{
+    xrefLocker();
+    for (ReplacedObject &replaced : replacedObjects) {
+        XRefEntry *e = &entries[replaced.num];
+        e->obj = std::move(replaced.obj);
+        e->setFlag(XRefEntry::Updated, replaced.updated);
+    }
+    recordingModifiedObjects = false;
+    modified = modifiedBeforeRecording;
+    ++modificationCount;
+    replacedObjects.clear();
 }
 
 Ref XRef::addIndirectObject(const Object &o)
@@ -1633,7 +1982,9 @@ void XRef::XRefStreamWriter::writeEntry(Goffset offset, int gen, XRefEntryType t
 {
     const int entryTotalSize = 1 + offsetSize + 2; /* type + offset + gen */
     char data[16];
-    data[0] = (type == xrefEntryFree) ? 0 : 1;
+    // compressed entries hold the number of the object stream as offset
+    // and the index in it as generation
+    data[0] = (type == xrefEntryFree) ? 0 : (type == xrefEntryCompressed) ? 2 : 1;
     for (int i = offsetSize; i > 0; i--) {
         data[i] = offset & 0xff;
         offset >>= 8;
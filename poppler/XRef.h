@@ -37,8 +37,13 @@
 #ifndef XREF_H
 #define XREF_H
 
+#include <atomic>
+#include <cstdio>
 #include <functional>
+#include <memory>
+#include <mutex>
 
+#include "goo/GooRecursiveSharedMutex.h"
 #include "poppler-config.h"
 #include "poppler_private_export.h"
 #include "Object.h"
@@ -49,6 +54,7 @@ class Dict;
 class Stream;
 class Parser;
 class ObjectStream;
+class JBIG2GlobalsCache;
 
 //------------------------------------------------------------------------
 // XRef
@@ -74,7 +80,6 @@ struct XRefEntry
     {
         // Regular flags
         Updated, // Entry was modified
-        Parsing, // Entry is currently being parsed
 
         // Special flags -- available only after xref->scanSpecialFlags() is run
         Unencrypted, // Entry is stored in unencrypted form (meaningless in unencrypted documents)
@@ -124,6 +129,15 @@ public:
     // Copy xref but with new base stream!
     XRef *copy() const;
 
+    // Write the complete xref table, reading any xref sections that have
+    // not been read yet, to <f>.  The result can be turned back into an
+    // XRef with readIndex(), which avoids parsing (or reconstructing) the
+    // xref again.  Returns false if the table can't be written.
+    bool writeIndex(FILE *f);
+    // Create an XRef for <strA> from an index written by writeIndex().
+    // Returns nullptr if the index is truncated or invalid.
+    static XRef *readIndex(BaseStream *strA, FILE *f);
+
     // Is xref table valid?
     bool isOk() const { return ok; }
 
@@ -209,10 +223,23 @@ public:
     // Was the XRef modified?
     bool isModified() const { return modified; }
     // Set the modification flag for XRef to true.
-    void setModified() { modified = true; }
+    void setModified()
+    {
+        modified = true;
+        ++modificationCount;
+    }
+    // Number of changes made to the XRef so far; anything derived from
+    // its objects (e.g. page text) is out of date once this changes.
+    unsigned int getModificationCount() const { return modificationCount; }
 
     // Write access
     void setModifiedObject(const Object *o, Ref r);
+    // Remember the objects setModifiedObject() replaces from now on,
+    // until restoreModifiedObjects() puts them back.  Meanwhile fetch()
+    // returns deep copies, so that objects changed in place by the caller
+    // aren't shared with the xref, its object streams or earlier fetches.
+    void recordModifiedObjects();
+    void restoreModifiedObjects();
     Ref addIndirectObject(const Object &o);
     void removeIndirectObject(Ref r);
     bool add(int num, int gen, Goffset offs, bool used);
@@ -230,10 +257,15 @@ public:
     // Output XRef stream contents to GooString and fill trailerDict fields accordingly
     void writeStreamToBuffer(GooString *stmBuf, Dict *xrefDict, XRef *xref);
 
-    // to be thread safe during write where changes are not allowed
+    // Lock the xref exclusively, to be thread safe during write where
+    // changes are not allowed.  fetch() can still be called by the
+    // thread holding the lock.
     void lock();
     void unlock();
 
+    // Decoded JBIG2Globals streams, shared by the pages of the document.
+    JBIG2GlobalsCache *getJBIG2GlobalsCache() { return jbig2GlobalsCache.get(); }
+
 private:
     BaseStream *str; // input stream
     Goffset start; // offset in file (to allow for garbage
@@ -247,6 +279,7 @@ private:
     bool xrefReconstructed; // marker, true if xref was already reconstructed
     Object trailerDict; // trailer dictionary
     bool modified;
+    std::atomic<unsigned int> modificationCount;
     Goffset *streamEnds; // 'endstream' positions - only used in
                          //   damaged files
     int streamEndsLen; // number of valid entries in streamEnds
@@ -265,10 +298,36 @@ private:
     Goffset mainXRefOffset; // position of the main XRef table/stream
     bool scannedSpecialFlags; // true if scanSpecialFlags has been called
     bool strOwner; // true if str is owned by the instance
-    mutable std::recursive_mutex mutex;
+    // fetch() only needs a shared lock for entries that are known
+    // already, anything that changes the table takes it exclusively
+    mutable GooRecursiveSharedMutex mutex;
+    std::mutex objStrsMutex; // guards objStrs
     std::function<void()> xrefReconstructedCb;
+    std::unique_ptr<JBIG2GlobalsCache> jbig2GlobalsCache;
 
-    RefRecursionChecker refsBeingFetched;
+    // An object replaced by setModifiedObject(), see
+    // recordModifiedObjects()
+    struct ReplacedObject
+    {
+        int num;
+        Object obj;
+        bool updated;
+    };
+    bool recordingModifiedObjects;
+    bool modifiedBeforeRecording;
+    std::vector<ReplacedObject> replacedObjects;
+
+    // Copy of an xref entry, taken by fetch()
+    struct FetchEntry
+    {
+        XRefEntryType type;
+        Goffset offset;
+        int gen;
+        bool unencrypted;
+        bool validObjStr; // compressed entry refers to an object stream
+        bool deepCopy; // fetch() returns deep copies, see recordModifiedObjects()
+        Object obj; // updated object, if any
+    };
 
     int reserve(int newSize);
     int resize(int newSize);
@@ -278,6 +337,7 @@ private:
     bool readXRefStream(Stream *xrefStr, Goffset *pos);
     bool constructXRef(bool *wasReconstructed, bool needCatalogDict = false);
     bool parseEntry(Goffset offset, XRefEntry *entry);
+    bool lookupEntry(int num, FetchEntry *entry);
     void readXRefUntil(int untilEntryNum, std::vector<int> *xrefStreamObjsNum = nullptr);
     void markUnencrypted(Object *obj);
 
@@ -56,8 +56,15 @@
 #include <QtCore/QDebug>
 #include <QtCore/QFile>
 #include <QtCore/QByteArray>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
 #include <QTimeZone>
 
+#include <algorithm>
+#include <atomic>
+#include <optional>
+
 #include "poppler-form.h"
 #include "poppler-private.h"
 #include "poppler-link-private.h"
@@ -883,6 +890,94 @@ void Document::setXRefReconstructedCallback(const std::function<void()> &callbac
     m_doc->xrefReconstructedCallback = callback;
 }
 
+static bool shouldAbortSearchCallback(void *data)
+{
+    return *static_cast<std::atomic_bool *>(data);
+}
+
+void Document::search(const QString &text, const SearchResultFunc &resultCallback, Page::SearchFlags flags, Page::Rotation rotate) const
+{
+    const bool sCase = flags.testFlag(Page::IgnoreCase) ? false : true;
+    const bool sWords = flags.testFlag(Page::WholeWords) ? true : false;
+    const bool sDiacritics = flags.testFlag(Page::IgnoreDiacritics) ? true : false;
+    const bool sAcrossLines = flags.testFlag(Page::AcrossLines) ? true : false;
+    const int rotation = (int)rotate * 90;
+    const int numPages = m_doc->doc->getNumPages();
+    if (numPages <= 0) {
+        return;
+    }
+
+    const QVector<Unicode> u = text.toUcs4();
+    QMutex mutex; // guards nextPage and results
+    QWaitCondition pageDone;
+    int nextPage = 0;
+    std::vector<std::optional<QList<QRectF>>> results(numPages);
+    std::atomic_bool stop { false };
+
+    // every thread searches the next page that nobody has taken yet
+    const auto searchPages = [&] {
+        for (;;) {
+            int page;
+            {
+                QMutexLocker locker(&mutex);
+                if (stop || nextPage == numPages) {
+                    return;
+                }
+                page = nextPage++;
+            }
+
+            const std::shared_ptr<SearchTextPage> textPage = m_doc->searchTextPage(page, rotation, shouldAbortSearchCallback, &stop);
+            QList<QRectF> matches;
+            if (!stop) {
+                QMutexLocker searchLocker(&textPage->searchMutex);
+                matches = PageData::performMultipleTextSearch(textPage->textPage.get(), u, sCase, sWords, sDiacritics, sAcrossLines);
+            }
+
+            QMutexLocker locker(&mutex);
+            results[page] = std::move(matches);
+            pageDone.wakeAll();
+        }
+    };
+
+    // a pool of our own, so that the search can't wait for tasks queued
+    // behind it in the global one
+    QThreadPool pool;
+    const int numThreads = std::min(QThread::idealThreadCount(), numPages);
+    pool.setMaxThreadCount(numThreads);
+    for (int i = 0; i < numThreads; ++i) {
+        pool.start(searchPages);
+    }
+
+    for (int page = 0; page < numPages; ++page) {
+        QList<QRectF> matches;
+        {
+            QMutexLocker locker(&mutex);
+            while (!results[page]) {
+                pageDone.wait(&mutex);
+            }
+            matches = std::move(*results[page]);
+        }
+        if (!resultCallback(page, matches)) {
+            stop = true;
+            break;
+        }
+    }
+    pool.waitForDone();
+}
+
+void Document::setSearchCacheSize(int pages)
+{
+    QMutexLocker locker(&m_doc->searchCacheMutex);
+    m_doc->searchCacheSize = pages;
+    m_doc->trimSearchCache();
+}
+
+int Document::searchCacheSize() const
+{
+    QMutexLocker locker(&m_doc->searchCacheMutex);
+    return m_doc->searchCacheSize;
+}
+
 QDateTime convertDate(const char *dateString)
 {
     int year, mon, day, hour, min, sec, tzHours, tzMins;
@@ -24,6 +24,8 @@
 #ifndef _POPPLER_PAGE_PRIVATE_H_
 #define _POPPLER_PAGE_PRIVATE_H_
 
+#include <memory>
+
 #include "CharTypes.h"
 
 class QRectF;
@@ -36,6 +38,7 @@ namespace Poppler {
 
 class DocumentData;
 class PageTransition;
+struct SearchTextPage;
 
 class PageData
 {
@@ -49,9 +52,9 @@ public:
 
     static std::unique_ptr<Link> convertLinkActionToLink(::LinkAction *a, DocumentData *parentDoc, const QRectF &linkArea);
 
-    TextPage *prepareTextSearch(const QString &text, Page::Rotation rotate, QVector<Unicode> *u);
+    std::shared_ptr<SearchTextPage> prepareTextSearch(const QString &text, Page::Rotation rotate, QVector<Unicode> *u);
     bool performSingleTextSearch(TextPage *textPage, QVector<Unicode> &u, double &sLeft, double &sTop, double &sRight, double &sBottom, Page::SearchDirection direction, bool sCase, bool sWords, bool sDiacritics, bool sAcrossLines);
-    QList<QRectF> performMultipleTextSearch(TextPage *textPage, QVector<Unicode> &u, bool sCase, bool sWords, bool sDiacritics, bool sAcrossLines);
+    static QList<QRectF> performMultipleTextSearch(TextPage *textPage, const QVector<Unicode> &u, bool sCase, bool sWords, bool sDiacritics, bool sAcrossLines);
 };
 
 }
@@ -386,18 +386,14 @@ std::unique_ptr<Link> PageData::convertLinkActionToLink(::LinkAction *a, Documen
     return popplerLink;
 }
 
-inline TextPage *PageData::prepareTextSearch(const QString &text, Page::Rotation rotate, QVector<Unicode> *u)
+inline std::shared_ptr<SearchTextPage> PageData::prepareTextSearch(const QString &text, Page::Rotation rotate, QVector<Unicode> *u)
 {
     *u = text.toUcs4();
 
     const int rotation = (int)rotate * 90;
 
     // fetch ourselves a textpage
-    TextOutputDev td(nullptr, true, 0, false, false);
-    parentDoc->doc->displayPage(&td, index + 1, 72, 72, rotation, false, true, false, nullptr, nullptr, nullptr, nullptr, true);
-    TextPage *textPage = td.takeText();
-
-    return textPage;
+    return parentDoc->searchTextPage(index, rotation);
 }
 
 inline bool PageData::performSingleTextSearch(TextPage *textPage, QVector<Unicode> &u, double &sLeft, double &sTop, double &sRight, double &sBottom, Page::SearchDirection direction, bool sCase, bool sWords, bool sDiacritics,
@@ -406,15 +402,17 @@ inline bool PageData::performSingleTextSearch(TextPage *textPage, QVector<Unicod
     if (direction == Page::FromTop) {
         return textPage->findText(u.data(), u.size(), true, true, false, false, sCase, sDiacritics, sAcrossLines, false, sWords, &sLeft, &sTop, &sRight, &sBottom, nullptr, nullptr);
     } else if (direction == Page::NextResult) {
-        return textPage->findText(u.data(), u.size(), false, true, true, false, sCase, sDiacritics, sAcrossLines, false, sWords, &sLeft, &sTop, &sRight, &sBottom, nullptr, nullptr);
+        // start at sLeft/sTop, not at the last match of an earlier search
+        // on the cached text page
+        return textPage->findText(u.data(), u.size(), false, true, false, false, sCase, sDiacritics, sAcrossLines, false, sWords, &sLeft, &sTop, &sRight, &sBottom, nullptr, nullptr);
     } else if (direction == Page::PreviousResult) {
-        return textPage->findText(u.data(), u.size(), false, true, true, false, sCase, sDiacritics, sAcrossLines, true, sWords, &sLeft, &sTop, &sRight, &sBottom, nullptr, nullptr);
+        return textPage->findText(u.data(), u.size(), false, true, false, false, sCase, sDiacritics, sAcrossLines, true, sWords, &sLeft, &sTop, &sRight, &sBottom, nullptr, nullptr);
     }
 
     return false;
 }
 
-inline QList<QRectF> PageData::performMultipleTextSearch(TextPage *textPage, QVector<Unicode> &u, bool sCase, bool sWords, bool sDiacritics, bool sAcrossLines)
+QList<QRectF> PageData::performMultipleTextSearch(TextPage *textPage, const QVector<Unicode> &u, bool sCase, bool sWords, bool sDiacritics, bool sAcrossLines)
 {
     QList<QRectF> results;
     double sLeft = 0.0, sTop = 0.0, sRight = 0.0, sBottom = 0.0;
@@ -422,7 +420,9 @@ inline QList<QRectF> PageData::performMultipleTextSearch(TextPage *textPage, QVe
     PDFRectangle continueMatch;
     continueMatch.x1 = DBL_MAX; // we use this to detect valid return values
 
-    while (textPage->findText(u.data(), u.size(), false, true, true, false, sCase, sDiacritics, sAcrossLines, false, sWords, &sLeft, &sTop, &sRight, &sBottom, &continueMatch, &sIgnoredHyphen)) {
+    // the first match is looked for from the top, not from the last match
+    // of an earlier search on the cached text page
+    while (textPage->findText(u.constData(), u.size(), false, true, !results.isEmpty(), false, sCase, sDiacritics, sAcrossLines, false, sWords, &sLeft, &sTop, &sRight, &sBottom, &continueMatch, &sIgnoredHyphen)) {
         QRectF result;
 
         result.setLeft(sLeft);
@@ -715,13 +715,10 @@ bool Page::search(const QString &text, double &sLeft, double &sTop, double &sRig
     const bool sAcrossLines = flags.testFlag(AcrossLines) ? true : false;
 
     QVector<Unicode> u;
-    TextPage *textPage = m_page->prepareTextSearch(text, rotate, &u);
-
-    const bool found = m_page->performSingleTextSearch(textPage, u, sLeft, sTop, sRight, sBottom, direction, sCase, sWords, sDiacritics, sAcrossLines);
-
-    textPage->decRefCnt();
+    const std::shared_ptr<SearchTextPage> textPage = m_page->prepareTextSearch(text, rotate, &u);
 
-    return found;
+    QMutexLocker locker(&textPage->searchMutex);
+    return m_page->performSingleTextSearch(textPage->textPage.get(), u, sLeft, sTop, sRight, sBottom, direction, sCase, sWords, sDiacritics, sAcrossLines);
 }
 
 QList<QRectF> Page::search(const QString &text, SearchFlags flags, Rotation rotate) const
@@ -732,13 +729,10 @@ QList<QRectF> Page::search(const QString &text, SearchFlags flags, Rotation rota
     const bool sAcrossLines = flags.testFlag(AcrossLines) ? true : false;
 
     QVector<Unicode> u;
-    TextPage *textPage = m_page->prepareTextSearch(text, rotate, &u);
+    const std::shared_ptr<SearchTextPage> textPage = m_page->prepareTextSearch(text, rotate, &u);
 
-    QList<QRectF> results = m_page->performMultipleTextSearch(textPage, u, sCase, sWords, sDiacritics, sAcrossLines);
-
-    textPage->decRefCnt();
-
-    return results;
+    QMutexLocker locker(&textPage->searchMutex);
+    return PageData::performMultipleTextSearch(textPage->textPage.get(), u, sCase, sWords, sDiacritics, sAcrossLines);
 }
 
 std::vector<std::unique_ptr<TextBox>> Page::textList(Rotation rotate) const
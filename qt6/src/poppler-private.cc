@@ -39,9 +39,12 @@
 #include <QtCore/QDebug>
 #include <QtCore/QVariant>
 
+#include <algorithm>
+
 #include <Link.h>
 #include <Outline.h>
 #include <PDFDocEncoding.h>
+#include <TextOutputDev.h>
 #include <UnicodeMap.h>
 #include <UTF.h>
 
@@ -199,6 +202,7 @@ Annot::AdditionalActionsType toPopplerAdditionalActionType(Annotation::Additiona
 
 DocumentData::~DocumentData()
 {
+    searchCache.clear();
     qDeleteAll(m_embeddedFiles);
     delete (OptContentModel *)m_optContentModel;
     delete doc;
@@ -212,6 +216,7 @@ void DocumentData::init()
     m_optContentModel = nullptr;
     xrefReconstructed = false;
     xrefReconstructedCallback = {};
+    searchCacheSize = 256;
 
 #ifdef ANDROID
     // Copy fonts from android apk to the app's storage dir, and
@@ -237,6 +242,59 @@ void DocumentData::init()
 #endif
 }
 
+std::shared_ptr<SearchTextPage> DocumentData::searchTextPage(int index, int rotation, bool (*abortCheckCbk)(void *data), void *abortCheckCbkData)
+{
+    const unsigned int modificationCount = doc->getXRef()->getModificationCount();
+    {
+        QMutexLocker locker(&searchCacheMutex);
+        if (index < (int)searchCache.size()) {
+            const std::shared_ptr<SearchTextPage> &cached = searchCache[index];
+            if (cached && cached->rotation == rotation && cached->modificationCount == modificationCount) {
+                searchCacheLru.splice(searchCacheLru.begin(), searchCacheLru, cached->lruPos);
+                return cached;
+            }
+        }
+    }
+
+    // extract the text without holding the lock, so that several pages
+    // can be done at once
+    TextOutputDev td(nullptr, true, 0, false, false);
+    doc->displayPage(&td, index + 1, 72, 72, rotation, false, true, false, abortCheckCbk, abortCheckCbkData, nullptr, nullptr, true);
+    auto textPage = std::make_shared<SearchTextPage>();
+    textPage->rotation = rotation;
+    textPage->modificationCount = modificationCount;
+    textPage->textPage = std::shared_ptr<TextPage>(td.takeText(), [](TextPage *t) { t->decRefCnt(); });
+
+    if (abortCheckCbk && abortCheckCbk(abortCheckCbkData)) {
+        return textPage;
+    }
+
+    QMutexLocker locker(&searchCacheMutex);
+    if (searchCacheSize <= 0) {
+        return textPage;
+    }
+    if (index >= (int)searchCache.size()) {
+        searchCache.resize(std::max(index + 1, doc->getNumPages()));
+    }
+    std::shared_ptr<SearchTextPage> &cached = searchCache[index];
+    if (cached) {
+        searchCacheLru.erase(cached->lruPos);
+    }
+    searchCacheLru.push_front(index);
+    textPage->lruPos = searchCacheLru.begin();
+    cached = textPage;
+    trimSearchCache();
+    return textPage;
+}
+
+void DocumentData::trimSearchCache()
+{
+    while ((int)searchCacheLru.size() > std::max(searchCacheSize, 0)) {
+        searchCache[searchCacheLru.back()].reset();
+        searchCacheLru.pop_back();
+    }
+}
+
 void DocumentData::noitfyXRefReconstructed()
 {
     if (!xrefReconstructed) {
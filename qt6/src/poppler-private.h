@@ -50,6 +50,9 @@
 #include <QtCore/QVector>
 
 #include <functional>
+#include <list>
+#include <memory>
+#include <vector>
 #include <config.h>
 #include <poppler-config.h>
 #include <GfxState.h>
@@ -68,6 +71,7 @@
 
 class LinkDest;
 class FormWidget;
+class TextPage;
 
 namespace Poppler {
 
@@ -91,6 +95,18 @@ void qt6ErrorFunction(ErrorCategory /*category*/, Goffset pos, const char *msg);
 
 Annot::AdditionalActionsType toPopplerAdditionalActionType(Annotation::AdditionalActionType type);
 
+// The text of a page, laid out for searching
+struct SearchTextPage
+{
+    int rotation;
+    unsigned int modificationCount; // XRef::getModificationCount() it was made at
+    std::shared_ptr<TextPage> textPage;
+    // TextPage::findText() remembers its last match, so searches must
+    // take turns
+    QMutex searchMutex;
+    std::list<int>::iterator lruPos;
+};
+
 class LinkDestinationData
 {
 public:
@@ -165,6 +181,16 @@ public:
 
     static std::unique_ptr<Document> checkDocument(DocumentData *doc);
 
+    /**
+     * returns the text of page <index> for searching, from the cache if
+     * the page hasn't changed since; if <abortCheckCbk> stops the text
+     * extraction, the incomplete text isn't cached
+     */
+    std::shared_ptr<SearchTextPage> searchTextPage(int index, int rotation, bool (*abortCheckCbk)(void *data) = nullptr, void *abortCheckCbkData = nullptr);
+    // drops the least recently used pages over searchCacheSize, must be
+    // called with searchCacheMutex locked
+    void trimSearchCache();
+
     PDFDoc *doc;
     QString m_filePath;
     QIODevice *m_device;
@@ -182,6 +208,11 @@ public:
     bool xrefReconstructed;
     // notifies the user whenever the backend's PDFDoc XRef is reconstructed
     std::function<void()> xrefReconstructedCallback;
+    // the text of recently searched pages, by page index
+    QMutex searchCacheMutex;
+    std::vector<std::shared_ptr<SearchTextPage>> searchCache;
+    std::list<int> searchCacheLru; // most recently used first
+    int searchCacheSize;
 };
 
 class FontInfoData
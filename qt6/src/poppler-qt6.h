@@ -1759,6 +1759,59 @@ QString subject = m_doc->info("Subject");
     */
     void setXRefReconstructedCallback(const std::function<void()> &callback);
 
+    /**
+       Search result callback.
+
+       Called by search() with the index of a page and the matches on it,
+       which are empty if there are none. Returning false stops the search.
+
+       \since 25.07
+    */
+    using SearchResultFunc = std::function<bool(int /*page*/, const QList<QRectF> & /*matches*/)>;
+
+    /**
+       Returns the matches of \p text on all the pages, as
+       Page::search(const QString &, Page::SearchFlags, Page::Rotation) would.
+
+       Several pages are searched at once, on threads of their own. \p
+       resultCallback is called from the calling thread for every page, in
+       page order, as soon as that page and the ones before it are
+       done. search() returns once it has been called for the last page
+       or it returned false.
+
+       The text of the searched pages is kept, so searching again (for
+       instance while the user types) doesn't need to extract it again,
+       unless the page was changed since (e.g. an annotation was added).
+       Page::search() uses the same text.
+
+       \param text the text to search
+       \param resultCallback called with the matches of each page
+       \param flags the flags to consider during matching
+       \param rotate the rotation to apply for the search order
+
+       \sa setSearchCacheSize()
+
+       \since 25.07
+    */
+    void search(const QString &text, const SearchResultFunc &resultCallback, Page::SearchFlags flags = Page::NoSearchFlags, Page::Rotation rotate = Page::Rotate0) const;
+
+    /**
+       Sets the number of pages whose text is kept for searching.
+
+       The least recently searched pages are dropped once there are more.
+       The default is 256, 0 keeps none.
+
+       \since 25.07
+    */
+    void setSearchCacheSize(int pages);
+
+    /**
+       The number of pages whose text is kept for searching.
+
+       \since 25.07
+    */
+    int searchCacheSize() const;
+
     /**
        Destructor.
     */
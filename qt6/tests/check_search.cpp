@@ -1,3 +1,4 @@
+#include <QtCore/QThread>
 #include <QtTest/QTest>
 
 #include <poppler-qt6.h>
@@ -16,6 +17,8 @@ private Q_SLOTS:
     void testIgnoreDiacritics();
     void testRussianSearch(); // Issue #743
     void testDeseretSearch(); // Issue #853
+    void testDocumentSearch();
+    void testDocumentSearchWhileText();
 };
 
 void TestSearch::bug7063()
@@ -398,5 +401,85 @@ void TestSearch::testAcrossLinesSearchDoubleColumn()
     QCOMPARE(page->search(bug_str, mode).size(), 4);
 }
 
+void TestSearch::testDocumentSearch()
+{
+    std::unique_ptr<Poppler::Document> document = Poppler::Document::load(QStringLiteral(TESTDATADIR "/unittestcases/xr01.pdf"));
+    QVERIFY(document);
+
+    QList<int> pages;
+    QList<QList<QRectF>> matches;
+    document->search(QStringLiteral("is"), [&pages, &matches](int page, const QList<QRectF> &pageMatches) {
+        pages.append(page);
+        matches.append(pageMatches);
+        return true;
+    });
+
+    // every page is reported, in order, with the matches Page::search() finds
+    QCOMPARE(pages.size(), document->numPages());
+    QVERIFY(!matches[0].isEmpty());
+    for (int i = 0; i < document->numPages(); ++i) {
+        QCOMPARE(pages[i], i);
+        std::unique_ptr<Poppler::Page> page = document->page(i);
+        QVERIFY(page);
+        QCOMPARE(page->search(QStringLiteral("is")), matches[i]);
+    }
+
+    // the same without the text cache
+    document->setSearchCacheSize(0);
+    QCOMPARE(document->searchCacheSize(), 0);
+    QList<QList<QRectF>> uncachedMatches;
+    document->search(QStringLiteral("is"), [&uncachedMatches](int, const QList<QRectF> &pageMatches) {
+        uncachedMatches.append(pageMatches);
+        return true;
+    });
+    QCOMPARE(uncachedMatches, matches);
+
+    // returning false stops the search
+    int calls = 0;
+    document->search(QStringLiteral("is"), [&calls](int, const QList<QRectF> &) {
+        ++calls;
+        return false;
+    });
+    QCOMPARE(calls, 1);
+}
+
+// With ECM_ENABLE_SANITIZERS=thread, this is the data race check for the
+// search threads and Page::text()
+void TestSearch::testDocumentSearchWhileText()
+{
+    std::unique_ptr<Poppler::Document> reference = Poppler::Document::load(QStringLiteral(TESTDATADIR "/unittestcases/xr01.pdf"));
+    QVERIFY(reference);
+    QStringList expectedTexts;
+    QList<QList<QRectF>> expectedMatches;
+    for (int i = 0; i < reference->numPages(); ++i) {
+        std::unique_ptr<Poppler::Page> page = reference->page(i);
+        QVERIFY(page);
+        expectedTexts.append(page->text(QRectF()));
+        expectedMatches.append(page->search(QStringLiteral("is")));
+    }
+
+    // on fresh documents, so that search() extracts the text of every page
+    // while another thread does too
+    for (int pass = 0; pass < 4; ++pass) {
+        std::unique_ptr<Poppler::Document> document = Poppler::Document::load(QStringLiteral(TESTDATADIR "/unittestcases/xr01.pdf"));
+        QVERIFY(document);
+        QStringList texts;
+        std::unique_ptr<QThread> thread(QThread::create([&document, &texts] {
+            for (int i = document->numPages() - 1; i >= 0; --i) {
+                texts.prepend(document->page(i)->text(QRectF()));
+            }
+        }));
+        thread->start();
+        QList<QList<QRectF>> matches;
+        document->search(QStringLiteral("is"), [&matches](int, const QList<QRectF> &pageMatches) {
+            matches.append(pageMatches);
+            return true;
+        });
+        thread->wait();
+        QCOMPARE(texts, expectedTexts);
+        QCOMPARE(matches, expectedMatches);
+    }
+}
+
 QTEST_GUILESS_MAIN(TestSearch)
 #include "check_search.moc"
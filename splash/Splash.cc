@@ -183,6 +183,10 @@ struct SplashPipe
 
     // the "run" function
     void (Splash::*run)(SplashPipe *pipe);
+
+    // composites a whole span at once, can replace the pipeRunAA*
+    // functions; nullptr if not available
+    SplashCompositeAASpanFunc aaSpan;
 };
 
 SplashPipeResultColorCtrl Splash::pipeResultColorNoAlphaBlend[] = { splashPipeResultColorNoAlphaBlendMono, splashPipeResultColorNoAlphaBlendMono, splashPipeResultColorNoAlphaBlendRGB,    splashPipeResultColorNoAlphaBlendRGB,
@@ -257,6 +261,7 @@ inline void Splash::pipeInit(SplashPipe *pipe, int x, int y, SplashPattern *patt
 
     // select the 'run' function
     pipe->run = &Splash::pipeRun;
+    pipe->aaSpan = nullptr;
     if (!pipe->pattern && pipe->noTransparency && !state->blendFunc) {
         if (bitmap->mode == splashModeMono1 && !pipe->destAlphaPtr) {
             pipe->run = &Splash::pipeRunSimpleMono1;
@@ -289,6 +294,9 @@ inline void Splash::pipeInit(SplashPipe *pipe, int x, int y, SplashPattern *patt
         } else if (bitmap->mode == splashModeDeviceN8 && pipe->destAlphaPtr) {
             pipe->run = &Splash::pipeRunAADeviceN8;
         }
+        if (pipe->run != &Splash::pipeRun && state->rgbCMYKTransferIdentity && (bitmap->mode != splashModeCMYK8 || ((state->overprintMask & 0xf) == 0xf && !state->overprintAdditive))) {
+            pipe->aaSpan = aaSpanFunc;
+        }
     }
 }
 
@@ -1386,6 +1394,8 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, bool adj
     int xx, yy, t;
 #endif
     int x;
+    // the span kernels don't know about stroke adjustment
+    const bool useSpan = pipe->aaSpan && !adjustLine;
 
 #if splashAASize == 4
     p0 = aaBuf->getDataPtr() + (x0 >> 1);
@@ -1417,13 +1427,19 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, bool adj
         }
 #endif
 
-        if (t != 0) {
+        if (useSpan) {
+            aaSpanShape[x - x0] = (unsigned char)aaGamma[t];
+        } else if (t != 0) {
             pipe->shape = (adjustLine) ? div255(static_cast<int>((int)lineOpacity * (double)aaGamma[t])) : (int)aaGamma[t];
             (this->*pipe->run)(pipe);
         } else {
             pipeIncX(pipe);
         }
     }
+
+    if (useSpan && x1 >= x0) {
+        (*pipe->aaSpan)(pipe->destColorPtr, pipe->destAlphaPtr, aaSpanShape, x1 - x0 + 1, pipe->aInput, pipe->cSrc);
+    }
 }
 
 //------------------------------------------------------------------------
@@ -1452,12 +1468,15 @@ Splash::Splash(SplashBitmap *bitmapA, bool vectorAntialiasA, SplashScreenParams
     state = new SplashState(bitmap->width, bitmap->height, vectorAntialias, screenParams);
     if (vectorAntialias) {
         aaBuf = new SplashBitmap(splashAASize * bitmap->width, splashAASize, 1, splashModeMono1, false);
+        aaSpanShape = (unsigned char *)gmalloc(bitmap->width);
         for (i = 0; i <= splashAASize * splashAASize; ++i) {
             aaGamma[i] = (unsigned char)splashRound(splashPow((SplashCoord)i / (SplashCoord)(splashAASize * splashAASize), splashAAGamma) * 255);
         }
     } else {
         aaBuf = nullptr;
+        aaSpanShape = nullptr;
     }
+    aaSpanFunc = splashGetCompositeAASpanFunc(bitmap->mode);
     minLineWidth = 0;
     thinLineMode = splashThinLineDefault;
     debugMode = false;
@@ -1474,12 +1493,15 @@ Splash::Splash(SplashBitmap *bitmapA, bool vectorAntialiasA, SplashScreen *scree
     state = new SplashState(bitmap->width, bitmap->height, vectorAntialias, screenA);
     if (vectorAntialias) {
         aaBuf = new SplashBitmap(splashAASize * bitmap->width, splashAASize, 1, splashModeMono1, false);
+        aaSpanShape = (unsigned char *)gmalloc(bitmap->width);
         for (i = 0; i <= splashAASize * splashAASize; ++i) {
             aaGamma[i] = (unsigned char)splashRound(splashPow((SplashCoord)i / (SplashCoord)(splashAASize * splashAASize), splashAAGamma) * 255);
         }
     } else {
         aaBuf = nullptr;
+        aaSpanShape = nullptr;
     }
+    aaSpanFunc = splashGetCompositeAASpanFunc(bitmap->mode);
     minLineWidth = 0;
     thinLineMode = splashThinLineDefault;
     debugMode = false;
@@ -1493,6 +1515,7 @@ Splash::~Splash()
     }
     delete state;
     delete aaBuf;
+    gfree(aaSpanShape);
 }
 
 //------------------------------------------------------------------------
@@ -2685,13 +2708,19 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, bool noClip)
             pipeInit(&pipe, xStart, yStart, state->fillPattern, nullptr, (unsigned char)splashRound(state->fillAlpha * 255), true, false);
             for (yy = 0, y1 = yStart; yy < yyLimit; ++yy, ++y1) {
                 pipeSetXY(&pipe, xStart, y1);
-                for (xx = 0, x1 = xStart; xx < xxLimit; ++xx, ++x1) {
-                    alpha = p[xx];
-                    if (alpha != 0) {
-                        pipe.shape = alpha;
-                        (this->*pipe.run)(&pipe);
-                    } else {
-                        pipeIncX(&pipe);
+                if (pipe.aaSpan) {
+                    if (xxLimit > 0) {
+                        (*pipe.aaSpan)(pipe.destColorPtr, pipe.destAlphaPtr, p, xxLimit, pipe.aInput, pipe.cSrc);
+                    }
+                } else {
+                    for (xx = 0, x1 = xStart; xx < xxLimit; ++xx, ++x1) {
+                        alpha = p[xx];
+                        if (alpha != 0) {
+                            pipe.shape = alpha;
+                            (this->*pipe.run)(&pipe);
+                        } else {
+                            pipeIncX(&pipe);
+                        }
                     }
                 }
                 p += glyph->w;
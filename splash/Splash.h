@@ -31,6 +31,7 @@
 #include "SplashTypes.h"
 #include "SplashClip.h"
 #include "SplashPattern.h"
+#include "SplashCompositeSpan.h"
 #include "poppler_private_export.h"
 
 class SplashBitmap;
@@ -241,6 +242,11 @@ public:
     // Toggle debug mode on or off.
     void setDebugMode(bool debugModeA) { debugMode = debugModeA; }
 
+    // Replace the span kernel used for antialiased fills and glyphs;
+    // nullptr composites every pixel through the pipe.  Meant for tests
+    // comparing the kernels with the pipe.
+    void setCompositeAASpanFunc(SplashCompositeAASpanFunc func) { aaSpanFunc = func; }
+
 #if 1 //~tmp: turn off anti-aliasing temporarily
     void setInShading(bool sh) { inShading = sh; }
     bool getVectorAntialias() { return vectorAntialias; }
@@ -319,6 +325,8 @@ private:
     SplashState *state;
     SplashBitmap *aaBuf;
     int aaBufY;
+    unsigned char *aaSpanShape; // shape values of the line drawn by drawAALine
+    SplashCompositeAASpanFunc aaSpanFunc; // span kernel for bitmap->mode, or nullptr
     SplashBitmap *alpha0Bitmap; // for non-isolated groups, this is the
                                 //   bitmap containing the alpha0 values
     int alpha0X, alpha0Y; // offset within alpha0Bitmap
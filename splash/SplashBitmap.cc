@@ -163,7 +163,7 @@ SplashBitmap::~SplashBitmap()
     delete separationList;
 }
 
-SplashError SplashBitmap::writePNMFile(char *fileName)
+SplashError SplashBitmap::writePNMFile(const char *fileName)
 {
     FILE *f;
     SplashError e;
@@ -256,7 +256,7 @@ SplashError SplashBitmap::writePNMFile(FILE *f)
     return splashOk;
 }
 
-SplashError SplashBitmap::writeAlphaPGMFile(char *fileName)
+SplashError SplashBitmap::writeAlphaPGMFile(const char *fileName)
 {
     FILE *f;
 
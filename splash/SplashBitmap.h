@@ -75,9 +75,9 @@ public:
     const unsigned char *getAlphaPtr() const { return alpha; }
     const std::vector<std::unique_ptr<GfxSeparationColorSpace>> *getSeparationList() const { return separationList; }
 
-    SplashError writePNMFile(char *fileName);
+    SplashError writePNMFile(const char *fileName);
     SplashError writePNMFile(FILE *f);
-    SplashError writeAlphaPGMFile(char *fileName);
+    SplashError writeAlphaPGMFile(const char *fileName);
 
     struct WriteImgParams
     {
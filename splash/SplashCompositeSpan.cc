@@ -0,0 +1,466 @@
+//========================================================================
+//
+// SplashCompositeSpan.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "SplashCompositeSpan.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define SPLASH_SPAN_SSE2 1
+#    include <emmintrin.h>
+#endif
+
+// AVX2 is selected at runtime, which needs the target attribute
+#if defined(SPLASH_SPAN_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define SPLASH_SPAN_AVX2 1
+#    include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#    define SPLASH_SPAN_NEON 1
+#    include <arm_neon.h>
+#endif
+
+//------------------------------------------------------------------------
+// helpers
+//------------------------------------------------------------------------
+
+static inline unsigned char div255(int x)
+{
+    return (unsigned char)((x + (x >> 8) + 0x80) >> 8);
+}
+
+// The source color in destination byte order.  The fourth byte is the
+// XBGR8 padding byte, which is always written as 255.
+template<int nComps, int bytesPerPixel, bool reversed>
+static inline void getSrcPixel(SplashColorConstPtr cSrc, unsigned char *src)
+{
+    for (int k = 0; k < nComps; ++k) {
+        src[k] = reversed ? cSrc[nComps - 1 - k] : cSrc[k];
+    }
+    for (int k = nComps; k < 4; ++k) {
+        src[k] = (k < bytesPerPixel) ? 255 : 0;
+    }
+}
+
+#if defined(SPLASH_SPAN_SSE2) || defined(SPLASH_SPAN_NEON)
+
+// The vector kernels divide by the result alpha as
+//   q = (n * recip[d]) >> 16, plus one if n - q * d >= d
+// which is exact for n <= 255 * 255 and 1 <= d <= 255.
+static constexpr std::array<uint16_t, 256> makeRecipTable()
+{
+    std::array<uint16_t, 256> table {};
+    table[0] = 0;
+    table[1] = 65535;
+    for (int d = 2; d < 256; ++d) {
+        table[d] = (uint16_t)(65536 / d);
+    }
+    return table;
+}
+
+static constexpr std::array<uint16_t, 256> recipTable = makeRecipTable();
+
+// Replicates a 16 bit value into the four lanes of one pixel.
+static inline uint64_t broadcast4(uint16_t x)
+{
+    return (uint64_t)x * 0x0001000100010001ULL;
+}
+
+// 3 byte formats are widened to 4 bytes per pixel for the vector code.
+template<int bytesPerPixel>
+static inline unsigned char *loadBlock(SplashColorPtr destColor, unsigned char *buf, int n)
+{
+    if (bytesPerPixel == 4) {
+        return destColor;
+    }
+    for (int j = 0; j < n; ++j) {
+        memcpy(buf + 4 * j, destColor + 3 * j, 3);
+        buf[4 * j + 3] = 0;
+    }
+    return buf;
+}
+
+template<int bytesPerPixel>
+static inline void storeBlock(SplashColorPtr destColor, const unsigned char *buf, int n)
+{
+    if (bytesPerPixel == 4) {
+        return;
+    }
+    for (int j = 0; j < n; ++j) {
+        memcpy(destColor + 3 * j, buf + 4 * j, 3);
+    }
+}
+
+#endif
+
+//------------------------------------------------------------------------
+// scalar reference
+//------------------------------------------------------------------------
+
+template<int nComps, int bytesPerPixel, bool reversed>
+static void compositeAASpanScalar(SplashColorPtr destColor, unsigned char *destAlpha, const unsigned char *shape, int n, unsigned char aInput, SplashColorConstPtr cSrc)
+{
+    unsigned char src[4];
+    int aSrc, aDest, aResult, k;
+
+    getSrcPixel<nComps, bytesPerPixel, reversed>(cSrc, src);
+    for (int i = 0; i < n; ++i, destColor += bytesPerPixel) {
+        if (shape[i] == 0) {
+            continue;
+        }
+        aSrc = div255(aInput * shape[i]);
+        aDest = destAlpha[i];
+        aResult = aSrc + aDest - div255(aSrc * aDest);
+        if (aResult == 0) {
+            for (k = 0; k < nComps; ++k) {
+                destColor[k] = 0;
+            }
+        } else {
+            for (k = 0; k < nComps; ++k) {
+                destColor[k] = (unsigned char)(((aResult - aSrc) * destColor[k] + aSrc * src[k]) / aResult);
+            }
+        }
+        if (bytesPerPixel > nComps) {
+            destColor[nComps] = 255;
+        }
+        destAlpha[i] = (unsigned char)aResult;
+    }
+}
+
+//------------------------------------------------------------------------
+// SSE2
+//------------------------------------------------------------------------
+
+#ifdef SPLASH_SPAN_SSE2
+
+static inline __m128i div255SSE2(__m128i x)
+{
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), _mm_set1_epi16(0x80)), 8);
+}
+
+static inline __m128i selectSSE2(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128i pairSSE2(const uint16_t *v, int j)
+{
+    return _mm_set_epi64x((long long)broadcast4(v[j + 1]), (long long)broadcast4(v[j]));
+}
+
+template<int nComps, int bytesPerPixel, bool reversed>
+static void compositeAASpanSSE2(SplashColorPtr destColor, unsigned char *destAlpha, const unsigned char *shape, int n, unsigned char aInput, SplashColorConstPtr cSrc)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i aIn = _mm_set1_epi16(aInput);
+    const __m128i xMask = (bytesPerPixel > nComps) ? _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0) : zero;
+    unsigned char src[4];
+    alignas(16) uint16_t aSrcs[8], wDests[8], divs[8], recips[8], skips[8];
+    alignas(16) unsigned char buf[32];
+    int i, j;
+
+    getSrcPixel<nComps, bytesPerPixel, reversed>(cSrc, src);
+    int32_t src32;
+    memcpy(&src32, src, 4);
+    const __m128i srcV = _mm_unpacklo_epi8(_mm_set1_epi32(src32), zero);
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        const __m128i sh = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(shape + i)), zero);
+        const __m128i skip = _mm_cmpeq_epi16(sh, zero);
+        if (_mm_movemask_epi8(skip) == 0xffff) {
+            continue;
+        }
+
+        //----- result alpha
+        const __m128i aDest = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(destAlpha + i)), zero);
+        const __m128i aSrc = div255SSE2(_mm_mullo_epi16(aIn, sh));
+        const __m128i aResult = _mm_sub_epi16(_mm_add_epi16(aSrc, aDest), div255SSE2(_mm_mullo_epi16(aSrc, aDest)));
+        const __m128i alpha = selectSSE2(skip, aDest, aResult);
+        _mm_storel_epi64((__m128i *)(destAlpha + i), _mm_packus_epi16(alpha, alpha));
+
+        _mm_store_si128((__m128i *)aSrcs, aSrc);
+        _mm_store_si128((__m128i *)wDests, _mm_sub_epi16(aResult, aSrc));
+        _mm_store_si128((__m128i *)divs, _mm_max_epi16(aResult, one));
+        _mm_store_si128((__m128i *)skips, skip);
+        for (j = 0; j < 8; ++j) {
+            recips[j] = recipTable[divs[j]];
+        }
+
+        //----- result color, two pixels at a time
+        SplashColorPtr p = destColor + bytesPerPixel * i;
+        unsigned char *q = loadBlock<bytesPerPixel>(p, buf, 8);
+        for (j = 0; j < 8; j += 2) {
+            const __m128i cDest = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(q + 4 * j)), zero);
+            const __m128i d = pairSSE2(divs, j);
+            const __m128i num = _mm_add_epi16(_mm_mullo_epi16(pairSSE2(wDests, j), cDest), _mm_mullo_epi16(pairSSE2(aSrcs, j), srcV));
+            __m128i quot = _mm_mulhi_epu16(num, pairSSE2(recips, j));
+            const __m128i rem = _mm_sub_epi16(num, _mm_mullo_epi16(quot, d));
+            quot = _mm_sub_epi16(quot, _mm_cmpgt_epi16(rem, _mm_sub_epi16(d, one)));
+            const __m128i res = selectSSE2(pairSSE2(skips, j), cDest, _mm_or_si128(quot, xMask));
+            _mm_storel_epi64((__m128i *)(q + 4 * j), _mm_packus_epi16(res, res));
+        }
+        storeBlock<bytesPerPixel>(p, q, 8);
+    }
+
+    compositeAASpanScalar<nComps, bytesPerPixel, reversed>(destColor + bytesPerPixel * i, destAlpha + i, shape + i, n - i, aInput, cSrc);
+}
+
+#endif
+
+//------------------------------------------------------------------------
+// AVX2
+//------------------------------------------------------------------------
+
+#ifdef SPLASH_SPAN_AVX2
+
+#    define SPLASH_AVX2_TARGET __attribute__((target("avx2")))
+
+SPLASH_AVX2_TARGET static inline __m256i div255AVX2(__m256i x)
+{
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), _mm256_set1_epi16(0x80)), 8);
+}
+
+SPLASH_AVX2_TARGET static inline __m256i quadAVX2(const uint16_t *v, int j)
+{
+    return _mm256_set_epi64x((long long)broadcast4(v[j + 3]), (long long)broadcast4(v[j + 2]), (long long)broadcast4(v[j + 1]), (long long)broadcast4(v[j]));
+}
+
+SPLASH_AVX2_TARGET static inline __m128i packAVX2(__m256i x)
+{
+    return _mm_packus_epi16(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+}
+
+template<int nComps, int bytesPerPixel, bool reversed>
+SPLASH_AVX2_TARGET static void compositeAASpanAVX2(SplashColorPtr destColor, unsigned char *destAlpha, const unsigned char *shape, int n, unsigned char aInput, SplashColorConstPtr cSrc)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i aIn = _mm256_set1_epi16(aInput);
+    const __m256i xMask = (bytesPerPixel > nComps) ? _mm256_set1_epi64x((long long)(255ULL << 48)) : zero;
+    unsigned char src[4];
+    alignas(32) uint16_t aSrcs[16], wDests[16], divs[16], recips[16], skips[16];
+    alignas(32) unsigned char buf[64];
+    int i, j;
+
+    getSrcPixel<nComps, bytesPerPixel, reversed>(cSrc, src);
+    int32_t src32;
+    memcpy(&src32, src, 4);
+    const __m256i srcV = _mm256_cvtepu8_epi16(_mm_set1_epi32(src32));
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        const __m256i sh = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(shape + i)));
+        const __m256i skip = _mm256_cmpeq_epi16(sh, zero);
+        if (_mm256_movemask_epi8(skip) == -1) {
+            continue;
+        }
+
+        //----- result alpha
+        const __m256i aDest = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(destAlpha + i)));
+        const __m256i aSrc = div255AVX2(_mm256_mullo_epi16(aIn, sh));
+        const __m256i aResult = _mm256_sub_epi16(_mm256_add_epi16(aSrc, aDest), div255AVX2(_mm256_mullo_epi16(aSrc, aDest)));
+        _mm_storeu_si128((__m128i *)(destAlpha + i), packAVX2(_mm256_blendv_epi8(aResult, aDest, skip)));
+
+        _mm256_store_si256((__m256i *)aSrcs, aSrc);
+        _mm256_store_si256((__m256i *)wDests, _mm256_sub_epi16(aResult, aSrc));
+        _mm256_store_si256((__m256i *)divs, _mm256_max_epi16(aResult, one));
+        _mm256_store_si256((__m256i *)skips, skip);
+        for (j = 0; j < 16; ++j) {
+            recips[j] = recipTable[divs[j]];
+        }
+
+        //----- result color, four pixels at a time
+        SplashColorPtr p = destColor + bytesPerPixel * i;
+        unsigned char *q = loadBlock<bytesPerPixel>(p, buf, 16);
+        for (j = 0; j < 16; j += 4) {
+            const __m256i cDest = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(q + 4 * j)));
+            const __m256i d = quadAVX2(divs, j);
+            const __m256i num = _mm256_add_epi16(_mm256_mullo_epi16(quadAVX2(wDests, j), cDest), _mm256_mullo_epi16(quadAVX2(aSrcs, j), srcV));
+            __m256i quot = _mm256_mulhi_epu16(num, quadAVX2(recips, j));
+            const __m256i rem = _mm256_sub_epi16(num, _mm256_mullo_epi16(quot, d));
+            quot = _mm256_sub_epi16(quot, _mm256_cmpgt_epi16(rem, _mm256_sub_epi16(d, one)));
+            const __m256i res = _mm256_blendv_epi8(_mm256_or_si256(quot, xMask), cDest, quadAVX2(skips, j));
+            _mm_storeu_si128((__m128i *)(q + 4 * j), packAVX2(res));
+        }
+        storeBlock<bytesPerPixel>(p, q, 16);
+    }
+
+    compositeAASpanSSE2<nComps, bytesPerPixel, reversed>(destColor + bytesPerPixel * i, destAlpha + i, shape + i, n - i, aInput, cSrc);
+}
+
+#endif
+
+//------------------------------------------------------------------------
+// NEON
+//------------------------------------------------------------------------
+
+#ifdef SPLASH_SPAN_NEON
+
+static inline uint16x8_t div255NEON(uint16x8_t x)
+{
+    return vshrq_n_u16(vaddq_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), vdupq_n_u16(0x80)), 8);
+}
+
+static inline uint16x8_t pairNEON(const uint16_t *v, int j)
+{
+    return vcombine_u16(vdup_n_u16(v[j]), vdup_n_u16(v[j + 1]));
+}
+
+template<int nComps, int bytesPerPixel, bool reversed>
+static void compositeAASpanNEON(SplashColorPtr destColor, unsigned char *destAlpha, const unsigned char *shape, int n, unsigned char aInput, SplashColorConstPtr cSrc)
+{
+    const uint16x8_t zero = vdupq_n_u16(0);
+    const uint16x8_t one = vdupq_n_u16(1);
+    const uint16x8_t aIn = vdupq_n_u16(aInput);
+    const uint16x8_t xMask = (bytesPerPixel > nComps) ? vreinterpretq_u16_u64(vdupq_n_u64(255ULL << 48)) : zero;
+    unsigned char src[4];
+    uint16_t aSrcs[8], wDests[8], divs[8], recips[8], skips[8];
+    unsigned char buf[32];
+    int i, j;
+
+    getSrcPixel<nComps, bytesPerPixel, reversed>(cSrc, src);
+    uint32_t src32;
+    memcpy(&src32, src, 4);
+    const uint16x8_t srcV = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(src32)));
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        const uint16x8_t sh = vmovl_u8(vld1_u8(shape + i));
+        if (vmaxvq_u16(sh) == 0) {
+            continue;
+        }
+        const uint16x8_t skip = vceqq_u16(sh, zero);
+
+        //----- result alpha
+        const uint16x8_t aDest = vmovl_u8(vld1_u8(destAlpha + i));
+        const uint16x8_t aSrc = div255NEON(vmulq_u16(aIn, sh));
+        const uint16x8_t aResult = vsubq_u16(vaddq_u16(aSrc, aDest), div255NEON(vmulq_u16(aSrc, aDest)));
+        vst1_u8(destAlpha + i, vmovn_u16(vbslq_u16(skip, aDest, aResult)));
+
+        vst1q_u16(aSrcs, aSrc);
+        vst1q_u16(wDests, vsubq_u16(aResult, aSrc));
+        vst1q_u16(divs, vmaxq_u16(aResult, one));
+        vst1q_u16(skips, skip);
+        for (j = 0; j < 8; ++j) {
+            recips[j] = recipTable[divs[j]];
+        }
+
+        //----- result color, two pixels at a time
+        SplashColorPtr p = destColor + bytesPerPixel * i;
+        unsigned char *q = loadBlock<bytesPerPixel>(p, buf, 8);
+        for (j = 0; j < 8; j += 2) {
+            const uint16x8_t cDest = vmovl_u8(vld1_u8(q + 4 * j));
+            const uint16x8_t d = pairNEON(divs, j);
+            const uint16x8_t recip = pairNEON(recips, j);
+            const uint16x8_t num = vmlaq_u16(vmulq_u16(pairNEON(wDests, j), cDest), pairNEON(aSrcs, j), srcV);
+            uint16x8_t quot = vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(num), vget_low_u16(recip)), 16), vshrn_n_u32(vmull_u16(vget_high_u16(num), vget_high_u16(recip)), 16));
+            const uint16x8_t rem = vmlsq_u16(num, quot, d);
+            quot = vsubq_u16(quot, vcgeq_u16(rem, d));
+            const uint16x8_t res = vbslq_u16(pairNEON(skips, j), cDest, vorrq_u16(quot, xMask));
+            vst1_u8(q + 4 * j, vmovn_u16(res));
+        }
+        storeBlock<bytesPerPixel>(p, q, 8);
+    }
+
+    compositeAASpanScalar<nComps, bytesPerPixel, reversed>(destColor + bytesPerPixel * i, destAlpha + i, shape + i, n - i, aInput, cSrc);
+}
+
+#endif
+
+//------------------------------------------------------------------------
+// dispatch
+//------------------------------------------------------------------------
+
+namespace {
+
+struct SpanKernels
+{
+    SplashCompositeAASpanFunc rgb8, bgr8, xbgr8, cmyk8;
+};
+
+}
+
+#define SPAN_KERNELS(kernel) { &kernel<3, 3, false>, &kernel<3, 3, true>, &kernel<3, 4, true>, &kernel<4, 4, false> }
+
+static SplashCompositeAASpanFunc selectKernel(const SpanKernels &kernels, SplashColorMode mode)
+{
+    switch (mode) {
+    case splashModeRGB8:
+        return kernels.rgb8;
+    case splashModeBGR8:
+        return kernels.bgr8;
+    case splashModeXBGR8:
+        return kernels.xbgr8;
+    case splashModeCMYK8:
+        return kernels.cmyk8;
+    default:
+        return nullptr;
+    }
+}
+
+SplashSpanImpl splashGetBestSpanImpl()
+{
+    static const SplashSpanImpl best = [] {
+#ifdef SPLASH_SPAN_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return splashSpanImplAVX2;
+        }
+#endif
+#if defined(SPLASH_SPAN_SSE2)
+        return splashSpanImplSSE2;
+#elif defined(SPLASH_SPAN_NEON)
+        return splashSpanImplNEON;
+#else
+        return splashSpanImplScalar;
+#endif
+    }();
+    return best;
+}
+
+SplashCompositeAASpanFunc splashGetCompositeAASpanFunc(SplashColorMode mode, SplashSpanImpl impl)
+{
+    switch (impl) {
+    case splashSpanImplScalar: {
+        static const SpanKernels kernels = SPAN_KERNELS(compositeAASpanScalar);
+        return selectKernel(kernels, mode);
+    }
+#ifdef SPLASH_SPAN_SSE2
+    case splashSpanImplSSE2: {
+        static const SpanKernels kernels = SPAN_KERNELS(compositeAASpanSSE2);
+        return selectKernel(kernels, mode);
+    }
+#endif
+#ifdef SPLASH_SPAN_AVX2
+    case splashSpanImplAVX2: {
+        if (splashGetBestSpanImpl() != splashSpanImplAVX2) {
+            return nullptr;
+        }
+        static const SpanKernels kernels = SPAN_KERNELS(compositeAASpanAVX2);
+        return selectKernel(kernels, mode);
+    }
+#endif
+#ifdef SPLASH_SPAN_NEON
+    case splashSpanImplNEON: {
+        static const SpanKernels kernels = SPAN_KERNELS(compositeAASpanNEON);
+        return selectKernel(kernels, mode);
+    }
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+SplashCompositeAASpanFunc splashGetCompositeAASpanFunc(SplashColorMode mode)
+{
+    return splashGetCompositeAASpanFunc(mode, splashGetBestSpanImpl());
+}
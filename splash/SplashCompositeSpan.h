@@ -0,0 +1,46 @@
+//========================================================================
+//
+// SplashCompositeSpan.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHCOMPOSITESPAN_H
+#define SPLASHCOMPOSITESPAN_H
+
+#include "poppler_private_export.h"
+#include "SplashTypes.h"
+
+//------------------------------------------------------------------------
+// span compositing kernels
+//------------------------------------------------------------------------
+
+// Composites <n> pixels of the solid color <cSrc> with the source alpha
+// <aInput> and the per-pixel coverage values in <shape> onto a
+// destination that has an alpha channel.  Pixels whose shape is zero are
+// left untouched.  The result is identical to calling the matching
+// Splash::pipeRunAA* function for every pixel with a non-zero shape,
+// assuming an identity transfer function and no overprinting.
+typedef void (*SplashCompositeAASpanFunc)(SplashColorPtr destColor, unsigned char *destAlpha, const unsigned char *shape, int n, unsigned char aInput, SplashColorConstPtr cSrc);
+
+enum SplashSpanImpl
+{
+    splashSpanImplScalar,
+    splashSpanImplSSE2,
+    splashSpanImplAVX2,
+    splashSpanImplNEON
+};
+
+// The fastest implementation supported by this build and CPU.
+POPPLER_PRIVATE_EXPORT SplashSpanImpl splashGetBestSpanImpl();
+
+// Returns the kernel for <mode> using <impl>, or nullptr if <mode> has
+// no span kernel (only RGB8, BGR8, XBGR8 and CMYK8 have one) or <impl>
+// is not available.
+POPPLER_PRIVATE_EXPORT SplashCompositeAASpanFunc splashGetCompositeAASpanFunc(SplashColorMode mode, SplashSpanImpl impl);
+
+// Same, using the fastest available implementation.
+POPPLER_PRIVATE_EXPORT SplashCompositeAASpanFunc splashGetCompositeAASpanFunc(SplashColorMode mode);
+
+#endif
@@ -0,0 +1,190 @@
+//========================================================================
+//
+// SplashFTFaceCache.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include "SplashGlyphCache.h"
+#include "SplashFTFaceCache.h"
+
+// default size limit, in bytes
+#define splashFTFaceCacheDefaultSize (32 * 1024 * 1024)
+
+// approximate memory FreeType uses for a face on top of the font data
+#define splashFTFaceCacheEntryOverhead (16 * 1024)
+
+//------------------------------------------------------------------------
+// SplashFTFaceLibrary
+//------------------------------------------------------------------------
+
+// The FT_Library of the cached faces.  It is kept alive by the faces,
+// so that a face may outlive the cache.
+struct SplashFTFaceLibrary
+{
+    SplashFTFaceLibrary()
+    {
+        if (FT_Init_FreeType(&lib)) {
+            lib = nullptr;
+        }
+    }
+
+    ~SplashFTFaceLibrary()
+    {
+        if (lib) {
+            FT_Done_FreeType(lib);
+        }
+    }
+
+    FT_Library lib;
+    // FT_New_Memory_Face and FT_Done_Face aren't thread safe on one
+    // library, the other calls only need the face to be locked
+    std::mutex mutex;
+};
+
+//------------------------------------------------------------------------
+// SplashFTSharedFace
+//------------------------------------------------------------------------
+
+SplashFTSharedFace::~SplashFTSharedFace()
+{
+    if (face) {
+        const std::scoped_lock locker(lib->mutex);
+        FT_Done_Face(face);
+    }
+}
+
+//------------------------------------------------------------------------
+// SplashFTFaceCache
+//------------------------------------------------------------------------
+
+SplashFTFaceCache *SplashFTFaceCache::getInstance()
+{
+    static SplashFTFaceCache instance;
+    return &instance;
+}
+
+SplashFTFaceCache::SplashFTFaceCache() : lib(std::make_shared<SplashFTFaceLibrary>()), size(0), maxSize(splashFTFaceCacheDefaultSize), hits(0), misses(0), evictions(0) { }
+
+SplashFTFaceCache::~SplashFTFaceCache() = default;
+
+// Must be called with the mutex locked.
+std::shared_ptr<SplashFTSharedFace> SplashFTFaceCache::find(uint64_t hash, const std::vector<unsigned char> &data, int faceIndex)
+{
+    auto range = index.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        const Entry &entry = *it->second;
+        if (entry.faceIndex == faceIndex && entry.face->data == data) {
+            lru.splice(lru.begin(), lru, it->second);
+            return entry.face;
+        }
+    }
+    return nullptr;
+}
+
+// Must be called with the mutex locked.
+void SplashFTFaceCache::evict(size_t limit)
+{
+    while (size > limit && !lru.empty()) {
+        const auto last = std::prev(lru.end());
+        auto range = index.equal_range(last->face->dataHash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == last) {
+                index.erase(it);
+                break;
+            }
+        }
+        size -= last->face->data.size() + splashFTFaceCacheEntryOverhead;
+        lru.pop_back();
+        ++evictions;
+    }
+}
+
+void SplashFTFaceCache::setMaxSize(size_t maxSizeA)
+{
+    const std::scoped_lock locker(mutex);
+    maxSize = maxSizeA;
+    evict(maxSize);
+}
+
+size_t SplashFTFaceCache::getMaxSize() const
+{
+    const std::scoped_lock locker(mutex);
+    return maxSize;
+}
+
+std::shared_ptr<SplashFTSharedFace> SplashFTFaceCache::getFace(const std::vector<unsigned char> &data, int faceIndex)
+{
+    if (data.empty() || !lib->lib) {
+        return nullptr;
+    }
+
+    const uint64_t hash = splashHashBytes(data.data(), data.size());
+    {
+        const std::scoped_lock locker(mutex);
+        if (data.size() + splashFTFaceCacheEntryOverhead > maxSize) {
+            return nullptr;
+        }
+        if (std::shared_ptr<SplashFTSharedFace> face = find(hash, data, faceIndex)) {
+            ++hits;
+            return face;
+        }
+        ++misses;
+    }
+
+    // load without holding the lock; if another thread is loading the
+    // same font, the first one to finish gets to cache it
+    auto face = std::make_shared<SplashFTSharedFace>();
+    face->data = data;
+    face->dataHash = hash;
+    face->lib = lib;
+    {
+        const std::scoped_lock libLocker(lib->mutex);
+        if (FT_New_Memory_Face(lib->lib, (const FT_Byte *)face->data.data(), face->data.size(), faceIndex, &face->face)) {
+            face->face = nullptr;
+            return nullptr;
+        }
+    }
+
+    const std::scoped_lock locker(mutex);
+    if (std::shared_ptr<SplashFTSharedFace> other = find(hash, data, faceIndex)) {
+        return other;
+    }
+    lru.push_front({ faceIndex, face });
+    index.emplace(hash, lru.begin());
+    size += face->data.size() + splashFTFaceCacheEntryOverhead;
+    evict(maxSize);
+    return face;
+}
+
+void SplashFTFaceCache::clear()
+{
+    const std::scoped_lock locker(mutex);
+    index.clear();
+    lru.clear();
+    size = 0;
+}
+
+SplashFTFaceCache::Stats SplashFTFaceCache::getStats() const
+{
+    const std::scoped_lock locker(mutex);
+    Stats stats;
+
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.size = size;
+    stats.faces = lru.size();
+    return stats;
+}
+
+void SplashFTFaceCache::resetStats()
+{
+    const std::scoped_lock locker(mutex);
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
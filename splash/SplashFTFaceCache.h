@@ -0,0 +1,123 @@
+//========================================================================
+//
+// SplashFTFaceCache.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHFTFACECACHE_H
+#define SPLASHFTFACECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "poppler_private_export.h"
+
+struct SplashFTFaceLibrary;
+
+//------------------------------------------------------------------------
+// SplashFTSharedFace
+//------------------------------------------------------------------------
+
+// An FT_Face together with the font data it was made from.  Several
+// font files, of several documents and threads, may use the same face:
+// everything that touches its sizes, transform or glyph slot must hold
+// <mutex>.
+struct SplashFTSharedFace
+{
+    SplashFTSharedFace() = default;
+    ~SplashFTSharedFace();
+
+    SplashFTSharedFace(const SplashFTSharedFace &) = delete;
+    SplashFTSharedFace &operator=(const SplashFTSharedFace &) = delete;
+
+    FT_Face face = nullptr;
+    std::mutex mutex;
+    std::vector<unsigned char> data;
+    uint64_t dataHash = 0; // splashHashBytes() of data
+    std::shared_ptr<SplashFTFaceLibrary> lib;
+};
+
+//------------------------------------------------------------------------
+// SplashFTFaceCache
+//------------------------------------------------------------------------
+
+// A process-wide cache of FreeType faces of embedded fonts, so that a
+// font embedded byte for byte the same in many documents (the same
+// subset in every invoice made from one template) is only loaded by
+// FreeType once.
+//
+// Faces are found by the content of the font data and the face index,
+// not by the PDF object they came from.  They are made in an FT_Library
+// owned by the cache.  The least recently used faces are dropped once
+// the cache is over its size limit; a face still used by a font file
+// lives on until that font file is deleted.  All methods can be called
+// from several threads at once.
+class POPPLER_PRIVATE_EXPORT SplashFTFaceCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t size; // bytes currently used
+        size_t faces; // number of cached faces
+    };
+
+    static SplashFTFaceCache *getInstance();
+
+    SplashFTFaceCache(const SplashFTFaceCache &) = delete;
+    SplashFTFaceCache &operator=(const SplashFTFaceCache &) = delete;
+
+    // Set the size limit in bytes; 0 disables the cache.  Shrinking the
+    // limit evicts faces as needed.
+    void setMaxSize(size_t maxSizeA);
+    size_t getMaxSize() const;
+
+    // Return the face <faceIndex> of the font in <data>, which is copied
+    // on a miss.  Returns nullptr if the cache is disabled, the font is
+    // over the size limit or FreeType can't load it, in which case the
+    // caller loads the face itself.
+    std::shared_ptr<SplashFTSharedFace> getFace(const std::vector<unsigned char> &data, int faceIndex);
+
+    // Remove all faces.  The counters are kept.
+    void clear();
+
+    Stats getStats() const;
+    void resetStats();
+
+private:
+    SplashFTFaceCache();
+    ~SplashFTFaceCache();
+
+    struct Entry
+    {
+        int faceIndex;
+        std::shared_ptr<SplashFTSharedFace> face;
+    };
+
+    std::shared_ptr<SplashFTSharedFace> find(uint64_t hash, const std::vector<unsigned char> &data, int faceIndex);
+    void evict(size_t limit);
+
+    mutable std::mutex mutex;
+    std::shared_ptr<SplashFTFaceLibrary> lib;
+    std::list<Entry> lru; // most recently used first
+    std::unordered_multimap<uint64_t, std::list<Entry>::iterator> index; // by data hash
+    size_t size;
+    size_t maxSize;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+#endif
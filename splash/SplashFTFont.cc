@@ -60,6 +60,9 @@ SplashFTFont::SplashFTFont(SplashFTFontFile *fontFileA, SplashCoord *matA, const
     int div;
     int x, y;
 
+    renderFlags |= (enableFreeTypeHinting ? 2 : 0) | (enableSlightHinting ? 4 : 0);
+
+    const std::unique_lock<std::mutex> locker = fontFileA->lockFace();
     face = fontFileA->face;
     if (FT_New_Size(face, &sizeObj)) {
         return;
@@ -148,7 +151,14 @@ SplashFTFont::SplashFTFont(SplashFTFontFile *fontFileA, SplashCoord *matA, const
     isOk = true;
 }
 
-SplashFTFont::~SplashFTFont() = default;
+SplashFTFont::~SplashFTFont()
+{
+    if (sizeObj) {
+        // the face may be shared, and outlive this font
+        const std::unique_lock<std::mutex> locker = ((SplashFTFontFile *)fontFile)->lockFace();
+        FT_Done_Size(sizeObj);
+    }
+}
 
 bool SplashFTFont::getGlyph(int c, int xFrac, int yFrac, SplashGlyphBitmap *bitmap, int x0, int y0, SplashClip *clip, SplashClipResult *clipRes)
 {
@@ -201,6 +211,7 @@ bool SplashFTFont::makeGlyph(int c, int xFrac, int yFrac, SplashGlyphBitmap *bit
 
     ff = (SplashFTFontFile *)fontFile;
 
+    const std::unique_lock<std::mutex> locker = ff->lockFace();
     ff->face->size = sizeObj;
     offset.x = (FT_Pos)(int)((SplashCoord)xFrac * splashFontFractionMul * 64);
     offset.y = 0;
@@ -283,6 +294,7 @@ double SplashFTFont::getGlyphAdvance(int c)
     offset.x = 0;
     offset.y = 0;
 
+    const std::unique_lock<std::mutex> locker = ff->lockFace();
     ff->face->size = sizeObj;
     FT_Set_Transform(ff->face, &identityMatrix, &offset);
 
@@ -335,6 +347,7 @@ SplashPath *SplashFTFont::getGlyphPath(int c)
     }
 
     ff = (SplashFTFontFile *)fontFile;
+    const std::unique_lock<std::mutex> locker = ff->lockFace();
     ff->face->size = sizeObj;
     FT_Set_Transform(ff->face, &textMatrix, nullptr);
     slot = ff->face->glyph;
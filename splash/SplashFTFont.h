@@ -58,7 +58,7 @@ public:
     double getGlyphAdvance(int c) override;
 
 private:
-    FT_Size sizeObj;
+    FT_Size sizeObj = nullptr;
     FT_Matrix matrix;
     FT_Matrix textMatrix;
     SplashCoord textScale;
@@ -28,10 +28,12 @@
 #include "goo/gmem.h"
 #include "goo/GooString.h"
 #include "poppler/GfxFont.h"
+#include "SplashFTFaceCache.h"
 #include "SplashFTFontEngine.h"
 #include "SplashFTFont.h"
 #include "SplashFTFontFile.h"
 #include "SplashFontFileID.h"
+#include "SplashGlyphCache.h"
 
 //------------------------------------------------------------------------
 // SplashFTFontFile
@@ -40,85 +42,124 @@
 SplashFontFile *SplashFTFontFile::loadType1Font(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, SplashFontSrc *src, const char **encA, int faceIndexA)
 {
     FT_Face faceA;
+    std::shared_ptr<SplashFTSharedFace> sharedFaceA;
     const char *name;
     int i;
 
-    if (src->isFile) {
-        if (ft_new_face_from_file(engineA->lib, src->fileName.c_str(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
-    } else {
-        if (FT_New_Memory_Face(engineA->lib, (const FT_Byte *)src->buf.data(), src->buf.size(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
+    if (!loadFace(engineA, src, faceIndexA, &faceA, &sharedFaceA)) {
+        return nullptr;
     }
     std::vector<int> codeToGIDA;
     codeToGIDA.resize(256, 0);
-    for (i = 0; i < 256; ++i) {
-        if ((name = encA[i])) {
-            codeToGIDA[i] = (int)FT_Get_Name_Index(faceA, (char *)name);
-            if (codeToGIDA[i] == 0) {
-                name = GfxFont::getAlternateName(name);
-                if (name) {
-                    codeToGIDA[i] = FT_Get_Name_Index(faceA, (char *)name);
+    {
+        std::unique_lock<std::mutex> locker;
+        if (sharedFaceA) {
+            locker = std::unique_lock(sharedFaceA->mutex);
+        }
+        for (i = 0; i < 256; ++i) {
+            if ((name = encA[i])) {
+                codeToGIDA[i] = (int)FT_Get_Name_Index(faceA, (char *)name);
+                if (codeToGIDA[i] == 0) {
+                    name = GfxFont::getAlternateName(name);
+                    if (name) {
+                        codeToGIDA[i] = FT_Get_Name_Index(faceA, (char *)name);
+                    }
                 }
             }
         }
     }
 
-    return new SplashFTFontFile(engineA, std::move(idA), src, faceA, std::move(codeToGIDA), false, true);
+    return new SplashFTFontFile(engineA, std::move(idA), src, faceA, std::move(sharedFaceA), faceIndexA, std::move(codeToGIDA), false, true);
 }
 
 SplashFontFile *SplashFTFontFile::loadCIDFont(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, SplashFontSrc *src, std::vector<int> &&codeToGIDA, int faceIndexA)
 {
     FT_Face faceA;
+    std::shared_ptr<SplashFTSharedFace> sharedFaceA;
 
-    if (src->isFile) {
-        if (ft_new_face_from_file(engineA->lib, src->fileName.c_str(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
-    } else {
-        if (FT_New_Memory_Face(engineA->lib, (const FT_Byte *)src->buf.data(), src->buf.size(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
+    if (!loadFace(engineA, src, faceIndexA, &faceA, &sharedFaceA)) {
+        return nullptr;
     }
 
-    return new SplashFTFontFile(engineA, std::move(idA), src, faceA, std::move(codeToGIDA), false, false);
+    return new SplashFTFontFile(engineA, std::move(idA), src, faceA, std::move(sharedFaceA), faceIndexA, std::move(codeToGIDA), false, false);
 }
 
 SplashFontFile *SplashFTFontFile::loadTrueTypeFont(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, SplashFontSrc *src, std::vector<int> &&codeToGIDA, int faceIndexA)
 {
     FT_Face faceA;
+    std::shared_ptr<SplashFTSharedFace> sharedFaceA;
 
-    if (src->isFile) {
-        if (ft_new_face_from_file(engineA->lib, src->fileName.c_str(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
-    } else {
-        if (FT_New_Memory_Face(engineA->lib, (const FT_Byte *)src->buf.data(), src->buf.size(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
+    if (!loadFace(engineA, src, faceIndexA, &faceA, &sharedFaceA)) {
+        return nullptr;
     }
 
-    return new SplashFTFontFile(engineA, std::move(idA), src, faceA, std::move(codeToGIDA), true, false);
+    return new SplashFTFontFile(engineA, std::move(idA), src, faceA, std::move(sharedFaceA), faceIndexA, std::move(codeToGIDA), true, false);
 }
 
-SplashFTFontFile::SplashFTFontFile(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, SplashFontSrc *srcA, FT_Face faceA, std::vector<int> &&codeToGIDA, bool trueTypeA, bool type1A) : SplashFontFile(std::move(idA), srcA)
+SplashFTFontFile::SplashFTFontFile(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, SplashFontSrc *srcA, FT_Face faceA, std::shared_ptr<SplashFTSharedFace> &&sharedFaceA, int faceIndexA, std::vector<int> &&codeToGIDA,
+                                   bool trueTypeA, bool type1A)
+    : SplashFontFile(std::move(idA), srcA)
 {
     engine = engineA;
     face = faceA;
+    sharedFace = std::move(sharedFaceA);
     codeToGID = std::move(codeToGIDA);
     trueType = trueTypeA;
     type1 = type1A;
+
+    // only embedded fonts share their glyphs: the glyph cache compares
+    // their data, a font on disk may change under the same path
+    SplashGlyphCache *glyphCache = SplashGlyphCache::getInstance();
+    if (!src->isFile && glyphCache->isEnabled()) {
+        auto font = std::make_shared<SplashGlyphCacheFont>();
+        uint64_t dataHash;
+        if (sharedFace) {
+            font->data = std::shared_ptr<const std::vector<unsigned char>>(sharedFace, &sharedFace->data);
+            dataHash = sharedFace->dataHash;
+        } else {
+            font->data = std::make_shared<const std::vector<unsigned char>>(src->buf);
+            dataHash = splashHashBytes(src->buf.data(), src->buf.size());
+        }
+        font->faceIndex = faceIndexA;
+        font->codeToGID = codeToGID;
+        font->type = (trueType ? 1 : 0) | (type1 ? 2 : 0);
+        font->computeHash(dataHash);
+        glyphCacheFont = glyphCache->getFont(std::move(font));
+    }
+
+    // a shared face uses the face cache's copy of the font data
+    if (sharedFace) {
+        src->buf = std::vector<unsigned char>();
+    }
 }
 
 SplashFTFontFile::~SplashFTFontFile()
 {
-    if (face) {
+    if (face && !sharedFace) {
         FT_Done_Face(face);
     }
 }
 
+bool SplashFTFontFile::loadFace(SplashFTFontEngine *engineA, SplashFontSrc *src, int faceIndexA, FT_Face *faceA, std::shared_ptr<SplashFTSharedFace> *sharedFaceA)
+{
+    if (src->isFile) {
+        return !ft_new_face_from_file(engineA->lib, src->fileName.c_str(), faceIndexA, faceA);
+    }
+    if ((*sharedFaceA = SplashFTFaceCache::getInstance()->getFace(src->buf, faceIndexA))) {
+        *faceA = (*sharedFaceA)->face;
+        return true;
+    }
+    return !FT_New_Memory_Face(engineA->lib, (const FT_Byte *)src->buf.data(), src->buf.size(), faceIndexA, faceA);
+}
+
+std::unique_lock<std::mutex> SplashFTFontFile::lockFace()
+{
+    if (sharedFace) {
+        return std::unique_lock(sharedFace->mutex);
+    }
+    return {};
+}
+
 SplashFont *SplashFTFontFile::makeFont(SplashCoord *mat, const SplashCoord *textMat)
 {
     SplashFont *font;
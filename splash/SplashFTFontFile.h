@@ -25,6 +25,8 @@
 #ifndef SPLASHFTFONTFILE_H
 #define SPLASHFTFONTFILE_H
 
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <ft2build.h>
@@ -33,6 +35,7 @@
 
 class SplashFontFileID;
 class SplashFTFontEngine;
+struct SplashFTSharedFace;
 
 //------------------------------------------------------------------------
 // SplashFTFontFile
@@ -52,10 +55,20 @@ public:
     SplashFont *makeFont(SplashCoord *mat, const SplashCoord *textMat) override;
 
 private:
-    SplashFTFontFile(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, SplashFontSrc *src, FT_Face faceA, std::vector<int> &&codeToGIDA, bool trueTypeA, bool type1A);
+    SplashFTFontFile(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, SplashFontSrc *src, FT_Face faceA, std::shared_ptr<SplashFTSharedFace> &&sharedFaceA, int faceIndexA, std::vector<int> &&codeToGIDA, bool trueTypeA, bool type1A);
+
+    // Load the face of <src>; embedded fonts come from the
+    // SplashFTFaceCache when possible, in which case <sharedFaceA> is
+    // set.
+    static bool loadFace(SplashFTFontEngine *engineA, SplashFontSrc *src, int faceIndexA, FT_Face *faceA, std::shared_ptr<SplashFTSharedFace> *sharedFaceA);
+
+    // Lock the face while using it, if it is shared with other font
+    // files.
+    std::unique_lock<std::mutex> lockFace();
 
     SplashFTFontEngine *engine;
     FT_Face face;
+    std::shared_ptr<SplashFTSharedFace> sharedFace; // nullptr if <face> is ours
     std::vector<int> codeToGID;
     bool trueType;
     bool type1;
@@ -28,6 +28,7 @@
 #include "SplashGlyphBitmap.h"
 #include "SplashFontFile.h"
 #include "SplashFont.h"
+#include "SplashGlyphCache.h"
 
 //------------------------------------------------------------------------
 
@@ -56,6 +57,7 @@ SplashFont::SplashFont(SplashFontFile *fontFileA, const SplashCoord *matA, const
     textMat[2] = textMatA[2];
     textMat[3] = textMatA[3];
     aa = aaA;
+    renderFlags = aa ? 1 : 0;
 
     cache = nullptr;
     cacheTags = nullptr;
@@ -155,9 +157,31 @@ bool SplashFont::getGlyph(int c, int xFrac, int yFrac, SplashGlyphBitmap *bitmap
         }
     }
 
-    // generate the glyph bitmap
-    if (!makeGlyph(c, xFrac, yFrac, &bitmap2, x0, y0, clip, clipRes)) {
-        return false;
+    // check the shared cache, then generate the glyph bitmap
+    SplashGlyphCache *sharedCache = SplashGlyphCache::getInstance();
+    SplashGlyphCacheKey key;
+    const bool useSharedCache = fontFile->getGlyphCacheFont() && sharedCache->isEnabled();
+    if (useSharedCache) {
+        key.font = fontFile->getGlyphCacheFont();
+        key.mat[0] = mat[0];
+        key.mat[1] = mat[1];
+        key.mat[2] = mat[2];
+        key.mat[3] = mat[3];
+        key.flags = renderFlags;
+        key.c = c;
+        key.xFrac = (short)xFrac;
+        key.yFrac = (short)yFrac;
+    }
+    if (useSharedCache && sharedCache->lookup(key, &bitmap2)) {
+        *clipRes = clip->testRect(x0 - bitmap2.x, y0 - bitmap2.y, x0 - bitmap2.x + bitmap2.w, y0 - bitmap2.y + bitmap2.h);
+    } else {
+        if (!makeGlyph(c, xFrac, yFrac, &bitmap2, x0, y0, clip, clipRes)) {
+            return false;
+        }
+        // glyphs that are entirely clipped away are not rendered
+        if (useSharedCache && *clipRes != splashClipAllOutside) {
+            sharedCache->insert(key, bitmap2);
+        }
     }
 
     if (*clipRes == splashClipAllOutside) {
@@ -104,6 +104,9 @@ protected:
     SplashCoord textMat[4]; // text transform matrix
                             //   (text space -> user space)
     bool aa; // anti-aliasing
+    unsigned int renderFlags; // rasterizer options that change the glyph
+                              //   bitmaps; bit 0 is aa, subclasses add
+                              //   their own
     int xMin, yMin, xMax, yMax; // glyph bounding box
     unsigned char *cache; // glyph bitmap cache
     SplashFontCacheTag * // cache tags
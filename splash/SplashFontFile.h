@@ -34,6 +34,7 @@
 class SplashFontEngine;
 class SplashFont;
 class SplashFontFileID;
+struct SplashGlyphCacheFont;
 
 //------------------------------------------------------------------------
 // SplashFontFile
@@ -78,6 +79,11 @@ public:
     // Get the font file ID.
     const SplashFontFileID &getID() const { return *id; }
 
+    // The font data and everything else that determines the glyph
+    // shapes, used to share glyphs between documents.  nullptr if the
+    // glyphs are not to be shared.
+    const SplashGlyphCacheFont *getGlyphCacheFont() const { return glyphCacheFont.get(); }
+
     // Increment the reference count.
     void incRefCnt();
 
@@ -92,6 +98,7 @@ protected:
 
     std::unique_ptr<SplashFontFileID> id;
     SplashFontSrc *src;
+    std::shared_ptr<const SplashGlyphCacheFont> glyphCacheFont;
     int refCnt;
 
     friend class SplashFontEngine;
@@ -0,0 +1,256 @@
+//========================================================================
+//
+// SplashGlyphCache.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+
+#include "goo/gmem.h"
+#include "SplashGlyphBitmap.h"
+#include "SplashGlyphCache.h"
+
+// default size limit, in bytes
+#define splashGlyphCacheDefaultSize (16 * 1024 * 1024)
+
+// approximate bookkeeping cost of a glyph on top of its bitmap data
+#define splashGlyphCacheEntryOverhead 128
+
+//------------------------------------------------------------------------
+// SplashGlyphCacheFont
+//------------------------------------------------------------------------
+
+void SplashGlyphCacheFont::computeHash(uint64_t dataHash)
+{
+    hash = splashHashBytes(&dataHash, sizeof(dataHash));
+    hash = splashHashBytes(&faceIndex, sizeof(faceIndex), hash);
+    hash = splashHashBytes(codeToGID.data(), codeToGID.size() * sizeof(int), hash);
+    hash = splashHashBytes(&type, sizeof(type), hash);
+}
+
+bool SplashGlyphCacheFont::operator==(const SplashGlyphCacheFont &other) const
+{
+    if (hash != other.hash || faceIndex != other.faceIndex || type != other.type || codeToGID != other.codeToGID) {
+        return false;
+    }
+    return data == other.data || (data && other.data && *data == *other.data);
+}
+
+//------------------------------------------------------------------------
+// SplashGlyphCacheKey
+//------------------------------------------------------------------------
+
+uint64_t SplashGlyphCacheKey::hash() const
+{
+    uint64_t h = font->hash;
+    for (SplashCoord m : mat) {
+        // -0 and 0 compare equal, so they have to hash the same
+        const double d = (double)m + 0.0;
+        h = splashHashBytes(&d, sizeof(d), h);
+    }
+    h = splashHashBytes(&flags, sizeof(flags), h);
+    h = splashHashBytes(&c, sizeof(c), h);
+    h = splashHashBytes(&xFrac, sizeof(xFrac), h);
+    h = splashHashBytes(&yFrac, sizeof(yFrac), h);
+    return h;
+}
+
+namespace {
+
+struct SplashGlyphCacheKeyHash
+{
+    size_t operator()(const SplashGlyphCacheKey &key) const { return (size_t)key.hash(); }
+};
+
+struct SplashGlyphCacheEntry
+{
+    SplashGlyphCacheKey key;
+    std::shared_ptr<const SplashGlyphCacheFont> font; // keeps key.font registered
+    int x, y, w, h;
+    bool aa;
+    std::vector<unsigned char> data;
+
+    size_t cost() const { return data.size() + splashGlyphCacheEntryOverhead; }
+};
+
+}
+
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//------------------------------------------------------------------------
+
+struct SplashGlyphCache::Shard
+{
+    std::mutex mutex;
+    std::list<SplashGlyphCacheEntry> lru; // most recently used first
+    std::unordered_map<SplashGlyphCacheKey, std::list<SplashGlyphCacheEntry>::iterator, SplashGlyphCacheKeyHash> index;
+    size_t size = 0;
+};
+
+SplashGlyphCache *SplashGlyphCache::getInstance()
+{
+    static SplashGlyphCache instance;
+    return &instance;
+}
+
+SplashGlyphCache::SplashGlyphCache() : shards(new Shard[nShards]), fontsSweepSize(64), maxSize(splashGlyphCacheDefaultSize), hits(0), misses(0), evictions(0) { }
+
+SplashGlyphCache::~SplashGlyphCache()
+{
+    delete[] shards;
+}
+
+std::shared_ptr<const SplashGlyphCacheFont> SplashGlyphCache::getFont(std::shared_ptr<const SplashGlyphCacheFont> font)
+{
+    std::lock_guard<std::mutex> lock(fontsMutex);
+    auto range = fonts.equal_range(font->hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        std::shared_ptr<const SplashGlyphCacheFont> registered = it->second.lock();
+        if (registered && *registered == *font) {
+            return registered;
+        }
+    }
+    if (fonts.size() >= fontsSweepSize) {
+        for (auto it = fonts.begin(); it != fonts.end();) {
+            if (it->second.expired()) {
+                it = fonts.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        fontsSweepSize = std::max<size_t>(64, 2 * fonts.size());
+    }
+    fonts.emplace(font->hash, font);
+    return font;
+}
+
+SplashGlyphCache::Shard *SplashGlyphCache::getShard(uint64_t hash) const
+{
+    // the low bits pick the hash table bucket, use the high ones here
+    return &shards[(hash >> 60) & (nShards - 1)];
+}
+
+// Must be called with the shard locked.
+void SplashGlyphCache::evict(Shard *shard, size_t limit)
+{
+    while (shard->size > limit && !shard->lru.empty()) {
+        const SplashGlyphCacheEntry &entry = shard->lru.back();
+        shard->size -= entry.cost();
+        shard->index.erase(entry.key);
+        shard->lru.pop_back();
+        ++evictions;
+    }
+}
+
+void SplashGlyphCache::setMaxSize(size_t maxSizeA)
+{
+    maxSize = maxSizeA;
+    for (int i = 0; i < nShards; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        evict(&shards[i], maxSizeA / nShards);
+    }
+}
+
+bool SplashGlyphCache::lookup(const SplashGlyphCacheKey &key, SplashGlyphBitmap *bitmap)
+{
+    if (!isEnabled()) {
+        return false;
+    }
+
+    Shard *shard = getShard(key.hash());
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        auto it = shard->index.find(key);
+        if (it != shard->index.end()) {
+            shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+            const SplashGlyphCacheEntry &entry = *it->second;
+            bitmap->data = (unsigned char *)gmalloc(entry.data.size());
+            if (!entry.data.empty()) {
+                memcpy(bitmap->data, entry.data.data(), entry.data.size());
+            }
+            bitmap->x = entry.x;
+            bitmap->y = entry.y;
+            bitmap->w = entry.w;
+            bitmap->h = entry.h;
+            bitmap->aa = entry.aa;
+            bitmap->freeData = true;
+            ++hits;
+            return true;
+        }
+    }
+    ++misses;
+    return false;
+}
+
+void SplashGlyphCache::insert(const SplashGlyphCacheKey &key, const SplashGlyphBitmap &bitmap)
+{
+    const size_t limit = maxSize / nShards;
+    if (!bitmap.data || bitmap.w <= 0 || bitmap.h <= 0) {
+        return;
+    }
+    const size_t rowSize = bitmap.aa ? bitmap.w : (bitmap.w + 7) >> 3;
+    const size_t dataSize = rowSize * bitmap.h;
+    if (dataSize + splashGlyphCacheEntryOverhead > limit) {
+        return;
+    }
+
+    Shard *shard = getShard(key.hash());
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    if (shard->index.find(key) != shard->index.end()) {
+        // another thread got there first
+        return;
+    }
+    shard->lru.emplace_front();
+    SplashGlyphCacheEntry &entry = shard->lru.front();
+    entry.key = key;
+    entry.font = key.font->shared_from_this();
+    entry.x = bitmap.x;
+    entry.y = bitmap.y;
+    entry.w = bitmap.w;
+    entry.h = bitmap.h;
+    entry.aa = bitmap.aa;
+    entry.data.assign(bitmap.data, bitmap.data + dataSize);
+    shard->index.emplace(key, shard->lru.begin());
+    shard->size += entry.cost();
+    evict(shard, limit);
+}
+
+void SplashGlyphCache::clear()
+{
+    for (int i = 0; i < nShards; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        shards[i].index.clear();
+        shards[i].lru.clear();
+        shards[i].size = 0;
+    }
+}
+
+SplashGlyphCache::Stats SplashGlyphCache::getStats() const
+{
+    Stats stats;
+
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.size = 0;
+    stats.glyphs = 0;
+    for (int i = 0; i < nShards; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        stats.size += shards[i].size;
+        stats.glyphs += shards[i].lru.size();
+    }
+    return stats;
+}
+
+void SplashGlyphCache::resetStats()
+{
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
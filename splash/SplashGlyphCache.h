@@ -0,0 +1,160 @@
+//========================================================================
+//
+// SplashGlyphCache.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHGLYPHCACHE_H
+#define SPLASHGLYPHCACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "SplashTypes.h"
+#include "poppler_private_export.h"
+
+struct SplashGlyphBitmap;
+
+//------------------------------------------------------------------------
+
+// 64 bit FNV-1a hash of <len> bytes, continuing from <hash>.
+static inline uint64_t splashHashBytes(const void *data, size_t len, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+//------------------------------------------------------------------------
+// SplashGlyphCacheFont
+//------------------------------------------------------------------------
+
+// Everything about a font file that determines its glyph shapes.  Font
+// files whose SplashGlyphCacheFont is equal share their glyphs.
+struct POPPLER_PRIVATE_EXPORT SplashGlyphCacheFont : public std::enable_shared_from_this<SplashGlyphCacheFont>
+{
+    std::shared_ptr<const std::vector<unsigned char>> data; // the font file
+    int faceIndex = 0;
+    std::vector<int> codeToGID;
+    unsigned char type = 0; // font format flags of the font file
+
+    // Set from the other members by computeHash(), only equal fonts
+    // are compared byte for byte.
+    uint64_t hash = 0;
+
+    // <dataHash> is splashHashBytes() of the font data, if known.
+    void computeHash(uint64_t dataHash);
+
+    bool operator==(const SplashGlyphCacheFont &other) const;
+};
+
+//------------------------------------------------------------------------
+// SplashGlyphCacheKey
+//------------------------------------------------------------------------
+
+struct SplashGlyphCacheKey
+{
+    const SplashGlyphCacheFont *font; // as returned by SplashGlyphCache::getFont()
+    SplashCoord mat[4]; // font transform matrix
+    unsigned int flags; // rasterizer options, see SplashFont
+    int c;
+    short xFrac, yFrac;
+
+    bool operator==(const SplashGlyphCacheKey &other) const
+    {
+        return font == other.font && mat[0] == other.mat[0] && mat[1] == other.mat[1] && mat[2] == other.mat[2] && mat[3] == other.mat[3] && flags == other.flags && c == other.c && xFrac == other.xFrac
+                && yFrac == other.yFrac;
+    }
+
+    uint64_t hash() const;
+};
+
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//------------------------------------------------------------------------
+
+// A process-wide cache of rasterized glyphs, shared by all SplashFonts
+// of all documents and threads.  Glyphs are found by the content of
+// their font file rather than by the PDF object they came from, so the
+// same embedded font in different documents shares its glyphs.  Font
+// files are only considered the same after comparing their data byte
+// for byte, see getFont().
+//
+// SplashFont consults it when its own small per-font cache misses.  The
+// cache is split into independently locked shards, each of which evicts
+// its least recently used glyphs once it is over its share of the size
+// limit.
+class POPPLER_PRIVATE_EXPORT SplashGlyphCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t size; // bytes currently used
+        size_t glyphs; // number of cached glyphs
+    };
+
+    static SplashGlyphCache *getInstance();
+
+    // Returns the font registered before that is equal to <font>, or
+    // registers <font> and returns it.  Keys use the returned pointer,
+    // so fonts only share glyphs if their data is identical, not just
+    // their hash.  A font stays registered while font files or cached
+    // glyphs use it.
+    std::shared_ptr<const SplashGlyphCacheFont> getFont(std::shared_ptr<const SplashGlyphCacheFont> font);
+
+    SplashGlyphCache(const SplashGlyphCache &) = delete;
+    SplashGlyphCache &operator=(const SplashGlyphCache &) = delete;
+
+    // Set the size limit in bytes; 0 disables the cache.  Shrinking the
+    // limit evicts glyphs as needed.
+    void setMaxSize(size_t maxSizeA);
+    size_t getMaxSize() const { return maxSize; }
+    bool isEnabled() const { return maxSize > 0; }
+
+    // Look up a glyph.  On success <bitmap> is set to a copy of the
+    // cached glyph, which the caller owns (bitmap->freeData is true).
+    bool lookup(const SplashGlyphCacheKey &key, SplashGlyphBitmap *bitmap);
+
+    // Add a copy of <bitmap> to the cache.
+    void insert(const SplashGlyphCacheKey &key, const SplashGlyphBitmap &bitmap);
+
+    // Remove all glyphs.  The counters are kept.
+    void clear();
+
+    Stats getStats() const;
+    void resetStats();
+
+private:
+    SplashGlyphCache();
+    ~SplashGlyphCache();
+
+    struct Shard;
+    static constexpr int nShards = 16;
+
+    Shard *getShard(uint64_t hash) const;
+    void evict(Shard *shard, size_t limit);
+
+    Shard *shards;
+
+    std::mutex fontsMutex;
+    std::unordered_multimap<uint64_t, std::weak_ptr<const SplashGlyphCacheFont>> fonts; // by hash
+    size_t fontsSweepSize; // drop the expired fonts when there are this many
+    std::atomic<size_t> maxSize;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> evictions;
+};
+
+#endif
@@ -86,6 +86,7 @@ SplashState::SplashState(int width, int height, bool vectorAntialias, SplashScre
             cp[i] = (unsigned char)i;
         }
     }
+    rgbCMYKTransferIdentity = true;
     overprintMask = 0xffffffff;
     overprintAdditive = false;
     next = nullptr;
@@ -139,6 +140,7 @@ SplashState::SplashState(int width, int height, bool vectorAntialias, SplashScre
             cp[i] = (unsigned char)i;
         }
     }
+    rgbCMYKTransferIdentity = true;
     overprintMask = 0xffffffff;
     overprintAdditive = false;
     next = nullptr;
@@ -182,6 +184,7 @@ SplashState::SplashState(const SplashState *state)
     for (int cp = 0; cp < SPOT_NCOMPS + 4; cp++) {
         memcpy(deviceNTransfer[cp], state->deviceNTransfer[cp], 256);
     }
+    rgbCMYKTransferIdentity = state->rgbCMYKTransferIdentity;
     overprintMask = state->overprintMask;
     overprintAdditive = state->overprintAdditive;
     next = nullptr;
@@ -249,4 +252,11 @@ void SplashState::setTransfer(unsigned char *red, unsigned char *green, unsigned
     memcpy(rgbTransferG, green, 256);
     memcpy(rgbTransferB, blue, 256);
     memcpy(grayTransfer, gray, 256);
+    rgbCMYKTransferIdentity = true;
+    for (int i = 0; i < 256; ++i) {
+        if (rgbTransferR[i] != i || rgbTransferG[i] != i || rgbTransferB[i] != i || cmykTransferC[i] != i || cmykTransferM[i] != i || cmykTransferY[i] != i || cmykTransferK[i] != i) {
+            rgbCMYKTransferIdentity = false;
+            break;
+        }
+    }
 }
@@ -122,6 +122,7 @@ private:
     unsigned char grayTransfer[256];
     unsigned char cmykTransferC[256], cmykTransferM[256], cmykTransferY[256], cmykTransferK[256];
     unsigned char deviceNTransfer[SPOT_NCOMPS + 4][256];
+    bool rgbCMYKTransferIdentity; // the rgb and cmyk transfer tables are all the identity
     unsigned int overprintMask;
     bool overprintAdditive;
 
@@ -0,0 +1,489 @@
+//========================================================================
+//
+// cached-file-test.cc
+//
+// Checks how CachedFile loads ranges: short gaps between needed chunks
+// are loaded with them, but never chunks that are already loaded.  Then
+// loads a file from a local HTTP server with CurlCachedFileLoader, and
+// checks the data, how many requests that takes, that they run
+// concurrently and reuse their connections, and that a server which
+// ignores ranges or cuts responses short is handled.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "CachedFile.h"
+#include "CurlCachedFile.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "Stream.h"
+#include "test-pdf-builder.h"
+
+static std::string makeContents(size_t size)
+{
+    std::string contents(size, '\0');
+    unsigned int state = 1;
+    for (char &c : contents) {
+        state = state * 1103515245u + 12345u;
+        c = (char)(state >> 16);
+    }
+    return contents;
+}
+
+//------------------------------------------------------------------------
+// a loader that records the ranges it is asked for
+//------------------------------------------------------------------------
+
+class RecordingLoader : public CachedFileLoader
+{
+public:
+    RecordingLoader(const std::string &contentsA, std::vector<ByteRange> *requestsA) : contents(contentsA), requests(requestsA) { }
+
+    size_t init(CachedFile *cachedFile) override { return contents.size(); }
+
+    int load(const std::vector<ByteRange> &ranges, CachedFileWriter *writer) override
+    {
+        for (const ByteRange &range : ranges) {
+            requests->push_back(range);
+            const size_t length = std::min((size_t)range.length, contents.size() - range.offset);
+            writer->write(contents.data() + range.offset, length);
+        }
+        return 0;
+    }
+
+private:
+    std::string contents;
+    std::vector<ByteRange> *requests;
+};
+
+static ByteRange chunkRange(size_t first, size_t n)
+{
+    ByteRange range;
+    range.offset = first * CachedFileChunkSize;
+    range.length = n * CachedFileChunkSize;
+    return range;
+}
+
+static bool sameRanges(const std::vector<ByteRange> &a, const std::vector<ByteRange> &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].offset != b[i].offset || a[i].length != b[i].length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int checkGaps(int *numChecks)
+{
+    const std::string contents = makeContents(20 * CachedFileChunkSize);
+    std::vector<ByteRange> requests;
+    CachedFile file(std::make_unique<RecordingLoader>(contents, &requests));
+    file.setReadAhead(4 * CachedFileChunkSize);
+    int numFailures = 0;
+
+    // chunks 1 and 4: the gap of 2 and 3 is loaded with them
+    file.cache({ chunkRange(1, 1), chunkRange(4, 1) });
+    ++*numChecks;
+    if (!sameRanges(requests, { chunkRange(1, 4) })) {
+        fprintf(stderr, "a gap of new chunks wasn't loaded with the chunks around it\n");
+        ++numFailures;
+    }
+
+    // chunks 8 and 12 around the loaded chunk 10: only the needed ones
+    // are loaded
+    requests.clear();
+    file.cache({ chunkRange(10, 1) });
+    requests.clear();
+    file.cache({ chunkRange(8, 1), chunkRange(12, 1) });
+    ++*numChecks;
+    if (!sameRanges(requests, { chunkRange(8, 1), chunkRange(12, 1) })) {
+        fprintf(stderr, "a gap with a loaded chunk in it was loaded (%d requests)\n", (int)requests.size());
+        ++numFailures;
+    }
+
+    // gaps longer than the read ahead aren't filled
+    requests.clear();
+    file.cache({ chunkRange(13, 1), chunkRange(19, 1) });
+    ++*numChecks;
+    if (!sameRanges(requests, { chunkRange(13, 1), chunkRange(19, 1) })) {
+        fprintf(stderr, "a gap longer than the read ahead was loaded\n");
+        ++numFailures;
+    }
+
+    std::vector<char> data(contents.size());
+    file.seek(0, SEEK_SET);
+    ++*numChecks;
+    if (file.read(data.data(), 1, data.size()) != data.size() || memcmp(data.data(), contents.data(), data.size()) != 0) {
+        fprintf(stderr, "the cached file has the wrong contents\n");
+        ++numFailures;
+    }
+    return numFailures;
+}
+
+//------------------------------------------------------------------------
+// a local HTTP server
+//------------------------------------------------------------------------
+
+class TestHttpServer
+{
+public:
+    enum Mode
+    {
+        modeRanges, // answer range requests with 206
+        modeIgnoreRanges, // always send the whole file with 200
+        modeShortResponses // announce the range, send half of it and close
+    };
+
+    TestHttpServer(const std::string &contentsA, int latencyMsA) : contents(contentsA), latencyMs(latencyMsA) { }
+    ~TestHttpServer() { stop(); }
+
+    bool start()
+    {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0) {
+            return false;
+        }
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t addrLen = sizeof(addr);
+        if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, 16) != 0 || getsockname(listenFd, (sockaddr *)&addr, &addrLen) != 0) {
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        port = ntohs(addr.sin_port);
+        acceptThread = std::thread(&TestHttpServer::acceptLoop, this);
+        return true;
+    }
+
+    void stop()
+    {
+        if (listenFd < 0) {
+            return;
+        }
+        stopping = true;
+        acceptThread.join();
+        for (std::thread &t : connectionThreads) {
+            t.join();
+        }
+        connectionThreads.clear();
+        close(listenFd);
+        listenFd = -1;
+    }
+
+    std::string url() const { return "http://127.0.0.1:" + std::to_string(port) + "/test.pdf"; }
+    void setMode(Mode modeA) { mode = modeA; }
+
+    // ranged GET requests, connections, and the most GET requests that
+    // were handled at the same time
+    int getRequests() const { return requests; }
+    int getConnections() const { return connections; }
+    int getMaxConcurrent() const { return maxConcurrent; }
+    void resetStats()
+    {
+        requests = 0;
+        connections = 0;
+        maxConcurrent = 0;
+    }
+
+private:
+    void acceptLoop()
+    {
+        while (!stopping) {
+            pollfd pfd = { listenFd, POLLIN, 0 };
+            if (poll(&pfd, 1, 50) <= 0) {
+                continue;
+            }
+            const int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            ++connections;
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            connectionThreads.emplace_back(&TestHttpServer::serve, this, fd);
+        }
+    }
+
+    // Reads one request head; returns false when the connection is closed.
+    bool readRequest(int fd, std::string *buffer, std::string *head)
+    {
+        size_t end;
+        while ((end = buffer->find("\r\n\r\n")) == std::string::npos) {
+            pollfd pfd = { fd, POLLIN, 0 };
+            if (stopping) {
+                return false;
+            }
+            if (poll(&pfd, 1, 50) <= 0) {
+                continue;
+            }
+            char buf[4096];
+            const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                return false;
+            }
+            buffer->append(buf, n);
+        }
+        *head = buffer->substr(0, end);
+        buffer->erase(0, end + 4);
+        return true;
+    }
+
+    bool sendAll(int fd, const std::string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            const ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            sent += n;
+        }
+        return true;
+    }
+
+    void serve(int fd)
+    {
+        std::string buffer, head;
+        while (readRequest(fd, &buffer, &head)) {
+            const bool isHead = head.compare(0, 5, "HEAD ") == 0;
+            unsigned long long first = 0, last = contents.size() - 1;
+            bool hasRange = false;
+            const size_t rangePos = head.find("Range: bytes=");
+            if (rangePos != std::string::npos) {
+                hasRange = sscanf(head.c_str() + rangePos, "Range: bytes=%llu-%llu", &first, &last) == 2;
+                if (last >= contents.size()) {
+                    last = contents.size() - 1;
+                }
+            }
+
+            if (!isHead) {
+                ++requests;
+                const int now = ++concurrent;
+                int max = maxConcurrent;
+                while (now > max && !maxConcurrent.compare_exchange_weak(max, now)) { }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(latencyMs));
+
+            std::string response;
+            bool keepOpen = true;
+            if (isHead || !hasRange || mode == modeIgnoreRanges) {
+                response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(contents.size()) + "\r\n\r\n";
+                if (!isHead) {
+                    response += contents;
+                }
+            } else {
+                const std::string body = contents.substr(first, last - first + 1);
+                response = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(contents.size()) + "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+                if (mode == modeShortResponses) {
+                    response += body.substr(0, body.size() / 2);
+                    keepOpen = false;
+                } else {
+                    response += body;
+                }
+            }
+            const bool ok = sendAll(fd, response);
+            if (!isHead) {
+                --concurrent;
+            }
+            if (!ok || !keepOpen) {
+                break;
+            }
+        }
+        close(fd);
+    }
+
+    const std::string contents;
+    const int latencyMs;
+    int listenFd = -1;
+    int port = 0;
+    std::atomic<Mode> mode { modeRanges };
+    std::atomic<bool> stopping { false };
+    std::atomic<int> requests { 0 };
+    std::atomic<int> connections { 0 };
+    std::atomic<int> concurrent { 0 };
+    std::atomic<int> maxConcurrent { 0 };
+    std::thread acceptThread;
+    std::mutex threadsMutex;
+    std::vector<std::thread> connectionThreads;
+};
+
+//------------------------------------------------------------------------
+
+static const int latencyMs = 40;
+
+static bool readAll(CachedFile *file, const std::string &contents)
+{
+    std::vector<char> data(contents.size());
+    file->seek(0, SEEK_SET);
+    return file->read(data.data(), 1, data.size()) == data.size() && memcmp(data.data(), contents.data(), data.size()) == 0;
+}
+
+static int checkCurlLoader(TestHttpServer *server, const std::string &contents, int *numChecks)
+{
+    int numFailures = 0;
+
+    // scattered ranges are loaded concurrently, one request each
+    server->resetStats();
+    CachedFile file(std::make_unique<CurlCachedFileLoader>(server->url()));
+    ++*numChecks;
+    if (file.getLength() != contents.size()) {
+        fprintf(stderr, "the loader got a length of %u instead of %u\n", file.getLength(), (unsigned int)contents.size());
+        return numFailures + 1;
+    }
+    const int nRanges = 12;
+    std::vector<ByteRange> ranges;
+    for (int i = 0; i < nRanges; ++i) {
+        ranges.push_back(chunkRange(3 * i, 1));
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const int result = file.cache(ranges);
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%d ranges with %d ms latency: %d requests, %d at a time, %.0f ms\n", nRanges, latencyMs, server->getRequests(), server->getMaxConcurrent(), elapsed.count());
+    ++*numChecks;
+    if (result != 0 || server->getRequests() != nRanges) {
+        fprintf(stderr, "loading %d ranges failed or took %d requests\n", nRanges, server->getRequests());
+        ++numFailures;
+    }
+    ++*numChecks;
+    if (server->getMaxConcurrent() < 2 || server->getMaxConcurrent() > curlCachedFileMaxTransfers) {
+        fprintf(stderr, "%d requests ran at the same time, expected 2 to %d\n", server->getMaxConcurrent(), curlCachedFileMaxTransfers);
+        ++numFailures;
+    }
+    // one after the other they would take nRanges times the latency
+    ++*numChecks;
+    if (elapsed.count() >= nRanges * latencyMs * 0.75) {
+        fprintf(stderr, "loading %d ranges took %.0f ms, they didn't run concurrently\n", nRanges, elapsed.count());
+        ++numFailures;
+    }
+
+    // the rest of the file, with the connections of the first load
+    const int connectionsBefore = server->getConnections();
+    ++*numChecks;
+    if (!readAll(&file, contents)) {
+        fprintf(stderr, "the file loaded over HTTP has the wrong contents\n");
+        ++numFailures;
+    }
+    ++*numChecks;
+    if (server->getConnections() != connectionsBefore) {
+        fprintf(stderr, "later loads opened %d new connections\n", server->getConnections() - connectionsBefore);
+        ++numFailures;
+    }
+
+    // a server that ignores ranges
+    server->setMode(TestHttpServer::modeIgnoreRanges);
+    CachedFile wholeFile(std::make_unique<CurlCachedFileLoader>(server->url()));
+    ++*numChecks;
+    if (wholeFile.cache({ chunkRange(5, 2), chunkRange(11, 1) }) != 0 || !readAll(&wholeFile, contents)) {
+        fprintf(stderr, "a file from a server that ignores ranges has the wrong contents\n");
+        ++numFailures;
+    }
+
+    // a server that cuts its responses short
+    server->setMode(TestHttpServer::modeShortResponses);
+    CachedFile shortFile(std::make_unique<CurlCachedFileLoader>(server->url()));
+    ++*numChecks;
+    if (shortFile.cache({ chunkRange(4, 2), chunkRange(9, 1) }) == 0) {
+        fprintf(stderr, "loading short responses didn't fail\n");
+        ++numFailures;
+    }
+    server->setMode(TestHttpServer::modeRanges);
+    ++*numChecks;
+    if (!readAll(&shortFile, contents)) {
+        fprintf(stderr, "short responses left wrong data in the cache\n");
+        ++numFailures;
+    }
+    return numFailures;
+}
+
+// Opens a PDF file over HTTP the way CurlPDFDocBuilder does.
+static int checkDocument(int *numChecks)
+{
+    TestPdfBuilder builder;
+    for (int page = 0; page < 20; ++page) {
+        std::string content;
+        for (int i = 0; i < 400; ++i) {
+            content += "BT /F1 10 Tf " + std::to_string(40 + i % 50) + " " + std::to_string(100 + i) + " Td (page " + std::to_string(page) + " line " + std::to_string(i) + ") Tj ET\n";
+        }
+        builder.addPage(content, "/Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /Helvetica >> >>");
+    }
+    const std::string contents = builder.build();
+
+    TestHttpServer server(contents, latencyMs);
+    if (!server.start()) {
+        fprintf(stderr, "can't start the HTTP server\n");
+        return 1;
+    }
+    auto cachedFile = std::make_shared<CachedFile>(std::make_unique<CurlCachedFileLoader>(server.url()));
+    cachedFile->setReadAhead(64 * 1024);
+    const unsigned int length = cachedFile->getLength();
+    auto doc = std::make_unique<PDFDoc>(new CachedFileStream(cachedFile, 0, false, length, Object::null()));
+    int numFailures = 0;
+    ++*numChecks;
+    if (!doc->isOk() || doc->getNumPages() != 20) {
+        fprintf(stderr, "the document loaded over HTTP is broken\n");
+        ++numFailures;
+    } else {
+        // all pages' contents
+        for (int page = 1; page <= doc->getNumPages(); ++page) {
+            Object contentsObj = doc->getPage(page)->getContents();
+            if (contentsObj.isStream()) {
+                while (contentsObj.getStream()->getChar() != EOF) { }
+            }
+        }
+    }
+    printf("a %u byte document over HTTP: %d requests on %d connections\n", length, server.getRequests(), server.getConnections());
+    doc.reset();
+    server.stop();
+    return numFailures;
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    int numChecks = 0;
+    int numFailures = checkGaps(&numChecks);
+
+    const std::string contents = makeContents(40 * CachedFileChunkSize + 123);
+    TestHttpServer server(contents, latencyMs);
+    if (!server.start()) {
+        fprintf(stderr, "can't start the HTTP server\n");
+        return 1;
+    }
+    numFailures += checkCurlLoader(&server, contents, &numChecks);
+    server.stop();
+    numFailures += checkDocument(&numChecks);
+
+    curl_global_cleanup();
+    printf("%d cached file checks: %d failures\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+//========================================================================
+//
+// decoded-image-cache-test.cc
+//
+// Checks that the DecodedImageCache of a document serves an image drawn
+// on several pages from the cache, and that replacing the image object
+// with XRef::setModifiedObject() renders the new image instead of the
+// cached one.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "GlobalParams.h"
+#include "Dict.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "splash/SplashBitmap.h"
+#include "test-pdf-builder.h"
+
+static const char *imageDict = "/Type /XObject /Subtype /Image /Width 4 /Height 4 /BitsPerComponent 8 /ColorSpace /DeviceGray /Filter /ASCIIHexDecode";
+static const char *firstImage = "00 40 80 C0 40 80 C0 FF 80 C0 FF 00 C0 FF 00 40>";
+static const char *secondImage = "FF E0 C0 A0 10 20 30 40 FF 00 FF 00 00 FF 00 FF>";
+
+static bool writeDocument(const std::string &fileName, const char *image)
+{
+    TestPdfBuilder builder;
+    const int imageNum = builder.addStream(imageDict, image);
+    const std::string resources = "/XObject << /Im1 " + std::to_string(imageNum) + " 0 R >>";
+    builder.addPage("q 300 0 0 300 100 100 cm /Im1 Do Q\n", resources);
+    builder.addPage("q 200 0 0 400 50 300 cm /Im1 Do Q\n", resources);
+    return builder.write(fileName);
+}
+
+static std::unique_ptr<SplashBitmap> render(PDFDoc *doc, int page)
+{
+    SplashColor paperColor = { 0xff, 0xff, 0xff };
+    SplashOutputDev out(splashModeRGB8, 1, false, paperColor);
+    out.startDoc(doc);
+    doc->displayPage(&out, page, 36, 36, 0, false, true, false);
+    return std::unique_ptr<SplashBitmap>(out.takeBitmap());
+}
+
+static bool sameBitmaps(SplashBitmap *a, SplashBitmap *b)
+{
+    return a && b && a->getWidth() == b->getWidth() && a->getHeight() == b->getHeight() && a->getRowSize() == b->getRowSize() && memcmp(a->getDataPtr(), b->getDataPtr(), (size_t)a->getRowSize() * a->getHeight()) == 0;
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    const std::string firstFileName = testTempFileName("decoded-image-cache-1.pdf");
+    const std::string secondFileName = testTempFileName("decoded-image-cache-2.pdf");
+    if (!writeDocument(firstFileName, firstImage) || !writeDocument(secondFileName, secondImage)) {
+        return 1;
+    }
+
+    // references, rendered without the cache
+    std::unique_ptr<SplashBitmap> firstRefs[2], secondRefs[2];
+    {
+        std::unique_ptr<PDFDoc> first = testOpenPdf(firstFileName);
+        std::unique_ptr<PDFDoc> second = testOpenPdf(secondFileName);
+        if (!first || !second) {
+            return 1;
+        }
+        first->getDecodedImageCache()->setMaxSize(0);
+        second->getDecodedImageCache()->setMaxSize(0);
+        for (int page = 1; page <= 2; ++page) {
+            firstRefs[page - 1] = render(first.get(), page);
+            secondRefs[page - 1] = render(second.get(), page);
+        }
+    }
+
+    int numChecks = 0;
+    int numFailures = 0;
+    std::unique_ptr<PDFDoc> doc = testOpenPdf(firstFileName);
+    if (!doc) {
+        return 1;
+    }
+    DecodedImageCache *cache = doc->getDecodedImageCache();
+
+    // the second page reuses the image decoded for the first one
+    for (int page = 1; page <= 2; ++page) {
+        std::unique_ptr<SplashBitmap> bitmap = render(doc.get(), page);
+        ++numChecks;
+        if (!sameBitmaps(bitmap.get(), firstRefs[page - 1].get())) {
+            fprintf(stderr, "page %d renders differently with the decoded image cache\n", page);
+            ++numFailures;
+        }
+    }
+    DecodedImageCache::Stats stats = cache->getStats();
+    ++numChecks;
+    if (stats.misses != 1 || stats.hits != 1) {
+        fprintf(stderr, "expected 1 miss and 1 hit, got %llu misses and %llu hits\n", (unsigned long long)stats.misses, (unsigned long long)stats.hits);
+        ++numFailures;
+    }
+
+    // replace the image object: the cached data is out of date
+    XRef *xref = doc->getXRef();
+    Object xobjects = doc->getPage(1)->getResourceDictObject()->dictLookup("XObject");
+    const Ref imageRef = xobjects.dictLookupNF("Im1").getRef();
+    Dict *dict = new Dict(xref);
+    dict->add("Type", Object(objName, "XObject"));
+    dict->add("Subtype", Object(objName, "Image"));
+    dict->add("Width", Object(4));
+    dict->add("Height", Object(4));
+    dict->add("BitsPerComponent", Object(8));
+    dict->add("ColorSpace", Object(objName, "DeviceGray"));
+    dict->add("Filter", Object(objName, "ASCIIHexDecode"));
+    dict->add("Length", Object((int)strlen(secondImage)));
+    Stream *imageStr = new MemStream(secondImage, 0, strlen(secondImage), Object(dict));
+    const Object newImage(std::unique_ptr<Stream>(imageStr->addFilters(imageStr->getDict())));
+    xref->setModifiedObject(&newImage, imageRef);
+
+    cache->resetStats();
+    for (int page = 1; page <= 2; ++page) {
+        std::unique_ptr<SplashBitmap> bitmap = render(doc.get(), page);
+        ++numChecks;
+        if (!sameBitmaps(bitmap.get(), secondRefs[page - 1].get())) {
+            fprintf(stderr, "page %d shows the cached image after the image object was replaced\n", page);
+            ++numFailures;
+        }
+    }
+    stats = cache->getStats();
+    ++numChecks;
+    if (stats.misses != 1 || stats.hits != 1) {
+        fprintf(stderr, "after the change, expected 1 miss and 1 hit, got %llu misses and %llu hits\n", (unsigned long long)stats.misses, (unsigned long long)stats.hits);
+        ++numFailures;
+    }
+
+    doc.reset();
+    remove(firstFileName.c_str());
+    remove(secondFileName.c_str());
+    printf("%d decoded image cache checks: %d failures\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
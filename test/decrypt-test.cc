@@ -0,0 +1,299 @@
+//========================================================================
+//
+// decrypt-test.cc
+//
+// Known-answer tests for the AES-128 (R4) and AES-256 (R5, R6) security
+// handlers, run once with the portable AES and SHA-256 code and once with
+// the CPU instructions, where the CPU has them.  The documents have been
+// encrypted with OpenSSL: streams of every length around the 16 byte
+// block size, and streams that end within, on and across the 4096 byte
+// buffer of DecryptStream, with a whole or a partial final block.  The
+// R5 and R6 documents are opened with the user and the owner password,
+// which derives their keys with SHA-256 and, for R6, with the hash of
+// ISO 32000-2 algorithm 2.B.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "goo/GooString.h"
+#include "Decrypt.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "XRef.h"
+#include "test-pdf-builder.h"
+
+// A stream of <length> bytes from plainText(), padded as in PKCS #7 and
+// encrypted in CBC mode: the hex of the IV followed by the cipher text.
+struct PaddedVector
+{
+    int length;
+    const char *data;
+};
+
+// A stream of <length> bytes from plainText(), as IV and cipher text,
+// that isn't padded and need not be a whole number of blocks: it
+// decrypts to <plainLength> bytes with an FNV-1a hash of <plainHash>.
+// A partial final block is dropped, and padding is only removed from a
+// stream that ends on a whole block.
+struct PatternVector
+{
+    int length;
+    int plainLength;
+    unsigned long long plainHash;
+};
+
+// The streams are objects 6 and on, the padded ones first.  The AES-256
+// documents all have the file key of the example in NIST SP 800-38A,
+// the owner password "owner" and the user password "user"; the AES-128
+// document has an empty user password, and a key for each object.
+static const char *const fileId = "443254ede5320d51dd2e9ddf05f90aa2";
+static const char *const r4Dict = "/Filter /Standard /V 4 /R 4 /Length 128 /CF << /StdCF << /CFM /AESV2 /AuthEvent /DocOpen /Length 16 >> >> /StmF /StdCF /StrF /StdCF "
+                                  "/O <0ad5d2f4860e422ed74a751265f88c16ec8856511bdc4ac8ee6f4177cb43f321> "
+                                  "/U <c30822c36e1ab1fc9dcbe105c4224cde00000000000000000000000000000000> /P -1028";
+static const char *const r5Dict = "/Filter /Standard /V 5 /R 5 /Length 256 /CF << /StdCF << /CFM /AESV3 /AuthEvent /DocOpen /Length 32 >> >> /StmF /StdCF /StrF /StdCF "
+                                  "/O <0e05a00d75110afda846595396ff48d62d8ecdd960d8a3872d1cdddfc7a50dff121d66b9db4f6262d8c0e4c07c2b9740> "
+                                  "/U <309c5790e169d1e7474c219f9650c6b5202d9e2af326b49a14917e24adec6d0085d86bac9896f7a64b7be9b339732d84> "
+                                  "/OE <7cbd1d41b7a32d7a766b31d3c333dab1409d4d6155028aab89d8a0b59f736931> "
+                                  "/UE <53f85912475bdd4fa4e4b433c9ba5c3715a80259d3359ff1b081c927f8327f92> /P -1028 "
+                                  "/Perms <f6e6a876415ca90545cea0b6ccf288b3>";
+static const char *const r6Dict = "/Filter /Standard /V 5 /R 6 /Length 256 /CF << /StdCF << /CFM /AESV3 /AuthEvent /DocOpen /Length 32 >> >> /StmF /StdCF /StrF /StdCF "
+                                  "/O <d2c515707293f2fa030f98fd7e53d4d8c05c3e41dd7537c09e89e011b5602cf8121d66b9db4f6262d8c0e4c07c2b9740> "
+                                  "/U <e2965d400b7ee7da750f657c0a9361c7d12bf72470f96ad19e71716ee3d155aa85d86bac9896f7a64b7be9b339732d84> "
+                                  "/OE <a43c5473681012b9e316dc6f989c0a7875aed73046e97425dbc54dd480a98278> "
+                                  "/UE <d8447acf6ec245bd6f2459d6adb1430c71c28ac84dadf16c5c81f7a460518c27> /P -1028 "
+                                  "/Perms <f6e6a876415ca90545cea0b6ccf288b3>";
+static const PaddedVector aes128Padded[] = {
+    { 0, "ede43f78ab435674b604a3aa75bffa19454cab3b8084ebe589f42af9e597e0f2" },
+    { 1, "b387bd7e4c208b52b0207bddd5bd7c8d276fbad397bb3921e2f195064534d0ff" },
+    { 15, "8c6b9dd91e2c76745dad4baa1ca499ecddfea380ec67a67ba29b5c2a056cc3d0" },
+    { 16, "520e1be0bf09ab5257ca23dd7ca31b617be26f665f02888262cd2999a2cb28b2d2f68d20bc8aba8ad9999f6c3b41ea45" },
+    { 17, "18b099e660e5e02f51e6fb10dda19dd5210f1401ac6f7d02c6ecaa058bc707237f92ccbc209462e7571c2363885a4d9a" },
+    { 31, "f095794132f2cb52fe73cbdd2388ba34db309f02f861a307b9e9bc2cd77ea44b9f7e0fb4ce2965781a39979a6127acf0" },
+    { 32, "b738f748d4ce0030f890a31083863ca9a7d21aa0bb2ea2c8abce68b5c4169df901b9f37bb717836b15f98a0aebf017963733dae1adb72700820baad5345373b7" },
+    { 33, "7dda744e75ab350df2ac7b43e485be1d15b39caeb729a03d8a496dd11aecb7afae10504e6db920794c7f88f72f2a866be6ecb70f80a04f5e108ca36aeef3e50a" },
+    { 100, "64695d02ab562a1f641903a9220fc89c2529e051c40fbdc5d2cb9ff9495438b2666ff46b0d65f21730f5a451bd4513ce69e2c083d77b54682e31eb93f47a35f8a0c802e27a287a3dd4a1580afe18aad03a67b20f8a06d81ee662c5b348281e48ce573a027b38475d3baa6c6ff18a275b32d1889e049f34cca29a22634e018df2" },
+};
+static const PatternVector aes128Patterns[] = {
+    { 4080, 4064, 0xd7a46d6be0d3ef69ull },
+    { 4096, 4080, 0xb08fa5fcaedbde1full },
+    { 4112, 4096, 0x81b4cd7e7df1bafdull },
+    { 4103, 4096, 0xb6dfaf16fa38b4d8ull },
+    { 8279, 8272, 0x7445f62c1273f688ull },
+    { 12288, 12272, 0x22a7c1391828bf51ull },
+};
+static const PaddedVector aes256Padded[] = {
+    { 0, "ede43f78ab435674b604a3aa75bffa19a8bce34dedeaa15ac616477edd897e95" },
+    { 1, "b387bd7e4c208b52b0207bddd5bd7c8d3c34580b30bc51c85bb9a0963e26a04d" },
+    { 15, "8c6b9dd91e2c76745dad4baa1ca499ecfbb362e386a6bde363713ba1216c6e8d" },
+    { 16, "520e1be0bf09ab5257ca23dd7ca31b61eb960b5b23ab937a5951ef2e783558e3f31af44894b3600f00d2cc49397653be" },
+    { 17, "18b099e660e5e02f51e6fb10dda19dd52664db2a2c3201e0fb384630c31800cc5246a8be566c99744f5137a05fd6261b" },
+    { 31, "f095794132f2cb52fe73cbdd2388ba34bbca1cff3fe5be2c7e8e998ed40be2e5de583e30df0a7cdd81179f5b367586b7" },
+    { 32, "b738f748d4ce0030f890a31083863ca92afcb297749c19bbe98134e3c5a676a2d1facec1f8c6f6a5424effea38e9e14ae25cd208b79cb7227deb2ad6d0f59927" },
+    { 33, "7dda744e75ab350df2ac7b43e485be1d8990ff0ee1e61f8fa603d148de306a00d2b278bbf8245ba2f6b2aed43f41509bfd8a994f2c187b1f810d1056d3ae5677" },
+    { 100, "64695d02ab562a1f641903a9220fc89cf69f3cd183a5740b0beee808b54288e565dbd3af70cd03c9a897723a2fd67b2d880f9f45a1e1f1ea2c400ed30176efcb791f697a338180f844df3cff82198cc7ba16f63e51a683b065e6b3c469a7d94f7e78b81e6b471b5445cddfe5710b4ab33d0212213c5d34ab249795a3bdd9c394" },
+};
+static const PatternVector aes256Patterns[] = {
+    { 4080, 4064, 0x8fdb8df15ba9a0e2ull },
+    { 4096, 4080, 0xb44007e3782547f6ull },
+    { 4112, 4096, 0x3596d3abb6684d4bull },
+    { 4103, 4096, 0x9793ab43e9508fa0ull },
+    { 8279, 8272, 0x3d6975072b769775ull },
+    { 12288, 12272, 0x32414ba5d24f1a7bull },
+};
+
+// NIST SP 800-38A F.2.6, CBC-AES256.Decrypt: the last block of the
+// cipher text happens to decrypt to a padding of 16 bytes.
+static const char *const nistCipherText = "000102030405060708090a0b0c0d0e0f"
+                                          "f58c4c04d6e5f1ba779eabfb5f7bfbd69cfc4e967edb808d679f777bc6702c7d"
+                                          "39f23369a9d9bacfa530e26304231461b2eb05e2c39be9fcda6c19078c6a9d1b";
+static const char *const nistPlainText = "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                                         "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+
+static std::string fromHex(const char *hex)
+{
+    std::string data;
+    for (const char *p = hex; p[0] && p[1]; p += 2) {
+        data.push_back((char)std::stoi(std::string(p, 2), nullptr, 16));
+    }
+    return data;
+}
+
+static std::string plainText(unsigned int seed, int length)
+{
+    std::string data;
+    for (int i = 0; i < length; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data.push_back((char)((seed >> 16) & 0xff));
+    }
+    return data;
+}
+
+static unsigned long long fnv1a(const std::string &data)
+{
+    unsigned long long hash = 0xcbf29ce484222325ull;
+    for (char c : data) {
+        hash = (hash ^ (unsigned char)c) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static bool buildDocument(const std::string &path, const char *encryptDict, const PaddedVector *padded, const PatternVector *patterns, bool nist)
+{
+    TestPdfBuilder builder;
+    builder.addPage(std::string());
+    builder.addObject(std::string("<< ") + encryptDict + " >>");
+    for (int i = 0; i < 9; ++i) {
+        builder.addStream(std::string(), fromHex(padded[i].data));
+    }
+    for (int i = 0; i < 6; ++i) {
+        builder.addStream(std::string(), plainText(300 + patterns[i].length, 16 + patterns[i].length));
+    }
+    if (nist) {
+        builder.addStream(std::string(), fromHex(nistCipherText));
+        builder.addStream(std::string(), fromHex(nistCipherText) + "1234567");
+    }
+    builder.addTrailerEntries(std::string("/Encrypt 5 0 R /ID [<") + fileId + "> <" + fileId + ">]");
+    return builder.write(path);
+}
+
+// Returns the decrypted stream <num>, read in blocks and a character at
+// a time, or an empty optional if they differ.
+static std::optional<std::string> readStream(PDFDoc *doc, int num)
+{
+    Object obj = doc->getXRef()->fetch(num, 0);
+    if (!obj.isStream()) {
+        return {};
+    }
+    std::string data;
+    obj.getStream()->fillString(data);
+    std::string chars;
+    if (!obj.streamReset()) {
+        return {};
+    }
+    int c;
+    while ((c = obj.streamGetChar()) != EOF) {
+        chars.push_back((char)c);
+    }
+    obj.streamClose();
+    if (chars != data) {
+        return {};
+    }
+    return data;
+}
+
+static int checkDocument(const std::string &path, const char *name, const std::optional<GooString> &ownerPassword, const std::optional<GooString> &userPassword, bool owner, const PaddedVector *padded, const PatternVector *patterns,
+                         bool nist, int *numChecks)
+{
+    ++*numChecks;
+    PDFDoc doc(std::make_unique<GooString>(path), ownerPassword, userPassword);
+    if (!doc.isOk()) {
+        fprintf(stderr, "%s: can't open the document\n", name);
+        return 1;
+    }
+    int numFailures = 0;
+    if (doc.okToAssemble() != owner) {
+        fprintf(stderr, "%s: opened with the %s password\n", name, owner ? "user" : "owner");
+        ++numFailures;
+    }
+    int num = 6;
+    for (int i = 0; i < 9; ++i, ++num) {
+        ++*numChecks;
+        const std::optional<std::string> data = readStream(&doc, num);
+        if (!data || *data != plainText(100 + padded[i].length, padded[i].length)) {
+            fprintf(stderr, "%s: padded stream of %d bytes decrypted wrongly\n", name, padded[i].length);
+            ++numFailures;
+        }
+    }
+    for (int i = 0; i < 6; ++i, ++num) {
+        ++*numChecks;
+        const std::optional<std::string> data = readStream(&doc, num);
+        if (!data || (int)data->size() != patterns[i].plainLength || fnv1a(*data) != patterns[i].plainHash) {
+            fprintf(stderr, "%s: stream of %d bytes decrypted wrongly\n", name, patterns[i].length);
+            ++numFailures;
+        }
+    }
+    if (nist) {
+        const std::string plain = fromHex(nistPlainText);
+        ++*numChecks;
+        const std::optional<std::string> data = readStream(&doc, num);
+        if (!data || *data != plain.substr(0, 48)) {
+            fprintf(stderr, "%s: NIST vector decrypted wrongly\n", name);
+            ++numFailures;
+        }
+        ++*numChecks;
+        const std::optional<std::string> partial = readStream(&doc, num + 1);
+        if (!partial || *partial != plain) {
+            fprintf(stderr, "%s: NIST vector with a partial block decrypted wrongly\n", name);
+            ++numFailures;
+        }
+    }
+    return numFailures;
+}
+
+static int checkWrongPassword(const std::string &path, const char *name, int *numChecks)
+{
+    ++*numChecks;
+    PDFDoc doc(std::make_unique<GooString>(path), GooString("user"), GooString("owner"));
+    PDFDoc noPassword(std::make_unique<GooString>(path));
+    if (doc.isOk() || doc.getErrorCode() != errEncrypted || noPassword.isOk()) {
+        fprintf(stderr, "%s: opened with a wrong password\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    const std::string r4Path = testTempFileName("decrypt-r4.pdf");
+    const std::string r5Path = testTempFileName("decrypt-r5.pdf");
+    const std::string r6Path = testTempFileName("decrypt-r6.pdf");
+    if (!buildDocument(r4Path, r4Dict, aes128Padded, aes128Patterns, false) || !buildDocument(r5Path, r5Dict, aes256Padded, aes256Patterns, true) || !buildDocument(r6Path, r6Dict, aes256Padded, aes256Patterns, true)) {
+        return 1;
+    }
+
+    int numChecks = 0;
+    int numFailures = 0;
+    for (bool hardware : { false, true }) {
+        setCryptHardwareEnabled(hardware);
+        bool aes, sha256;
+        getCryptHardware(&aes, &sha256);
+        if (hardware && !aes && !sha256) {
+            printf("no CPU instructions for AES or SHA-256\n");
+            break;
+        }
+        ++numChecks;
+        if (!hardware && (aes || sha256)) {
+            fprintf(stderr, "CPU instructions used while disabled\n");
+            ++numFailures;
+        }
+        printf("AES: %s, SHA-256: %s\n", aes ? "CPU" : "portable", sha256 ? "CPU" : "portable");
+
+        const std::optional<GooString> user = GooString("user");
+        const std::optional<GooString> owner = GooString("owner");
+        numFailures += checkDocument(r4Path, "R4", {}, {}, false, aes128Padded, aes128Patterns, false, &numChecks);
+        numFailures += checkDocument(r5Path, "R5, user", {}, user, false, aes256Padded, aes256Patterns, true, &numChecks);
+        numFailures += checkDocument(r5Path, "R5, owner", owner, {}, true, aes256Padded, aes256Patterns, true, &numChecks);
+        numFailures += checkDocument(r6Path, "R6, user", {}, user, false, aes256Padded, aes256Patterns, true, &numChecks);
+        numFailures += checkDocument(r6Path, "R6, owner", owner, {}, true, aes256Padded, aes256Patterns, true, &numChecks);
+        numFailures += checkWrongPassword(r5Path, "R5", &numChecks);
+        numFailures += checkWrongPassword(r6Path, "R6", &numChecks);
+    }
+    setCryptHardwareEnabled(true);
+    std::remove(r4Path.c_str());
+    std::remove(r5Path.c_str());
+    std::remove(r6Path.c_str());
+
+    printf("%d decryption checks: %d failures\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
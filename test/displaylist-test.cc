@@ -0,0 +1,249 @@
+//========================================================================
+//
+// displaylist-test.cc
+//
+// Checks that replaying a DisplayList produces the same output as
+// rendering the page directly: the same Splash bitmap, byte for byte, at
+// the recorded and at a different resolution, the same extracted text and
+// the same sequence of marked content calls.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "GlobalParams.h"
+#include "Dict.h"
+#include "DisplayListOutputDev.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "TextOutputDev.h"
+#include "splash/SplashBitmap.h"
+#include "test-pdf-builder.h"
+
+static std::string pageContent()
+{
+    std::string content;
+    content += "/Artifact BMC\n";
+    for (int i = 0; i < 30; ++i) {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%.3f %.3f %.3f rg %d %d m %d %d l %d %d l f\n", (i * 37 % 100) / 100.0, (i * 59 % 100) / 100.0, (i * 17 % 100) / 100.0, (i * 97) % 612, (i * 131) % 792, (i * 53 + 200) % 612, (i * 71 + 300) % 792,
+                 (i * 29 + 400) % 612, (i * 43 + 100) % 792);
+        content += buf;
+    }
+    content += "EMC\n";
+    content += "/Figure << /MCID 0 >> BDC\n";
+    content += "0 0 1 RG 3 w 20 20 m 300 780 500 10 590 770 c S\n";
+    content += "[6 3] 0 d 0 1 0 RG 2 w 50 50 500 700 re S [] 0 d\n";
+    content += "q 60 500 200 200 re W n /Sh1 sh Q\n";
+    content += "q 300 500 200 200 re W n /Sh2 sh Q\n";
+    content += "/Here MP\n";
+    content += "EMC\n";
+    content += "/Span << /ActualText (replaced) >> BDC\n";
+    content += "q /GS1 gs 0.2 0.4 0.8 rg 150 150 300 500 re f Q\n";
+    content += "EMC\n";
+    content += "/Note /P1 DP\n";
+    content += "q 200 0 0 300 350 200 cm BI /W 4 /H 4 /BPC 8 /CS /RGB /I true ID\n";
+    for (int i = 0; i < 16; ++i) {
+        content += (char)(i * 16);
+        content += (char)(255 - i * 16);
+        content += (char)(i * 7);
+    }
+    content += "\nEI Q\n";
+    content += "/P << /MCID 1 >> BDC\n";
+    content += "BT /F1 24 Tf 72 700 Td (Display list replay) Tj 0 -30 Td (second line) Tj ET\n";
+    content += "BT /T3 20 Tf 72 600 Td (abab) Tj ET\n";
+    content += "EMC\n";
+    content += "/Stamp << /Level 2 /Name /Draft >> DP\n";
+    return content;
+}
+
+static bool sameBitmaps(SplashBitmap *a, SplashBitmap *b)
+{
+    if (a->getWidth() != b->getWidth() || a->getHeight() != b->getHeight() || a->getMode() != b->getMode() || a->getRowSize() != b->getRowSize()) {
+        return false;
+    }
+    // the row padding isn't initialized
+    size_t rowBytes = 0;
+    switch (a->getMode()) {
+    case splashModeMono1:
+        rowBytes = (a->getWidth() + 7) / 8;
+        break;
+    case splashModeMono8:
+        rowBytes = a->getWidth();
+        break;
+    case splashModeRGB8:
+    case splashModeBGR8:
+        rowBytes = (size_t)a->getWidth() * 3;
+        break;
+    case splashModeXBGR8:
+    case splashModeCMYK8:
+        rowBytes = (size_t)a->getWidth() * 4;
+        break;
+    case splashModeDeviceN8:
+        rowBytes = (size_t)a->getWidth() * (SPOT_NCOMPS + 4);
+        break;
+    }
+    for (int y = 0; y < a->getHeight(); ++y) {
+        const size_t offset = (size_t)y * a->getRowSize();
+        if (memcmp(a->getDataPtr() + offset, b->getDataPtr() + offset, rowBytes) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::unique_ptr<SplashOutputDev> createOutputDev(PDFDoc *doc, SplashColorMode mode, bool antialias)
+{
+    // white paper, which is no ink in CMYK
+    SplashColor paperColor;
+    memset(paperColor, mode == splashModeCMYK8 ? 0x00 : 0xff, sizeof(paperColor));
+    auto out = std::make_unique<SplashOutputDev>(mode, 4, false, paperColor);
+    out->setFontAntialias(antialias);
+    out->setVectorAntialias(antialias);
+    out->startDoc(doc);
+    return out;
+}
+
+// Logs the marked content calls it gets.
+class MarkedContentLogger : public OutputDev
+{
+public:
+    bool upsideDown() override { return true; }
+    bool useDrawChar() override { return false; }
+    bool interpretType3Chars() override { return false; }
+
+    void beginMarkedContent(const char *name, Dict *properties) override
+    {
+        log += std::string("BDC ") + name;
+        logProperties(properties);
+        log += "\n";
+    }
+    void endMarkedContent(GfxState * /*state*/) override { log += "EMC\n"; }
+    void markPoint(const char *name) override { log += std::string("MP ") + name + "\n"; }
+    void markPoint(const char *name, Dict *properties) override
+    {
+        log += std::string("DP ") + name;
+        logProperties(properties);
+        log += "\n";
+    }
+
+    std::string log;
+
+private:
+    void logProperties(Dict *properties)
+    {
+        if (!properties) {
+            return;
+        }
+        for (int i = 0; i < properties->getLength(); ++i) {
+            const Object &value = properties->getValNF(i);
+            log += std::string(" /") + properties->getKey(i);
+            if (value.isInt()) {
+                log += " " + std::to_string(value.getInt());
+            } else if (value.isName()) {
+                log += std::string(" /") + value.getName();
+            }
+        }
+    }
+};
+
+static void appendText(void *stream, const char *text, int len)
+{
+    static_cast<std::string *>(stream)->append(text, len);
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    TestPdfBuilder builder;
+    const int axial = builder.addObject("<< /ShadingType 2 /ColorSpace /DeviceRGB /Coords [60 500 260 700] /Function << /FunctionType 2 /Domain [0 1] /C0 [1 0 0] /C1 [0 0 1] /N 1 >> /Extend [true true] >>");
+    const int functionBased = builder.addObject("<< /ShadingType 1 /ColorSpace /DeviceRGB /Domain [0 1 0 1] /Matrix [200 0 0 200 300 500] /Function << /FunctionType 2 /Domain [0 1] /C0 [0 1 0] /C1 [1 0 1] /N 2 >> >>");
+    const int gs = builder.addObject("<< /Type /ExtGState /ca 0.5 /BM /Multiply >>");
+    const int glyphA = builder.addStream("", "1000 0 0 0 750 750 d1 0 0 750 750 re f");
+    const int glyphB = builder.addStream("", "1000 0 0 0 750 750 d1 0 0 m 750 375 l 0 750 l f");
+    const int type3 = builder.addObject("<< /Type /Font /Subtype /Type3 /FontBBox [0 0 750 750] /FontMatrix [0.001 0 0 0.001 0 0] /FirstChar 97 /LastChar 98 /Widths [1000 1000] /Encoding << /Differences [97 /a /b] >> /CharProcs << /a "
+                                        + std::to_string(glyphA) + " 0 R /b " + std::to_string(glyphB) + " 0 R >> >>");
+    builder.addPage(pageContent(),
+                    "/Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /Helvetica >> /T3 " + std::to_string(type3) + " 0 R >> /Shading << /Sh1 " + std::to_string(axial) + " 0 R /Sh2 " + std::to_string(functionBased)
+                            + " 0 R >> /ExtGState << /GS1 " + std::to_string(gs) + " 0 R >> /Properties << /P1 << /Kind /Test /Count 3 >> >>");
+    const std::string fileName = testTempFileName("displaylist.pdf");
+    if (!builder.write(fileName)) {
+        return 1;
+    }
+    std::unique_ptr<PDFDoc> doc = testOpenPdf(fileName);
+    if (!doc) {
+        return 1;
+    }
+
+    int numFailures = 0;
+    int numChecks = 0;
+
+    const double recordDPI = 72;
+    DisplayListOutputDev recorder;
+    doc->displayPage(&recorder, 1, recordDPI, recordDPI, 0, false, true, false);
+    std::unique_ptr<DisplayList> list = recorder.takeDisplayList();
+    if (!list) {
+        fprintf(stderr, "no display list was recorded\n");
+        return 1;
+    }
+
+    const struct
+    {
+        SplashColorMode mode;
+        const char *name;
+    } modes[] = { { splashModeMono1, "Mono1" }, { splashModeMono8, "Mono8" }, { splashModeRGB8, "RGB8" }, { splashModeXBGR8, "XBGR8" }, { splashModeCMYK8, "CMYK8" } };
+    // the replay scales the recorded states, the resolutions are exact
+    // multiples of the recorded one so that no rounding differs
+    const double resolutions[] = { 72, 144 };
+    for (const auto &m : modes) {
+        for (double dpi : resolutions) {
+            for (bool antialias : { false, true }) {
+                std::unique_ptr<SplashOutputDev> direct = createOutputDev(doc.get(), m.mode, antialias);
+                doc->displayPage(direct.get(), 1, dpi, dpi, 0, false, true, false);
+                std::unique_ptr<SplashOutputDev> replayed = createOutputDev(doc.get(), m.mode, antialias);
+                ++numChecks;
+                if (!list->replay(replayed.get(), dpi, dpi) || !sameBitmaps(direct->getBitmap(), replayed->getBitmap())) {
+                    fprintf(stderr, "%s, %g DPI, antialias %s: replay differs from direct rendering\n", m.name, dpi, antialias ? "on" : "off");
+                    ++numFailures;
+                }
+            }
+        }
+    }
+
+    std::string directText, replayedText;
+    {
+        TextOutputDev direct(&appendText, &directText, false, 0, false, false);
+        doc->displayPage(&direct, 1, recordDPI, recordDPI, 0, false, true, false);
+        TextOutputDev replayed(&appendText, &replayedText, false, 0, false, false);
+        list->replay(&replayed, recordDPI, recordDPI);
+    }
+    ++numChecks;
+    if (directText != replayedText || directText.find("Display list replay") == std::string::npos) {
+        fprintf(stderr, "replayed text differs from the directly extracted text:\n%s\n---\n%s\n", directText.c_str(), replayedText.c_str());
+        ++numFailures;
+    }
+
+    MarkedContentLogger directLog, replayedLog;
+    doc->displayPage(&directLog, 1, recordDPI, recordDPI, 0, false, true, false);
+    list->replay(&replayedLog, recordDPI, recordDPI);
+    ++numChecks;
+    if (directLog.log != replayedLog.log || directLog.log.find("DP Here") != std::string::npos || directLog.log.find("DP Stamp /Level 2 /Name /Draft") == std::string::npos) {
+        fprintf(stderr, "replayed marked content differs from direct rendering:\n%s---\n%s", directLog.log.c_str(), replayedLog.log.c_str());
+        ++numFailures;
+    }
+
+    list.reset();
+    doc.reset();
+    remove(fileName.c_str());
+    printf("%d replays compared: %d mismatches\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
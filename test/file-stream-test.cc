@@ -0,0 +1,137 @@
+//========================================================================
+//
+// file-stream-test.cc
+//
+// Checks how PDFDoc reads files opened by name: by default through a
+// FileStream, which survives the file being truncated while the
+// document is open, and with GlobalParams::setMapFiles() through a
+// MappedFileStream that renders the same as the FileStream.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "splash/SplashBitmap.h"
+#include "test-pdf-builder.h"
+
+static const int numPages = 6;
+
+static std::string pageContent(int page)
+{
+    std::string content;
+    for (int i = 0; i < 1500; ++i) {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "%.3f %.3f %.3f rg %d %d %d %d re f\n", ((i + page) * 37 % 100) / 100.0, (i * 59 % 100) / 100.0, (i * 17 % 100) / 100.0, (i * 97 + page) % 600, (i * 131) % 780, 5 + i % 20, 5 + i % 30);
+        content += buf;
+    }
+    return content;
+}
+
+static std::unique_ptr<SplashBitmap> render(PDFDoc *doc, int page)
+{
+    SplashColor paperColor = { 0xff, 0xff, 0xff };
+    SplashOutputDev out(splashModeRGB8, 1, false, paperColor);
+    out.startDoc(doc);
+    doc->displayPage(&out, page, 36, 36, 0, false, true, false);
+    return std::unique_ptr<SplashBitmap>(out.takeBitmap());
+}
+
+static bool sameBitmaps(SplashBitmap *a, SplashBitmap *b)
+{
+    return a && b && a->getWidth() == b->getWidth() && a->getHeight() == b->getHeight() && a->getRowSize() == b->getRowSize() && memcmp(a->getDataPtr(), b->getDataPtr(), (size_t)a->getRowSize() * a->getHeight()) == 0;
+}
+
+// Fetches every object and reads every stream to its end.
+static void readAllObjects(PDFDoc *doc)
+{
+    XRef *xref = doc->getXRef();
+    for (int num = 1; num < xref->getNumObjects(); ++num) {
+        Object obj = xref->fetch(num, 0);
+        if (obj.isStream()) {
+            obj.getStream()->reset();
+            while (obj.getStream()->getChar() != EOF) { }
+            obj.getStream()->close();
+        }
+    }
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    TestPdfBuilder builder;
+    for (int page = 1; page <= numPages; ++page) {
+        builder.addPage(pageContent(page));
+    }
+    const std::string fileName = testTempFileName("file-stream.pdf");
+    if (!builder.write(fileName)) {
+        return 1;
+    }
+
+    int numChecks = 0;
+    int numFailures = 0;
+
+    // a mapped file renders the same as one read with read()
+    std::unique_ptr<PDFDoc> doc = testOpenPdf(fileName);
+    globalParams->setMapFiles(true);
+    std::unique_ptr<PDFDoc> mappedDoc = testOpenPdf(fileName);
+    globalParams->setMapFiles(false);
+    if (!doc || !mappedDoc) {
+        return 1;
+    }
+    ++numChecks;
+    if (doc->getBaseStream()->getKind() != strFile || mappedDoc->getBaseStream()->getKind() != strMappedFile) {
+        fprintf(stderr, "files are read through a %s stream by default and a %s stream with setMapFiles()\n", doc->getBaseStream()->getKind() == strFile ? "file" : "mapped",
+                mappedDoc->getBaseStream()->getKind() == strMappedFile ? "mapped" : "file");
+        ++numFailures;
+    }
+    for (int page = 1; page <= numPages; ++page) {
+        std::unique_ptr<SplashBitmap> bitmap = render(doc.get(), page);
+        std::unique_ptr<SplashBitmap> mappedBitmap = render(mappedDoc.get(), page);
+        ++numChecks;
+        if (!sameBitmaps(bitmap.get(), mappedBitmap.get())) {
+            fprintf(stderr, "page %d renders differently from a mapped file\n", page);
+            ++numFailures;
+        }
+    }
+    mappedDoc.reset();
+    doc.reset();
+
+    // truncating the file while the document is open: the lost objects
+    // are read as the end of the file, nothing may crash
+    doc = testOpenPdf(fileName);
+    if (!doc) {
+        return 1;
+    }
+    render(doc.get(), 1);
+    std::error_code ec;
+    std::filesystem::resize_file(fileName, std::filesystem::file_size(fileName) / 3, ec);
+    if (ec) {
+        fprintf(stderr, "can't truncate %s\n", fileName.c_str());
+        return 1;
+    }
+    for (int page = 1; page <= numPages; ++page) {
+        render(doc.get(), page);
+    }
+    readAllObjects(doc.get());
+    ++numChecks;
+    doc.reset();
+
+    remove(fileName.c_str());
+    printf("%d file stream checks: %d failures\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+//========================================================================
+//
+// jbig2-bench.cc
+//
+// Times JBIG2 generic region decoding with the specialized decoders and
+// with the general ones, on generated text pages coded with each
+// template and as random MMR data.  Prints the best of a number of runs
+// of each.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "GlobalParams.h"
+#include "JBIG2Stream.h"
+#include "jbig2-encoder.h"
+
+// Returns the shortest time in ms of <runs> decodes of <stream>.
+static double timeDecode(const std::string &stream, bool fast, int runs)
+{
+    jbig2SetFastDecoding(fast);
+    double best = 0;
+    for (int i = 0; i < runs; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        const std::string out = jbig2Decode(stream);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (i == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+    jbig2SetFastDecoding(true);
+    return best;
+}
+
+static void report(const char *name, const std::string &stream, int runs)
+{
+    const double general = timeDecode(stream, false, runs);
+    const double fast = timeDecode(stream, true, runs);
+    printf("%-36s %9.2f ms %9.2f ms %6.2fx\n", name, general, fast, fast > 0 ? general / fast : 0);
+}
+
+int main(int argc, char *argv[])
+{
+    const int runs = argc > 1 ? atoi(argv[1]) : 15;
+    if (runs < 1) {
+        fprintf(stderr, "Usage: jbig2-bench [runs]\n");
+        return 1;
+    }
+
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    printf("%-36s %12s %12s %7s\n", "region", "general", "specialized", "speedup");
+    const int pageSizes[][2] = { { 850, 1100 }, { 2550, 3300 } };
+    for (const auto &size : pageSizes) {
+        const Jbig2TestImage page = jbig2TextImage(size[0], size[1], 1);
+        for (int templ = 0; templ < 4; ++templ) {
+            for (int tpgd = 0; tpgd < 2; ++tpgd) {
+                int atx[4], aty[4];
+                jbig2NominalAT(templ, atx, aty);
+                const std::string data = jbig2EncodeGenericRegion(page, templ, tpgd, atx, aty);
+                char name[64];
+                snprintf(name, sizeof(name), "%dx%d text, template %d%s", size[0], size[1], templ, tpgd ? ", TPGD" : "");
+                report(name, jbig2EmbeddedStream(size[0], size[1], false, templ, tpgd, atx, aty, data), runs);
+            }
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "%dx%d random MMR", size[0], size[1]);
+        report(name, jbig2EmbeddedStream(size[0], size[1], true, 0, false, nullptr, nullptr, jbig2RandomMMRData(size[0] * size[1] / 16, 1)), runs);
+    }
+    return 0;
+}
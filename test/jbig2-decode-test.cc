@@ -0,0 +1,126 @@
+//========================================================================
+//
+// jbig2-decode-test.cc
+//
+// Checks that the specialized JBIG2 generic region decoders give the
+// same bitmaps as the general ones: regions coded with every template,
+// with and without typical prediction, and with nominal, near and far
+// adaptive template pixels round trip through both, and random MMR data
+// decodes the same through both.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GlobalParams.h"
+#include "JBIG2Stream.h"
+#include "jbig2-encoder.h"
+
+// Decodes <stream> with the specialized and with the general decoders.
+static void decodeBoth(const std::string &stream, std::string *fast, std::string *general)
+{
+    jbig2SetFastDecoding(true);
+    *fast = jbig2Decode(stream);
+    jbig2SetFastDecoding(false);
+    *general = jbig2Decode(stream);
+    jbig2SetFastDecoding(true);
+}
+
+static int checkGenericRegions(int *numChecks)
+{
+    struct TestImage
+    {
+        const char *name;
+        Jbig2TestImage image;
+    };
+    std::vector<TestImage> images;
+    const int sizes[][2] = { { 1, 1 }, { 7, 5 }, { 8, 8 }, { 9, 3 }, { 63, 17 }, { 64, 20 }, { 65, 11 }, { 333, 41 } };
+    unsigned int seed = 1;
+    for (const auto &size : sizes) {
+        images.push_back({ "sparse noise", jbig2NoiseImage(size[0], size[1], 3, seed++) });
+        images.push_back({ "noise", jbig2NoiseImage(size[0], size[1], 50, seed++) });
+        images.push_back({ "dense noise", jbig2NoiseImage(size[0], size[1], 97, seed++) });
+    }
+    images.push_back({ "text", jbig2TextImage(850, 300, seed++) });
+    images.push_back({ "text", jbig2TextImage(1203, 150, seed++) });
+
+    // for each template: the nominal pixels, others near them, and some
+    // far away that the general decoder reads with getPixel()
+    const int atPixels[][3][8] = {
+        { { 3, -1, -3, -1, 2, -2, -2, -2 }, { -1, 0, 1, -1, -2, -1, 0, -2 }, { -20, -1, 12, -3, -9, 0, 100, -1 } },
+        { { 3, -1 }, { -4, 0 }, { 30, -2 } },
+        { { 2, -1 }, { 1, -2 }, { -50, 0 } },
+        { { 2, -1 }, { -1, -1 }, { 9, -1 } },
+    };
+    const char *atNames[] = { "nominal", "near", "far" };
+
+    int numFailures = 0;
+    for (const TestImage &image : images) {
+        const std::string expected = image.image.toFilterOutput();
+        for (int templ = 0; templ < 4; ++templ) {
+            for (int at = 0; at < 3; ++at) {
+                int atx[4], aty[4];
+                for (int i = 0; i < 4; ++i) {
+                    atx[i] = atPixels[templ][at][2 * i];
+                    aty[i] = atPixels[templ][at][2 * i + 1];
+                }
+                for (int tpgd = 0; tpgd < 2; ++tpgd) {
+                    const std::string data = jbig2EncodeGenericRegion(image.image, templ, tpgd, atx, aty);
+                    const std::string stream = jbig2EmbeddedStream(image.image.w, image.image.h, false, templ, tpgd, atx, aty, data);
+                    std::string fast, general;
+                    decodeBoth(stream, &fast, &general);
+                    ++*numChecks;
+                    if (fast != general || fast != expected) {
+                        fprintf(stderr, "%dx%d %s, template %d, %s AT pixels, TPGD %s: the %s\n", image.image.w, image.image.h, image.name, templ, atNames[at], tpgd ? "on" : "off",
+                                fast != general ? "specialized and general decoders differ" : "decoded bitmap differs from the coded one");
+                        ++numFailures;
+                    }
+                }
+            }
+        }
+    }
+    return numFailures;
+}
+
+static int checkMMRRegions(int *numChecks)
+{
+    const int widths[] = { 1, 5, 8, 13, 64, 100, 257, 1000 };
+    int numFailures = 0;
+    unsigned int seed = 1;
+    for (int w : widths) {
+        for (int i = 0; i < 20; ++i) {
+            const int h = 1 + (int)(seed * 7 % 50);
+            const std::string data = jbig2RandomMMRData(16 + (int)(seed * 13 % 400), seed);
+            ++seed;
+            const std::string stream = jbig2EmbeddedStream(w, h, true, 0, false, nullptr, nullptr, data);
+            std::string fast, general;
+            decodeBoth(stream, &fast, &general);
+            ++*numChecks;
+            if (fast != general) {
+                fprintf(stderr, "%dx%d MMR region %u: the specialized and general decoders differ\n", w, h, seed - 1);
+                ++numFailures;
+            }
+        }
+    }
+    return numFailures;
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    int numChecks = 0;
+    int numFailures = checkGenericRegions(&numChecks);
+    numFailures += checkMMRRegions(&numChecks);
+
+    printf("%d JBIG2 regions decoded: %d mismatches\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
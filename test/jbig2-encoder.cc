@@ -0,0 +1,428 @@
+//========================================================================
+//
+// jbig2-encoder.cc
+//
+// The arithmetic coder is the MQ encoder of ITU-T T.88 Annex E.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <memory>
+
+#include "Dict.h"
+#include "Object.h"
+#include "Stream.h"
+#include "jbig2-encoder.h"
+
+//------------------------------------------------------------------------
+// Jbig2TestImage
+//------------------------------------------------------------------------
+
+std::string Jbig2TestImage::toFilterOutput() const
+{
+    const int lineSize = (w + 7) >> 3;
+    std::string out((size_t)lineSize * h, '\xff');
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            if (get(x, y)) {
+                out[(size_t)y * lineSize + (x >> 3)] ^= (char)(0x80 >> (x & 7));
+            }
+        }
+    }
+    return out;
+}
+
+//------------------------------------------------------------------------
+// MQ encoder
+//------------------------------------------------------------------------
+
+static const unsigned int qeTab[47] = { 0x5601, 0x3401, 0x1801, 0x0AC1, 0x0521, 0x0221, 0x5601, 0x5401, 0x4801, 0x3801, 0x3001, 0x2401, 0x1C01, 0x1601, 0x5601, 0x5401,
+                                        0x5101, 0x4801, 0x3801, 0x3401, 0x3001, 0x2801, 0x2401, 0x2201, 0x1C01, 0x1801, 0x1601, 0x1401, 0x1201, 0x1101, 0x0AC1, 0x09C1,
+                                        0x08A1, 0x0521, 0x0441, 0x02A1, 0x0221, 0x0141, 0x0111, 0x0085, 0x0049, 0x0025, 0x0015, 0x0009, 0x0005, 0x0001, 0x5601 };
+
+static const int nmpsTab[47] = { 1, 2, 3, 4, 5, 38, 7, 8, 9, 10, 11, 12, 13, 29, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 45, 46 };
+
+static const int nlpsTab[47] = { 1, 6, 9, 12, 29, 33, 6, 14, 14, 14, 17, 18, 20, 21, 14, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 46 };
+
+static const int switchTab[47] = { 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+class MQEncoder
+{
+public:
+    explicit MQEncoder(int contextBits) : index(1 << contextBits, 0), mps(1 << contextBits, 0)
+    {
+        // out.back() is the byte B of the spec; the first one is a
+        // placeholder before the coded data
+        out.push_back(0);
+    }
+
+    void encode(unsigned int cx, int bit)
+    {
+        const unsigned int qe = qeTab[index[cx]];
+        a -= qe;
+        if (bit == mps[cx]) {
+            if (a & 0x8000) {
+                c += qe;
+                return;
+            }
+            if (a < qe) {
+                a = qe;
+            } else {
+                c += qe;
+            }
+            index[cx] = nmpsTab[index[cx]];
+        } else {
+            if (a < qe) {
+                c += qe;
+            } else {
+                a = qe;
+            }
+            if (switchTab[index[cx]]) {
+                mps[cx] ^= 1;
+            }
+            index[cx] = nlpsTab[index[cx]];
+        }
+        renormalize();
+    }
+
+    std::string finish()
+    {
+        const unsigned int tempC = c + a;
+        c |= 0xffff;
+        if (c >= tempC) {
+            c -= 0x8000;
+        }
+        c <<= ct;
+        byteOut();
+        c <<= ct;
+        byteOut();
+        if (out.back() != 0xff) {
+            out.push_back(0xff);
+        }
+        out.push_back(0xac);
+        return std::string(out.begin() + 1, out.end());
+    }
+
+private:
+    void renormalize()
+    {
+        do {
+            a <<= 1;
+            c <<= 1;
+            if (--ct == 0) {
+                byteOut();
+            }
+        } while (!(a & 0x8000));
+    }
+
+    void byteOut()
+    {
+        if (out.back() != 0xff) {
+            if (c < 0x8000000) {
+                out.push_back((unsigned char)(c >> 19));
+                c &= 0x7ffff;
+                ct = 8;
+                return;
+            }
+            // propagate the carry
+            if (++out.back() != 0xff) {
+                out.push_back((unsigned char)(c >> 19));
+                c &= 0x7ffff;
+                ct = 8;
+                return;
+            }
+            c &= 0x7ffffff;
+        }
+        // after a 0xff byte only 7 bits are written
+        out.push_back((unsigned char)(c >> 20));
+        c &= 0xfffff;
+        ct = 7;
+    }
+
+    std::vector<unsigned char> index;
+    std::vector<unsigned char> mps;
+    std::vector<unsigned char> out;
+    unsigned int a = 0x8000;
+    unsigned int c = 0;
+    int ct = 12;
+};
+
+//------------------------------------------------------------------------
+// generic regions
+//------------------------------------------------------------------------
+
+static const int contextBits[4] = { 16, 13, 10, 10 };
+static const unsigned int typicalContexts[4] = { 0x3953, 0x079a, 0x0e3, 0x18b };
+
+// The context of pixel (<x>, <y>), as in T.88 6.2.5.3.
+static unsigned int genericContext(const Jbig2TestImage &image, int x, int y, int templ, const int *atx, const int *aty)
+{
+    unsigned int cx = 0;
+    auto add = [&](int dx, int dy) { cx = (cx << 1) | image.get(x + dx, y + dy); };
+
+    switch (templ) {
+    case 0:
+        for (int dx = -1; dx <= 1; ++dx) {
+            add(dx, -2);
+        }
+        for (int dx = -2; dx <= 2; ++dx) {
+            add(dx, -1);
+        }
+        for (int dx = -4; dx <= -1; ++dx) {
+            add(dx, 0);
+        }
+        for (int i = 0; i < 4; ++i) {
+            add(atx[i], aty[i]);
+        }
+        break;
+    case 1:
+        for (int dx = -1; dx <= 2; ++dx) {
+            add(dx, -2);
+        }
+        for (int dx = -2; dx <= 2; ++dx) {
+            add(dx, -1);
+        }
+        for (int dx = -3; dx <= -1; ++dx) {
+            add(dx, 0);
+        }
+        add(atx[0], aty[0]);
+        break;
+    case 2:
+        for (int dx = -1; dx <= 1; ++dx) {
+            add(dx, -2);
+        }
+        for (int dx = -2; dx <= 1; ++dx) {
+            add(dx, -1);
+        }
+        for (int dx = -2; dx <= -1; ++dx) {
+            add(dx, 0);
+        }
+        add(atx[0], aty[0]);
+        break;
+    case 3:
+        for (int dx = -3; dx <= 1; ++dx) {
+            add(dx, -1);
+        }
+        for (int dx = -4; dx <= -1; ++dx) {
+            add(dx, 0);
+        }
+        add(atx[0], aty[0]);
+        break;
+    }
+    return cx;
+}
+
+// Returns true if row <y> is the same as the row above, or, for the first
+// row, all white.
+static bool isTypicalRow(const Jbig2TestImage &image, int y)
+{
+    for (int x = 0; x < image.w; ++x) {
+        if (image.get(x, y) != image.get(x, y - 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string jbig2EncodeGenericRegion(const Jbig2TestImage &image, int templ, bool tpgd, const int *atx, const int *aty)
+{
+    MQEncoder encoder(contextBits[templ]);
+    bool ltp = false;
+    for (int y = 0; y < image.h; ++y) {
+        if (tpgd) {
+            const bool typical = isTypicalRow(image, y);
+            encoder.encode(typicalContexts[templ], typical != ltp);
+            ltp = typical;
+            if (typical) {
+                continue;
+            }
+        }
+        for (int x = 0; x < image.w; ++x) {
+            encoder.encode(genericContext(image, x, y, templ, atx, aty), image.get(x, y));
+        }
+    }
+    return encoder.finish();
+}
+
+void jbig2NominalAT(int templ, int *atx, int *aty)
+{
+    static const int nominal[4][8] = { { 3, -1, -3, -1, 2, -2, -2, -2 }, { 3, -1 }, { 2, -1 }, { 2, -1 } };
+    for (int i = 0; i < (templ == 0 ? 4 : 1); ++i) {
+        atx[i] = nominal[templ][2 * i];
+        aty[i] = nominal[templ][2 * i + 1];
+    }
+}
+
+//------------------------------------------------------------------------
+// embedded streams
+//------------------------------------------------------------------------
+
+static void appendULong(std::string *s, unsigned int x)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        *s += (char)(x >> shift);
+    }
+}
+
+static void appendSegment(std::string *s, unsigned int segNum, unsigned int type, const std::string &data)
+{
+    appendULong(s, segNum);
+    *s += (char)type;
+    *s += (char)0; // no referred-to segments
+    *s += (char)1; // page 1
+    appendULong(s, (unsigned int)data.size());
+    *s += data;
+}
+
+std::string jbig2EmbeddedStream(int w, int h, bool mmr, int templ, bool tpgd, const int *atx, const int *aty, const std::string &data)
+{
+    std::string pageInfo;
+    appendULong(&pageInfo, w);
+    appendULong(&pageInfo, h);
+    appendULong(&pageInfo, 0); // x resolution
+    appendULong(&pageInfo, 0); // y resolution
+    pageInfo += (char)0; // white default pixel, OR combination
+    pageInfo += std::string(2, '\0'); // not striped
+
+    std::string region;
+    appendULong(&region, w);
+    appendULong(&region, h);
+    appendULong(&region, 0); // x
+    appendULong(&region, 0); // y
+    region += (char)0; // OR combination
+    region += (char)((mmr ? 1 : 0) | (templ << 1) | (tpgd ? 8 : 0));
+    if (!mmr) {
+        for (int i = 0; i < (templ == 0 ? 4 : 1); ++i) {
+            region += (char)atx[i];
+            region += (char)aty[i];
+        }
+    }
+    region += data;
+
+    std::string stream;
+    appendSegment(&stream, 0, 48, pageInfo); // page information
+    appendSegment(&stream, 1, 38, region); // immediate generic region
+    appendSegment(&stream, 2, 49, std::string()); // end of page
+    return stream;
+}
+
+std::string jbig2Decode(const std::string &stream)
+{
+    Dict *dict = new Dict((XRef *)nullptr);
+    dict->add("Length", Object((int)stream.size()));
+    dict->add("Filter", Object(objName, "JBIG2Decode"));
+    Stream *str = new MemStream(stream.data(), 0, stream.size(), Object(dict));
+    std::unique_ptr<Stream> filter(str->addFilters(str->getDict()));
+
+    std::string out;
+    if (!filter->reset()) {
+        return out;
+    }
+    unsigned char buf[4096];
+    int n;
+    while ((n = filter->doGetChars(sizeof(buf), buf)) > 0) {
+        out.append((const char *)buf, n);
+    }
+    filter->close();
+    return out;
+}
+
+//------------------------------------------------------------------------
+// test images
+//------------------------------------------------------------------------
+
+namespace {
+
+class Random
+{
+public:
+    explicit Random(unsigned int seed) : state(seed) { }
+    unsigned int next()
+    {
+        state = state * 1103515245u + 12345u;
+        return (state >> 8) & 0xffffff;
+    }
+    int nextInt(int n) { return (int)(next() % n); }
+
+private:
+    unsigned int state;
+};
+
+}
+
+Jbig2TestImage jbig2TextImage(int w, int h, unsigned int seed)
+{
+    Random random(seed);
+    Jbig2TestImage image(w, h);
+    const int margin = w / 10;
+    const int lineHeight = 24;
+    for (int base = margin; base + lineHeight < h - margin; base += lineHeight) {
+        int x = margin;
+        while (x < w - margin - 20) {
+            if (random.nextInt(7) == 0) {
+                x += 8; // space between words
+                continue;
+            }
+            // a glyph: a few strokes in a box with a shared baseline
+            const int gw = 6 + random.nextInt(8);
+            const int gh = 9 + random.nextInt(7);
+            const int nStrokes = 1 + random.nextInt(3);
+            for (int i = 0; i < nStrokes; ++i) {
+                const bool vertical = random.nextInt(2);
+                const int sx = x + random.nextInt(gw - 2);
+                const int sy = base + lineHeight - gh + random.nextInt(gh - 2);
+                const int len = vertical ? gh / 2 + random.nextInt(gh / 2) : gw / 2 + random.nextInt(gw / 2);
+                for (int k = 0; k < len; ++k) {
+                    for (int t = 0; t < 2; ++t) {
+                        const int px = vertical ? sx + t : sx + k;
+                        const int py = vertical ? sy + k : sy + t;
+                        if (px < w && py < h) {
+                            image.set(px, py);
+                        }
+                    }
+                }
+            }
+            x += gw + 2;
+        }
+    }
+    return image;
+}
+
+Jbig2TestImage jbig2NoiseImage(int w, int h, int percentBlack, unsigned int seed)
+{
+    Random random(seed);
+    Jbig2TestImage image(w, h);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            if (random.nextInt(100) < percentBlack) {
+                image.set(x, y);
+            }
+        }
+    }
+    return image;
+}
+
+std::string jbig2RandomMMRData(int nBytes, unsigned int seed)
+{
+    // the codes of T.4 and T.6, as strings of bits
+    static const char *codes[] = {
+        "1", "1", "1", "1", // V0, the most frequent
+        "011", "010", "000011", "000010", "0000011", "0000010", // VR1, VL1, VR2, VL2, VR3, VL3
+        "0001", // pass
+        "001" "0111" "11", "001" "1000" "10", "001" "1011" "010", "001" "1110" "011", // horizontal: white 2..6, black 1..4
+    };
+    Random random(seed);
+    std::string bits;
+    while ((int)bits.size() < nBytes * 8) {
+        bits += codes[random.nextInt(sizeof(codes) / sizeof(codes[0]))];
+    }
+    std::string data(nBytes, '\0');
+    for (int i = 0; i < nBytes * 8; ++i) {
+        if (bits[i] == '1') {
+            data[i >> 3] |= (char)(0x80 >> (i & 7));
+        }
+    }
+    return data;
+}
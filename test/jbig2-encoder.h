@@ -0,0 +1,66 @@
+//========================================================================
+//
+// jbig2-encoder.h
+//
+// A small JBIG2 generic region encoder and test images for it, so that
+// the JBIG2 test and benchmark programs in this directory don't depend
+// on the external test data.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef JBIG2_ENCODER_H
+#define JBIG2_ENCODER_H
+
+#include <string>
+#include <vector>
+
+// A bilevel image, one byte per pixel, 1 is black.
+struct Jbig2TestImage
+{
+    int w, h;
+    std::vector<unsigned char> pixels;
+
+    Jbig2TestImage(int wA, int hA) : w(wA), h(hA), pixels((size_t)wA * hA, 0) { }
+
+    // Pixels outside of the image are white.
+    int get(int x, int y) const { return (x < 0 || x >= w || y < 0 || y >= h) ? 0 : pixels[(size_t)y * w + x]; }
+    void set(int x, int y) { pixels[(size_t)y * w + x] = 1; }
+
+    // Returns the image as the JBIG2Decode filter outputs it: rows of
+    // (w+7)/8 bytes, 1 bits are white.
+    std::string toFilterOutput() const;
+};
+
+// Returns the arithmetic coded data of a generic region holding <image>,
+// coded with template <templ>, typical prediction if <tpgd>, and the
+// adaptive template pixels <atx>, <aty> (4 of them for template 0, else
+// 1).
+std::string jbig2EncodeGenericRegion(const Jbig2TestImage &image, int templ, bool tpgd, const int *atx, const int *aty);
+
+// Returns an embedded JBIG2 stream, as the contents of a JBIG2Decode
+// stream, of a <w> x <h> page holding one immediate generic region:
+// MMR coded if <mmr>, else arithmetic coded with the <templ>, <tpgd>,
+// <atx> and <aty> given to jbig2EncodeGenericRegion.  <data> is the
+// coded region.
+std::string jbig2EmbeddedStream(int w, int h, bool mmr, int templ, bool tpgd, const int *atx, const int *aty, const std::string &data);
+
+// Returns what the JBIG2Decode filter outputs for <stream>.
+std::string jbig2Decode(const std::string &stream);
+
+// The nominal adaptive template pixels of template <templ>.
+void jbig2NominalAT(int templ, int *atx, int *aty);
+
+// Test images made from the pseudo random sequence starting at <seed>:
+// lines of small glyphs on white, as on scanned text pages, and noise
+// with <percentBlack> black pixels.
+Jbig2TestImage jbig2TextImage(int w, int h, unsigned int seed);
+Jbig2TestImage jbig2NoiseImage(int w, int h, int percentBlack, unsigned int seed);
+
+// Returns <nBytes> of MMR data made of random vertical, pass and short
+// horizontal mode codes, which decode to bitmaps with plenty of short
+// runs, and, where the codes don't fit the line, to decoding errors.
+std::string jbig2RandomMMRData(int nBytes, unsigned int seed);
+
+#endif
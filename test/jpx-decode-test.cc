@@ -0,0 +1,398 @@
+//========================================================================
+//
+// jpx-decode-test.cc
+//
+// Checks JPXStream's reduced resolution and partial decoding against a
+// full decode of the same lossless codestream: an area decoded alone has
+// the same samples as that area of the full image, at full and at
+// reduced resolution, and a reduced decode stays close to the full image
+// scaled down.  Then checks that SplashOutputDev draws clipped and
+// scaled down JPX images like the same samples stored uncompressed, and
+// draws nothing for an image that is clipped away entirely.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <openjpeg.h>
+
+#include "GlobalParams.h"
+#include "Object.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "Stream.h"
+#include "splash/SplashBitmap.h"
+#include "test-pdf-builder.h"
+
+static const int imageWidth = 509;
+static const int imageHeight = 387;
+static const int numResolutions = 6;
+
+// A smooth picture, so that lower resolutions are close to the full one
+// scaled down, with a few sharp edges to catch misplaced areas.
+static std::vector<unsigned char> makeImage()
+{
+    std::vector<unsigned char> pixels((size_t)imageWidth * imageHeight * 3);
+    for (int y = 0; y < imageHeight; ++y) {
+        for (int x = 0; x < imageWidth; ++x) {
+            unsigned char *p = &pixels[((size_t)y * imageWidth + x) * 3];
+            p[0] = (unsigned char)(x * 255 / (imageWidth - 1));
+            p[1] = (unsigned char)(y * 255 / (imageHeight - 1));
+            p[2] = ((x / 64 + y / 64) % 2) ? 200 : 40;
+        }
+    }
+    return pixels;
+}
+
+//------------------------------------------------------------------------
+// encoding
+//------------------------------------------------------------------------
+
+// A growing memory buffer to encode into.
+struct EncodeBuffer
+{
+    std::vector<unsigned char> data;
+    size_t pos = 0;
+};
+
+static OPJ_SIZE_T writeCallback(void *buffer, OPJ_SIZE_T nBytes, void *userData)
+{
+    auto *out = static_cast<EncodeBuffer *>(userData);
+    if (out->pos + nBytes > out->data.size()) {
+        out->data.resize(out->pos + nBytes);
+    }
+    memcpy(out->data.data() + out->pos, buffer, nBytes);
+    out->pos += nBytes;
+    return nBytes;
+}
+
+static OPJ_OFF_T skipCallback(OPJ_OFF_T nBytes, void *userData)
+{
+    auto *out = static_cast<EncodeBuffer *>(userData);
+    if (nBytes < 0 && (size_t)-nBytes > out->pos) {
+        return -1;
+    }
+    out->pos += nBytes;
+    if (out->pos > out->data.size()) {
+        out->data.resize(out->pos);
+    }
+    return nBytes;
+}
+
+static OPJ_BOOL seekCallback(OPJ_OFF_T pos, void *userData)
+{
+    auto *out = static_cast<EncodeBuffer *>(userData);
+    if (pos < 0) {
+        return OPJ_FALSE;
+    }
+    out->pos = (size_t)pos;
+    if (out->pos > out->data.size()) {
+        out->data.resize(out->pos);
+    }
+    return OPJ_TRUE;
+}
+
+// Encodes <pixels> losslessly as a JP2 file with several resolution
+// levels.
+static std::vector<unsigned char> encodeJP2(const std::vector<unsigned char> &pixels)
+{
+    opj_image_cmptparm_t compParams[3];
+    memset(compParams, 0, sizeof(compParams));
+    for (opj_image_cmptparm_t &c : compParams) {
+        c.dx = 1;
+        c.dy = 1;
+        c.w = imageWidth;
+        c.h = imageHeight;
+        c.prec = 8;
+        c.sgnd = 0;
+    }
+    opj_image_t *image = opj_image_create(3, compParams, OPJ_CLRSPC_SRGB);
+    image->x0 = 0;
+    image->y0 = 0;
+    image->x1 = imageWidth;
+    image->y1 = imageHeight;
+    for (int c = 0; c < 3; ++c) {
+        for (size_t i = 0; i < (size_t)imageWidth * imageHeight; ++i) {
+            image->comps[c].data[i] = pixels[i * 3 + c];
+        }
+    }
+
+    opj_cparameters_t params;
+    opj_set_default_encoder_parameters(&params);
+    params.numresolution = numResolutions;
+    params.tcp_numlayers = 1;
+    params.tcp_rates[0] = 0;
+    params.cp_disto_alloc = 1;
+    params.irreversible = 0;
+
+    EncodeBuffer out;
+    opj_codec_t *codec = opj_create_compress(OPJ_CODEC_JP2);
+    opj_stream_t *stream = opj_stream_default_create(OPJ_FALSE);
+    opj_stream_set_user_data(stream, &out, nullptr);
+    opj_stream_set_write_function(stream, writeCallback);
+    opj_stream_set_skip_function(stream, skipCallback);
+    opj_stream_set_seek_function(stream, seekCallback);
+    const bool ok = opj_setup_encoder(codec, &params, image) && opj_start_compress(codec, image, stream) && opj_encode(codec, stream) && opj_end_compress(codec, stream);
+    opj_stream_destroy(stream);
+    opj_destroy_codec(codec);
+    opj_image_destroy(image);
+    if (!ok) {
+        return {};
+    }
+    return std::move(out.data);
+}
+
+//------------------------------------------------------------------------
+// decoding
+//------------------------------------------------------------------------
+
+struct Samples
+{
+    int width = 0, height = 0;
+    std::vector<unsigned char> data; // RGB
+};
+
+// Decodes the image XObject /Im1 of the first page, at reduction
+// <reduction> and, if <x1> > 0, only the area <x0>,<y0> to <x1>,<y1>.
+static Samples decode(PDFDoc *doc, int reduction, int x0 = 0, int y0 = 0, int x1 = 0, int y1 = 0)
+{
+    Samples samples;
+    Object xobjects = doc->getPage(1)->getResourceDictObject()->dictLookup("XObject");
+    Object image = xobjects.dictLookup("Im1");
+    if (!image.isStream()) {
+        return samples;
+    }
+    Stream *str = image.getStream();
+    // ask for exactly <reduction> levels
+    const int scale = 1 << reduction;
+    if (str->setReducedDecoding(imageWidth, imageHeight, imageWidth / scale, imageHeight / scale) != reduction) {
+        fprintf(stderr, "reduction %d was refused\n", reduction);
+        return samples;
+    }
+    if (x1 > 0) {
+        if (!str->setDecodeArea(x0, y0, x1, y1)) {
+            fprintf(stderr, "area %d,%d-%d,%d was refused\n", x0, y0, x1, y1);
+            return samples;
+        }
+    } else {
+        x1 = imageWidth;
+        y1 = imageHeight;
+    }
+    samples.width = (x1 + scale - 1) / scale - (x0 + scale - 1) / scale;
+    samples.height = (y1 + scale - 1) / scale - (y0 + scale - 1) / scale;
+    samples.data.resize((size_t)samples.width * samples.height * 3);
+    if (!str->reset() || str->doGetChars((int)samples.data.size(), samples.data.data()) != (int)samples.data.size()) {
+        samples.data.clear();
+    }
+    str->close();
+    return samples;
+}
+
+// The largest difference between <area> and the part of <whole> at
+// <ax>,<ay>.
+static int maxAreaDifference(const Samples &whole, const Samples &area, int ax, int ay)
+{
+    if (area.data.empty() || whole.data.empty() || ax + area.width > whole.width || ay + area.height > whole.height) {
+        return 256;
+    }
+    int maxDiff = 0;
+    for (int y = 0; y < area.height; ++y) {
+        for (int i = 0; i < area.width * 3; ++i) {
+            const int diff = abs(area.data[(size_t)y * area.width * 3 + i] - whole.data[((size_t)(ay + y) * whole.width + ax) * 3 + i]);
+            maxDiff = std::max(maxDiff, diff);
+        }
+    }
+    return maxDiff;
+}
+
+// The mean difference between <reduced> and <full> averaged over
+// <scale> x <scale> blocks.
+static double meanReducedDifference(const Samples &full, const Samples &reduced, int scale)
+{
+    if (reduced.data.empty() || full.data.empty()) {
+        return 256;
+    }
+    double sum = 0;
+    int n = 0;
+    for (int y = 0; y < reduced.height; ++y) {
+        for (int x = 0; x < reduced.width; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                int total = 0, count = 0;
+                for (int yy = y * scale; yy < std::min((y + 1) * scale, full.height); ++yy) {
+                    for (int xx = x * scale; xx < std::min((x + 1) * scale, full.width); ++xx) {
+                        total += full.data[((size_t)yy * full.width + xx) * 3 + c];
+                        ++count;
+                    }
+                }
+                sum += abs(reduced.data[((size_t)y * reduced.width + x) * 3 + c] - (double)total / count);
+                ++n;
+            }
+        }
+    }
+    return sum / n;
+}
+
+//------------------------------------------------------------------------
+// rendering
+//------------------------------------------------------------------------
+
+static std::unique_ptr<SplashBitmap> render(PDFDoc *doc, int page)
+{
+    SplashColor paperColor = { 0xff, 0xff, 0xff };
+    SplashOutputDev out(splashModeRGB8, 1, false, paperColor);
+    out.startDoc(doc);
+    doc->displayPage(&out, page, 72, 72, 0, false, true, false);
+    return std::unique_ptr<SplashBitmap>(out.takeBitmap());
+}
+
+// The mean and the largest difference between two bitmaps.
+static void compareBitmaps(SplashBitmap *a, SplashBitmap *b, double *mean, int *max)
+{
+    *mean = 256;
+    *max = 256;
+    if (!a || !b || a->getWidth() != b->getWidth() || a->getHeight() != b->getHeight()) {
+        return;
+    }
+    double sum = 0;
+    *max = 0;
+    for (int y = 0; y < a->getHeight(); ++y) {
+        const unsigned char *pa = a->getDataPtr() + (size_t)y * a->getRowSize();
+        const unsigned char *pb = b->getDataPtr() + (size_t)y * b->getRowSize();
+        for (int i = 0; i < a->getWidth() * 3; ++i) {
+            const int diff = abs(pa[i] - pb[i]);
+            sum += diff;
+            *max = std::max(*max, diff);
+        }
+    }
+    *mean = sum / ((double)a->getWidth() * a->getHeight() * 3);
+}
+
+static bool isBlank(SplashBitmap *bitmap)
+{
+    for (int y = 0; y < bitmap->getHeight(); ++y) {
+        const unsigned char *p = bitmap->getDataPtr() + (size_t)y * bitmap->getRowSize();
+        for (int i = 0; i < bitmap->getWidth() * 3; ++i) {
+            if (p[i] != 0xff) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Pages drawing the image scaled down, clipped to a small part, scaled
+// down and clipped, and clipped away.
+static void addPages(TestPdfBuilder *builder, const std::string &imageDict, const std::string &imageData)
+{
+    const int image = builder->addStream(imageDict, imageData);
+    const std::string resources = "/XObject << /Im1 " + std::to_string(image) + " 0 R >>";
+    builder->addPage("q 60 0 0 45 100 100 cm /Im1 Do Q\n", resources);
+    builder->addPage("q 150 150 100 80 re W n 509 0 0 387 20 20 cm /Im1 Do Q\n", resources);
+    builder->addPage("q 150 150 40 30 re W n 160 0 0 122 100 100 cm /Im1 Do Q\n", resources);
+    builder->addPage("q 400 600 50 50 re W n 509 0 0 387 20 20 cm /Im1 Do Q\n", resources);
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    const std::vector<unsigned char> pixels = makeImage();
+    const std::vector<unsigned char> jp2 = encodeJP2(pixels);
+    if (jp2.empty()) {
+        fprintf(stderr, "can't encode the test image\n");
+        return 1;
+    }
+    const std::string size = "/Width " + std::to_string(imageWidth) + " /Height " + std::to_string(imageHeight);
+    TestPdfBuilder jpxBuilder;
+    addPages(&jpxBuilder, "/Type /XObject /Subtype /Image " + size + " /BitsPerComponent 8 /ColorSpace /DeviceRGB /Filter /JPXDecode", std::string(jp2.begin(), jp2.end()));
+    TestPdfBuilder rawBuilder;
+    addPages(&rawBuilder, "/Type /XObject /Subtype /Image " + size + " /BitsPerComponent 8 /ColorSpace /DeviceRGB", std::string(pixels.begin(), pixels.end()));
+    const std::string jpxFileName = testTempFileName("jpx.pdf");
+    const std::string rawFileName = testTempFileName("jpx-raw.pdf");
+    if (!jpxBuilder.write(jpxFileName) || !rawBuilder.write(rawFileName)) {
+        return 1;
+    }
+    std::unique_ptr<PDFDoc> jpxDoc = testOpenPdf(jpxFileName);
+    std::unique_ptr<PDFDoc> rawDoc = testOpenPdf(rawFileName);
+    if (!jpxDoc || !rawDoc) {
+        return 1;
+    }
+    jpxDoc->getDecodedImageCache()->setMaxSize(0);
+
+    int numChecks = 0;
+    int numFailures = 0;
+
+    // the full decode of a lossless codestream is the image
+    const Samples full = decode(jpxDoc.get(), 0);
+    ++numChecks;
+    if (full.data != pixels) {
+        fprintf(stderr, "the full decode differs from the encoded image\n");
+        ++numFailures;
+    }
+
+    // areas, some not aligned to anything, at every reduction
+    const struct
+    {
+        int x0, y0, x1, y1;
+    } areas[] = { { 0, 0, 100, 60 }, { 37, 51, 301, 250 }, { 255, 129, 509, 387 }, { 64, 64, 128, 128 } };
+    for (int reduction = 0; reduction < numResolutions - 1; ++reduction) {
+        const int scale = 1 << reduction;
+        const Samples reduced = reduction == 0 ? full : decode(jpxDoc.get(), reduction);
+        if (reduction > 0) {
+            const double mean = meanReducedDifference(full, reduced, scale);
+            ++numChecks;
+            if (reduced.width != (imageWidth + scale - 1) / scale || reduced.height != (imageHeight + scale - 1) / scale || mean > 6) {
+                fprintf(stderr, "reduction %d: %dx%d samples, mean difference %g from the full decode\n", reduction, reduced.width, reduced.height, mean);
+                ++numFailures;
+            }
+        }
+        for (const auto &a : areas) {
+            // areas are aligned to the reduction, as drawImage asks for them
+            const int x0 = a.x0 / scale * scale;
+            const int y0 = a.y0 / scale * scale;
+            const Samples area = decode(jpxDoc.get(), reduction, x0, y0, a.x1, a.y1);
+            ++numChecks;
+            const int diff = maxAreaDifference(reduced, area, x0 / scale, y0 / scale);
+            if (diff != 0) {
+                fprintf(stderr, "reduction %d, area %d,%d-%d,%d: differs by up to %d from the same area of the whole image\n", reduction, x0, y0, a.x1, a.y1, diff);
+                ++numFailures;
+            }
+        }
+    }
+
+    // rendering: reduced and partial decoding draw nearly the same as the
+    // samples stored uncompressed, a clipped away image draws nothing
+    for (int page = 1; page <= 4; ++page) {
+        std::unique_ptr<SplashBitmap> jpxBitmap = render(jpxDoc.get(), page);
+        std::unique_ptr<SplashBitmap> rawBitmap = render(rawDoc.get(), page);
+        double mean;
+        int max;
+        compareBitmaps(jpxBitmap.get(), rawBitmap.get(), &mean, &max);
+        ++numChecks;
+        // the second page shows the image at full resolution, only
+        // the sampling phase may differ
+        const double maxMean = page == 2 ? 0.5 : 3;
+        if (mean > maxMean || (page == 4 && !isBlank(jpxBitmap.get()))) {
+            fprintf(stderr, "page %d: the JPX image renders with a mean difference of %g (max %d) from the uncompressed one\n", page, mean, max);
+            ++numFailures;
+        }
+    }
+
+    jpxDoc.reset();
+    rawDoc.reset();
+    remove(jpxFileName.c_str());
+    remove(rawFileName.c_str());
+    printf("%d JPX decodes and renderings compared: %d mismatches\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,402 @@
+//========================================================================
+//
+// object-stream-test.cc
+//
+// Checks the files written with object streams: a compressed rewrite and,
+// if the path of pdfunite is given, the output of pdfunite -compress are
+// read back, their objects compared with the source, and their objects
+// must be stored in object streams, with type 2 xref stream entries.  An
+// incremental update of such a file must write an uncompressed xref
+// stream that still finds every object.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "XRef.h"
+#include "test-pdf-builder.h"
+
+static const int numExtraObjects = 250;
+
+// Three pages, a metadata stream, and more than two object streams'
+// worth of objects of every type, which refer to each other.
+static TestPdfBuilder buildDocument()
+{
+    TestPdfBuilder builder;
+    for (int page = 1; page <= 3; ++page) {
+        std::string content;
+        for (int line = 0; line < 20; ++line) {
+            content += "BT /F1 10 Tf 72 " + std::to_string(700 - 12 * line) + " Td (page " + std::to_string(page) + " line " + std::to_string(line) + ") Tj ET\n";
+        }
+        builder.addPage(page == 3 ? "0 0 m" : content, "/Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /Helvetica >> >>");
+    }
+    const int metadata = builder.addStream("/Type /Metadata /Subtype /XML", std::string(100, ' '));
+
+    std::string extra;
+    int previous = 0;
+    for (int i = 0; i < numExtraObjects; ++i) {
+        std::string body;
+        switch (i % 6) {
+        case 0:
+            body = std::to_string(i);
+            break;
+        case 1:
+            body = "(string " + std::to_string(i) + " \\(with\\) \\\\ escapes \\003)";
+            break;
+        case 2:
+            body = "/Name#20" + std::to_string(i);
+            break;
+        case 3:
+            body = "[ " + std::to_string(i) + " 0.5 true null <00ff" + std::to_string(i % 10) + "0> ]";
+            break;
+        case 4:
+            body = "<< /Index " + std::to_string(i) + " /Nested << /Array [ 1 2 3 ] >> /Previous " + std::to_string(previous) + " 0 R >>";
+            break;
+        default:
+            body = "<< /Type /Test /Index " + std::to_string(i) + " >>";
+            break;
+        }
+        previous = builder.addObject(body);
+        extra += std::to_string(previous) + " 0 R ";
+    }
+    builder.addCatalogEntries("/Metadata " + std::to_string(metadata) + " 0 R /Extra [ " + extra + "]");
+    return builder;
+}
+
+static std::string readFile(const std::string &path)
+{
+    std::ifstream f(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+//------------------------------------------------------------------------
+// object comparison
+//------------------------------------------------------------------------
+
+// Compares two object graphs.  Indirect objects are compared where they
+// are first reached, and later must be reached as the same objects again;
+// their numbers may differ.  /Parent is skipped, the page tree may be
+// different, and streams are compared by their decoded data.  With
+// addedKeys, the dictionaries of the second graph may have more entries.
+class ObjectComparer
+{
+public:
+    ObjectComparer(XRef *xrefA, XRef *xrefB, bool addedKeysA = false) : xrefs { xrefA, xrefB }, addedKeys(addedKeysA) { }
+
+    bool compare(const Object &a, const Object &b, const std::string &path)
+    {
+        if (a.isRef() || b.isRef()) {
+            if (!a.isRef() || !b.isRef()) {
+                return fail(path, "a reference and a direct object");
+            }
+            const auto it = seen.find(a.getRef().num);
+            if (it != seen.end()) {
+                return it->second == b.getRef().num || fail(path, "references to different objects");
+            }
+            seen[a.getRef().num] = b.getRef().num;
+            return compare(xrefs[0]->fetch(a.getRef()), xrefs[1]->fetch(b.getRef()), path + " -> " + std::to_string(a.getRef().num));
+        }
+        if (a.getType() != b.getType()) {
+            return fail(path, "different types");
+        }
+        switch (a.getType()) {
+        case objBool:
+            return a.getBool() == b.getBool() || fail(path, "different bools");
+        case objInt:
+            return a.getInt() == b.getInt() || fail(path, "different ints");
+        case objReal:
+            return a.getReal() == b.getReal() || fail(path, "different reals");
+        case objString:
+        case objHexString:
+            return a.getString()->toStr() == b.getString()->toStr() || fail(path, "different strings");
+        case objName:
+            return strcmp(a.getName(), b.getName()) == 0 || fail(path, "different names");
+        case objNull:
+            return true;
+        case objArray:
+            if (a.arrayGetLength() != b.arrayGetLength()) {
+                return fail(path, "arrays of different lengths");
+            }
+            for (int i = 0; i < a.arrayGetLength(); ++i) {
+                if (!compare(a.arrayGetNF(i), b.arrayGetNF(i), path + "[" + std::to_string(i) + "]")) {
+                    return false;
+                }
+            }
+            return true;
+        case objDict:
+            return compareDicts(a.getDict(), b.getDict(), path, false);
+        case objStream: {
+            if (!compareDicts(a.streamGetDict(), b.streamGetDict(), path, true)) {
+                return false;
+            }
+            std::string dataA, dataB;
+            a.getStream()->fillString(dataA);
+            b.getStream()->fillString(dataB);
+            return dataA == dataB || fail(path, "streams with different data");
+        }
+        default:
+            return fail(path, "objects that can't be compared");
+        }
+    }
+
+private:
+    // Stream dictionaries may differ in how the data is coded.
+    static bool skipKey(const char *key, bool stream)
+    {
+        return strcmp(key, "Parent") == 0 || (stream && (strcmp(key, "Length") == 0 || strcmp(key, "Filter") == 0 || strcmp(key, "DecodeParms") == 0));
+    }
+
+    bool compareDicts(Dict *a, Dict *b, const std::string &path, bool stream)
+    {
+        int keysA = 0;
+        for (int i = 0; i < a->getLength(); ++i) {
+            const char *key = a->getKey(i);
+            if (skipKey(key, stream)) {
+                continue;
+            }
+            ++keysA;
+            if (!b->hasKey(key)) {
+                return fail(path, std::string("a missing /") + key);
+            }
+            if (!compare(a->getValNF(i), b->lookupNF(key), path + "/" + key)) {
+                return false;
+            }
+        }
+        int keysB = 0;
+        for (int i = 0; i < b->getLength(); ++i) {
+            keysB += !skipKey(b->getKey(i), stream);
+        }
+        return keysA == keysB || (addedKeys && keysA < keysB) || fail(path, "dictionaries with different keys");
+    }
+
+    static bool fail(const std::string &path, const std::string &what)
+    {
+        fprintf(stderr, "  %s: %s\n", path.c_str(), what.c_str());
+        return false;
+    }
+
+    XRef *xrefs[2];
+    const bool addedKeys;
+    std::map<int, int> seen;
+};
+
+//------------------------------------------------------------------------
+
+// Checks that every object of <doc> but streams and object <except> is in
+// an object stream, at least <minCompressed> of them, and returns the
+// number of object streams.
+static int checkObjectStreams(PDFDoc *doc, const char *name, int minCompressed, int *numFailures, int except = -1)
+{
+    XRef *xref = doc->getXRef();
+    if (!xref->isXRefStream()) {
+        fprintf(stderr, "%s: has no xref stream\n", name);
+        ++*numFailures;
+        return 0;
+    }
+    int numObjStms = 0, numCompressed = 0;
+    for (int num = 1; num < xref->getNumObjects(); ++num) {
+        const XRefEntry *e = xref->getEntry(num);
+        if (e->type == xrefEntryFree) {
+            continue;
+        }
+        const Object obj = xref->fetch(num, e->type == xrefEntryCompressed ? 0 : e->gen);
+        if (obj.isNull()) {
+            fprintf(stderr, "%s: object %d can't be read\n", name, num);
+            ++*numFailures;
+        } else if (e->type == xrefEntryCompressed) {
+            ++numCompressed;
+        } else if (obj.isStream()) {
+            if (obj.streamGetDict()->is("ObjStm")) {
+                ++numObjStms;
+            }
+        } else if (num != except) {
+            fprintf(stderr, "%s: object %d isn't in an object stream\n", name, num);
+            ++*numFailures;
+        }
+    }
+    if (numCompressed < minCompressed) {
+        fprintf(stderr, "%s: only %d objects are in object streams\n", name, numCompressed);
+        ++*numFailures;
+    }
+    return numObjStms;
+}
+
+// Returns the dictionary of the last xref stream in <data>.
+static std::string lastXRefStreamDict(const std::string &data)
+{
+    const size_t type = data.rfind("/XRef");
+    if (type == std::string::npos) {
+        return std::string();
+    }
+    const size_t start = data.rfind(" obj", type);
+    const size_t end = data.find("stream", type);
+    if (start == std::string::npos || end == std::string::npos) {
+        return std::string();
+    }
+    return data.substr(start, end - start);
+}
+
+static int checkRewrite(const std::string &srcPath, const std::string &outPath, int *numChecks)
+{
+    int numFailures = 0;
+    std::unique_ptr<PDFDoc> src = testOpenPdf(srcPath);
+    ++*numChecks;
+    if (!src || src->saveAs(GooString(outPath), writeForceRewriteCompressed) != errNone) {
+        fprintf(stderr, "rewrite: can't write %s\n", outPath.c_str());
+        return numFailures + 1;
+    }
+    std::unique_ptr<PDFDoc> out = testOpenPdf(outPath);
+    if (!out) {
+        return numFailures + 1;
+    }
+
+    ++*numChecks;
+    const int numObjStms = checkObjectStreams(out.get(), "rewrite", numExtraObjects, &numFailures);
+    if (numObjStms < 3) {
+        fprintf(stderr, "rewrite: %d objects in %d object streams\n", numExtraObjects, numObjStms);
+        ++numFailures;
+    }
+    ++*numChecks;
+    if (lastXRefStreamDict(readFile(outPath)).find("/FlateDecode") == std::string::npos) {
+        fprintf(stderr, "rewrite: the xref stream isn't compressed\n");
+        ++numFailures;
+    }
+    ++*numChecks;
+    ObjectComparer comparer(src->getXRef(), out->getXRef());
+    if (!comparer.compare(src->getXRef()->getTrailerDict()->dictLookupNF("Root"), out->getXRef()->getTrailerDict()->dictLookupNF("Root"), "rewrite: /Root")) {
+        ++numFailures;
+    }
+    return numFailures;
+}
+
+static int checkIncrementalUpdate(const std::string &srcPath, const std::string &outPath, int *numChecks)
+{
+    const std::string original = readFile(srcPath);
+    std::unique_ptr<PDFDoc> doc = testOpenPdf(srcPath);
+    if (!doc) {
+        return 1;
+    }
+    Object extra = doc->getXRef()->getCatalog().dictLookup("Extra");
+    const Ref changedRef = extra.arrayGetNF(5).getRef();
+    Object changed = doc->getXRef()->fetch(changedRef);
+    changed.dictSet("Changed", Object(true));
+    doc->getXRef()->setModifiedObject(&changed, changedRef);
+
+    int numFailures = 0;
+    ++*numChecks;
+    if (doc->saveAs(GooString(outPath), writeForceIncremental) != errNone) {
+        fprintf(stderr, "incremental update: can't write %s\n", outPath.c_str());
+        return numFailures + 1;
+    }
+    const std::string data = readFile(outPath);
+    ++*numChecks;
+    if (data.compare(0, original.size(), original) != 0) {
+        fprintf(stderr, "incremental update: the original file was changed\n");
+        return numFailures + 1;
+    }
+    const std::string xrefDict = lastXRefStreamDict(data.substr(original.size()));
+    ++*numChecks;
+    if (xrefDict.empty() || xrefDict.find("/Filter") != std::string::npos) {
+        fprintf(stderr, "incremental update: %s\n", xrefDict.empty() ? "has no xref stream" : "the xref stream is compressed");
+        ++numFailures;
+    }
+
+    std::unique_ptr<PDFDoc> out = testOpenPdf(outPath);
+    if (!out) {
+        return numFailures + 1;
+    }
+    ++*numChecks;
+    checkObjectStreams(out.get(), "incremental update", numExtraObjects - 1, &numFailures, changedRef.num);
+    ++*numChecks;
+    ObjectComparer comparer(doc->getXRef(), out->getXRef());
+    if (!comparer.compare(doc->getXRef()->getTrailerDict()->dictLookupNF("Root"), out->getXRef()->getTrailerDict()->dictLookupNF("Root"), "incremental update: /Root")) {
+        ++numFailures;
+    }
+    return numFailures;
+}
+
+static int checkPdfunite(const char *pdfunite, const std::string &srcPath, const std::string &outPath, int *numChecks)
+{
+    const std::string command = std::string(pdfunite) + " -compress -deflate \"" + srcPath + "\" \"" + srcPath + "\" \"" + outPath + "\"";
+    int numFailures = 0;
+    ++*numChecks;
+    if (system(command.c_str()) != 0) {
+        fprintf(stderr, "pdfunite: %s failed\n", command.c_str());
+        return numFailures + 1;
+    }
+    std::unique_ptr<PDFDoc> src = testOpenPdf(srcPath);
+    std::unique_ptr<PDFDoc> out = testOpenPdf(outPath);
+    if (!src || !out) {
+        return numFailures + 1;
+    }
+    ++*numChecks;
+    // pdfunite copies the pages only
+    checkObjectStreams(out.get(), "pdfunite", out->getNumPages(), &numFailures);
+    ++*numChecks;
+    if (lastXRefStreamDict(readFile(outPath)).find("/FlateDecode") == std::string::npos) {
+        fprintf(stderr, "pdfunite: the xref stream isn't compressed\n");
+        ++numFailures;
+    }
+    ++*numChecks;
+    if (out->getNumPages() != 2 * src->getNumPages()) {
+        fprintf(stderr, "pdfunite: %d pages instead of %d\n", out->getNumPages(), 2 * src->getNumPages());
+        return numFailures + 1;
+    }
+    for (int page = 1; page <= out->getNumPages(); ++page) {
+        const int srcPage = (page - 1) % src->getNumPages() + 1;
+        ++*numChecks;
+        // pdfunite adds the boxes and /Rotate to the pages
+        ObjectComparer comparer(src->getXRef(), out->getXRef(), true);
+        const Object srcRef(*src->getCatalog()->getPageRef(srcPage));
+        const Object outRef(*out->getCatalog()->getPageRef(page));
+        if (!comparer.compare(srcRef, outRef, "pdfunite: page " + std::to_string(page))) {
+            ++numFailures;
+        }
+    }
+    return numFailures;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 2) {
+        fprintf(stderr, "Usage: object-stream-test [pdfunite]\n");
+        return 1;
+    }
+
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    const std::string srcPath = testTempFileName("object-stream.pdf");
+    const std::string compressedPath = testTempFileName("object-stream-compressed.pdf");
+    const std::string outPath = testTempFileName("object-stream-out.pdf");
+    if (!buildDocument().write(srcPath)) {
+        return 1;
+    }
+
+    int numChecks = 0;
+    int numFailures = checkRewrite(srcPath, compressedPath, &numChecks);
+    numFailures += checkIncrementalUpdate(compressedPath, outPath, &numChecks);
+    if (argc > 1) {
+        numFailures += checkPdfunite(argv[1], srcPath, outPath, &numChecks);
+    }
+    std::remove(srcPath.c_str());
+    std::remove(compressedPath.c_str());
+    std::remove(outPath.c_str());
+
+    printf("%d object stream checks: %d failures\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
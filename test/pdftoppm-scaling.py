@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+#
+# pdftoppm-scaling.py
+#
+# Measures how the rendering time of pdftoppm -j scales with the number of
+# threads.  Every thread count is run several times over the same files and
+# the fastest wall clock time is reported, together with the speedup and
+# parallel efficiency relative to a single thread.
+#
+# This file is licensed under the GPLv2 or later
+#
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def render(pdftoppm, files, jobs, resolution, outdir):
+    start = time.monotonic()
+    for i, path in enumerate(files):
+        root = os.path.join(outdir, 'f%d' % i)
+        subprocess.run([pdftoppm, '-j', str(jobs), '-r', str(resolution), path, root],
+                       check=True, stdout=subprocess.DEVNULL)
+    return time.monotonic() - start
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure the scaling of pdftoppm -j with the number of threads')
+    parser.add_argument('--pdftoppm', default='pdftoppm', help='pdftoppm binary to run (default: pdftoppm in PATH)')
+    parser.add_argument('-j', '--max-jobs', type=int, default=os.cpu_count(), help='highest thread count to measure (default: number of CPUs)')
+    parser.add_argument('-n', '--runs', type=int, default=3, help='runs per thread count, the fastest is reported (default 3)')
+    parser.add_argument('-r', '--resolution', type=int, default=150, help='resolution in DPI (default 150)')
+    parser.add_argument('files', nargs='+', help='PDF files to render')
+    args = parser.parse_args()
+
+    if shutil.which(args.pdftoppm) is None:
+        sys.exit('%s not found' % args.pdftoppm)
+
+    jobs = []
+    j = 1
+    while j < args.max_jobs:
+        jobs.append(j)
+        j *= 2
+    jobs.append(max(args.max_jobs, 1))
+
+    print('%-8s %10s %9s %11s' % ('threads', 'seconds', 'speedup', 'efficiency'))
+    base = None
+    with tempfile.TemporaryDirectory() as outdir:
+        for j in jobs:
+            best = min(render(args.pdftoppm, args.files, j, args.resolution, outdir) for _ in range(args.runs))
+            if base is None:
+                base = best
+            speedup = base / best
+            print('%-8d %10.3f %8.2fx %10.0f%%' % (j, best, speedup, 100 * speedup / j))
+            sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -1,952 +1,691 @@
-/* Copyright Krzysztof Kowalczyk 2006-2007
-   Copyright Hib Eris <hib@hiberis.nl> 2008, 2013
-   Copyright 2018, 2020, 2022 Albert Astals Cid <aacid@kde.org> 2018
-   Copyright 2019 Oliver Sander <oliver.sander@tu-dresden.de>
-   Copyright 2020 Adam Reichold <adam.reichold@t-online.de>
-   Copyright 2024 Vincent Lefevre <vincent@vinc17.net>
-   Copyright 2024 g10 Code GmbH, Author: Sune Stolborg Vuorela <sune@vuorela.dk>
-   License: GPLv2 */
-/*
-  A tool to stress-test poppler rendering and measure rendering times for
-  very simplistic performance measuring.
-
-  TODO:
-   * make it work with cairo output as well
-   * print more info about document like e.g. enumerate images,
-     streams, compression, encryption, password-protection. Each should have
-     a command-line arguments to turn it on/off
-   * never over-write file given as -out argument (optionally, provide -force
-     option to force writing the -out file). It's way too easy too lose results
-     of a previous run.
-*/
-
-#ifdef _MSC_VER
-// this sucks but I don't know any other way
-#    pragma comment(linker, "/manifestdependency:\"type='win32' name='Microsoft.Windows.Common-Controls' version='6.0.0.0' processorArchitecture='x86' publicKeyToken='6595b64144ccf1df' language='*'\"")
-#endif
-
-#include <config.h>
-
-#ifdef _WIN32
-#    include <windows.h>
-#else
-#    include <strings.h>
-#endif
-
-// Define COPY_FILE if you want the file to be copied to a local disk first
-// before it's tested. This is desired if a file is on a slow drive.
-// Currently copying only works on Windows.
-// Not enabled by default.
-// #define COPY_FILE 1
-
-#include <cassert>
-#include <cstdio>
-#include <cstdarg>
+//========================================================================
+//
+// perf-test.cc
+//
+// Renders a corpus of PDF files through one or more output devices and
+// records how long each page takes, so that the numbers of two builds can
+// be compared.  Runs over encrypted and plain copies of the same files can
+// be compared too, if they are started from directories with the same
+// layout.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <cerrno>
 #include <ctime>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
-#ifdef HAVE_DIRENT_H
-#    include <dirent.h>
+#ifdef _WIN32
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#    include <psapi.h>
+#else
+#    include <sys/resource.h>
 #endif
 
-#include "Error.h"
-#include "ErrorCodes.h"
 #include "goo/GooString.h"
-#include "goo/GooTimer.h"
+#include "goo/gfile.h"
+#include "DisplayListOutputDev.h"
 #include "GlobalParams.h"
-#include "splash/SplashBitmap.h"
-#include "Object.h" /* must be included before SplashOutputDev.h because of sloppiness in SplashOutputDev.h */
+#include "PDFDoc.h"
+#include "ProfileData.h"
+#include "PSOutputDev.h"
 #include "SplashOutputDev.h"
 #include "TextOutputDev.h"
-#include "PDFDoc.h"
-#include "Link.h"
+#include "splash/SplashBitmap.h"
+#include "utils/parseargs.h"
 
-#ifdef _MSC_VER
-#    define strdup _strdup
-#    define strcasecmp _stricmp
+#ifdef HAVE_CAIRO
+#    include <cairo.h>
+#    include "CairoFontEngine.h"
+#    include "CairoOutputDev.h"
 #endif
 
-#define dimof(X) (sizeof(X) / sizeof((X)[0]))
-
-#define INVALID_PAGE_NO (-1)
-
-/* Those must be implemented in order to provide preview during execution.
-   They can be no-ops. An implementation for windows is in
-   perf-test-preview-win.cc
-*/
-extern void PreviewBitmapInit();
-extern void PreviewBitmapDestroy();
-extern void PreviewBitmapSplash(SplashBitmap *bmpSplash);
-
-class PdfEnginePoppler
-{
-public:
-    PdfEnginePoppler();
-    ~PdfEnginePoppler();
-
-    PdfEnginePoppler(const PdfEnginePoppler &) = delete;
-    PdfEnginePoppler &operator=(const PdfEnginePoppler &) = delete;
-
-    const char *fileName() const { return _fileName; };
-
-    void setFileName(const char *fileName)
-    {
-        assert(!_fileName);
-        _fileName = (char *)strdup(fileName);
-    }
-
-    int pageCount() const { return _pageCount; }
+static char backendList[256] = "splash";
+static double resolution = 150;
+static int numRuns = 1;
+static int maxPages = 0;
+static bool profilePhases = false;
+static char jsonFileName[1024] = "";
+static char csvFileName[1024] = "";
+static bool compareMode = false;
+static double threshold = 5;
+static bool quiet = false;
+static char ownerPassword[33] = "\001";
+static char userPassword[33] = "\001";
+static bool printHelp = false;
 
-    bool load(const char *fileName);
-    SplashBitmap *renderBitmap(int pageNo, double zoomReal, int rotation);
+static const ArgDesc argDesc[] = { { "-backend", argString, backendList, sizeof(backendList), "comma separated output devices: splash, displaylist, cairo, text, ps (default splash)" },
+                                   { "-r", argFP, &resolution, 0, "resolution for splash and cairo, in DPI (default 150)" },
+                                   { "-n", argInt, &numRuns, 0, "number of runs, the fastest of which is reported (default 1)" },
+                                   { "-l", argInt, &maxPages, 0, "maximum number of pages per file (default all)" },
+                                   { "-phases", argFlag, &profilePhases, 0, "time the text, path, XObject and other content operators" },
+                                   { "-json", argString, jsonFileName, sizeof(jsonFileName), "write the results to a JSON file" },
+                                   { "-csv", argString, csvFileName, sizeof(csvFileName), "write the results to a CSV file" },
+                                   { "-compare", argFlag, &compareMode, 0, "compare two CSV files written by -csv" },
+                                   { "-threshold", argFP, &threshold, 0, "percentage a file may get slower before -compare reports it (default 5)" },
+                                   { "-q", argFlag, &quiet, 0, "don't print per file results" },
+                                   { "-opw", argString, ownerPassword, sizeof(ownerPassword), "owner password (for encrypted files)" },
+                                   { "-upw", argString, userPassword, sizeof(userPassword), "user password (for encrypted files)" },
+                                   { "-h", argFlag, &printHelp, 0, "print usage information" },
+                                   { "-help", argFlag, &printHelp, 0, "print usage information" },
+                                   { "--help", argFlag, &printHelp, 0, "print usage information" },
+                                   { "-?", argFlag, &printHelp, 0, "print usage information" },
+                                   {} };
 
-    SplashOutputDev *outputDevice();
+//------------------------------------------------------------------------
+// allocation counting
+//------------------------------------------------------------------------
 
-private:
-    char *_fileName;
-    int _pageCount;
-
-    PDFDoc *_pdfDoc;
-    SplashOutputDev *_outputDev;
-};
-
-typedef struct StrList
-{
-    struct StrList *next;
-    char *str;
-} StrList;
-
-/* List of all command-line arguments that are not switches.
-   We assume those are:
-     - names of PDF files
-     - names of a file with a list of PDF files
-     - names of directories with PDF files
-*/
-static StrList *gArgsListRoot = nullptr;
-
-/* Names of all command-line switches we recognize */
-#define TIMINGS_ARG "-timings"
-#define RESOLUTION_ARG "-resolution"
-#define RECURSIVE_ARG "-recursive"
-#define OUT_ARG "-out"
-#define PREVIEW_ARG "-preview"
-#define SLOW_PREVIEW_ARG "-slowpreview"
-#define LOAD_ONLY_ARG "-loadonly"
-#define PAGE_ARG "-page"
-#define TEXT_ARG "-text"
-
-/* Should we record timings? True if -timings command-line argument was given. */
-static bool gfTimings = false;
-
-/* If true, we use render each page at resolution 'gResolutionX'/'gResolutionY'.
-   If false, we render each page at its native resolution.
-   True if -resolution NxM command-line argument was given. */
-static bool gfForceResolution = false;
-static int gResolutionX = 0;
-static int gResolutionY = 0;
-/* If NULL, we output the log info to stdout. If not NULL, should be a name
-   of the file to which we output log info.
-   Controlled by -out command-line argument. */
-static char *gOutFileName = nullptr;
-/* FILE * corresponding to gOutFileName or stdout if gOutFileName is NULL or
-   was invalid name */
-static FILE *gOutFile = nullptr;
-/* FILE * corresponding to gOutFileName or stderr if gOutFileName is NULL or
-   was invalid name */
-static FILE *gErrFile = nullptr;
-
-/* If True and a directory is given as a command-line argument, we'll process
-   pdf files in sub-directories as well.
-   Controlled by -recursive command-line argument */
-static bool gfRecursive = false;
-
-/* If true, preview rendered image. To make sure that they're being rendered correctly. */
-static bool gfPreview = false;
-
-/* 1 second (1000 milliseconds) */
-#define SLOW_PREVIEW_TIME 1000
-
-/* If true, preview rendered image in a slow mode i.e. delay displaying for
-   SLOW_PREVIEW_TIME. This is so that a human has enough time to see if the
-   PDF renders ok. In release mode on fast processor pages take only ~100-200 ms
-   to render and they go away too quickly to be inspected by a human. */
-static bool gfSlowPreview = false;
-
-/* If true, we only dump the text, not render */
-static bool gfTextOnly = false;
-
-#define PAGE_NO_NOT_GIVEN (-1)
-
-/* If equals PAGE_NO_NOT_GIVEN, we're in default mode where we render all pages.
-   If different, will only render this page */
-static int gPageNo = PAGE_NO_NOT_GIVEN;
-/* If true, will only load the file, not render any pages. Mostly for
-   profiling load time */
-static bool gfLoadOnly = false;
-
-#define PDF_FILE_DPI 72
-
-#define MAX_FILENAME_SIZE 1024
-
-/* DOS is 0xd 0xa */
-#define DOS_NEWLINE "\x0d\x0a"
-/* Mac is single 0xd */
-#define MAC_NEWLINE "\x0d"
-/* Unix is single 0xa (10) */
-#define UNIX_NEWLINE "\x0a"
-#define UNIX_NEWLINE_C 0xa
-
-static void memzero(void *data, size_t len)
-{
-    memset(data, 0, len);
-}
+// Counts calls to operator new, in this program and in libpoppler.  Memory
+// allocated with gmalloc() isn't counted.
+static std::atomic<uint64_t> allocCount(0);
 
-static void *zmalloc(size_t len)
+void *operator new(size_t size)
 {
-    void *data = malloc(len);
-    if (data) {
-        memzero(data, len);
+    ++allocCount;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        // poppler is built without exceptions
+        fprintf(stderr, "Out of memory\n");
+        abort();
     }
-    return data;
+    return p;
 }
 
-/* Concatenate 4 strings. Any string can be NULL.
-   Caller needs to free() memory. */
-static char *str_cat4(const char *str1, const char *str2, const char *str3, const char *str4)
+void *operator new[](size_t size)
 {
-    char *str;
-    char *tmp;
-    size_t str1_len = 0;
-    size_t str2_len = 0;
-    size_t str3_len = 0;
-    size_t str4_len = 0;
-
-    if (str1) {
-        str1_len = strlen(str1);
-    }
-    if (str2) {
-        str2_len = strlen(str2);
-    }
-    if (str3) {
-        str3_len = strlen(str3);
-    }
-    if (str4) {
-        str4_len = strlen(str4);
-    }
-
-    str = (char *)zmalloc(str1_len + str2_len + str3_len + str4_len + 1);
-    if (!str) {
-        return nullptr;
-    }
-
-    tmp = str;
-    if (str1) {
-        memcpy(tmp, str1, str1_len);
-        tmp += str1_len;
-    }
-    if (str2) {
-        memcpy(tmp, str2, str2_len);
-        tmp += str2_len;
-    }
-    if (str3) {
-        memcpy(tmp, str3, str3_len);
-        tmp += str3_len;
-    }
-    if (str4) {
-        memcpy(tmp, str4, str1_len);
-    }
-    return str;
+    return operator new(size);
 }
 
-static char *str_dup(const char *str)
+void operator delete(void *p) noexcept
 {
-    return str_cat4(str, nullptr, nullptr, nullptr);
+    free(p);
 }
 
-static bool str_eq(const char *str1, const char *str2)
+void operator delete[](void *p) noexcept
 {
-    if (!str1 && !str2) {
-        return true;
-    }
-    if (!str1 || !str2) {
-        return false;
-    }
-    if (0 == strcmp(str1, str2)) {
-        return true;
-    }
-    return false;
+    free(p);
 }
 
-static bool str_ieq(const char *str1, const char *str2)
+void operator delete(void *p, size_t /*size*/) noexcept
 {
-    if (!str1 && !str2) {
-        return true;
-    }
-    if (!str1 || !str2) {
-        return false;
-    }
-    if (0 == strcasecmp(str1, str2)) {
-        return true;
-    }
-    return false;
+    free(p);
 }
 
-static bool str_endswith(const char *txt, const char *end)
+void operator delete[](void *p, size_t /*size*/) noexcept
 {
-    size_t end_len;
-    size_t txt_len;
-
-    if (!txt || !end) {
-        return false;
-    }
-
-    txt_len = strlen(txt);
-    end_len = strlen(end);
-    if (end_len > txt_len) {
-        return false;
-    }
-    if (str_eq(txt + txt_len - end_len, end)) {
-        return true;
-    }
-    return false;
+    free(p);
 }
 
-/* TODO: probably should move to some other file and change name to
-   sleep_milliseconds */
-static void sleep_milliseconds(int milliseconds)
+//------------------------------------------------------------------------
+// measurements
+//------------------------------------------------------------------------
+
+// Peak resident set size of the process so far, in KiB.
+static long getPeakRSS()
 {
 #ifdef _WIN32
-    Sleep((DWORD)milliseconds);
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return (long)(counters.PeakWorkingSetSize / 1024);
+    }
+    return 0;
 #else
-    struct timespec tv;
-    int secs, nanosecs;
-    secs = milliseconds / 1000;
-    nanosecs = (milliseconds - (secs * 1000)) * 1000;
-    tv.tv_sec = (time_t)secs;
-    tv.tv_nsec = (long)nanosecs;
-    while (true) {
-        int rval = nanosleep(&tv, &tv);
-        if (rval == 0) {
-            /* Completed the entire sleep time; all done. */
-            return;
-        } else if (errno == EINTR) {
-            /* Interrupted by a signal. Try again. */
-            continue;
-        } else {
-            /* Some other error; bail out. */
-            return;
-        }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#    ifdef __APPLE__
+        return usage.ru_maxrss / 1024;
+#    else
+        return usage.ru_maxrss;
+#    endif
     }
+    return 0;
 #endif
 }
 
-static SplashColorMode gSplashColorMode = splashModeBGR8;
-
-static SplashColor splashColRed;
-static SplashColor splashColGreen;
-static SplashColor splashColBlue;
-static SplashColor splashColWhite;
-static SplashColor splashColBlack;
-
-#define SPLASH_COL_RED_PTR ((SplashColorPtr) & (splashColRed[0]))
-#define SPLASH_COL_GREEN_PTR ((SplashColorPtr) & (splashColGreen[0]))
-#define SPLASH_COL_BLUE_PTR ((SplashColorPtr) & (splashColBlue[0]))
-#define SPLASH_COL_WHITE_PTR ((SplashColorPtr) & (splashColWhite[0]))
-#define SPLASH_COL_BLACK_PTR ((SplashColorPtr) & (splashColBlack[0]))
+enum Phase
+{
+    phaseText, // text operators, including loading fonts
+    phasePath, // path construction and painting, clipping, shading
+    phaseXObject, // images and XObjects, including everything forms draw
+    phaseOther,
+    numPhases
+};
 
-static SplashColorPtr gBgColor = SPLASH_COL_WHITE_PTR;
+static const char *phaseNames[numPhases] = { "text", "path", "xobject", "other" };
+
+static Phase getPhase(const std::string &op)
+{
+    static const std::unordered_map<std::string, Phase> phases = {
+        { "BT", phaseText }, { "ET", phaseText }, { "Tc", phaseText }, { "Td", phaseText }, { "TD", phaseText }, { "Tf", phaseText }, { "Tj", phaseText },  { "TJ", phaseText },     { "TL", phaseText },     { "Tm", phaseText },
+        { "Tr", phaseText }, { "Ts", phaseText }, { "Tw", phaseText }, { "Tz", phaseText }, { "T*", phaseText }, { "'", phaseText },  { "\"", phaseText }, { "d0", phaseText },     { "d1", phaseText },     { "m", phasePath },
+        { "l", phasePath },  { "c", phasePath },  { "v", phasePath },  { "y", phasePath },  { "h", phasePath },  { "re", phasePath }, { "f", phasePath },  { "F", phasePath },      { "f*", phasePath },     { "S", phasePath },
+        { "s", phasePath },  { "B", phasePath },  { "B*", phasePath }, { "b", phasePath },  { "b*", phasePath }, { "n", phasePath },  { "W", phasePath },  { "W*", phasePath },     { "sh", phasePath },     { "Do", phaseXObject },
+        { "BI", phaseXObject }
+    };
+    auto it = phases.find(op);
+    return it == phases.end() ? phaseOther : it->second;
+}
+
+// One page rendered by one output device.  Page 0 stands for the work
+// done once per document: opening it (backend "open") or setting up the
+// output device.
+struct Result
+{
+    std::string file;
+    std::string backend;
+    int page;
+    double wallMs;
+    double cpuMs;
+    uint64_t allocs;
+    long peakRSS;
+    double phaseMs[numPhases];
+};
 
-static void splashColorSet(SplashColorPtr col, unsigned char red, unsigned char green, unsigned char blue, unsigned char alpha)
+// Measures one step and appends its result.
+class Measurement
 {
-    switch (gSplashColorMode) {
-    case splashModeBGR8:
-        col[0] = blue;
-        col[1] = green;
-        col[2] = red;
-        break;
-    case splashModeRGB8:
-        col[0] = red;
-        col[1] = green;
-        col[2] = blue;
-        break;
-    default:
-        assert(0);
-        break;
+public:
+    Measurement(std::vector<Result> *resultsA, const std::string &file, const std::string &backend, int page, OutputDev *outA) : results(resultsA), out(outA)
+    {
+        result.file = file;
+        result.backend = backend;
+        result.page = page;
+        std::fill(result.phaseMs, result.phaseMs + numPhases, 0.0);
+        if (out && profilePhases) {
+            out->startProfile();
+        }
+        allocs0 = allocCount;
+        cpu0 = std::clock();
+        wall0 = std::chrono::steady_clock::now();
     }
-}
 
-static void SplashColorsInit()
-{
-    splashColorSet(SPLASH_COL_RED_PTR, 0xff, 0, 0, 0);
-    splashColorSet(SPLASH_COL_GREEN_PTR, 0, 0xff, 0, 0);
-    splashColorSet(SPLASH_COL_BLUE_PTR, 0, 0, 0xff, 0);
-    splashColorSet(SPLASH_COL_BLACK_PTR, 0, 0, 0, 0);
-    splashColorSet(SPLASH_COL_WHITE_PTR, 0xff, 0xff, 0xff, 0);
-}
+    ~Measurement()
+    {
+        result.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall0).count();
+        result.cpuMs = 1000.0 * (double)(std::clock() - cpu0) / CLOCKS_PER_SEC;
+        result.allocs = allocCount - allocs0;
+        result.peakRSS = getPeakRSS();
+        if (out && profilePhases) {
+            if (auto hash = out->endProfile()) {
+                for (const auto &[op, data] : *hash) {
+                    result.phaseMs[getPhase(op)] += 1000.0 * data.getTotal();
+                }
+            }
+        }
+        results->push_back(result);
+    }
 
-PdfEnginePoppler::PdfEnginePoppler() : _fileName(nullptr), _pageCount(INVALID_PAGE_NO), _pdfDoc(nullptr), _outputDev(nullptr) { }
+    Measurement(const Measurement &) = delete;
+    Measurement &operator=(const Measurement &) = delete;
 
-PdfEnginePoppler::~PdfEnginePoppler()
-{
-    free(_fileName);
-    delete _outputDev;
-    delete _pdfDoc;
-}
+private:
+    std::vector<Result> *results;
+    OutputDev *out;
+    Result result;
+    uint64_t allocs0;
+    std::clock_t cpu0;
+    std::chrono::steady_clock::time_point wall0;
+};
 
-bool PdfEnginePoppler::load(const char *fileName)
-{
-    setFileName(fileName);
+//------------------------------------------------------------------------
+// rendering
+//------------------------------------------------------------------------
 
-    _pdfDoc = new PDFDoc(std::make_unique<GooString>(fileName));
-    if (!_pdfDoc->isOk()) {
-        return false;
-    }
-    _pageCount = _pdfDoc->getNumPages();
-    return true;
+static int getNumPagesToRender(PDFDoc *doc)
+{
+    const int numPages = doc->getNumPages();
+    return maxPages > 0 ? std::min(numPages, maxPages) : numPages;
 }
 
-SplashOutputDev *PdfEnginePoppler::outputDevice()
+static void runSplash(PDFDoc *doc, const std::string &file, std::vector<Result> *results)
 {
-    if (!_outputDev) {
-        bool bitmapTopDown = true;
-        _outputDev = new SplashOutputDev(gSplashColorMode, 4, false, gBgColor, bitmapTopDown);
-        if (_outputDev) {
-            _outputDev->startDoc(_pdfDoc);
+    SplashColor paperColor = { 0xff, 0xff, 0xff };
+    SplashOutputDev out(splashModeRGB8, 4, false, paperColor);
+    {
+        Measurement m(results, file, "splash", 0, nullptr);
+        out.startDoc(doc);
+    }
+    for (int page = 1; page <= getNumPagesToRender(doc); ++page) {
+        Measurement m(results, file, "splash", page, &out);
+        doc->displayPage(&out, page, resolution, resolution, 0, false, true, false);
+    }
+}
+
+// Records every page into a display list ("displaylist-record") and
+// renders it from there with Splash ("displaylist"), the cost of drawing a
+// page again without interpreting its content stream.
+static void runDisplayList(PDFDoc *doc, const std::string &file, std::vector<Result> *results)
+{
+    SplashColor paperColor = { 0xff, 0xff, 0xff };
+    SplashOutputDev out(splashModeRGB8, 4, false, paperColor);
+    out.startDoc(doc);
+    DisplayListOutputDev recorder;
+    for (int page = 1; page <= getNumPagesToRender(doc); ++page) {
+        std::unique_ptr<DisplayList> list;
+        {
+            Measurement m(results, file, "displaylist-record", page, &recorder);
+            doc->displayPage(&recorder, page, resolution, resolution, 0, false, true, false);
+            list = recorder.takeDisplayList();
+        }
+        if (list) {
+            Measurement m(results, file, "displaylist", page, nullptr);
+            list->replay(&out, resolution, resolution);
         }
     }
-    return _outputDev;
 }
 
-SplashBitmap *PdfEnginePoppler::renderBitmap(int pageNo, double zoomReal, int rotation)
+static void runText(PDFDoc *doc, const std::string &file, std::vector<Result> *results)
 {
-    assert(outputDevice());
-    if (!outputDevice()) {
-        return nullptr;
+    TextOutputDev out(nullptr, false, 0, false, false);
+    for (int page = 1; page <= getNumPagesToRender(doc); ++page) {
+        Measurement m(results, file, "text", page, &out);
+        doc->displayPage(&out, page, 72, 72, 0, false, true, false);
     }
-
-    double hDPI = (double)PDF_FILE_DPI * zoomReal * 0.01;
-    double vDPI = (double)PDF_FILE_DPI * zoomReal * 0.01;
-    bool useMediaBox = false;
-    bool crop = true;
-    bool doLinks = true;
-    _pdfDoc->displayPage(_outputDev, pageNo, hDPI, vDPI, rotation, useMediaBox, crop, doLinks, nullptr, nullptr);
-
-    SplashBitmap *bmp = _outputDev->takeBitmap();
-    return bmp;
 }
 
-static int StrList_Len(StrList **root)
-{
-    int len = 0;
-    StrList *cur;
-    assert(root);
-    if (!root) {
-        return 0;
-    }
-    cur = *root;
-    while (cur) {
-        ++len;
-        cur = cur->next;
-    }
-    return len;
-}
+static void discardOutput(void * /*stream*/, const char * /*data*/, size_t /*len*/) { }
 
-static int StrList_InsertAndOwn(StrList **root, char *txt)
+static void runPS(PDFDoc *doc, const std::string &file, std::vector<Result> *results)
 {
-    StrList *el;
-    assert(root && txt);
-    if (!root || !txt) {
-        return false;
+    std::vector<int> pages;
+    for (int page = 1; page <= getNumPagesToRender(doc); ++page) {
+        pages.push_back(page);
     }
-
-    el = (StrList *)malloc(sizeof(StrList));
-    if (!el) {
-        return false;
+    std::unique_ptr<PSOutputDev> out;
+    {
+        // the prolog sets up the fonts of all pages
+        Measurement m(results, file, "ps", 0, nullptr);
+        out = std::make_unique<PSOutputDev>(&discardOutput, nullptr, nullptr, doc, pages, psModePS);
+    }
+    if (!out->isOk()) {
+        return;
+    }
+    for (int page : pages) {
+        Measurement m(results, file, "ps", page, out.get());
+        doc->displayPage(out.get(), page, 72, 72, 0, false, true, true);
     }
-    el->str = txt;
-    el->next = *root;
-    *root = el;
-    return true;
 }
 
-static int StrList_Insert(StrList **root, char *txt)
+#ifdef HAVE_CAIRO
+static void runCairo(PDFDoc *doc, const std::string &file, std::vector<Result> *results)
 {
-    char *txtDup;
-
-    assert(root && txt);
-    if (!root || !txt) {
-        return false;
+    static FT_Library ftLib = nullptr;
+    if (!ftLib) {
+        FT_Init_FreeType(&ftLib);
     }
-    txtDup = str_dup(txt);
-    if (!txtDup) {
-        return false;
-    }
-
-    if (!StrList_InsertAndOwn(root, txtDup)) {
-        free((void *)txtDup);
-        return false;
+    CairoFontEngine fontEngine(ftLib);
+    CairoOutputDev out;
+    {
+        Measurement m(results, file, "cairo", 0, nullptr);
+        out.startDoc(doc, &fontEngine);
+    }
+    for (int page = 1; page <= getNumPagesToRender(doc); ++page) {
+        Measurement m(results, file, "cairo", page, &out);
+        const double width = doc->getPageMediaWidth(page) * resolution / 72.0;
+        const double height = doc->getPageMediaHeight(page) * resolution / 72.0;
+        cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, (int)ceil(width), (int)ceil(height));
+        cairo_t *cr = cairo_create(surface);
+        out.setCairo(cr);
+        out.setPrinting(false);
+        cairo_scale(cr, resolution / 72.0, resolution / 72.0);
+        doc->displayPageSlice(&out, page, 72, 72, 0, true, false, false, -1, -1, -1, -1);
+        out.setCairo(nullptr);
+        cairo_destroy(cr);
+        cairo_surface_destroy(surface);
     }
-    return true;
 }
+#endif
 
-static void StrList_FreeElement(StrList *el)
-{
-    if (!el) {
-        return;
+using BackendFunc = void (*)(PDFDoc *doc, const std::string &file, std::vector<Result> *results);
+
+static BackendFunc getBackend(const std::string &name)
+{
+    if (name == "splash") {
+        return &runSplash;
+    } else if (name == "displaylist") {
+        return &runDisplayList;
+    } else if (name == "text") {
+        return &runText;
+    } else if (name == "ps") {
+        return &runPS;
+#ifdef HAVE_CAIRO
+    } else if (name == "cairo") {
+        return &runCairo;
+#endif
     }
-    free((void *)el->str);
-    free((void *)el);
+    return nullptr;
 }
 
-static void StrList_Destroy(StrList **root)
+static void runFile(const std::string &file, const std::vector<std::string> &backends, std::vector<Result> *results)
 {
-    StrList *cur;
-    StrList *next;
-
-    if (!root) {
-        return;
+    std::optional<GooString> ownerPW, userPW;
+    if (ownerPassword[0] != '\001') {
+        ownerPW = GooString(ownerPassword);
     }
-    cur = *root;
-    while (cur) {
-        next = cur->next;
-        StrList_FreeElement(cur);
-        cur = next;
+    if (userPassword[0] != '\001') {
+        userPW = GooString(userPassword);
     }
-    *root = nullptr;
-}
-
-static void my_error(ErrorCategory, Goffset pos, const char *msg)
-{
-#if 0
-    char        buf[4096], *p = buf;
 
-    // NB: this can be called before the globalParams object is created
-    if (globalParams && globalParams->getErrQuiet()) {
+    std::unique_ptr<PDFDoc> doc;
+    {
+        // checking the password is part of opening the document
+        Measurement m(results, file, "open", 0, nullptr);
+        doc = std::make_unique<PDFDoc>(std::make_unique<GooString>(file), ownerPW, userPW);
+        // reading the page tree is part of opening the document
+        if (doc->isOk()) {
+            doc->getNumPages();
+        }
+    }
+    if (!doc->isOk()) {
+        fprintf(stderr, "Error opening PDF file %s\n", file.c_str());
+        results->pop_back();
         return;
     }
-
-    if (pos >= 0) {
-      p += _snprintf(p, sizeof(buf)-1, "Error (%lld): ", (long long)pos);
-        *p   = '\0';
-        OutputDebugString(p);
-    } else {
-        OutputDebugString("Error: ");
-    }
-
-    p = buf;
-    p += vsnprintf(p, sizeof(buf) - 1, msg, args);
-    while ( p > buf  &&  isspace(p[-1]) )
-            *--p = '\0';
-    *p++ = '\r';
-    *p++ = '\n';
-    *p   = '\0';
-    OutputDebugString(buf);
-
-    if (pos >= 0) {
-        p += _snprintf(p, sizeof(buf)-1, "Error (%lld): ", (long long)pos);
-        *p   = '\0';
-        OutputDebugString(buf);
-        if (gErrFile)
-            fprintf(gErrFile, buf);
-    } else {
-        OutputDebugString("Error: ");
-        if (gErrFile)
-            fprintf(gErrFile, "Error: ");
+    for (const std::string &backend : backends) {
+        getBackend(backend)(doc.get(), file, results);
     }
-#endif
-#if 0
-    p = buf;
-    va_start(args, msg);
-    p += vsnprintf(p, sizeof(buf) - 3, msg, args);
-    while ( p > buf  &&  isspace(p[-1]) )
-            *--p = '\0';
-    *p++ = '\r';
-    *p++ = '\n';
-    *p   = '\0';
-    OutputDebugString(buf);
-    if (gErrFile)
-        fprintf(gErrFile, buf);
-    va_end(args);
-#endif
 }
 
-static void LogInfo(const char *fmt, ...) GCC_PRINTF_FORMAT(1, 2);
+//------------------------------------------------------------------------
+// output
+//------------------------------------------------------------------------
 
-static void LogInfo(const char *fmt, ...)
+static std::string csvQuote(const std::string &s)
 {
-    va_list args;
-    char buf[4096], *p = buf;
-
-    p = buf;
-    va_start(args, fmt);
-    p += vsnprintf(p, sizeof(buf) - 1, fmt, args);
-    *p = '\0';
-    fprintf(gOutFile, "%s", buf);
-    va_end(args);
-    fflush(gOutFile);
-}
-
-static void PrintUsageAndExit(int argc, char **argv)
-{
-    printf("Usage: pdftest [-preview|-slowpreview] [-loadonly] [-timings] [-text] [-resolution NxM] [-recursive] [-page N] [-out out.txt] pdf-files-to-process\n");
-    for (int i = 0; i < argc; i++) {
-        printf("i=%d, '%s'\n", i, argv[i]);
+    std::string quoted = "\"";
+    for (char c : s) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
     }
-    exit(0);
+    return quoted + "\"";
 }
 
-static bool ShowPreview()
+static std::string jsonQuote(const std::string &s)
 {
-    if (gfPreview || gfSlowPreview) {
-        return true;
+    std::string quoted = "\"";
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += (char)c;
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            quoted += buf;
+        } else {
+            quoted += (char)c;
+        }
     }
-    return false;
+    return quoted + "\"";
 }
 
-static void RenderPdfAsText(const char *fileName)
+static bool writeCSV(const char *fileName, const std::vector<Result> &results)
 {
-    PDFDoc *pdfDoc = nullptr;
-    int pageCount;
-    double timeInMs;
-
-    assert(fileName);
-    if (!fileName) {
-        return;
-    }
-
-    LogInfo("started: %s\n", fileName);
-
-    TextOutputDev *textOut = new TextOutputDev(nullptr, true, 0, false, false);
-    if (!textOut->isOk()) {
-        delete textOut;
-        return;
+    FILE *f = openFile(fileName, "wb");
+    if (!f) {
+        fprintf(stderr, "Couldn't open %s\n", fileName);
+        return false;
     }
-
-    GooTimer msTimer;
-    pdfDoc = new PDFDoc(std::make_unique<GooString>(fileName));
-    if (!pdfDoc->isOk()) {
-        error(errIO, -1, "RenderPdfFile(): failed to open PDF file {0:s}", fileName);
-        goto Exit;
+    fprintf(f, "file,backend,page,wall_ms,cpu_ms,allocs,peak_rss_kb");
+    for (const char *name : phaseNames) {
+        fprintf(f, ",%s_ms", name);
     }
-
-    msTimer.stop();
-    timeInMs = msTimer.getElapsed();
-    LogInfo("load: %.2f ms\n", timeInMs);
-
-    pageCount = pdfDoc->getNumPages();
-    LogInfo("page count: %d\n", pageCount);
-
-    for (int curPage = 1; curPage <= pageCount; curPage++) {
-        if ((gPageNo != PAGE_NO_NOT_GIVEN) && (gPageNo != curPage)) {
-            continue;
-        }
-
-        msTimer.start();
-        int rotate = 0;
-        bool useMediaBox = false;
-        bool crop = true;
-        bool doLinks = false;
-        pdfDoc->displayPage(textOut, curPage, 72, 72, rotate, useMediaBox, crop, doLinks);
-        GooString txt = textOut->getText(0.0, 0.0, 10000.0, 10000.0);
-        msTimer.stop();
-        timeInMs = msTimer.getElapsed();
-        if (gfTimings) {
-            LogInfo("page %d: %.2f ms\n", curPage, timeInMs);
+    fprintf(f, "\n");
+    for (const Result &r : results) {
+        fprintf(f, "%s,%s,%d,%.3f,%.3f,%llu,%ld", csvQuote(r.file).c_str(), r.backend.c_str(), r.page, r.wallMs, r.cpuMs, (unsigned long long)r.allocs, r.peakRSS);
+        for (double ms : r.phaseMs) {
+            fprintf(f, ",%.3f", ms);
         }
-        printf("%s\n", txt.c_str());
+        fprintf(f, "\n");
     }
-
-Exit:
-    LogInfo("finished: %s\n", fileName);
-    delete textOut;
-    delete pdfDoc;
+    fclose(f);
+    return true;
 }
 
-#ifdef _MSC_VER
-#    define POPPLER_TMP_NAME "c:\\poppler_tmp.pdf"
-#else
-#    define POPPLER_TMP_NAME "/tmp/poppler_tmp.pdf"
-#endif
-
-static void RenderPdf(const char *fileName)
+static bool writeJSON(const char *fileName, const std::vector<Result> &results)
 {
-    const char *fileNameSplash = nullptr;
-    PdfEnginePoppler *engineSplash = nullptr;
-    int pageCount;
-    double timeInMs;
-
-#ifdef COPY_FILE
-    // TODO: fails if file already exists and has read-only attribute
-    CopyFile(fileName, POPPLER_TMP_NAME, false);
-    fileNameSplash = POPPLER_TMP_NAME;
-#else
-    fileNameSplash = fileName;
-#endif
-    LogInfo("started: %s\n", fileName);
-
-    engineSplash = new PdfEnginePoppler();
-
-    GooTimer msTimer;
-    if (!engineSplash->load(fileNameSplash)) {
-        LogInfo("failed to load splash\n");
-        goto Error;
-    }
-    msTimer.stop();
-    timeInMs = msTimer.getElapsed();
-    LogInfo("load splash: %.2f ms\n", timeInMs);
-    pageCount = engineSplash->pageCount();
-
-    LogInfo("page count: %d\n", pageCount);
-    if (gfLoadOnly) {
-        goto Error;
+    FILE *f = openFile(fileName, "wb");
+    if (!f) {
+        fprintf(stderr, "Couldn't open %s\n", fileName);
+        return false;
     }
-
-    for (int curPage = 1; curPage <= pageCount; curPage++) {
-        if ((gPageNo != PAGE_NO_NOT_GIVEN) && (gPageNo != curPage)) {
-            continue;
-        }
-
-        SplashBitmap *bmpSplash = nullptr;
-
-        GooTimer msRenderTimer;
-        bmpSplash = engineSplash->renderBitmap(curPage, 100.0, 0);
-        msRenderTimer.stop();
-        timeInMs = msRenderTimer.getElapsed();
-        if (gfTimings) {
-            if (!bmpSplash) {
-                LogInfo("page splash %d: failed to render\n", curPage);
-            } else {
-                LogInfo("page splash %d (%dx%d): %.2f ms\n", curPage, bmpSplash->getWidth(), bmpSplash->getHeight(), timeInMs);
+    fprintf(f, "{\n  \"resolution\": %g,\n  \"runs\": %d,\n  \"results\": [", resolution, numRuns);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        fprintf(f, "%s\n    { \"file\": %s, \"backend\": %s, \"page\": %d, \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"allocs\": %llu, \"peak_rss_kb\": %ld", i ? "," : "", jsonQuote(r.file).c_str(), jsonQuote(r.backend).c_str(), r.page, r.wallMs,
+                r.cpuMs, (unsigned long long)r.allocs, r.peakRSS);
+        if (profilePhases) {
+            fprintf(f, ", \"phases_ms\": {");
+            for (int p = 0; p < numPhases; ++p) {
+                fprintf(f, "%s \"%s\": %.3f", p ? "," : "", phaseNames[p], r.phaseMs[p]);
             }
+            fprintf(f, " }");
         }
-
-        if (ShowPreview()) {
-            PreviewBitmapSplash(bmpSplash);
-            if (gfSlowPreview) {
-                sleep_milliseconds(SLOW_PREVIEW_TIME);
-            }
-        }
-        delete bmpSplash;
+        fprintf(f, " }");
     }
-Error:
-    delete engineSplash;
-    LogInfo("finished: %s\n", fileName);
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    return true;
 }
 
-static void RenderFile(const char *fileName)
+// Total wall time per file and backend, in the order they were run.
+static std::vector<std::pair<std::string, double>> getTotals(const std::vector<Result> &results)
 {
-    if (gfTextOnly) {
-        RenderPdfAsText(fileName);
-        return;
+    std::vector<std::pair<std::string, double>> totals;
+    std::map<std::string, size_t> index;
+    for (const Result &r : results) {
+        const std::string key = r.file + " [" + r.backend + "]";
+        auto it = index.find(key);
+        if (it == index.end()) {
+            it = index.emplace(key, totals.size()).first;
+            totals.emplace_back(key, 0.0);
+        }
+        totals[it->second].second += r.wallMs;
     }
-
-    RenderPdf(fileName);
+    return totals;
 }
 
-static bool ParseInteger(const char *start, const char *end, int *intOut)
-{
-    char numBuf[16];
-    int digitsCount;
-    const char *tmp;
+//------------------------------------------------------------------------
+// comparing runs
+//------------------------------------------------------------------------
 
-    assert(start && end && intOut);
-    assert(end >= start);
-    if (!start || !end || !intOut || (start > end)) {
+static bool readCSV(const char *fileName, std::vector<Result> *results)
+{
+    FILE *f = openFile(fileName, "rb");
+    if (!f) {
+        fprintf(stderr, "Couldn't open %s\n", fileName);
         return false;
     }
-
-    digitsCount = 0;
-    tmp = start;
-    while (tmp <= end) {
-        if (isspace(*tmp)) {
-            /* do nothing, we allow whitespace */
-        } else if (!isdigit(*tmp)) {
-            return false;
+    std::string line;
+    bool header = true;
+    int c;
+    do {
+        c = fgetc(f);
+        if (c != '\n' && c != EOF) {
+            line += (char)c;
+            continue;
         }
-        numBuf[digitsCount] = *tmp;
-        ++digitsCount;
-        if (digitsCount == dimof(numBuf) - 3) { /* -3 to be safe */
+        if (header || line.empty()) {
+            header = false;
+            line.clear();
+            continue;
+        }
+        // the file name is quoted, the other fields are plain
+        Result r;
+        size_t pos = 1;
+        r.file.clear();
+        while (pos < line.size()) {
+            if (line[pos] == '"') {
+                if (pos + 1 < line.size() && line[pos + 1] == '"') {
+                    r.file += '"';
+                    pos += 2;
+                    continue;
+                }
+                break;
+            }
+            r.file += line[pos++];
+        }
+        char backend[64];
+        unsigned long long allocs;
+        if (line.empty() || line[0] != '"' || pos + 1 >= line.size()
+            || sscanf(line.c_str() + pos + 1, ",%63[^,],%d,%lf,%lf,%llu,%ld", backend, &r.page, &r.wallMs, &r.cpuMs, &allocs, &r.peakRSS) != 6) {
+            fprintf(stderr, "%s: malformed line '%s'\n", fileName, line.c_str());
+            fclose(f);
             return false;
         }
-        ++tmp;
-    }
-    if (0 == digitsCount) {
-        return false;
-    }
-    numBuf[digitsCount] = 0;
-    *intOut = atoi(numBuf);
+        r.backend = backend;
+        r.allocs = allocs;
+        results->push_back(r);
+        line.clear();
+    } while (c != EOF);
+    fclose(f);
     return true;
 }
 
-/* Given 'resolutionString' in format NxM (e.g. "100x200"), parse the string and put N
-   into 'resolutionXOut' and M into 'resolutionYOut'.
-   Return false if there was an error (e.g. string is not in the right format */
-static bool ParseResolutionString(const char *resolutionString, int *resolutionXOut, int *resolutionYOut)
+static int compareRuns(const char *oldFileName, const char *newFileName)
 {
-    const char *posOfX;
-
-    assert(resolutionString);
-    assert(resolutionXOut);
-    assert(resolutionYOut);
-    if (!resolutionString || !resolutionXOut || !resolutionYOut) {
-        return false;
-    }
-    *resolutionXOut = 0;
-    *resolutionYOut = 0;
-    posOfX = strchr(resolutionString, 'X');
-    if (!posOfX) {
-        posOfX = strchr(resolutionString, 'x');
-    }
-    if (!posOfX) {
-        return false;
-    }
-    if (posOfX == resolutionString) {
-        return false;
+    std::vector<Result> oldResults, newResults;
+    if (!readCSV(oldFileName, &oldResults) || !readCSV(newFileName, &newResults)) {
+        return 2;
     }
-    if (!ParseInteger(resolutionString, posOfX - 1, resolutionXOut)) {
-        return false;
+
+    std::map<std::string, double> oldTotals;
+    for (const auto &[key, ms] : getTotals(oldResults)) {
+        oldTotals[key] = ms;
     }
-    if (!ParseInteger(posOfX + 1, resolutionString + strlen(resolutionString) - 1, resolutionYOut)) {
-        return false;
+    double oldSum = 0, newSum = 0;
+    int regressions = 0;
+    for (const auto &[key, ms] : getTotals(newResults)) {
+        auto it = oldTotals.find(key);
+        if (it == oldTotals.end()) {
+            continue;
+        }
+        oldSum += it->second;
+        newSum += ms;
+        const double change = it->second > 0 ? 100.0 * (ms - it->second) / it->second : 0;
+        // differences of less than a millisecond are noise
+        if (std::abs(ms - it->second) < 1.0) {
+            continue;
+        }
+        if (change > threshold) {
+            printf("SLOWER %+7.1f%%  %10.1f ms -> %10.1f ms  %s\n", change, it->second, ms, key.c_str());
+            ++regressions;
+        } else if (change < -threshold && !quiet) {
+            printf("faster %+7.1f%%  %10.1f ms -> %10.1f ms  %s\n", change, it->second, ms, key.c_str());
+        }
     }
-    return true;
+    printf("total %.1f ms -> %.1f ms (%+.1f%%), %d regressions over %g%%\n", oldSum, newSum, oldSum > 0 ? 100.0 * (newSum - oldSum) / oldSum : 0.0, regressions, threshold);
+    return regressions ? 1 : 0;
 }
 
-static void ParseCommandLine(int argc, char **argv)
+//------------------------------------------------------------------------
+
+static void collectFiles(const std::string &path, std::vector<std::string> *files)
 {
-    char *arg;
-
-    if (argc < 2) {
-        PrintUsageAndExit(argc, argv);
-    }
-
-    for (int i = 1; i < argc; i++) {
-        arg = argv[i];
-        assert(arg);
-        if ('-' == arg[0]) {
-            if (str_ieq(arg, TIMINGS_ARG)) {
-                gfTimings = true;
-            } else if (str_ieq(arg, RESOLUTION_ARG)) {
-                ++i;
-                if (i == argc) {
-                    PrintUsageAndExit(argc, argv); /* expect a file name after that */
-                }
-                if (!ParseResolutionString(argv[i], &gResolutionX, &gResolutionY)) {
-                    PrintUsageAndExit(argc, argv);
-                }
-                gfForceResolution = true;
-            } else if (str_ieq(arg, RECURSIVE_ARG)) {
-                gfRecursive = true;
-            } else if (str_ieq(arg, OUT_ARG)) {
-                /* expect a file name after that */
-                ++i;
-                if (i == argc) {
-                    PrintUsageAndExit(argc, argv);
-                }
-                gOutFileName = str_dup(argv[i]);
-            } else if (str_ieq(arg, PREVIEW_ARG)) {
-                gfPreview = true;
-            } else if (str_ieq(arg, TEXT_ARG)) {
-                gfTextOnly = true;
-            } else if (str_ieq(arg, SLOW_PREVIEW_ARG)) {
-                gfSlowPreview = true;
-            } else if (str_ieq(arg, LOAD_ONLY_ARG)) {
-                gfLoadOnly = true;
-            } else if (str_ieq(arg, PAGE_ARG)) {
-                /* expect an integer after that */
-                ++i;
-                if (i == argc) {
-                    PrintUsageAndExit(argc, argv);
-                }
-                gPageNo = atoi(argv[i]);
-                if (gPageNo < 1) {
-                    PrintUsageAndExit(argc, argv);
-                }
-            } else {
-                /* unknown option */
-                PrintUsageAndExit(argc, argv);
-            }
-        } else {
-            /* we assume that this is not an option hence it must be
-               a name of PDF/directory/file with PDF names */
-            StrList_Insert(&gArgsListRoot, arg);
+    std::error_code ec;
+    if (!std::filesystem::is_directory(path, ec)) {
+        files->push_back(path);
+        return;
+    }
+    std::vector<std::string> found;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (entry.is_regular_file(ec) && ext == ".pdf") {
+            found.push_back(entry.path().string());
         }
     }
+    std::sort(found.begin(), found.end());
+    files->insert(files->end(), found.begin(), found.end());
 }
 
-static bool IsPdfFileName(char *path)
+int main(int argc, char *argv[])
 {
-    if (str_endswith(path, ".pdf")) {
-        return true;
+    const bool ok = parseArgs(argDesc, &argc, argv);
+    if (!ok || printHelp || argc < 2 || (compareMode && argc != 3) || numRuns < 1) {
+        printUsage(argv[0], "<PDF-file or directory>... | -compare <old.csv> <new.csv>", argDesc);
+        return printHelp ? 0 : 2;
     }
-    return false;
-}
-
-/* Render 'cmdLineArg', which can be:
-   - name of PDF file
-*/
-static void RenderCmdLineArg(char *cmdLineArg)
-{
-    assert(cmdLineArg);
-    if (!cmdLineArg) {
-        return;
+    if (compareMode) {
+        return compareRuns(argv[1], argv[2]);
     }
-    if (IsPdfFileName(cmdLineArg)) {
-        RenderFile(cmdLineArg);
-    } else {
-        error(errCommandLine, -1, "unexpected argument '{0:s}'", cmdLineArg);
+
+    std::vector<std::string> backends;
+    for (const char *p = backendList; *p;) {
+        const char *end = strchr(p, ',');
+        const std::string name = end ? std::string(p, end - p) : std::string(p);
+        if (!getBackend(name)) {
+            fprintf(stderr, "Unknown or unavailable backend '%s'\n", name.c_str());
+            return 2;
+        }
+        backends.push_back(name);
+        p = end ? end + 1 : p + name.size();
     }
-}
 
-int main(int argc, char **argv)
-{
-    setErrorCallback(my_error);
-    ParseCommandLine(argc, argv);
-    if (0 == StrList_Len(&gArgsListRoot)) {
-        PrintUsageAndExit(argc, argv);
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        collectFiles(argv[i], &files);
     }
-    assert(gArgsListRoot);
 
-    SplashColorsInit();
     globalParams = std::make_unique<GlobalParams>();
-    if (!globalParams) {
-        return 1;
+    globalParams->setErrQuiet(true);
+    globalParams->setProfileCommands(profilePhases);
+
+    // keep the fastest of all runs for every step
+    std::vector<Result> results;
+    for (int run = 0; run < numRuns; ++run) {
+        std::vector<Result> runResults;
+        for (const std::string &file : files) {
+            runFile(file, backends, &runResults);
+        }
+        if (run == 0) {
+            results = std::move(runResults);
+            continue;
+        }
+        for (size_t i = 0; i < results.size() && i < runResults.size(); ++i) {
+            if (runResults[i].wallMs < results[i].wallMs) {
+                results[i] = runResults[i];
+            }
+        }
     }
-    globalParams->setErrQuiet(false);
 
-    FILE *outFile = nullptr;
-    if (gOutFileName) {
-        outFile = fopen(gOutFileName, "wb");
-        if (!outFile) {
-            printf("failed to open -out file %s\n", gOutFileName);
-            return 1;
+    if (!quiet) {
+        for (const auto &[key, ms] : getTotals(results)) {
+            printf("%10.1f ms  %s\n", ms, key.c_str());
         }
-        gOutFile = outFile;
-    } else {
-        gOutFile = stdout;
     }
-
-    if (gOutFileName) {
-        gErrFile = outFile;
-    } else {
-        gErrFile = stderr;
+    double total = 0;
+    for (const Result &r : results) {
+        total += r.wallMs;
     }
+    printf("%zu files, %zu steps, %.1f ms, peak RSS %ld KiB\n", files.size(), results.size(), total, getPeakRSS());
 
-    PreviewBitmapInit();
-
-    StrList *curr = gArgsListRoot;
-    while (curr) {
-        RenderCmdLineArg(curr->str);
-        curr = curr->next;
+    if (csvFileName[0] && !writeCSV(csvFileName, results)) {
+        return 2;
     }
-    if (outFile) {
-        fclose(outFile);
+    if (jsonFileName[0] && !writeJSON(jsonFileName, results)) {
+        return 2;
     }
-    PreviewBitmapDestroy();
-    StrList_Destroy(&gArgsListRoot);
-    free(gOutFileName);
     return 0;
 }
@@ -0,0 +1,304 @@
+//========================================================================
+//
+// postscript-function-test.cc
+//
+// Checks that compiled PostScript (type 4) functions give the same
+// results as interpreted ones, to the bit, for every operator, for
+// conditionals, for code that only the interpreter can run (stack under-
+// and overflows, stack depths that depend on the inputs, type errors),
+// and for code that fails at run time.  Sampled functions must be within
+// the sampling tolerance of the interpreter, and functions that aren't
+// continuous, or can't be interpolated accurately, must not be sampled.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Dict.h"
+#include "Function.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+
+// The tolerance of sampled functions, as a fraction of the output range.
+static const double sampledTolerance = 1.0 / 2048;
+
+enum Expected
+{
+    expectInterpreter, // the code can't be compiled
+    expectCompiled, // the code can be compiled but not sampled
+    expectSampled // the code can be compiled and sampled
+};
+
+struct TestFunction
+{
+    int nInputs;
+    int nOutputs;
+    double domainMin, domainMax; // the same for every input
+    double rangeMin, rangeMax; // the same for every output
+    std::string code;
+    Expected expected;
+};
+
+static const double big = 1e6;
+
+static std::vector<TestFunction> testFunctions()
+{
+    std::vector<TestFunction> funcs = {
+        // every operator, one input
+        { 1, 1, -2, 2, -big, big, "{ abs }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 0.25 add }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ dup add }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 3 add }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 1 atan }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 1 exch atan }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 2 bitshift }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi -1 bitshift }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ ceiling }", expectCompiled },
+        { 1, 3, -2, 2, -big, big, "{ 2 3 3 copy pop }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 90 mul cos }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi cvr 0.5 add }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 3 div }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 1 exch 0.1 add div }", expectCompiled },
+        { 1, 2, -2, 2, -big, big, "{ dup 2 mul }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 3 eq { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 0.5 eq { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 2, -2, 2, -big, big, "{ 2 exch }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 1 add 2 exp }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 2 exch exp }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ dup exp }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ false { 1 } { 2 } ifelse add }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ floor }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 0.5 ge { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 0.5 gt { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 3 idiv }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 1 2 2 index add add exch pop }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 0.5 le { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ abs 0.1 add ln }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ abs 0.1 add log }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 0.5 lt { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 3 mod }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 7 mul }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ dup mul }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 0.5 ne { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ neg }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi neg }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 0 gt not { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi not }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 0 gt false or { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 5 or }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 0 gt true and { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 6 and }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 0 gt true xor { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 6 xor }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 2 pop }", expectSampled },
+        { 1, 3, -2, 2, -big, big, "{ 2 3 3 1 roll }", expectSampled },
+        { 1, 3, -2, 2, -big, big, "{ 2 3 3 -1 roll }", expectSampled },
+        // rolling more entries than there are does nothing
+        { 1, 1, -2, 2, -big, big, "{ 2 1 roll }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 3 mul round }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 90 mul sin }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ abs sqrt }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 0.5 sub }", expectSampled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 3 sub }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 3 mul truncate }", expectCompiled },
+
+        // conditionals
+        { 1, 1, -2, 2, -big, big, "{ dup 0 lt { pop 0.0 } if }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ dup 0 gt { dup 0.5 gt { 2 mul } { 3 mul } ifelse } { neg dup 1 gt { pop 1.0 } if } ifelse }", expectCompiled },
+        { 1, 3, 0, 1, 0, 1, "{ dup 0.5 lt { 2 mul 0.0 } { 0.5 sub 2 mul 1.0 exch } ifelse 1 }", expectCompiled },
+        { 2, 1, 0, 1, 0, 2, "{ exch 0.5 gt { 1 } { 0 } ifelse add }", expectCompiled },
+
+        // only for the interpreter
+        { 1, 1, -2, 2, -big, big, "{ 0 gt { 1 2 } { 3 } ifelse }", expectInterpreter },
+        // the result is an integer or a real, depending on the input
+        { 1, 1, -2, 2, -big, big, "{ dup 0 lt { pop 0 } if }", expectInterpreter },
+        { 1, 1, -2, 2, -big, big, "{ pop pop add }", expectInterpreter },
+        { 1, 1, -2, 2, -big, big, "{ 5 index }", expectInterpreter },
+        { 1, 1, -2, 2, -big, big, "{ 3 copy }", expectInterpreter },
+        { 1, 1, -2, 2, -big, big, "{ true add }", expectInterpreter },
+        { 1, 1, -2, 2, -big, big, "{ 1 and }", expectInterpreter },
+        { 1, 1, -2, 2, -big, big, "{ 0 gt }", expectInterpreter },
+        { 1, 1, -2, 2, -big, big, "{ 50 copy 60 copy pop }", expectInterpreter },
+
+        // errors at run time
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 0 idiv }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 5 sub 3 exch idiv }", expectCompiled },
+        { 1, 1, -2, 2, -big, big, "{ 10 mul cvi 5 sub 3 exch mod }", expectCompiled },
+
+        // typical tint transforms
+        { 1, 4, 0, 1, 0, 1, "{ dup 0.3 mul exch dup 0.7 mul exch 0.1 mul 0 }", expectSampled },
+        { 1, 3, 0, 1, 0, 1, "{ 2.2 exp dup dup }", expectSampled },
+        { 1, 3, 0, 1, 0, 1, "{ 1 exch sub dup 0.5 mul exch dup mul 0 }", expectSampled },
+        { 2, 1, 0, 1, 0, 1, "{ add 2 div }", expectSampled },
+        { 2, 2, 0, 1, 0, 2, "{ 2 copy mul 3 1 roll add }", expectSampled },
+        { 2, 1, 0, 1, -1, 1, "{ 90 mul sin exch 180 mul cos mul }", expectSampled },
+        { 2, 2, 0, 1, 0, 2, "{ 2 copy 2 exp exch 1 add 0.5 exp mul 3 1 roll sub 1 add }", expectSampled },
+
+        // continuous code that changes too fast between the grid points
+        { 1, 1, 0, 1, -1, 1, "{ 5000 mul sin }", expectCompiled },
+        { 1, 1, 0, 1, 0, 1, "{ 0.5 exp }", expectCompiled },
+        { 2, 1, 0, 1, -1, 1, "{ 400 mul sin exch 400 mul cos mul }", expectCompiled },
+        // a step and a spike between the points that used to be checked
+        { 1, 1, 0, 1, 0, 1, "{ dup 0.3 gt exch 0.3001 lt and { 1 } { 0 } ifelse }", expectCompiled },
+        { 1, 1, 0, 1, 0, 1, "{ 0.30005 sub 100000 mul dup mul 1 add 1 exch div }", expectCompiled },
+    };
+
+    // stack overflow
+    std::string code = "{";
+    for (int i = 0; i < 110; ++i) {
+        code += " dup";
+    }
+    code += " }";
+    funcs.push_back({ 1, 1, -2, 2, -big, big, code, expectInterpreter });
+    return funcs;
+}
+
+static std::unique_ptr<Function> makeFunction(const TestFunction &test, PSFunctionImpl impl)
+{
+    Dict *dict = new Dict((XRef *)nullptr);
+    dict->add("FunctionType", Object(4));
+    Array *domain = new Array(nullptr);
+    for (int i = 0; i < test.nInputs; ++i) {
+        domain->add(Object(test.domainMin));
+        domain->add(Object(test.domainMax));
+    }
+    dict->add("Domain", Object(domain));
+    Array *range = new Array(nullptr);
+    for (int i = 0; i < test.nOutputs; ++i) {
+        range->add(Object(test.rangeMin));
+        range->add(Object(test.rangeMax));
+    }
+    dict->add("Range", Object(range));
+    dict->add("Length", Object((int)test.code.size()));
+    Object funcObj(std::unique_ptr<Stream>(new MemStream(test.code.c_str(), 0, test.code.size(), Object(dict))));
+
+    setPSFunctionImpl(impl);
+    std::unique_ptr<Function> func = Function::parse(&funcObj);
+    setPSFunctionImpl(psFunctionImplSampled);
+    if (!func || func->getType() != Function::Type::PostScript) {
+        return nullptr;
+    }
+    return func;
+}
+
+static PSFunctionImpl getImpl(const Function *func)
+{
+    return static_cast<const PostScriptFunction *>(func)->getImpl();
+}
+
+// Inputs on a grid over the domain, off the grid, and outside of the
+// domain.
+static std::vector<std::vector<double>> testInputs(const TestFunction &test)
+{
+    std::vector<double> values;
+    const double size = test.domainMax - test.domainMin;
+    for (int i = 0; i <= 40; ++i) {
+        values.push_back(test.domainMin + size * i / 40);
+    }
+    unsigned int state = 1;
+    for (int i = 0; i < 40; ++i) {
+        state = state * 1103515245u + 12345u;
+        values.push_back(test.domainMin + size * ((state >> 8) & 0xffff) / 0xffff);
+    }
+    values.push_back(test.domainMin + size * 0.30005);
+    values.push_back(test.domainMin - size / 10);
+    values.push_back(test.domainMax + size / 10);
+
+    std::vector<std::vector<double>> inputs;
+    if (test.nInputs == 1) {
+        for (double v : values) {
+            inputs.push_back({ v });
+        }
+    } else {
+        for (size_t i = 0; i < values.size(); i += 3) {
+            for (size_t j = 0; j < values.size(); j += 5) {
+                inputs.push_back({ values[i], values[j] });
+            }
+        }
+    }
+    return inputs;
+}
+
+static bool sameBits(const double *a, const double *b, int n)
+{
+    return memcmp(a, b, n * sizeof(double)) == 0;
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    static const char *implNames[] = { "interpreted", "compiled", "sampled" };
+    int numChecks = 0;
+    int numFailures = 0;
+    for (const TestFunction &test : testFunctions()) {
+        std::unique_ptr<Function> interpreted = makeFunction(test, psFunctionImplInterpreter);
+        std::unique_ptr<Function> compiled = makeFunction(test, psFunctionImplCompiled);
+        std::unique_ptr<Function> sampled = makeFunction(test, psFunctionImplSampled);
+        ++numChecks;
+        if (!interpreted || !compiled || !sampled) {
+            fprintf(stderr, "%s: can't parse the function\n", test.code.c_str());
+            ++numFailures;
+            continue;
+        }
+
+        // the implementation that was picked
+        const PSFunctionImpl expectedCompiled = test.expected == expectInterpreter ? psFunctionImplInterpreter : psFunctionImplCompiled;
+        const PSFunctionImpl expectedSampled = (PSFunctionImpl)test.expected;
+        ++numChecks;
+        if (getImpl(interpreted.get()) != psFunctionImplInterpreter || getImpl(compiled.get()) != expectedCompiled || getImpl(sampled.get()) != expectedSampled) {
+            fprintf(stderr, "%s: %s, %s and %s instead of interpreted, %s and %s\n", test.code.c_str(), implNames[getImpl(interpreted.get())], implNames[getImpl(compiled.get())], implNames[getImpl(sampled.get())],
+                    implNames[expectedCompiled], implNames[expectedSampled]);
+            ++numFailures;
+        }
+
+        // the outputs, one by one and in a batch
+        const std::vector<std::vector<double>> inputs = testInputs(test);
+        std::vector<double> batchIn, batchOut(inputs.size() * test.nOutputs);
+        for (const std::vector<double> &in : inputs) {
+            batchIn.insert(batchIn.end(), in.begin(), in.end());
+        }
+        compiled->transformBatch(batchIn.data(), batchOut.data(), (int)inputs.size());
+        const double tolerance = (test.rangeMax - test.rangeMin) * sampledTolerance;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            const double *in = inputs[i].data();
+            double ref[funcMaxOutputs], out[funcMaxOutputs], sampledOut[funcMaxOutputs];
+            interpreted->transform(in, ref);
+            compiled->transform(in, out);
+            sampled->transform(in, sampledOut);
+            bool ok = sameBits(ref, out, test.nOutputs) && sameBits(ref, batchOut.data() + i * test.nOutputs, test.nOutputs);
+            bool inDomain = true;
+            for (int k = 0; k < test.nInputs; ++k) {
+                inDomain = inDomain && in[k] >= test.domainMin && in[k] <= test.domainMax;
+            }
+            // outside of the domain, the compiled code runs
+            if (getImpl(sampled.get()) == psFunctionImplSampled && inDomain) {
+                for (int k = 0; k < test.nOutputs; ++k) {
+                    ok = ok && fabs(sampledOut[k] - ref[k]) <= tolerance;
+                }
+            } else {
+                ok = ok && sameBits(ref, sampledOut, test.nOutputs);
+            }
+            ++numChecks;
+            if (!ok) {
+                fprintf(stderr, "%s: at %g%s differs from the interpreter\n", test.code.c_str(), in[0], test.nInputs > 1 ? " ..." : "");
+                ++numFailures;
+            }
+        }
+    }
+
+    printf("%d PostScript function checks: %d failures\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
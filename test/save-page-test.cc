@@ -0,0 +1,172 @@
+//========================================================================
+//
+// save-page-test.cc
+//
+// Checks that saving several pages from one PDFDoc with savePageAs()
+// gives the same files as saving each page from a document of its own.
+// The document has form fields and annotations on several pages, which
+// savePageAs() filters, and is tested as written, with object streams,
+// and with objects that were changed before saving.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "XRef.h"
+#include "test-pdf-builder.h"
+
+static const int numPages = 4;
+
+// Four pages, each with a form field and a link.  The fields are listed
+// in a direct /Fields array of a direct /AcroForm, and the third page
+// has a direct /Annots array that also holds a note of the first page.
+static TestPdfBuilder buildDocument()
+{
+    TestPdfBuilder builder;
+    std::vector<int> annots;
+    for (int i = 0; i < 2 * numPages + 1; ++i) {
+        annots.push_back(builder.addObject("null"));
+    }
+    std::vector<int> pages;
+    for (int i = 0; i < numPages; ++i) {
+        const std::string widget = std::to_string(annots[2 * i]) + " 0 R";
+        const std::string link = std::to_string(annots[2 * i + 1]) + " 0 R";
+        std::string annotsEntry;
+        if (i == 2) {
+            annotsEntry = "/Annots [ " + widget + " " + link + " " + std::to_string(annots[2 * numPages]) + " 0 R ]";
+        } else {
+            annotsEntry = "/Annots " + std::to_string(builder.addObject("[ " + widget + " " + link + " ]")) + " 0 R";
+        }
+        const std::string content = "BT /F1 12 Tf 72 700 Td (Page " + std::to_string(i + 1) + ") Tj ET\n";
+        pages.push_back(builder.addPage(content, "/Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /Helvetica >> >>", annotsEntry));
+    }
+    std::string fields;
+    for (int i = 0; i < numPages; ++i) {
+        const std::string page = std::to_string(pages[i]) + " 0 R";
+        builder.setObject(annots[2 * i], "<< /Type /Annot /Subtype /Widget /FT /Tx /T (field" + std::to_string(i + 1) + ") /V (value " + std::to_string(i + 1) + ") /Rect [72 600 300 620] /P " + page + " >>");
+        builder.setObject(annots[2 * i + 1], "<< /Type /Annot /Subtype /Link /Rect [72 500 300 520] /Border [0 0 0] /A << /S /URI /URI (https://example.com/" + std::to_string(i + 1) + ") >> /P " + page + " >>");
+        fields += std::to_string(annots[2 * i]) + " 0 R ";
+    }
+    builder.setObject(annots[2 * numPages], "<< /Type /Annot /Subtype /Text /Rect [72 400 92 420] /Contents (note) /P " + std::to_string(pages[0]) + " 0 R >>");
+    builder.addCatalogEntries("/AcroForm << /Fields [ " + fields + "] /DA (/Helv 0 Tf 0 g) >> /OpenAction [ " + std::to_string(pages[0]) + " 0 R /Fit ]");
+    return builder;
+}
+
+static std::unique_ptr<PDFDoc> openDocument(const std::string &path, bool modify)
+{
+    std::unique_ptr<PDFDoc> doc = testOpenPdf(path);
+    if (doc && modify) {
+        // changed objects are shared by every fetch() of them
+        XRef *xref = doc->getXRef();
+        const Ref catalogRef = { xref->getRootNum(), xref->getRootGen() };
+        Object catalog = xref->fetch(catalogRef);
+        catalog.dictSet("Lang", Object(std::make_unique<GooString>("en")));
+        xref->setModifiedObject(&catalog, catalogRef);
+        const Ref pageRef = *doc->getCatalog()->getPageRef(3);
+        Object page = xref->fetch(pageRef);
+        xref->setModifiedObject(&page, pageRef);
+    }
+    return doc;
+}
+
+// Returns the file at <path>, without the time-based /ID.
+static std::string readOutput(const std::string &path)
+{
+    std::ifstream f(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    const size_t id = data.find("/ID [");
+    if (id != std::string::npos) {
+        const size_t end = data.find(']', id);
+        if (end != std::string::npos) {
+            data.erase(id, end - id + 1);
+        }
+    }
+    std::remove(path.c_str());
+    return data;
+}
+
+static int checkSavePages(const std::string &path, const char *name, bool modify, int *numChecks)
+{
+    const std::string outPath = testTempFileName("save-page-out.pdf");
+
+    // each page from a document of its own
+    std::vector<std::string> expected;
+    for (int page = 1; page <= numPages; ++page) {
+        std::unique_ptr<PDFDoc> doc = openDocument(path, modify);
+        if (!doc || doc->savePageAs(GooString(outPath), page) != errNone) {
+            fprintf(stderr, "%s: can't save page %d\n", name, page);
+            return 1;
+        }
+        expected.push_back(readOutput(outPath));
+    }
+
+    // all pages from one document, twice and in another order
+    int numFailures = 0;
+    std::unique_ptr<PDFDoc> doc = openDocument(path, modify);
+    if (!doc) {
+        return 1;
+    }
+    const int order[] = { 1, 2, 3, 4, 3, 1, 4, 2 };
+    for (int page : order) {
+        ++*numChecks;
+        if (doc->savePageAs(GooString(outPath), page) != errNone) {
+            fprintf(stderr, "%s: can't save page %d again\n", name, page);
+            ++numFailures;
+            continue;
+        }
+        if (readOutput(outPath) != expected[page - 1]) {
+            fprintf(stderr, "%s: page %d saved from a shared document differs\n", name, page);
+            ++numFailures;
+        }
+    }
+
+    // and the document itself is as it was
+    ++*numChecks;
+    if (doc->getXRef()->isModified() != modify) {
+        fprintf(stderr, "%s: saving pages changed whether the document is modified\n", name);
+        ++numFailures;
+    }
+    return numFailures;
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    const std::string plainPath = testTempFileName("save-page.pdf");
+    const std::string compressedPath = testTempFileName("save-page-compressed.pdf");
+    if (!buildDocument().write(plainPath)) {
+        return 1;
+    }
+    {
+        std::unique_ptr<PDFDoc> doc = testOpenPdf(plainPath);
+        if (!doc || doc->saveAs(GooString(compressedPath), writeForceRewriteCompressed) != errNone) {
+            fprintf(stderr, "can't write the document with object streams\n");
+            return 1;
+        }
+    }
+
+    int numChecks = 0;
+    int numFailures = checkSavePages(plainPath, "plain", false, &numChecks);
+    numFailures += checkSavePages(plainPath, "plain, modified", true, &numChecks);
+    numFailures += checkSavePages(compressedPath, "object streams", false, &numChecks);
+    numFailures += checkSavePages(compressedPath, "object streams, modified", true, &numChecks);
+    std::remove(plainPath.c_str());
+    std::remove(compressedPath.c_str());
+
+    printf("%d pages saved: %d failures\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,264 @@
+//========================================================================
+//
+// splash-glyph-cache-test.cc
+//
+// Checks that the shared SplashGlyphCache only hands out glyphs of font
+// files whose data is the same: documents embedding different fonts
+// under the same name render as they do without the cache, a document
+// embedding the same font reuses the glyphs, and fonts whose hashes
+// collide don't share glyphs.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "splash/SplashBitmap.h"
+#include "splash/SplashGlyphBitmap.h"
+#include "splash/SplashGlyphCache.h"
+#include "test-pdf-builder.h"
+
+//------------------------------------------------------------------------
+// Type 1 font programs
+//------------------------------------------------------------------------
+
+static void appendCharStringNumber(std::string *s, int v)
+{
+    if (v >= -107 && v <= 107) {
+        *s += (char)(v + 139);
+    } else if (v >= 108 && v <= 1131) {
+        *s += (char)((v - 108) / 256 + 247);
+        *s += (char)((v - 108) % 256);
+    } else if (v >= -1131 && v <= -108) {
+        *s += (char)((-v - 108) / 256 + 251);
+        *s += (char)((-v - 108) % 256);
+    } else {
+        *s += (char)255;
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            *s += (char)((unsigned int)v >> shift);
+        }
+    }
+}
+
+static std::string encrypt(const std::string &plain, unsigned short r)
+{
+    std::string cipher;
+    for (unsigned char p : plain) {
+        const unsigned char c = p ^ (r >> 8);
+        r = (unsigned short)((c + r) * 52845 + 22719);
+        cipher += (char)c;
+    }
+    return cipher;
+}
+
+// A glyph made of closed polygons, given as relative moves and lines.
+static std::string charString(const std::vector<std::vector<int>> &contours)
+{
+    std::string s;
+    appendCharStringNumber(&s, 0);
+    appendCharStringNumber(&s, 1000);
+    s += (char)13; // hsbw
+    for (const std::vector<int> &contour : contours) {
+        appendCharStringNumber(&s, contour[0]);
+        appendCharStringNumber(&s, contour[1]);
+        s += (char)21; // rmoveto
+        for (size_t i = 2; i + 1 < contour.size(); i += 2) {
+            appendCharStringNumber(&s, contour[i]);
+            appendCharStringNumber(&s, contour[i + 1]);
+            s += (char)5; // rlineto
+        }
+        s += (char)9; // closepath
+    }
+    s += (char)14; // endchar
+    // lenIV 4
+    return encrypt(std::string(4, '\0') + s, 4330);
+}
+
+// A Type 1 font named TestFont whose glyph 'a' (code 97) is <glyph>.
+static std::string type1Font(const std::string &glyph, std::string *cleartext, std::string *binary)
+{
+    *cleartext = "%!PS-AdobeFont-1.0: TestFont 001.000\n"
+                 "11 dict begin\n"
+                 "/FontInfo 1 dict dup begin /FullName (TestFont) readonly def end readonly def\n"
+                 "/FontName /TestFont def\n"
+                 "/PaintType 0 def\n"
+                 "/FontType 1 def\n"
+                 "/FontMatrix [0.001 0 0 0.001 0 0] readonly def\n"
+                 "/Encoding 256 array 0 1 255 {1 index exch /.notdef put} for dup 97 /a put readonly def\n"
+                 "/FontBBox {0 0 1000 1000} readonly def\n"
+                 "currentdict end\n"
+                 "currentfile eexec\n";
+    const std::string notdef = charString({});
+    std::string priv = "dup /Private 8 dict dup begin\n"
+                       "/RD{string currentfile exch readstring pop}executeonly def\n"
+                       "/ND{noaccess def}executeonly def\n"
+                       "/NP{noaccess put}executeonly def\n"
+                       "/BlueValues [] ND\n"
+                       "/MinFeature {16 16} ND\n"
+                       "/password 5839 def\n"
+                       "/lenIV 4 def\n"
+                       "2 index /CharStrings 2 dict dup begin\n";
+    priv += "/.notdef " + std::to_string(notdef.size()) + " RD " + notdef + " ND\n";
+    priv += "/a " + std::to_string(glyph.size()) + " RD " + glyph + " ND\n";
+    priv += "end\nend\nreadonly put\nnoaccess put\ndup /FontName get exch definefont pop\nmark currentfile closefile\n";
+    *binary = encrypt(std::string(4, '\0') + priv, 55665);
+    std::string trailer;
+    for (int i = 0; i < 8; ++i) {
+        trailer += std::string(64, '0') + "\n";
+    }
+    trailer += "cleartomark\n";
+    return *cleartext + *binary + trailer;
+}
+
+static bool writeDocument(const std::string &fileName, const std::string &glyph)
+{
+    std::string cleartext, binary;
+    const std::string font = type1Font(glyph, &cleartext, &binary);
+
+    TestPdfBuilder builder;
+    const int fontFile = builder.addStream("/Length1 " + std::to_string(cleartext.size()) + " /Length2 " + std::to_string(binary.size()) + " /Length3 " + std::to_string(font.size() - cleartext.size() - binary.size()), font);
+    const int descriptor = builder.addObject("<< /Type /FontDescriptor /FontName /TestFont /Flags 4 /FontBBox [0 0 1000 1000] /ItalicAngle 0 /Ascent 1000 /Descent 0 /CapHeight 1000 /StemV 80 /FontFile " + std::to_string(fontFile) + " 0 R >>");
+    builder.addPage("BT /F1 90 Tf 40 600 Td (aaaa) Tj 0 -150 Td 0.5 Tc (aaa) Tj ET\n",
+                    "/Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /TestFont /FirstChar 97 /LastChar 97 /Widths [1000] /FontDescriptor " + std::to_string(descriptor) + " 0 R >> >>");
+    return builder.write(fileName);
+}
+
+//------------------------------------------------------------------------
+
+static std::unique_ptr<SplashBitmap> render(const std::string &fileName)
+{
+    std::unique_ptr<PDFDoc> doc = testOpenPdf(fileName);
+    if (!doc) {
+        return nullptr;
+    }
+    SplashColor paperColor = { 0xff, 0xff, 0xff };
+    SplashOutputDev out(splashModeRGB8, 1, false, paperColor);
+    out.setFontAntialias(true);
+    out.startDoc(doc.get());
+    doc->displayPage(&out, 1, 72, 72, 0, false, true, false);
+    return std::unique_ptr<SplashBitmap>(out.takeBitmap());
+}
+
+static bool sameBitmaps(SplashBitmap *a, SplashBitmap *b)
+{
+    return a && b && a->getWidth() == b->getWidth() && a->getHeight() == b->getHeight() && a->getRowSize() == b->getRowSize() && memcmp(a->getDataPtr(), b->getDataPtr(), (size_t)a->getRowSize() * a->getHeight()) == 0;
+}
+
+// Fonts with the same hash but different data must not share glyphs.
+static int checkHashCollision(int *numChecks)
+{
+    SplashGlyphCache *cache = SplashGlyphCache::getInstance();
+
+    auto fontA = std::make_shared<SplashGlyphCacheFont>();
+    fontA->data = std::make_shared<const std::vector<unsigned char>>(std::vector<unsigned char> { 1, 2, 3 });
+    fontA->hash = 42;
+    auto fontB = std::make_shared<SplashGlyphCacheFont>();
+    fontB->data = std::make_shared<const std::vector<unsigned char>>(std::vector<unsigned char> { 1, 2, 4 });
+    fontB->hash = 42;
+    auto fontC = std::make_shared<SplashGlyphCacheFont>();
+    fontC->data = std::make_shared<const std::vector<unsigned char>>(std::vector<unsigned char> { 1, 2, 3 });
+    fontC->hash = 42;
+
+    std::shared_ptr<const SplashGlyphCacheFont> a = cache->getFont(fontA);
+    std::shared_ptr<const SplashGlyphCacheFont> b = cache->getFont(fontB);
+    std::shared_ptr<const SplashGlyphCacheFont> c = cache->getFont(fontC);
+
+    unsigned char data[4] = { 10, 20, 30, 40 };
+    SplashGlyphBitmap glyph = { 0, 0, 2, 2, true, data, false };
+    SplashGlyphCacheKey key = { a.get(), { 1, 0, 0, 1 }, 1, 97, 0, 0 };
+    cache->insert(key, glyph);
+
+    int numFailures = 0;
+    SplashGlyphBitmap found;
+    key.font = b.get();
+    ++*numChecks;
+    if (b == a || cache->lookup(key, &found)) {
+        fprintf(stderr, "a glyph was found for a different font with the same hash\n");
+        ++numFailures;
+        if (b != a) {
+            gfree(found.data);
+        }
+    }
+    key.font = c.get();
+    ++*numChecks;
+    if (c != a || !cache->lookup(key, &found)) {
+        fprintf(stderr, "the glyph wasn't found for an equal font\n");
+        ++numFailures;
+    } else {
+        gfree(found.data);
+    }
+    cache->clear();
+    return numFailures;
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    SplashGlyphCache *cache = SplashGlyphCache::getInstance();
+    const size_t defaultMaxSize = cache->getMaxSize();
+    int numChecks = 0;
+    int numFailures = checkHashCollision(&numChecks);
+
+    // the same font name, object numbers and metrics, different outlines
+    const std::string square = charString({ { 100, 0, 800, 0, 0, 800, -800, 0 } });
+    const std::string triangle = charString({ { 100, 0, 800, 0, -400, 900 } });
+    const std::string fileA = testTempFileName("glyph-cache-a.pdf");
+    const std::string fileB = testTempFileName("glyph-cache-b.pdf");
+    const std::string fileC = testTempFileName("glyph-cache-c.pdf");
+    if (!writeDocument(fileA, square) || !writeDocument(fileB, triangle) || !writeDocument(fileC, square)) {
+        return 1;
+    }
+
+    cache->setMaxSize(0);
+    std::unique_ptr<SplashBitmap> refA = render(fileA);
+    std::unique_ptr<SplashBitmap> refB = render(fileB);
+
+    cache->setMaxSize(defaultMaxSize > 0 ? defaultMaxSize : 16 * 1024 * 1024);
+    cache->clear();
+    cache->resetStats();
+    std::unique_ptr<SplashBitmap> cachedA = render(fileA);
+    std::unique_ptr<SplashBitmap> cachedB = render(fileB);
+    const uint64_t hitsBeforeC = cache->getStats().hits;
+    std::unique_ptr<SplashBitmap> cachedC = render(fileC);
+    const uint64_t hitsC = cache->getStats().hits - hitsBeforeC;
+
+    ++numChecks;
+    if (!refA || !refB || sameBitmaps(refA.get(), refB.get())) {
+        fprintf(stderr, "the two fonts render the same\n");
+        ++numFailures;
+    }
+    ++numChecks;
+    if (!sameBitmaps(refA.get(), cachedA.get())) {
+        fprintf(stderr, "the first document renders differently with the glyph cache\n");
+        ++numFailures;
+    }
+    ++numChecks;
+    if (!sameBitmaps(refB.get(), cachedB.get())) {
+        fprintf(stderr, "the second document got glyphs of the first one's font\n");
+        ++numFailures;
+    }
+    ++numChecks;
+    if (!sameBitmaps(refA.get(), cachedC.get()) || hitsC == 0) {
+        fprintf(stderr, "a document with the same font as the first one didn't reuse its glyphs correctly (%llu hits)\n", (unsigned long long)hitsC);
+        ++numFailures;
+    }
+
+    cache->setMaxSize(defaultMaxSize);
+    remove(fileA.c_str());
+    remove(fileB.c_str());
+    remove(fileC.c_str());
+    printf("%d glyph cache checks: %d failures\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
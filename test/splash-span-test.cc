@@ -0,0 +1,220 @@
+//========================================================================
+//
+// splash-span-test.cc
+//
+// Checks that the antialiased span compositing kernels produce the same
+// bytes as the per-pixel Splash pipe: every available implementation
+// against the scalar kernel for spans of all alignments and lengths, and
+// Splash fills and glyphs drawn with each implementation against the
+// pipe in every color mode.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "splash/Splash.h"
+#include "splash/SplashBitmap.h"
+#include "splash/SplashCompositeSpan.h"
+#include "splash/SplashGlyphBitmap.h"
+#include "splash/SplashPath.h"
+#include "splash/SplashPattern.h"
+
+static const struct
+{
+    SplashSpanImpl impl;
+    const char *name;
+} impls[] = { { splashSpanImplScalar, "scalar" }, { splashSpanImplSSE2, "SSE2" }, { splashSpanImplAVX2, "AVX2" }, { splashSpanImplNEON, "NEON" } };
+
+static const struct
+{
+    SplashColorMode mode;
+    const char *name;
+    int nComps;
+} modes[] = { { splashModeMono1, "Mono1", 1 }, { splashModeMono8, "Mono8", 1 }, { splashModeRGB8, "RGB8", 3 }, { splashModeBGR8, "BGR8", 3 }, { splashModeXBGR8, "XBGR8", 4 }, { splashModeCMYK8, "CMYK8", 4 }, { splashModeDeviceN8, "DeviceN8", SPOT_NCOMPS + 4 } };
+
+// A fixed pseudo random sequence, so that failures can be reproduced.
+class Random
+{
+public:
+    unsigned int next()
+    {
+        state = state * 1103515245u + 12345u;
+        return (state >> 8) & 0xffffff;
+    }
+    unsigned char nextByte() { return (unsigned char)next(); }
+    double nextDouble(double max) { return max * (next() / (double)0x1000000); }
+
+private:
+    unsigned int state = 1;
+};
+
+// Shape values as the rasterizer produces them: runs of empty, full and
+// partly covered pixels.
+static void fillShape(Random *random, unsigned char *shape, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        switch (random->next() % 4) {
+        case 0:
+            shape[i] = 0;
+            break;
+        case 1:
+            shape[i] = 255;
+            break;
+        default:
+            shape[i] = random->nextByte();
+            break;
+        }
+    }
+}
+
+// Compares every kernel with the scalar one, for spans starting at every
+// offset within a vector and of every length up to a few vectors.  The
+// buffers reach past the span on both sides to catch stray writes.
+static int checkKernels(int *numChecks)
+{
+    static const int bytesPerPixel[] = { 0, 0, 3, 3, 4, 4, 0 };
+    const int maxStart = 32;
+    const int maxLength = 72;
+    const unsigned char alphas[] = { 255, 254, 128, 1 };
+
+    Random random;
+    int numFailures = 0;
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+        SplashCompositeAASpanFunc scalar = splashGetCompositeAASpanFunc(modes[m].mode, splashSpanImplScalar);
+        if (!scalar) {
+            continue;
+        }
+        const int bpp = bytesPerPixel[m];
+        for (const auto &impl : impls) {
+            SplashCompositeAASpanFunc func = splashGetCompositeAASpanFunc(modes[m].mode, impl.impl);
+            if (!func || impl.impl == splashSpanImplScalar) {
+                continue;
+            }
+            for (int start = 0; start < maxStart; ++start) {
+                for (int length = 0; length <= maxLength; ++length) {
+                    const int size = start + length + 8;
+                    std::vector<unsigned char> color(size * bpp), alpha(size), shape(size);
+                    for (unsigned char &c : color) {
+                        c = random.nextByte();
+                    }
+                    for (unsigned char &a : alpha) {
+                        a = random.nextByte();
+                    }
+                    fillShape(&random, shape.data(), size);
+                    SplashColor src;
+                    for (unsigned char &c : src) {
+                        c = random.nextByte();
+                    }
+                    const unsigned char aInput = alphas[(start + length) % 4];
+
+                    std::vector<unsigned char> refColor(color), refAlpha(alpha);
+                    scalar(refColor.data() + start * bpp, refAlpha.data() + start, shape.data() + start, length, aInput, src);
+                    func(color.data() + start * bpp, alpha.data() + start, shape.data() + start, length, aInput, src);
+                    ++*numChecks;
+                    if (color != refColor || alpha != refAlpha) {
+                        fprintf(stderr, "%s %s kernel: span at %d of length %d, alpha %d differs from the scalar kernel\n", impl.name, modes[m].name, start, length, aInput);
+                        ++numFailures;
+                    }
+                }
+            }
+        }
+    }
+    return numFailures;
+}
+
+// Draws antialiased slivers and glyphs of all widths at fractional
+// positions, partly transparent and over a partly transparent backdrop.
+static void drawScene(Splash *splash, int nComps)
+{
+    Random random;
+    SplashColor color;
+
+    memset(color, 0, sizeof(color));
+    splash->clear(color, 0);
+    for (int i = 0; i < 60; ++i) {
+        for (int k = 0; k < nComps; ++k) {
+            color[k] = random.nextByte();
+        }
+        splash->setFillPattern(new SplashSolidColor(color));
+        splash->setFillAlpha(i % 3 == 0 ? 1.0 : i % 3 == 1 ? 0.6 : 0.25);
+        const double x = random.nextDouble(150);
+        const double y = random.nextDouble(90);
+        const double w = 0.3 + random.nextDouble(i % 2 ? 4 : 80);
+        SplashPath path;
+        path.moveTo(x, y);
+        path.lineTo(x + w, y + random.nextDouble(3));
+        path.lineTo(x + w * 0.7 + random.nextDouble(10), y + 5 + random.nextDouble(20));
+        path.close();
+        splash->fill(&path, false);
+    }
+
+    // glyphs that are entirely inside the clip rectangle
+    std::vector<unsigned char> glyphData(37 * 9);
+    fillShape(&random, glyphData.data(), (int)glyphData.size());
+    SplashGlyphBitmap glyph;
+    glyph.x = 0;
+    glyph.y = 0;
+    glyph.w = 37;
+    glyph.h = 9;
+    glyph.aa = true;
+    glyph.data = glyphData.data();
+    glyph.freeData = false;
+    for (int i = 0; i < 24; ++i) {
+        for (int k = 0; k < nComps; ++k) {
+            color[k] = random.nextByte();
+        }
+        splash->setFillPattern(new SplashSolidColor(color));
+        splash->setFillAlpha(i % 2 ? 1.0 : 0.5);
+        splash->fillGlyph(1 + i * 5 + random.nextDouble(1), 2 + (i % 8) * 11, &glyph);
+    }
+}
+
+static std::unique_ptr<SplashBitmap> render(SplashColorMode mode, int nComps, bool useKernel, SplashSpanImpl impl)
+{
+    // Mono1 has no alpha channel, its antialiased pipe doesn't use one
+    auto bitmap = std::make_unique<SplashBitmap>(203, 97, 1, mode, mode != splashModeMono1);
+    Splash splash(bitmap.get(), true);
+    splash.setCompositeAASpanFunc(useKernel ? splashGetCompositeAASpanFunc(mode, impl) : nullptr);
+    drawScene(&splash, nComps);
+    return bitmap;
+}
+
+static bool sameBitmaps(SplashBitmap *a, SplashBitmap *b)
+{
+    const size_t size = (size_t)a->getRowSize() * a->getHeight();
+    if (memcmp(a->getDataPtr(), b->getDataPtr(), size) != 0) {
+        return false;
+    }
+    return !a->getAlphaPtr() || memcmp(a->getAlphaPtr(), b->getAlphaPtr(), (size_t)a->getWidth() * a->getHeight()) == 0;
+}
+
+int main()
+{
+    int numChecks = 0;
+    int numFailures = checkKernels(&numChecks);
+
+    for (const auto &m : modes) {
+        std::unique_ptr<SplashBitmap> ref = render(m.mode, m.nComps, false, splashSpanImplScalar);
+        for (const auto &impl : impls) {
+            if (!splashGetCompositeAASpanFunc(m.mode, impl.impl) && impl.impl != splashSpanImplScalar) {
+                continue;
+            }
+            std::unique_ptr<SplashBitmap> bitmap = render(m.mode, m.nComps, true, impl.impl);
+            ++numChecks;
+            if (!sameBitmaps(ref.get(), bitmap.get())) {
+                fprintf(stderr, "%s: drawing with the %s span kernel differs from the pipe\n", m.name, impl.name);
+                ++numFailures;
+            }
+        }
+    }
+
+    printf("%d spans and renderings compared, best kernel %s: %d mismatches\n", numChecks, impls[splashGetBestSpanImpl()].name, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
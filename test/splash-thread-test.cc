@@ -0,0 +1,163 @@
+//========================================================================
+//
+// splash-thread-test.cc
+//
+// Renders all pages of a single PDFDoc from several threads at once and
+// checks that every page comes out the same as when rendered alone: once
+// starting on a freshly opened document, with nothing loaded or cached
+// yet, and then on a document whose pages have all been rendered.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdint>
+#include <cstdio>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "splash/SplashBitmap.h"
+#include "utils/parseargs.h"
+
+static int numThreads = 8;
+static int numPasses = 2;
+static double resolution = 72;
+static bool printHelp = false;
+
+static const ArgDesc argDesc[] = { { "-j", argInt, &numThreads, 0, "number of rendering threads (default 8)" },
+                                   { "-n", argInt, &numPasses, 0, "number of times each thread renders every page (default 2)" },
+                                   { "-r", argFP, &resolution, 0, "resolution, in DPI (default 72)" },
+                                   { "-h", argFlag, &printHelp, 0, "print usage information" },
+                                   { "-help", argFlag, &printHelp, 0, "print usage information" },
+                                   { "--help", argFlag, &printHelp, 0, "print usage information" },
+                                   { "-?", argFlag, &printHelp, 0, "print usage information" },
+                                   {} };
+
+static uint64_t hashBitmap(SplashBitmap *bitmap)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const int rowBytes = bitmap->getWidth() * 3;
+    for (int y = 0; y < bitmap->getHeight(); ++y) {
+        const unsigned char *p = bitmap->getDataPtr() + (size_t)y * bitmap->getRowSize();
+        for (int x = 0; x < rowBytes; ++x) {
+            h = (h ^ p[x]) * 0x100000001b3ULL;
+        }
+    }
+    return h;
+}
+
+static std::unique_ptr<SplashOutputDev> createOutputDev(PDFDoc *doc)
+{
+    SplashColor paperColor = { 0xff, 0xff, 0xff };
+    auto out = std::make_unique<SplashOutputDev>(splashModeRGB8, 4, false, paperColor);
+    out->startDoc(doc);
+    return out;
+}
+
+static uint64_t renderPage(PDFDoc *doc, SplashOutputDev *out, int page)
+{
+    doc->displayPage(out, page, resolution, resolution, 0, false, true, false);
+    return hashBitmap(out->getBitmap());
+}
+
+int main(int argc, char *argv[])
+{
+    const bool ok = parseArgs(argDesc, &argc, argv);
+    if (!ok || argc != 2 || printHelp || numThreads < 1 || numPasses < 1) {
+        printUsage(argv[0], "PDF-FILE", argDesc);
+        return printHelp ? 0 : 1;
+    }
+
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    // Cold start: all threads start rendering together on a document that
+    // hasn't loaded a page, font or image yet, each at a different page.
+    PDFDoc coldDoc(std::make_unique<GooString>(argv[1]));
+    if (!coldDoc.isOk()) {
+        fprintf(stderr, "Error opening PDF file %s\n", argv[1]);
+        return 1;
+    }
+    const int numPages = coldDoc.getNumPages();
+    std::vector<std::vector<uint64_t>> coldHashes(numThreads, std::vector<uint64_t>(numPages));
+    {
+        std::latch start(numThreads);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numThreads; ++t) {
+            threads.emplace_back([&coldDoc, &coldHashes, &start, numPages, t] {
+                std::unique_ptr<SplashOutputDev> out = createOutputDev(&coldDoc);
+                start.arrive_and_wait();
+                for (int i = 0; i < numPages; ++i) {
+                    const int page = (t + i) % numPages + 1;
+                    coldHashes[t][page - 1] = renderPage(&coldDoc, out.get(), page);
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    PDFDoc doc(std::make_unique<GooString>(argv[1]));
+    if (!doc.isOk()) {
+        fprintf(stderr, "Error opening PDF file %s\n", argv[1]);
+        return 1;
+    }
+
+    // reference rendering, one page at a time
+    std::vector<uint64_t> expected(numPages);
+    {
+        std::unique_ptr<SplashOutputDev> out = createOutputDev(&doc);
+        for (int page = 1; page <= numPages; ++page) {
+            expected[page - 1] = renderPage(&doc, out.get(), page);
+        }
+    }
+
+    int numColdFailures = 0;
+    for (int t = 0; t < numThreads; ++t) {
+        for (int page = 1; page <= numPages; ++page) {
+            if (coldHashes[t][page - 1] != expected[page - 1]) {
+                fprintf(stderr, "Thread %d: page %d rendered on a cold document differs from the reference rendering\n", t, page);
+                ++numColdFailures;
+            }
+        }
+    }
+
+    // Every thread renders every page, starting at a different one, so
+    // that some threads render different pages and some the same page at
+    // the same time.
+    std::vector<int> failures(numThreads, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&doc, &expected, &failures, numPages, t] {
+            std::unique_ptr<SplashOutputDev> out = createOutputDev(&doc);
+            for (int pass = 0; pass < numPasses; ++pass) {
+                for (int i = 0; i < numPages; ++i) {
+                    const int page = (t + i) % numPages + 1;
+                    if (renderPage(&doc, out.get(), page) != expected[page - 1]) {
+                        fprintf(stderr, "Thread %d: page %d differs from the reference rendering\n", t, page);
+                        ++failures[t];
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    int numFailures = numColdFailures;
+    for (int n : failures) {
+        numFailures += n;
+    }
+    printf("%d threads rendered %d pages %d times each after a cold start: %d mismatches\n", numThreads, numPages, numPasses + 1, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+//========================================================================
+//
+// splash-tiled-test.cc
+//
+// Checks that SplashOutputDev::displayPageSliceTiled() produces the same
+// bitmap, byte for byte, as rendering the page in a single pass, for
+// every color mode and a few band counts.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "splash/SplashBitmap.h"
+#include "test-pdf-builder.h"
+
+static std::string pageContent()
+{
+    std::string content;
+    // overlapping antialiased triangles
+    for (int i = 0; i < 60; ++i) {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%.3f %.3f %.3f rg %d %d m %d %d l %d %d l f\n", (i * 37 % 100) / 100.0, (i * 59 % 100) / 100.0, (i * 17 % 100) / 100.0, (i * 97) % 612, (i * 131) % 792, (i * 53 + 200) % 612, (i * 71 + 300) % 792,
+                 (i * 29 + 400) % 612, (i * 43 + 100) % 792);
+        content += buf;
+    }
+    // strokes and curves crossing the band boundaries
+    content += "0 0 1 RG 3 w 20 20 m 300 780 500 10 590 770 c S\n";
+    content += "1 0 0 RG 0.3 w 10 400 m 600 401 l S\n";
+    content += "[6 3] 0 d 0 1 0 RG 2 w 50 50 500 700 re S [] 0 d\n";
+    // a shading
+    content += "q 100 100 200 500 re W n /Sh1 sh Q\n";
+    // a transparent fill in a group
+    content += "q /GS1 gs 0.2 0.4 0.8 rg 150 150 300 500 re f Q\n";
+    // an interpolated inline image
+    content += "q 200 0 0 300 350 200 cm BI /W 4 /H 4 /BPC 8 /CS /RGB /I true ID\n";
+    for (int i = 0; i < 16; ++i) {
+        content += (char)(i * 16);
+        content += (char)(255 - i * 16);
+        content += (char)(i * 7);
+    }
+    content += "\nEI Q\n";
+    content += "BT /F1 36 Tf 72 700 Td (Tiled rendering) Tj ET\n";
+    return content;
+}
+
+static bool sameBitmaps(SplashBitmap *a, SplashBitmap *b)
+{
+    if (a->getWidth() != b->getWidth() || a->getHeight() != b->getHeight() || a->getMode() != b->getMode() || a->getRowSize() != b->getRowSize()) {
+        return false;
+    }
+    // the row padding isn't initialized
+    size_t rowBytes = 0;
+    switch (a->getMode()) {
+    case splashModeMono1:
+        rowBytes = (a->getWidth() + 7) / 8;
+        break;
+    case splashModeMono8:
+        rowBytes = a->getWidth();
+        break;
+    case splashModeRGB8:
+    case splashModeBGR8:
+        rowBytes = (size_t)a->getWidth() * 3;
+        break;
+    case splashModeXBGR8:
+    case splashModeCMYK8:
+        rowBytes = (size_t)a->getWidth() * 4;
+        break;
+    case splashModeDeviceN8:
+        rowBytes = (size_t)a->getWidth() * (SPOT_NCOMPS + 4);
+        break;
+    }
+    for (int y = 0; y < a->getHeight(); ++y) {
+        const size_t offset = (size_t)y * a->getRowSize();
+        if (memcmp(a->getDataPtr() + offset, b->getDataPtr() + offset, rowBytes) != 0) {
+            return false;
+        }
+    }
+    if ((a->getAlphaPtr() == nullptr) != (b->getAlphaPtr() == nullptr)) {
+        return false;
+    }
+    return !a->getAlphaPtr() || memcmp(a->getAlphaPtr(), b->getAlphaPtr(), (size_t)a->getWidth() * a->getHeight()) == 0;
+}
+
+static std::unique_ptr<SplashOutputDev> createOutputDev(PDFDoc *doc, SplashColorMode mode, bool antialias, int tileThreads)
+{
+    // white paper, which is no ink in CMYK
+    SplashColor paperColor;
+    memset(paperColor, mode == splashModeCMYK8 ? 0x00 : 0xff, sizeof(paperColor));
+    auto out = std::make_unique<SplashOutputDev>(mode, 4, false, paperColor);
+    out->setFontAntialias(antialias);
+    out->setVectorAntialias(antialias);
+    out->setTileThreads(tileThreads);
+    out->startDoc(doc);
+    return out;
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    TestPdfBuilder builder;
+    const int shading = builder.addObject("<< /ShadingType 2 /ColorSpace /DeviceRGB /Coords [100 100 300 600] /Function << /FunctionType 2 /Domain [0 1] /C0 [1 0 0] /C1 [0 0 1] /N 1 >> /Extend [true true] >>");
+    const int gs = builder.addObject("<< /Type /ExtGState /ca 0.5 /BM /Multiply >>");
+    builder.addPage(pageContent(), "/Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /Helvetica >> >> /Shading << /Sh1 " + std::to_string(shading) + " 0 R >> /ExtGState << /GS1 " + std::to_string(gs) + " 0 R >>");
+    const std::string fileName = testTempFileName("tiled.pdf");
+    if (!builder.write(fileName)) {
+        return 1;
+    }
+    std::unique_ptr<PDFDoc> doc = testOpenPdf(fileName);
+    if (!doc) {
+        return 1;
+    }
+
+    const struct
+    {
+        SplashColorMode mode;
+        const char *name;
+    } modes[] = { { splashModeMono1, "Mono1" }, { splashModeMono8, "Mono8" }, { splashModeRGB8, "RGB8" }, { splashModeBGR8, "BGR8" }, { splashModeXBGR8, "XBGR8" }, { splashModeCMYK8, "CMYK8" } };
+    // from 300 DPI on Mono1 output uses a random halftone screen
+    const double resolutions[] = { 72, 113 };
+    const int threadCounts[] = { 2, 3, 7 };
+
+    int numFailures = 0;
+    int numChecks = 0;
+    for (const auto &m : modes) {
+        for (double dpi : resolutions) {
+            for (bool antialias : { false, true }) {
+                std::unique_ptr<SplashOutputDev> ref = createOutputDev(doc.get(), m.mode, antialias, 1);
+                doc->displayPageSlice(ref.get(), 1, dpi, dpi, 0, true, false, false, -1, -1, -1, -1);
+                for (int threads : threadCounts) {
+                    std::unique_ptr<SplashOutputDev> tiled = createOutputDev(doc.get(), m.mode, antialias, threads);
+                    tiled->displayPageSliceTiled(doc.get(), 1, dpi, dpi, 0, true, false, false, -1, -1, -1, -1);
+                    ++numChecks;
+                    if (!sameBitmaps(ref->getBitmap(), tiled->getBitmap())) {
+                        fprintf(stderr, "%s, %g DPI, antialias %s, %d threads: tiled rendering differs from single pass rendering\n", m.name, dpi, antialias ? "on" : "off", threads);
+                        ++numFailures;
+                    }
+                }
+                // a slice that doesn't start at the page origin
+                std::unique_ptr<SplashOutputDev> refSlice = createOutputDev(doc.get(), m.mode, antialias, 1);
+                doc->displayPageSlice(refSlice.get(), 1, dpi, dpi, 0, true, false, false, 13, 37, 200, 301);
+                std::unique_ptr<SplashOutputDev> tiledSlice = createOutputDev(doc.get(), m.mode, antialias, 4);
+                tiledSlice->displayPageSliceTiled(doc.get(), 1, dpi, dpi, 0, true, false, false, 13, 37, 200, 301);
+                ++numChecks;
+                if (!sameBitmaps(refSlice->getBitmap(), tiledSlice->getBitmap())) {
+                    fprintf(stderr, "%s, %g DPI, antialias %s: tiled slice differs from single pass rendering\n", m.name, dpi, antialias ? "on" : "off");
+                    ++numFailures;
+                }
+            }
+        }
+    }
+
+    doc.reset();
+    remove(fileName.c_str());
+    printf("%d tiled renderings compared: %d mismatches\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+//========================================================================
+//
+// test-pdf-builder.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <cstdio>
+#include <filesystem>
+
+#ifdef _WIN32
+#    include <process.h>
+#    define getpid _getpid
+#else
+#    include <unistd.h>
+#endif
+
+#include "goo/GooString.h"
+#include "PDFDoc.h"
+#include "test-pdf-builder.h"
+
+TestPdfBuilder::TestPdfBuilder()
+{
+    // the catalog and the page tree are filled in by build()
+    objects.emplace_back();
+    objects.emplace_back();
+}
+
+int TestPdfBuilder::addObject(const std::string &body)
+{
+    objects.push_back(body);
+    return (int)objects.size();
+}
+
+int TestPdfBuilder::addStream(const std::string &dict, const std::string &data)
+{
+    return addObject("<< " + dict + " /Length " + std::to_string(data.size()) + " >>\nstream\n" + data + "\nendstream");
+}
+
+int TestPdfBuilder::addPage(const std::string &content, const std::string &resources, const std::string &entries)
+{
+    const int contents = addStream(std::string(), content);
+    pages.push_back(addObject("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources << " + resources + " >> /Contents " + std::to_string(contents) + " 0 R " + entries + ">>"));
+    return pages.back();
+}
+
+std::string TestPdfBuilder::build() const
+{
+    std::vector<std::string> objs = objects;
+    objs[0] = "<< /Type /Catalog /Pages 2 0 R " + catalogEntries + " >>";
+    std::string kids;
+    for (int page : pages) {
+        kids += std::to_string(page) + " 0 R ";
+    }
+    objs[1] = "<< /Type /Pages /Kids [ " + kids + "] /Count " + std::to_string(pages.size()) + " >>";
+
+    std::string out = "%PDF-1.7\n%\xe2\xe3\xcf\xd3\n";
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < objs.size(); ++i) {
+        offsets.push_back(out.size());
+        out += std::to_string(i + 1) + " 0 obj\n" + objs[i] + "\nendobj\n";
+    }
+    const size_t xrefOffset = out.size();
+    out += "xref\n0 " + std::to_string(objs.size() + 1) + "\n0000000000 65535 f \n";
+    for (size_t offset : offsets) {
+        char entry[32];
+        snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+        out += entry;
+    }
+    out += "trailer\n<< /Size " + std::to_string(objs.size() + 1) + " /Root 1 0 R " + trailerEntries + " >>\nstartxref\n" + std::to_string(xrefOffset) + "\n%%EOF\n";
+    return out;
+}
+
+bool TestPdfBuilder::write(const std::string &path) const
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f) {
+        fprintf(stderr, "Couldn't create %s\n", path.c_str());
+        return false;
+    }
+    const std::string data = build();
+    const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+}
+
+std::string testTempFileName(const std::string &suffix)
+{
+    std::error_code ec;
+    std::filesystem::path dir = std::filesystem::temp_directory_path(ec);
+    if (ec) {
+        dir = ".";
+    }
+    return (dir / ("poppler-test-" + std::to_string(getpid()) + "-" + suffix)).string();
+}
+
+std::unique_ptr<PDFDoc> testOpenPdf(const std::string &path)
+{
+    auto doc = std::make_unique<PDFDoc>(std::make_unique<GooString>(path));
+    if (!doc->isOk()) {
+        fprintf(stderr, "Error opening %s\n", path.c_str());
+        return nullptr;
+    }
+    return doc;
+}
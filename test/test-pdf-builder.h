@@ -0,0 +1,69 @@
+//========================================================================
+//
+// test-pdf-builder.h
+//
+// Writes small PDF files from content streams, so that the test programs
+// in this directory don't depend on the external test data.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef TEST_PDF_BUILDER_H
+#define TEST_PDF_BUILDER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class PDFDoc;
+
+class TestPdfBuilder
+{
+public:
+    TestPdfBuilder();
+
+    // Adds an indirect object and returns its object number.  <body> is
+    // written between "obj" and "endobj".
+    int addObject(const std::string &body);
+
+    // Replaces the body of object <num>, for objects that refer to each
+    // other.
+    void setObject(int num, const std::string &body) { objects[num - 1] = body; }
+
+    // Adds a stream object; <dict> are the dictionary entries except
+    // /Length, without the << >>.
+    int addStream(const std::string &dict, const std::string &data);
+
+    // Adds a 612x792 page and returns its object number.  <resources> are
+    // the entries of its resource dictionary, and <entries> further
+    // entries of the page dictionary, without the << >>.
+    int addPage(const std::string &content, const std::string &resources = std::string(), const std::string &entries = std::string());
+
+    // Adds entries, without the << >>, to the catalog.
+    void addCatalogEntries(const std::string &entries) { catalogEntries += entries; }
+
+    // Adds entries, without the << >>, to the trailer.
+    void addTrailerEntries(const std::string &entries) { trailerEntries += entries; }
+
+    // Returns the file, with a classic xref table.
+    std::string build() const;
+
+    // Writes the file to <path>.
+    bool write(const std::string &path) const;
+
+private:
+    std::vector<std::string> objects; // objects[0] is object 1
+    std::vector<int> pages;
+    std::string catalogEntries;
+    std::string trailerEntries;
+};
+
+// Returns a path in the temporary directory that is unique to this
+// process, ending in <suffix>.
+std::string testTempFileName(const std::string &suffix);
+
+// Opens <path>, prints an error and returns nullptr if that fails.
+std::unique_ptr<PDFDoc> testOpenPdf(const std::string &path);
+
+#endif
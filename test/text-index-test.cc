@@ -0,0 +1,323 @@
+//========================================================================
+//
+// text-index-test.cc
+//
+// Builds a TextIndex of a small document, checks what it finds against
+// TextPage::findText(), and that an index saved and loaded again finds
+// the same.  Then loads damaged copies of the saved index: truncated,
+// with tables outside of the file, with counts that overflow, and with
+// records that point outside of their tables.  Each must be rejected,
+// and every copy with one word changed must either be rejected or be
+// safe to search.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "TextIndex.h"
+#include "TextOutputDev.h"
+#include "UTF.h"
+#include "test-pdf-builder.h"
+
+// the header of the index, in 32 bit words, see TextIndex.cc
+enum
+{
+    hdrMagic,
+    hdrVersion,
+    hdrNumPages,
+    hdrNumTerms,
+    hdrTerms,
+    hdrNumOccurrences,
+    hdrOccurrences,
+    hdrNumEdges,
+    hdrEdges,
+    hdrStrings,
+    hdrStringsSize,
+    hdrLength
+};
+static const int termWords = 5;
+static const int occurrenceWords = 6;
+
+static const char *const queries[] = { "fox", "quick brown", "resume", "RÉSUMÉ", "naive cafe", "brown", "the", "dog", "vertical", "up the side", "nothing here" };
+
+static int numChecks = 0;
+static int numFailures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    ++numChecks;
+    if (!ok) {
+        fprintf(stderr, "%s\n", what.c_str());
+        ++numFailures;
+    }
+}
+
+static bool buildDocument(const std::string &path)
+{
+    TestPdfBuilder builder;
+    const std::string resources = "/Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >> >>";
+    builder.addPage("BT /F1 12 Tf 72 700 Td (The quick brown fox jumps over the lazy dog.) Tj ET\n"
+                    "BT /F1 12 Tf 72 680 Td (R\\351sum\\351, na\\357ve caf\\351) Tj ET\n",
+                    resources);
+    builder.addPage("BT /F1 12 Tf 72 700 Td (Brown bread and a quick brownie) Tj ET\n"
+                    "BT /F1 12 Tf 0 1 -1 0 300 300 Tm (vertical text up the side) Tj ET\n",
+                    resources);
+    builder.addPage("BT /F1 10 Tf 72 700 Td (the end, the dog) Tj ET\n", resources);
+    return builder.write(path);
+}
+
+static std::vector<Unicode> toUnicode(const std::string &s)
+{
+    return utf8ToUCS4(s);
+}
+
+static bool sameMatches(const std::vector<TextIndex::Match> &a, const std::vector<TextIndex::Match> &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].page != b[i].page || a[i].rects.size() != b[i].rects.size()) {
+            return false;
+        }
+        for (size_t j = 0; j < a[i].rects.size(); ++j) {
+            const PDFRectangle &r = a[i].rects[j], &s = b[i].rects[j];
+            if (r.x1 != s.x1 || r.y1 != s.y1 || r.x2 != s.x2 || r.y2 != s.y2) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static std::vector<TextIndex::Match> find(const TextIndex *index, const std::string &query, bool prefix = false)
+{
+    const std::vector<Unicode> u = toUnicode(query);
+    return index->find(u.data(), u.size(), prefix);
+}
+
+// the matches of <word> on <page> as TextPage::findText() finds them
+static std::vector<PDFRectangle> findOnPage(PDFDoc *doc, int page, const std::string &word)
+{
+    TextOutputDev out(nullptr, false, 0, false, false);
+    doc->displayPage(&out, page, 72, 72, 0, false, true, false);
+    const std::vector<Unicode> u = toUnicode(word);
+    std::vector<PDFRectangle> rects;
+    PDFRectangle r;
+    while (out.findText(u.data(), u.size(), rects.empty(), true, !rects.empty(), false, false, false, true, &r.x1, &r.y1, &r.x2, &r.y2)) {
+        rects.push_back(r);
+    }
+    return rects;
+}
+
+static bool near(const PDFRectangle &a, const PDFRectangle &b)
+{
+    return std::abs(a.x1 - b.x1) < 0.01 && std::abs(a.y1 - b.y1) < 0.01 && std::abs(a.x2 - b.x2) < 0.01 && std::abs(a.y2 - b.y2) < 0.01;
+}
+
+static void checkIndex(const TextIndex *index, PDFDoc *doc)
+{
+    check(index->getNumPages() == 3, "wrong number of pages");
+
+    // single words where TextPage::findText() finds them
+    const char *const words[] = { "fox", "brown", "lazy", "the", "vertical" };
+    for (const char *word : words) {
+        std::vector<PDFRectangle> expected;
+        std::vector<int> expectedPages;
+        for (int page = 1; page <= 3; ++page) {
+            for (const PDFRectangle &r : findOnPage(doc, page, word)) {
+                expected.push_back(r);
+                expectedPages.push_back(page);
+            }
+        }
+        const std::vector<TextIndex::Match> matches = find(index, word);
+        bool same = !expected.empty() && matches.size() == expected.size();
+        for (size_t i = 0; same && i < matches.size(); ++i) {
+            same = matches[i].page == expectedPages[i] && matches[i].rects.size() == 1 && near(matches[i].rects[0], expected[i]);
+        }
+        check(same, std::string("the matches of \"") + word + "\" differ from TextPage::findText()");
+    }
+
+    // phrases, prefixes and folding
+    std::vector<TextIndex::Match> m = find(index, "quick brown");
+    check(m.size() == 1 && m[0].page == 1 && m[0].rects.size() == 2, "\"quick brown\" not found once");
+    m = find(index, "quick brown", true);
+    check(m.size() == 2 && m[0].page == 1 && m[1].page == 2, "\"quick brown\" as a prefix not found twice");
+    const std::vector<TextIndex::Match> brownie = find(index, "brownie");
+    check(m.size() == 2 && m[1].rects.size() == 2 && brownie.size() == 1 && m[1].rects[1].x1 == brownie[0].rects[0].x1 && m[1].rects[1].x2 < brownie[0].rects[0].x2, "the prefix match doesn't cover just the prefix");
+    check(find(index, "resume").size() == 1 && sameMatches(find(index, "resume"), find(index, "RÉSUMÉ,")), "\"resume\" doesn't match \"Résumé,\"");
+    check(find(index, "naive cafe").size() == 1, "\"naive cafe\" not found");
+    check(find(index, "up the side").size() == 1 && find(index, "up the side")[0].page == 2, "vertical phrase not found");
+    check(find(index, "brown fox dog").empty() && find(index, "nothing").empty() && find(index, "").empty() && find(index, ", .").empty(), "found what isn't there");
+}
+
+static std::vector<uint32_t> readIndex(const std::string &path)
+{
+    std::ifstream f(path, std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    std::vector<uint32_t> words(data.size() / 4);
+    memcpy(words.data(), data.data(), words.size() * 4);
+    return words;
+}
+
+static void writeBytes(const std::string &path, const void *data, size_t size)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f) {
+        fwrite(data, 1, size, f);
+        fclose(f);
+    }
+}
+
+static std::unique_ptr<TextIndex> loadWords(const std::string &path, const std::vector<uint32_t> &words)
+{
+    writeBytes(path, words.data(), words.size() * 4);
+    return TextIndex::load(path);
+}
+
+// Each change of <words> must make the index fail to load.
+static void checkRejected(const std::string &path, const std::vector<uint32_t> &words, const char *what, const std::vector<std::pair<size_t, uint32_t>> &changes)
+{
+    std::vector<uint32_t> damaged = words;
+    for (const auto &change : changes) {
+        damaged[change.first] = change.second;
+    }
+    check(!loadWords(path, damaged), std::string("loaded an index with ") + what);
+}
+
+static void checkDamaged(const std::string &path, const std::vector<uint32_t> &words)
+{
+    const std::string damagedPath = path + ".damaged";
+
+    // truncated
+    for (size_t bytes : { (size_t)0, (size_t)3, (size_t)4, (size_t)hdrLength * 4 - 4, (size_t)hdrLength * 4, words.size() * 4 - 4, words.size() * 4 - 1, words.size() * 4 + 1 }) {
+        std::vector<uint32_t> data = words;
+        data.push_back(0);
+        writeBytes(damagedPath, data.data(), bytes);
+        check(!TextIndex::load(damagedPath), "loaded an index of " + std::to_string(bytes) + " bytes");
+    }
+
+    const uint32_t size = words.size();
+    const uint32_t terms = words[hdrTerms], occurrences = words[hdrOccurrences];
+    checkRejected(damagedPath, words, "a bad magic number", { { hdrMagic, words[hdrMagic] ^ 0xff000000 } });
+    checkRejected(damagedPath, words, "a bad version", { { hdrVersion, words[hdrVersion] + 1 } });
+
+    // tables outside of the index, over the header or each other
+    for (int table : { hdrTerms, hdrOccurrences, hdrEdges, hdrStrings }) {
+        for (uint32_t offset : { 0u, (uint32_t)hdrLength - 1, size, size + 1, 0x7fffffffu, 0xffffffffu }) {
+            checkRejected(damagedPath, words, ("table " + std::to_string(table) + " at " + std::to_string(offset)).c_str(), { { table, offset } });
+        }
+    }
+    checkRejected(damagedPath, words, "strings past the end", { { hdrStrings, size - 1 } });
+
+    // counts that overflow when multiplied by the size of a record
+    checkRejected(damagedPath, words, "an overflowing number of terms", { { hdrNumTerms, 0x80000000u / termWords * 2 + 1 } });
+    checkRejected(damagedPath, words, "an overflowing number of occurrences", { { hdrNumOccurrences, 0xffffffffu / occurrenceWords + 1 } });
+    for (int count : { hdrNumTerms, hdrNumOccurrences, hdrNumEdges, hdrStringsSize }) {
+        // the strings are padded to whole words
+        const uint32_t more = count == hdrStringsSize ? 4 : 1;
+        checkRejected(damagedPath, words, ("count " + std::to_string(count) + " too large").c_str(), { { count, words[count] + more } });
+        checkRejected(damagedPath, words, ("count " + std::to_string(count) + " too small").c_str(), { { count, words[count] - more } });
+        checkRejected(damagedPath, words, ("count " + std::to_string(count) + " of 0xffffffff").c_str(), { { count, 0xffffffffu } });
+    }
+
+    // term records out of their tables
+    const uint32_t lastTerm = terms + (words[hdrNumTerms] - 1) * termWords;
+    checkRejected(damagedPath, words, "a term string past the strings", { { lastTerm, words[hdrStringsSize] } });
+    checkRejected(damagedPath, words, "an overflowing term string", { { lastTerm, 1 }, { lastTerm + 1, 0xffffffffu } });
+    checkRejected(damagedPath, words, "an empty term", { { terms + 1, 0 } });
+    checkRejected(damagedPath, words, "occurrences past the table", { { lastTerm + 4, words[lastTerm + 4] + 1 } });
+    checkRejected(damagedPath, words, "overflowing occurrences", { { lastTerm + 4, 0xffffffffu } });
+    checkRejected(damagedPath, words, "overlapping occurrences", { { terms + termWords + 3, 0 } });
+    checkRejected(damagedPath, words, "a term of 0xffffffff characters", { { terms + 2, 0xffffffffu } });
+    checkRejected(damagedPath, words, "a term with more characters than edges", { { lastTerm + 2, words[hdrNumEdges] } });
+    checkRejected(damagedPath, words, "unsorted terms", { { terms, words[terms + termWords] }, { terms + 1, words[terms + termWords + 1] } });
+
+    // occurrence records out of their tables
+    const uint32_t lastOccurrence = occurrences + (words[hdrNumOccurrences] - 1) * occurrenceWords;
+    checkRejected(damagedPath, words, "edges past the table", { { lastOccurrence + 5, words[hdrNumEdges] } });
+    checkRejected(damagedPath, words, "overflowing edges", { { lastOccurrence + 5, 0xffffffffu } });
+    checkRejected(damagedPath, words, "page 0", { { occurrences, 0 } });
+    checkRejected(damagedPath, words, "a page past the last", { { occurrences, words[hdrNumPages] + 1 } });
+    checkRejected(damagedPath, words, "a bad rotation", { { occurrences + 2, 4 } });
+
+    // any one word changed: rejected, or safe to search
+    int numLoaded = 0;
+    for (size_t i = 0; i < words.size(); ++i) {
+        for (uint32_t value : { 0u, 1u, words[i] + 1, words[i] - 1, 0x7fffffffu, 0xffffffffu }) {
+            std::vector<uint32_t> damaged = words;
+            damaged[i] = value;
+            std::unique_ptr<TextIndex> index = loadWords(damagedPath, damaged);
+            if (index) {
+                ++numLoaded;
+                for (const char *query : queries) {
+                    find(index.get(), query);
+                    find(index.get(), query, true);
+                }
+            }
+        }
+    }
+    check(numLoaded > 0, "no index with a changed word loaded");
+    std::remove(damagedPath.c_str());
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    const std::string pdfPath = testTempFileName("text-index.pdf");
+    const std::string indexPath = testTempFileName("text-index.idx");
+    const std::string resavedPath = testTempFileName("text-index-resaved.idx");
+    if (!buildDocument(pdfPath)) {
+        return 1;
+    }
+    std::unique_ptr<PDFDoc> doc = testOpenPdf(pdfPath);
+    if (!doc) {
+        return 1;
+    }
+
+    std::unique_ptr<TextIndex> built = TextIndex::build(doc.get());
+    if (!built) {
+        fprintf(stderr, "can't build the index\n");
+        return 1;
+    }
+    checkIndex(built.get(), doc.get());
+
+    // saved and loaded again
+    check(built->save(indexPath), "can't save the index");
+    std::unique_ptr<TextIndex> loaded = TextIndex::load(indexPath);
+    check(loaded != nullptr, "can't load the saved index");
+    if (loaded) {
+        checkIndex(loaded.get(), doc.get());
+        check(loaded->getSize() == built->getSize() && loaded->getNumTerms() == built->getNumTerms(), "the loaded index differs in size");
+        for (const char *query : queries) {
+            check(sameMatches(find(built.get(), query), find(loaded.get(), query)) && sameMatches(find(built.get(), query, true), find(loaded.get(), query, true)), std::string("the loaded index finds \"") + query + "\" elsewhere");
+        }
+        check(loaded->save(resavedPath) && readIndex(resavedPath) == readIndex(indexPath), "the loaded index saves differently");
+    }
+
+    checkDamaged(indexPath, readIndex(indexPath));
+
+    std::remove(pdfPath.c_str());
+    std::remove(indexPath.c_str());
+    std::remove(resavedPath.c_str());
+
+    printf("%d text index checks: %d failures\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
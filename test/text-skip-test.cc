@@ -0,0 +1,298 @@
+//========================================================================
+//
+// text-skip-test.cc
+//
+// Checks the text that pdftotext gets from pages with the content that
+// Gfx skips for devices that only need text: paths, shadings, patterns,
+// inline image data (with and without a length, and with one that is
+// wrong), and forms without text.  The text must be the expected one,
+// and the same as that of a device that needs everything, in each of
+// the pdftotext modes.  Forms that only draw paths must still be run
+// for the underlines of the HTML mode.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "TextOutputDev.h"
+#include "test-pdf-builder.h"
+
+// A TextOutputDev that makes Gfx run everything, for reference
+class FullTextOutputDev : public TextOutputDev
+{
+public:
+    using TextOutputDev::TextOutputDev;
+
+    bool needNonText() override { return true; }
+    bool needPaths() override { return true; }
+};
+
+static const char *const font = "/Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /Helvetica >> >>";
+
+// 8x2 pixels, 8 bits gray: 16 bytes of data
+static const std::string imageData = "0123456789abcdef";
+
+// The inline images, each followed by a line of text that must not be
+// lost.  The ones with a wrong /L, or with 'EI' in their data, have to
+// be decoded to find their end, except for the /L that ends right
+// before an 'EI' in the data: the rest of the data is then taken for
+// operators, which must not upset the text after it.
+static std::string inlineImages(int y)
+{
+    const std::string image = "/W 8 /H 2 /BPC 8 /CS /G";
+    const std::string withEI = "0123 EI 789abcde";
+    const std::string hexData = "303132333435363738396162636465 66>";
+    const char *const texts[] = { "after no length", "after a length", "after /Length", "after a short length", "after a long length", "after EI in the data", "after a wrong EI", "after a filter" };
+    const std::string images[] = {
+        "BI " + image + " ID " + imageData + "\nEI\n",
+        "BI " + image + " /L 16 ID " + imageData + "\nEI\n",
+        "BI " + image + " /Length 16 ID " + imageData + " EI\n",
+        "BI " + image + " /L 4 ID " + imageData + "\nEI\n",
+        "BI " + image + " /L 60 ID " + imageData + "\nEI\n",
+        "BI " + image + " /L 16 ID " + withEI + "\nEI\n",
+        "BI " + image + " /L 5 ID " + withEI + "\nEI\n",
+        "BI " + image + " /F /AHx /L " + std::to_string(hexData.size()) + " ID " + hexData + "\nEI\n",
+    };
+    std::string content;
+    for (int i = 0; i < 8; ++i) {
+        content += "q 80 0 0 20 300 " + std::to_string(y - 20 * i) + " cm " + images[i] + "Q\n";
+        content += "BT /F1 10 Tf 72 " + std::to_string(y - 20 * i) + " Td (" + texts[i] + ") Tj ET\n";
+    }
+    return content;
+}
+
+static std::string toHex(const std::string &s)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned char c : s) {
+        hex.push_back(digits[c >> 4]);
+        hex.push_back(digits[c & 15]);
+    }
+    return hex + ">";
+}
+
+static bool buildDocument(const std::string &path)
+{
+    TestPdfBuilder builder;
+
+    // paths, and text in a clip
+    builder.addPage("0 0 1 rg 50 50 200 200 re f\n"
+                    "BT /F1 12 Tf 72 700 Td (Paths before) Tj ET\n"
+                    "72 690 m 300 690 l 300 600 400 600 400 500 c h S\n"
+                    "72 640 150 60 re W n\n"
+                    "BT /F1 12 Tf 72 670 Td (inside a clip) Tj ET\n"
+                    "100 100 m 200 200 250 250 v 300 300 350 350 y B*\n"
+                    "BT /F1 12 Tf 72 650 Td (after the paths) Tj ET\n",
+                    font);
+
+    // shadings and patterns
+    const int pattern = builder.addStream("/PatternType 1 /PaintType 1 /TilingType 1 /BBox [0 0 20 20] /XStep 20 /YStep 20 /Resources << >>", "0 0 1 rg 0 0 10 10 re f");
+    builder.addPage("BT /F1 12 Tf 72 700 Td (Shadings before) Tj ET\n"
+                    "q 0 0 612 300 re W n /Sh0 sh Q\n"
+                    "/Pattern cs /P0 scn /Pattern CS /P0 SCN 100 100 300 300 re B\n"
+                    "BT /F1 12 Tf 72 680 Td (in a pattern color) Tj ET\n"
+                    "0 g BT /F1 12 Tf 72 660 Td (after the shadings) Tj ET\n",
+                    std::string(font) + " /Shading << /Sh0 << /ShadingType 2 /ColorSpace /DeviceRGB /Coords [0 0 612 0] /Function << /FunctionType 2 /Domain [0 1] /C0 [1 0 0] /C1 [0 0 1] /N 1 >> >> >> /Pattern << /P0 "
+                            + std::to_string(pattern) + " 0 R >>");
+
+    // inline images, in a plain content stream and in a filtered one
+    builder.addPage(inlineImages(700), font);
+    const int page = builder.addPage(std::string(), font);
+    const std::string hex = toHex(inlineImages(700));
+    builder.setObject(page - 1, "<< /Filter /ASCIIHexDecode /Length " + std::to_string(hex.size()) + " >>\nstream\n" + hex + "\nendstream");
+
+    // forms: without text, with text, with text in a nested form, with
+    // only an image, and one with the line under the text
+    const std::string formDict = "/Type /XObject /Subtype /Form /BBox [0 0 612 792]";
+    const int paths = builder.addStream(formDict, "0 0 1 RG 72 500 m 500 500 l S 100 100 200 200 re f");
+    const int text = builder.addStream(formDict + " /Resources << " + font + " >>", "BT /F1 12 Tf 72 600 Td (in a form) Tj ET");
+    const int nested = builder.addStream(formDict + " /Resources << /XObject << /Fm0 " + std::to_string(text) + " 0 R >> >>", "q 1 0 0 1 0 -20 cm /Fm0 Do Q");
+    const int image = builder.addStream("/Type /XObject /Subtype /Image /Width 8 /Height 2 /BitsPerComponent 8 /ColorSpace /DeviceGray", imageData);
+    const int imageOnly = builder.addStream(formDict + " /Resources << /XObject << /Im0 " + std::to_string(image) + " 0 R >> >>", "q 80 0 0 20 300 300 cm /Im0 Do Q");
+    const int underline = builder.addStream(formDict, "0.5 w 72 548 m 150 548 l S");
+    builder.addPage("BT /F1 12 Tf 72 700 Td (Forms before) Tj ET\n"
+                    "/Fm0 Do /Fm1 Do /Fm2 Do /Fm3 Do\n"
+                    "BT /F1 12 Tf 72 550 Td (underlined) Tj ET\n"
+                    "/Fm4 Do\n"
+                    "BT /F1 12 Tf 72 520 Td (after the forms) Tj ET\n",
+                    std::string(font) + " /XObject << /Fm0 " + std::to_string(paths) + " 0 R /Fm1 " + std::to_string(text) + " 0 R /Fm2 " + std::to_string(nested) + " 0 R /Fm3 " + std::to_string(imageOnly) + " 0 R /Fm4 "
+                            + std::to_string(underline) + " 0 R >>");
+
+    return builder.write(path);
+}
+
+// The text of pdftotext, and of pdftotext -raw
+static const char *const expectedText = "Paths before\n"
+                                        "inside a clip\n"
+                                        "after the paths\n"
+                                        "\n"
+                                        "\f"
+                                        "Shadings before\n"
+                                        "in a pattern color\n"
+                                        "after the shadings\n"
+                                        "\n"
+                                        "\f"
+                                        "after no length\n"
+                                        "after a length\n"
+                                        "after /Length\n"
+                                        "after a short length\n"
+                                        "after a long length\n"
+                                        "after EI in the data\n"
+                                        "after a wrong EI\n"
+                                        "after a filter\n"
+                                        "\n"
+                                        "\f"
+                                        "after no length\n"
+                                        "after a length\n"
+                                        "after /Length\n"
+                                        "after a short length\n"
+                                        "after a long length\n"
+                                        "after EI in the data\n"
+                                        "after a wrong EI\n"
+                                        "after a filter\n"
+                                        "\n"
+                                        "\f"
+                                        "Forms before\n"
+                                        "\n"
+                                        "in a form\n"
+                                        "in a form\n"
+                                        "underlined\n"
+                                        "after the forms\n"
+                                        "\n"
+                                        "\f";
+
+static const char *const expectedRawText = "Paths before\n"
+                                           "inside a clip\n"
+                                           "after the paths\n"
+                                           "\f"
+                                           "Shadings before\n"
+                                           "in a pattern color\n"
+                                           "after the shadings\n"
+                                           "\f"
+                                           "after no length\n"
+                                           "after a length\n"
+                                           "after /Length\n"
+                                           "after a short length\n"
+                                           "after a long length\n"
+                                           "after EI in the data\n"
+                                           "after a wrong EI\n"
+                                           "after a filter\n"
+                                           "\f"
+                                           "after no length\n"
+                                           "after a length\n"
+                                           "after /Length\n"
+                                           "after a short length\n"
+                                           "after a long length\n"
+                                           "after EI in the data\n"
+                                           "after a wrong EI\n"
+                                           "after a filter\n"
+                                           "\f"
+                                           "Forms before\n"
+                                           "in a form\n"
+                                           "in a form\n"
+                                           "underlined\n"
+                                           "after the forms\n"
+                                           "\f";
+
+static void appendText(void *stream, const char *text, int len)
+{
+    static_cast<std::string *>(stream)->append(text, len);
+}
+
+// As pdftotext, with <physLayout> for -layout and <rawOrder> for -raw
+template<class Dev>
+static std::string documentText(PDFDoc *doc, bool physLayout, bool rawOrder)
+{
+    std::string text;
+    Dev out(appendText, &text, physLayout, 0, rawOrder);
+    doc->displayPages(&out, 1, doc->getNumPages(), 72, 72, 0, true, false, false);
+    return text;
+}
+
+// Is the word <s> of the last page underlined in the HTML mode?
+template<class Dev>
+static bool isUnderlined(PDFDoc *doc, const char *s)
+{
+    Dev out(nullptr, false, 0, false, false);
+    out.enableHTMLExtras(true);
+    doc->displayPage(&out, doc->getNumPages(), 72, 72, 0, true, false, false);
+    std::unique_ptr<TextWordList> words = out.makeWordList();
+    for (int i = 0; i < words->getLength(); ++i) {
+        const TextWord *word = words->get(i);
+        if (std::unique_ptr<GooString>(word->getText())->toStr() == s) {
+            return word->isUnderlined();
+        }
+    }
+    return false;
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    const std::string path = testTempFileName("text-skip.pdf");
+    if (!buildDocument(path)) {
+        return 1;
+    }
+    std::unique_ptr<PDFDoc> doc = testOpenPdf(path);
+    if (!doc) {
+        return 1;
+    }
+
+    int numChecks = 0, numFailures = 0;
+    const struct
+    {
+        const char *name;
+        bool physLayout, rawOrder;
+        const char *expected;
+    } modes[] = { { "default", false, false, expectedText }, { "-layout", true, false, nullptr }, { "-raw", false, true, expectedRawText } };
+    for (const auto &mode : modes) {
+        const std::string text = documentText<TextOutputDev>(doc.get(), mode.physLayout, mode.rawOrder);
+        const std::string fullText = documentText<FullTextOutputDev>(doc.get(), mode.physLayout, mode.rawOrder);
+        ++numChecks;
+        if (text != fullText) {
+            fprintf(stderr, "%s: the text differs from the one with everything run:\n%s\n---\n%s\n", mode.name, text.c_str(), fullText.c_str());
+            ++numFailures;
+        }
+        if (mode.expected) {
+            ++numChecks;
+            if (text != mode.expected) {
+                fprintf(stderr, "%s: the text differs from the expected one:\n%s\n", mode.name, text.c_str());
+                ++numFailures;
+            }
+        }
+    }
+
+    ++numChecks;
+    if (!isUnderlined<FullTextOutputDev>(doc.get(), "underlined")) {
+        fprintf(stderr, "The underline isn't found with everything run\n");
+        ++numFailures;
+    }
+    ++numChecks;
+    if (!isUnderlined<TextOutputDev>(doc.get(), "underlined")) {
+        fprintf(stderr, "The underline drawn by a form isn't found\n");
+        ++numFailures;
+    }
+    ++numChecks;
+    if (isUnderlined<TextOutputDev>(doc.get(), "after")) {
+        fprintf(stderr, "A word is underlined that isn't\n");
+        ++numFailures;
+    }
+
+    doc.reset();
+    std::remove(path.c_str());
+
+    printf("%d checks: %d failures\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+//========================================================================
+//
+// text-thread-test.cc
+//
+// Extracts and searches the text of a single PDFDoc from several threads
+// at once, the way the Qt frontend's Document::search() does on its
+// worker threads while the application calls Page::text() on another
+// one, and checks that every page gives the same text and matches as
+// when done alone.  The pages share a font and a form XObject and have
+// annotations, which are loaded by whichever thread gets to them first.
+// Built with ThreadSanitizer, this is the data race check for them.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <atomic>
+#include <cstdio>
+#include <latch>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "TextOutputDev.h"
+#include "test-pdf-builder.h"
+
+static const int numPages = 24;
+static const int numSearchThreads = 4;
+static const int numTextThreads = 2;
+static const int numPasses = 2;
+
+struct Match
+{
+    double xMin, yMin, xMax, yMax;
+
+    bool operator==(const Match &other) const = default;
+};
+
+static bool buildDocument(const std::string &path)
+{
+    TestPdfBuilder builder;
+    const int font = builder.addObject("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>");
+    const int form = builder.addStream("/Type /XObject /Subtype /Form /BBox [0 0 612 100] /Resources << /Font << /F1 " + std::to_string(font) + " 0 R >> >>",
+                                       "BT /F1 10 Tf 72 40 Td (This form is shared by every page) Tj ET");
+    const std::string resources = "/Font << /F1 " + std::to_string(font) + " 0 R /F2 << /Type /Font /Subtype /Type1 /BaseFont /Times-Roman >> >> /XObject << /Fm0 " + std::to_string(form) + " 0 R >>";
+    for (int i = 1; i <= numPages; ++i) {
+        const std::string n = std::to_string(i);
+        std::string content = "BT /F1 14 Tf 72 720 Td (Page " + n + " is here) Tj ET\n";
+        for (int line = 0; line < i % 5 + 3; ++line) {
+            content += "BT /F2 11 Tf 72 " + std::to_string(680 - 16 * line) + " Td (Line " + std::to_string(line) + " of page " + n + ": this is some text, it is searched) Tj ET\n";
+        }
+        content += "q 1 0 0 1 0 " + std::to_string(20 * (i % 4)) + " cm /Fm0 Do Q\n";
+        const int appearance = builder.addStream("/Type /XObject /Subtype /Form /BBox [0 0 200 30] /Resources << /Font << /F1 " + std::to_string(font) + " 0 R >> >>", "BT /F1 9 Tf 4 10 Td (Note " + n + " is an annotation) Tj ET");
+        const int annot = builder.addObject("<< /Type /Annot /Subtype /Square /Rect [300 300 500 330] /AP << /N " + std::to_string(appearance) + " 0 R >> >>");
+        builder.addPage(content, resources, "/Annots [ " + std::to_string(annot) + " 0 R ]");
+    }
+    return builder.write(path);
+}
+
+// As Page::text() of the Qt frontend: the text of the whole page
+static std::string pageText(PDFDoc *doc, int page)
+{
+    TextOutputDev out(nullptr, false, 0, false, false);
+    doc->displayPageSlice(&out, page, 72, 72, 0, false, true, false, -1, -1, -1, -1, nullptr, nullptr, nullptr, nullptr, true);
+    const PDFRectangle *box = doc->getPage(page)->getCropBox();
+    return out.getText(box->x1, box->y1, box->x2, box->y2).toStr();
+}
+
+static bool shouldAbort(void *data)
+{
+    return *static_cast<std::atomic_bool *>(data);
+}
+
+// As a worker of Document::search() of the Qt frontend: all matches of
+// "is" on the page
+static std::vector<Match> searchPage(PDFDoc *doc, int page, std::atomic_bool *stop)
+{
+    TextOutputDev out(nullptr, true, 0, false, false);
+    doc->displayPage(&out, page, 72, 72, 0, false, true, false, shouldAbort, stop, nullptr, nullptr, true);
+    TextPage *textPage = out.takeText();
+    const Unicode s[] = { 'i', 's' };
+    std::vector<Match> matches;
+    Match m = { 0, 0, 0, 0 };
+    while (textPage->findText(s, 2, false, true, !matches.empty(), false, true, false, false, &m.xMin, &m.yMin, &m.xMax, &m.yMax)) {
+        matches.push_back(m);
+    }
+    textPage->decRefCnt();
+    return matches;
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+    globalParams->setErrQuiet(true);
+
+    const std::string path = testTempFileName("text-thread.pdf");
+    if (!buildDocument(path)) {
+        return 1;
+    }
+
+    // reference text and matches, one page at a time
+    std::vector<std::string> expectedText(numPages);
+    std::vector<std::vector<Match>> expectedMatches(numPages);
+    {
+        std::unique_ptr<PDFDoc> doc = testOpenPdf(path);
+        if (!doc) {
+            return 1;
+        }
+        std::atomic_bool stop { false };
+        for (int page = 1; page <= numPages; ++page) {
+            expectedText[page - 1] = pageText(doc.get(), page);
+            expectedMatches[page - 1] = searchPage(doc.get(), page, &stop);
+        }
+    }
+    if (expectedMatches[0].size() < 3 || expectedText[0].find("shared by every page") == std::string::npos || expectedText[0].find("annotation") == std::string::npos) {
+        fprintf(stderr, "The reference text is incomplete\n");
+        return 1;
+    }
+
+    // Every pass starts on a freshly opened document, with nothing loaded
+    // yet.  The search threads take the next page nobody has started, the
+    // text threads go through all pages from the last one.
+    int numFailures = 0;
+    for (int pass = 0; pass < numPasses; ++pass) {
+        std::unique_ptr<PDFDoc> doc = testOpenPdf(path);
+        if (!doc) {
+            return 1;
+        }
+        std::vector<std::vector<Match>> matches(numPages);
+        std::vector<std::vector<std::string>> texts(numTextThreads, std::vector<std::string>(numPages));
+        std::atomic<int> nextPage { 0 };
+        std::atomic_bool stop { false };
+        std::latch start(numSearchThreads + numTextThreads);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numSearchThreads; ++t) {
+            threads.emplace_back([&] {
+                start.arrive_and_wait();
+                for (int page; (page = nextPage++) < numPages;) {
+                    matches[page] = searchPage(doc.get(), page + 1, &stop);
+                }
+            });
+        }
+        for (int t = 0; t < numTextThreads; ++t) {
+            threads.emplace_back([&, t] {
+                start.arrive_and_wait();
+                for (int page = numPages; page >= 1; --page) {
+                    texts[t][page - 1] = pageText(doc.get(), page);
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+
+        for (int page = 1; page <= numPages; ++page) {
+            if (matches[page - 1] != expectedMatches[page - 1]) {
+                fprintf(stderr, "Pass %d: the matches on page %d differ from the reference\n", pass, page);
+                ++numFailures;
+            }
+            for (int t = 0; t < numTextThreads; ++t) {
+                if (texts[t][page - 1] != expectedText[page - 1]) {
+                    fprintf(stderr, "Pass %d, text thread %d: the text of page %d differs from the reference\n", pass, t, page);
+                    ++numFailures;
+                }
+            }
+        }
+    }
+    std::remove(path.c_str());
+
+    printf("%d search and %d text threads on %d pages, %d times: %d mismatches\n", numSearchThreads, numTextThreads, numPages, numPasses, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
@@ -21,6 +21,11 @@
 #include <cstdlib>
 #include <cstddef>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
 #include "parseargs.h"
 #include "goo/GooString.h"
 #include "PDFDoc.h"
@@ -31,11 +36,13 @@
 
 static int firstPage = 0;
 static int lastPage = 0;
+static int numberOfJobs = 1;
 static bool printVersion = false;
 static bool printHelp = false;
 
 static const ArgDesc argDesc[] = { { "-f", argInt, &firstPage, 0, "first page to extract" },
                                    { "-l", argInt, &lastPage, 0, "last page to extract" },
+                                   { "-j", argInt, &numberOfJobs, 0, "number of pages to extract concurrently (0 = one per CPU core)" },
                                    { "-v", argFlag, &printVersion, 0, "print copyright and version info" },
                                    { "-h", argFlag, &printHelp, 0, "print usage information" },
                                    { "-help", argFlag, &printHelp, 0, "print usage information" },
@@ -43,9 +50,30 @@ static const ArgDesc argDesc[] = { { "-f", argInt, &firstPage, 0, "first page to
                                    { "-?", argFlag, &printHelp, 0, "print usage information" },
                                    {} };
 
-static bool extractPages(const char *srcFileName, const char *destFileName)
+static std::atomic<int> nextPageNo = 0;
+static std::atomic<bool> extractFailed = false;
+
+// Each worker saves pages from its own PDFDoc, as savePageAs() changes the
+// document while it works.  Pages are handed out in order and the first
+// failure stops all workers.
+static void extractPageJobs(PDFDoc *doc, const char *destFileName)
 {
     char pathName[4096];
+
+    while (!extractFailed) {
+        const int pageNo = nextPageNo++;
+        if (pageNo > lastPage) {
+            return;
+        }
+        snprintf(pathName, sizeof(pathName) - 1, destFileName, pageNo);
+        if (doc->savePageAs(GooString(pathName), pageNo) != errNone) {
+            extractFailed = true;
+        }
+    }
+}
+
+static bool extractPages(const char *srcFileName, const char *destFileName)
+{
     PDFDoc *doc = new PDFDoc(std::make_unique<GooString>(srcFileName));
 
     if (!doc->isOk()) {
@@ -117,19 +145,35 @@ static bool extractPages(const char *srcFileName, const char *destFileName)
     }
     free(auxDestFileName);
 
-    for (int pageNo = firstPage; pageNo <= lastPage; pageNo++) {
-        snprintf(pathName, sizeof(pathName) - 1, destFileName, pageNo);
-        PDFDoc *pagedoc = new PDFDoc(std::make_unique<GooString>(srcFileName));
-        int errCode = pagedoc->savePageAs(GooString(pathName), pageNo);
-        if (errCode != errNone) {
+    if (numberOfJobs <= 0) {
+        numberOfJobs = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    numberOfJobs = std::min(numberOfJobs, lastPage - firstPage + 1);
+
+    // every additional worker gets its own copy of the document
+    std::vector<std::unique_ptr<PDFDoc>> workerDocs;
+    for (int i = 1; i < numberOfJobs; ++i) {
+        std::unique_ptr<PDFDoc> workerDoc = std::make_unique<PDFDoc>(std::make_unique<GooString>(srcFileName));
+        if (!workerDoc->isOk()) {
             delete doc;
-            delete pagedoc;
             return false;
         }
-        delete pagedoc;
+        workerDocs.push_back(std::move(workerDoc));
+    }
+
+    nextPageNo = firstPage;
+    std::vector<std::thread> workers;
+    workers.reserve(workerDocs.size());
+    for (const std::unique_ptr<PDFDoc> &workerDoc : workerDocs) {
+        workers.emplace_back(extractPageJobs, workerDoc.get(), destFileName);
+    }
+    // the main thread works on the pages too, using the document opened above
+    extractPageJobs(doc, destFileName);
+    for (std::thread &worker : workers) {
+        worker.join();
     }
     delete doc;
-    return true;
+    return !extractFailed;
 }
 
 static constexpr int kOtherError = 99;
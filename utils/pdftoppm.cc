@@ -50,8 +50,13 @@
 #    include <fcntl.h> // for O_BINARY
 #    include <io.h> // for _setmode
 #endif
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
 #include "parseargs.h"
 #include "goo/gmem.h"
 #include "goo/GooString.h"
@@ -67,18 +72,6 @@
 #include "numberofcharacters.h"
 #include "sanitychecks.h"
 
-// Uncomment to build pdftoppm with pthreads
-// You may also have to change the buildsystem to
-// link pdftoppm to pthread library
-// This is here for developer testing not user ready
-// #define UTILS_USE_PTHREADS 1
-
-#ifdef UTILS_USE_PTHREADS
-#    include <cerrno>
-#    include <pthread.h>
-#    include <deque>
-#endif // UTILS_USE_PTHREADS
-
 #ifdef USE_CMS
 #    include <lcms2.h>
 #endif
@@ -137,9 +130,10 @@ static char userPassword[33] = "";
 static char TiffCompressionStr[16] = "";
 static char thinLineModeStr[8] = "";
 static SplashThinLineMode thinLineMode = splashThinLineDefault;
-#ifdef UTILS_USE_PTHREADS
 static int numberOfJobs = 1;
-#endif // UTILS_USE_PTHREADS
+static int tileThreads = 1;
+static bool mapFiles = false;
+static int jpxThreads = -1;
 static bool quiet = false;
 static bool progress = false;
 static bool printVersion = false;
@@ -199,9 +193,10 @@ static const ArgDesc argDesc[] = { { "-f", argInt, &firstPage, 0, "first page to
                                    { "-opw", argString, ownerPassword, sizeof(ownerPassword), "owner password (for encrypted files)" },
                                    { "-upw", argString, userPassword, sizeof(userPassword), "user password (for encrypted files)" },
 
-#ifdef UTILS_USE_PTHREADS
-                                   { "-j", argInt, &numberOfJobs, 0, "number of jobs to run concurrently" },
-#endif // UTILS_USE_PTHREADS
+                                   { "-j", argInt, &numberOfJobs, 0, "number of pages to render concurrently (0 = one per CPU core)" },
+                                   { "-tile-threads", argInt, &tileThreads, 0, "number of threads rendering horizontal bands of each page" },
+                                   { "-mmap", argFlag, &mapFiles, 0, "read the PDF file through a memory mapping" },
+                                   { "-jpx-threads", argInt, &jpxThreads, 0, "number of threads decoding each JPX image (0 = one per CPU core)" },
 
                                    { "-q", argFlag, &quiet, 0, "don't print any messages or errors" },
                                    { "-progress", argFlag, &progress, 0, "print progress info" },
@@ -280,7 +275,7 @@ static bool parseJpegOptions()
 
 static auto annotDisplayDecideCbk = [](Annot *annot, void *user_data) { return !hideAnnotations; };
 
-static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x, int y, int w, int h, double pg_w, double pg_h, char *ppmFile)
+static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x, int y, int w, int h, double pg_w, double pg_h, double xResolution, double yResolution, const char *ppmFile)
 {
     if (w == 0) {
         w = (int)ceil(pg_w);
@@ -290,7 +285,7 @@ static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x
     }
     w = (x + w > pg_w ? (int)ceil(pg_w - x) : w);
     h = (y + h > pg_h ? (int)ceil(pg_h - y) : h);
-    doc->displayPageSlice(splashOut, pg, x_resolution, y_resolution, 0, !useCropBox, false, false, x, y, w, h, nullptr, nullptr, annotDisplayDecideCbk, nullptr);
+    splashOut->displayPageSliceTiled(doc, pg, xResolution, yResolution, 0, !useCropBox, false, false, x, y, w, h, nullptr, nullptr, annotDisplayDecideCbk, nullptr);
 
     SplashBitmap *bitmap = splashOut->getBitmap();
 
@@ -304,13 +299,13 @@ static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x
         SplashError e;
 
         if (png) {
-            e = bitmap->writeImgFile(splashFormatPng, ppmFile, x_resolution, y_resolution);
+            e = bitmap->writeImgFile(splashFormatPng, ppmFile, xResolution, yResolution);
         } else if (jpeg) {
-            e = bitmap->writeImgFile(splashFormatJpeg, ppmFile, x_resolution, y_resolution, &params);
+            e = bitmap->writeImgFile(splashFormatJpeg, ppmFile, xResolution, yResolution, &params);
         } else if (jpegcmyk) {
-            e = bitmap->writeImgFile(splashFormatJpegCMYK, ppmFile, x_resolution, y_resolution, &params);
+            e = bitmap->writeImgFile(splashFormatJpegCMYK, ppmFile, xResolution, yResolution, &params);
         } else if (tiff) {
-            e = bitmap->writeImgFile(splashFormatTiff, ppmFile, x_resolution, y_resolution, &params);
+            e = bitmap->writeImgFile(splashFormatTiff, ppmFile, xResolution, yResolution, &params);
         } else {
             e = bitmap->writePNMFile(ppmFile);
         }
@@ -324,11 +319,11 @@ static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x
 #endif
 
         if (png) {
-            bitmap->writeImgFile(splashFormatPng, stdout, x_resolution, y_resolution);
+            bitmap->writeImgFile(splashFormatPng, stdout, xResolution, yResolution);
         } else if (jpeg) {
-            bitmap->writeImgFile(splashFormatJpeg, stdout, x_resolution, y_resolution, &params);
+            bitmap->writeImgFile(splashFormatJpeg, stdout, xResolution, yResolution, &params);
         } else if (tiff) {
-            bitmap->writeImgFile(splashFormatTiff, stdout, x_resolution, y_resolution, &params);
+            bitmap->writeImgFile(splashFormatTiff, stdout, xResolution, yResolution, &params);
         } else {
             bitmap->writePNMFile(stdout);
         }
@@ -339,76 +334,62 @@ static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x
     }
 }
 
-#ifdef UTILS_USE_PTHREADS
-
+// All the parameters needed to render one page; the resolution is part of
+// the job since -scale-to computes it per page
 struct PageJob
 {
-    PDFDoc *doc;
     int pg;
 
     double pg_w, pg_h;
-    SplashColor *paperColor;
+    double x_resolution, y_resolution;
 
-    char *ppmFile;
+    std::string ppmFile; // empty when writing to stdout
 };
 
-static std::deque<PageJob> pageJobQueue;
-static pthread_mutex_t pageJobMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<PageJob> pageJobs;
+static std::atomic<size_t> nextPageJob = 0;
 
-static void processPageJobs()
+static std::unique_ptr<SplashOutputDev> createSplashOutputDev(PDFDoc *doc, SplashColorPtr paperColor)
 {
-    while (true) {
-        // pop the next job or exit if queue is empty
-        pthread_mutex_lock(&pageJobMutex);
+    auto splashOut = std::make_unique<SplashOutputDev>(mono ? splashModeMono1 : gray ? splashModeMono8 : (jpegcmyk || overprint) ? splashModeDeviceN8 : splashModeRGB8, 4, false, paperColor, true, thinLineMode, splashOverprintPreview);
 
-        if (pageJobQueue.empty()) {
-            pthread_mutex_unlock(&pageJobMutex);
+    splashOut->setFontAntialias(fontAntialias);
+    splashOut->setVectorAntialias(vectorAntialias);
+    splashOut->setEnableFreeType(enableFreeType);
+    splashOut->setTileThreads(tileThreads);
+#ifdef USE_CMS
+    splashOut->setDisplayProfile(displayprofile);
+    splashOut->setDefaultGrayProfile(defaultgrayprofile);
+    splashOut->setDefaultRGBProfile(defaultrgbprofile);
+    splashOut->setDefaultCMYKProfile(defaultcmykprofile);
+#endif
+    splashOut->startDoc(doc);
+    return splashOut;
+}
+
+// Each worker owns its PDFDoc and SplashOutputDev so that nothing but
+// the (read only) job list is shared between threads. Jobs are handed
+// out in page order, output file names only depend on the page number.
+static void processPageJobs(PDFDoc *doc, SplashColorPtr paperColor)
+{
+    std::unique_ptr<SplashOutputDev> splashOut = createSplashOutputDev(doc, paperColor);
+
+    while (true) {
+        const size_t jobIndex = nextPageJob++;
+        if (jobIndex >= pageJobs.size()) {
             return;
         }
-
-        PageJob pageJob = pageJobQueue.front();
-        pageJobQueue.pop_front();
-
-        pthread_mutex_unlock(&pageJobMutex);
-
-        // process the job
-        SplashOutputDev *splashOut = new SplashOutputDev(mono                              ? splashModeMono1
-                                                                 : gray                    ? splashModeMono8
-                                                                 : (jpegcmyk || overprint) ? splashModeDeviceN8
-                                                                                           : splashModeRGB8,
-                                                         4, false, *pageJob.paperColor, true, thinLineMode, splashOverprintPreview);
-        splashOut->setFontAntialias(fontAntialias);
-        splashOut->setVectorAntialias(vectorAntialias);
-        splashOut->setEnableFreeType(enableFreeType);
-#    ifdef USE_CMS
-        splashOut->setDisplayProfile(displayprofile);
-        splashOut->setDefaultGrayProfile(defaultgrayprofile);
-        splashOut->setDefaultRGBProfile(defaultrgbprofile);
-        splashOut->setDefaultCMYKProfile(defaultcmykprofile);
-#    endif
-        splashOut->startDoc(pageJob.doc);
-
-        savePageSlice(pageJob.doc, splashOut, pageJob.pg, param_x, param_y, param_w, param_h, pageJob.pg_w, pageJob.pg_h, pageJob.ppmFile);
-
-        delete splashOut;
-        delete[] pageJob.ppmFile;
+        const PageJob &job = pageJobs[jobIndex];
+        savePageSlice(doc, splashOut.get(), job.pg, param_x, param_y, param_w, param_h, job.pg_w, job.pg_h, job.x_resolution, job.y_resolution, job.ppmFile.empty() ? nullptr : job.ppmFile.c_str());
     }
 }
 
-#endif // UTILS_USE_PTHREADS
-
 int main(int argc, char *argv[])
 {
     GooString *fileName = nullptr;
     char *ppmRoot = nullptr;
-    char *ppmFile;
     std::optional<GooString> ownerPW, userPW;
     SplashColor paperColor;
-#ifndef UTILS_USE_PTHREADS
-    SplashOutputDev *splashOut;
-#else
-    pthread_t *jobs;
-#endif // UTILS_USE_PTHREADS
     bool ok;
     int pg, pg_num_len;
     double pg_w, pg_h;
@@ -484,6 +465,7 @@ int main(int argc, char *argv[])
     if (quiet) {
         globalParams->setErrQuiet(quiet);
     }
+    globalParams->setMapFiles(mapFiles);
 
     // open PDF file
     if (ownerPassword[0]) {
@@ -501,8 +483,8 @@ int main(int argc, char *argv[])
         fileName = new GooString("fd://0");
     }
     std::unique_ptr<PDFDoc> doc(PDFDocFactory().createPDFDoc(*fileName, ownerPW, userPW));
-    delete fileName;
     if (!doc->isOk()) {
+        delete fileName;
         return 1;
     }
 
@@ -596,23 +578,6 @@ int main(int argc, char *argv[])
     }
 #endif
 
-#ifndef UTILS_USE_PTHREADS
-
-    splashOut = new SplashOutputDev(mono ? splashModeMono1 : gray ? splashModeMono8 : (jpegcmyk || overprint) ? splashModeDeviceN8 : splashModeRGB8, 4, false, paperColor, true, thinLineMode, splashOverprintPreview);
-
-    splashOut->setFontAntialias(fontAntialias);
-    splashOut->setVectorAntialias(vectorAntialias);
-    splashOut->setEnableFreeType(enableFreeType);
-#    ifdef USE_CMS
-    splashOut->setDisplayProfile(displayprofile);
-    splashOut->setDefaultGrayProfile(defaultgrayprofile);
-    splashOut->setDefaultRGBProfile(defaultrgbprofile);
-    splashOut->setDefaultCMYKProfile(defaultcmykprofile);
-#    endif
-    splashOut->startDoc(doc.get());
-
-#endif // UTILS_USE_PTHREADS
-
     if (sz != 0) {
         param_w = param_h = sz;
     }
@@ -678,64 +643,60 @@ int main(int argc, char *argv[])
             std::swap(pg_w, pg_h);
         }
 
+        std::string ppmFile;
         if (ppmRoot != nullptr) {
             const char *ext = png ? "png" : (jpeg || jpegcmyk) ? "jpg" : tiff ? "tif" : mono ? "pbm" : gray ? "pgm" : "ppm";
             if (singleFile && !forceNum) {
-                ppmFile = new char[strlen(ppmRoot) + 1 + strlen(ext) + 1];
-                sprintf(ppmFile, "%s.%s", ppmRoot, ext);
+                ppmFile = std::string(ppmRoot) + "." + ext;
             } else {
-                ppmFile = new char[strlen(ppmRoot) + 1 + pg_num_len + 1 + strlen(ext) + 1];
-                sprintf(ppmFile, "%s%s%0*d.%s", ppmRoot, sep, pg_num_len, pg, ext);
+                std::vector<char> buf(strlen(ppmRoot) + 1 + pg_num_len + 1 + strlen(ext) + 1);
+                snprintf(buf.data(), buf.size(), "%s%s%0*d.%s", ppmRoot, sep, pg_num_len, pg, ext);
+                ppmFile = buf.data();
             }
-        } else {
-            ppmFile = nullptr;
         }
-#ifndef UTILS_USE_PTHREADS
-        // process job in main thread
-        savePageSlice(doc.get(), splashOut, pg, param_x, param_y, param_w, param_h, pg_w, pg_h, ppmFile);
-
-        delete[] ppmFile;
-#else
-
-        // queue job for worker threads
-        PageJob pageJob = { .doc = doc.get(),
-                            .pg = pg,
-
-                            .pg_w = pg_w,
-                            .pg_h = pg_h,
-
-                            .paperColor = &paperColor,
 
-                            .ppmFile = ppmFile };
-
-        pageJobQueue.push_back(pageJob);
-
-#endif // UTILS_USE_PTHREADS
+        pageJobs.push_back(PageJob { .pg = pg, .pg_w = pg_w, .pg_h = pg_h, .x_resolution = x_resolution, .y_resolution = y_resolution, .ppmFile = std::move(ppmFile) });
     }
-#ifndef UTILS_USE_PTHREADS
-    delete splashOut;
-#else
-
-    // spawn worker threads and wait on them
-    jobs = (pthread_t *)malloc(numberOfJobs * sizeof(pthread_t));
 
-    for (int i = 0; i < numberOfJobs; ++i) {
-        if (pthread_create(&jobs[i], NULL, (void *(*)(void *))processPageJobs, NULL) != 0) {
-            fprintf(stderr, "pthread_create() failed with errno: %d\n", errno);
-            exit(EXIT_FAILURE);
+    if (numberOfJobs <= 0) {
+        numberOfJobs = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    numberOfJobs = std::min(numberOfJobs, (int)pageJobs.size());
+    if (numberOfJobs > 1 && (ppmRoot == nullptr || fileName->cmp("fd://0") == 0)) {
+        // pages written to stdout must not interleave and stdin can only be read once
+        if (!quiet) {
+            fprintf(stderr, "Warning: -j is ignored when reading from stdin or writing to stdout.\n");
         }
+        numberOfJobs = 1;
     }
+    // pages or bands rendered concurrently already keep the cores busy
+    if (jpxThreads < 0) {
+        jpxThreads = numberOfJobs == 1 && tileThreads <= 1 ? 0 : 1;
+    }
+    globalParams->setJPXDecodeThreads(jpxThreads);
 
-    for (int i = 0; i < numberOfJobs; ++i) {
-        if (pthread_join(jobs[i], NULL) != 0) {
-            fprintf(stderr, "pthread_join() failed with errno: %d\n", errno);
-            exit(EXIT_FAILURE);
+    // every additional worker gets its own copy of the document
+    std::vector<std::unique_ptr<PDFDoc>> workerDocs;
+    for (int i = 1; i < numberOfJobs; ++i) {
+        std::unique_ptr<PDFDoc> workerDoc = PDFDocFactory().createPDFDoc(*fileName, ownerPW, userPW);
+        if (!workerDoc->isOk()) {
+            delete fileName;
+            return 1;
         }
+        workerDocs.push_back(std::move(workerDoc));
     }
+    delete fileName;
 
-    free(jobs);
-
-#endif // UTILS_USE_PTHREADS
+    std::vector<std::thread> workers;
+    workers.reserve(workerDocs.size());
+    for (const std::unique_ptr<PDFDoc> &workerDoc : workerDocs) {
+        workers.emplace_back(processPageJobs, workerDoc.get(), paperColor);
+    }
+    // the main thread works on the jobs too, using the document opened above
+    processPageJobs(doc.get(), paperColor);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
 
     return 0;
 }
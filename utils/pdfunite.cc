@@ -27,10 +27,14 @@
 #include <poppler-config.h>
 #include <vector>
 
+static bool compress = false;
+static bool deflate = false;
 static bool printVersion = false;
 static bool printHelp = false;
 
-static const ArgDesc argDesc[] = { { "-v", argFlag, &printVersion, 0, "print copyright and version info" }, { "-h", argFlag, &printHelp, 0, "print usage information" }, { "-help", argFlag, &printHelp, 0, "print usage information" },
+static const ArgDesc argDesc[] = { { "-compress", argFlag, &compress, 0, "write the objects into object streams and a compressed xref stream" },
+                                   { "-deflate", argFlag, &deflate, 0, "Flate-compress the streams that have no filter" },
+                                   { "-v", argFlag, &printVersion, 0, "print copyright and version info" }, { "-h", argFlag, &printHelp, 0, "print usage information" }, { "-help", argFlag, &printHelp, 0, "print usage information" },
                                    { "--help", argFlag, &printHelp, 0, "print usage information" },         { "-?", argFlag, &printHelp, 0, "print usage information" }, {} };
 
 static void doMergeNameTree(PDFDoc *doc, XRef *srcXRef, XRef *countRef, int oldRefNum, int newRefNum, Dict *srcNameTree, Dict *mergeNameTree, int numOffset)
@@ -195,6 +199,14 @@ int main(int argc, char *argv[])
     yRef = new XRef();
     countRef = new XRef();
     yRef->add(0, 65535, 0, false);
+    std::unique_ptr<PDFDoc::ObjectStreamWriter> objStms;
+    if (compress) {
+        objStms = std::make_unique<PDFDoc::ObjectStreamWriter>(outStr, yRef, 0);
+        if (majorVersion == 1 && minorVersion < 5) {
+            // object and xref streams need PDF 1.5
+            minorVersion = 5;
+        }
+    }
     PDFDoc::writeHeader(outStr, majorVersion, minorVersion);
 
     // handle OutputIntents, AcroForm, OCProperties & Names
@@ -347,81 +359,110 @@ int main(int argc, char *argv[])
                 }
             }
         }
-        objectsCount += docs[i]->writePageObjects(outStr, yRef, numOffset, true);
+        objectsCount += docs[i]->writePageObjects(outStr, yRef, numOffset, true, objStms.get(), deflate);
         numOffset = yRef->getNumObjects() + 1;
     }
 
     rootNum = yRef->getNumObjects() + 1;
-    yRef->add(rootNum, 0, outStr->getPos(), true);
-    outStr->printf("%d 0 obj\n", rootNum);
-    outStr->printf("<< /Type /Catalog /Pages %d 0 R", rootNum + 1);
+    // the catalog, page tree and pages go into object streams too; reserve
+    // their numbers, so that no object stream gets one of them
+    if (objStms) {
+        yRef->add(rootNum + (int)pages.size() + 1, 0, 0, true);
+    }
+    const auto startObject = [&](int num) {
+        if (objStms) {
+            return objStms->startObject(Ref { num, 0 });
+        }
+        yRef->add(num, 0, outStr->getPos(), true);
+        outStr->printf("%d 0 obj\n", num);
+        return outStr;
+    };
+    const auto endObject = [&](OutStream *objOutStr) {
+        if (objStms) {
+            objStms->endObject();
+        } else {
+            objOutStr->printf("\nendobj\n");
+        }
+    };
+    OutStream *objOutStr = startObject(rootNum);
+    objOutStr->printf("<< /Type /Catalog /Pages %d 0 R", rootNum + 1);
     // insert OutputIntents
     if (intents.isArray() && intents.arrayGetLength() > 0) {
-        outStr->printf(" /OutputIntents [");
+        objOutStr->printf(" /OutputIntents [");
         for (j = 0; j < intents.arrayGetLength(); j++) {
             Object intent = intents.arrayGet(j, 0);
             if (intent.isDict()) {
-                PDFDoc::writeObject(&intent, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+                PDFDoc::writeObject(&intent, objOutStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
             }
         }
-        outStr->printf("]");
+        objOutStr->printf("]");
     }
     // insert AcroForm
     if (!afObj.isNull()) {
-        outStr->printf(" /AcroForm ");
-        PDFDoc::writeObject(&afObj, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+        objOutStr->printf(" /AcroForm ");
+        PDFDoc::writeObject(&afObj, objOutStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
     }
     // insert OCProperties
     if (!ocObj.isNull() && ocObj.isDict()) {
-        outStr->printf(" /OCProperties ");
-        PDFDoc::writeObject(&ocObj, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+        objOutStr->printf(" /OCProperties ");
+        PDFDoc::writeObject(&ocObj, objOutStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
     }
     // insert Names
     if (!names.isNull() && names.isDict()) {
-        outStr->printf(" /Names ");
-        PDFDoc::writeObject(&names, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+        objOutStr->printf(" /Names ");
+        PDFDoc::writeObject(&names, objOutStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
     }
-    outStr->printf(">>\nendobj\n");
+    objOutStr->printf(">>");
+    endObject(objOutStr);
     objectsCount++;
 
-    yRef->add(rootNum + 1, 0, outStr->getPos(), true);
-    outStr->printf("%d 0 obj\n", rootNum + 1);
-    outStr->printf("<< /Type /Pages /Kids [");
+    objOutStr = startObject(rootNum + 1);
+    objOutStr->printf("<< /Type /Pages /Kids [");
     for (j = 0; j < (int)pages.size(); j++) {
-        outStr->printf(" %d 0 R", rootNum + j + 2);
+        objOutStr->printf(" %d 0 R", rootNum + j + 2);
     }
-    outStr->printf(" ] /Count %zd >>\nendobj\n", pages.size());
+    objOutStr->printf(" ] /Count %zd >>", pages.size());
+    endObject(objOutStr);
     objectsCount++;
 
     for (i = 0; i < (int)pages.size(); i++) {
-        yRef->add(rootNum + i + 2, 0, outStr->getPos(), true);
-        outStr->printf("%d 0 obj\n", rootNum + i + 2);
-        outStr->printf("<< ");
+        objOutStr = startObject(rootNum + i + 2);
+        objOutStr->printf("<< ");
         Dict *pageDict = pages[i].getDict();
         for (j = 0; j < pageDict->getLength(); j++) {
             if (j > 0) {
-                outStr->printf(" ");
+                objOutStr->printf(" ");
             }
             const char *key = pageDict->getKey(j);
             Object value = pageDict->getValNF(j).copy();
             if (strcmp(key, "Parent") == 0) {
-                outStr->printf("/Parent %d 0 R", rootNum + 1);
+                objOutStr->printf("/Parent %d 0 R", rootNum + 1);
             } else {
-                outStr->printf("/%s ", key);
-                PDFDoc::writeObject(&value, outStr, yRef, offsets[i], nullptr, cryptRC4, 0, 0, 0);
+                objOutStr->printf("/%s ", key);
+                PDFDoc::writeObject(&value, objOutStr, yRef, offsets[i], nullptr, cryptRC4, 0, 0, 0);
             }
         }
-        outStr->printf(" >>\nendobj\n");
+        objOutStr->printf(" >>");
+        endObject(objOutStr);
         objectsCount++;
     }
-    Goffset uxrefOffset = outStr->getPos();
     Ref ref;
     ref.num = rootNum;
     ref.gen = 0;
-    Object trailerDict = PDFDoc::createTrailerDict(objectsCount, false, 0, &ref, yRef, fileName, outStr->getPos());
-    PDFDoc::writeXRefTableTrailer(std::move(trailerDict), yRef, true, // write all entries according to ISO 32000-1, 7.5.4 Cross-Reference Table: "For a file that has never been incrementally updated, the cross-reference section shall
-                                                                      // contain only one subsection, whose object numbering begins at 0."
-                                  uxrefOffset, outStr, yRef);
+    if (objStms) {
+        objStms->flush();
+        Goffset uxrefOffset = outStr->getPos();
+        Ref uxrefStreamRef = { yRef->getNumObjects(), 0 };
+        yRef->add(uxrefStreamRef, uxrefOffset, true);
+        Object trailerDict = PDFDoc::createTrailerDict(yRef->getNumObjects(), false, 0, &ref, yRef, fileName, uxrefOffset);
+        PDFDoc::writeXRefStreamTrailer(std::move(trailerDict), yRef, &uxrefStreamRef, uxrefOffset, outStr, yRef, true);
+    } else {
+        Goffset uxrefOffset = outStr->getPos();
+        Object trailerDict = PDFDoc::createTrailerDict(objectsCount, false, 0, &ref, yRef, fileName, outStr->getPos());
+        PDFDoc::writeXRefTableTrailer(std::move(trailerDict), yRef, true, // write all entries according to ISO 32000-1, 7.5.4 Cross-Reference Table: "For a file that has never been incrementally updated, the cross-reference section shall
+                                                                          // contain only one subsection, whose object numbering begins at 0."
+                                      uxrefOffset, outStr, yRef);
+    }
 
     outStr->close();
     delete outStr;